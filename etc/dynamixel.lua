@@ -0,0 +1,136 @@
+-- Wireshark dissector for the pcap files written by `monitor -p` and `pcap` (see
+-- `src/pcap_export.h`). Every frame is a link-layer header (bus, flags, reserved) followed by
+-- a raw Dynamixel 2.0 packet. Install it by copying it to Wireshark's personal Lua plugins
+-- directory (`~/.local/lib/wireshark/plugins` on Linux) or load it with
+-- `wireshark -X lua_script:etc/dynamixel.lua capture.pcap`.
+
+local FLAG_MISMATCHED_CHECKSUM = 0x01
+local FLAG_RESYNC = 0x02
+
+local instructions = {
+    [0x01] = "Ping",
+    [0x02] = "Read",
+    [0x03] = "Write",
+    [0x04] = "RegWrite",
+    [0x05] = "Action",
+    [0x06] = "FactoryReset",
+    [0x08] = "Reboot",
+    [0x10] = "Clear",
+    [0x55] = "Status",
+    [0x82] = "SyncRead",
+    [0x83] = "SyncWrite",
+    [0x8a] = "FastSyncRead",
+    [0x92] = "BulkRead",
+    [0x93] = "BulkWrite",
+    [0x9a] = "FastBulkRead",
+}
+
+local link = Proto("dxl_link", "Dynamixel Bus")
+local link_bus = ProtoField.uint8("dxl_link.bus", "Bus", base.DEC)
+local link_flags = ProtoField.uint8("dxl_link.flags", "Flags", base.HEX)
+local link_mismatched_checksum = ProtoField.bool("dxl_link.flags.mismatched_checksum",
+    "Mismatched checksum", 8, nil, FLAG_MISMATCHED_CHECKSUM)
+local link_resync = ProtoField.bool("dxl_link.flags.resync", "Resync", 8, nil, FLAG_RESYNC)
+link.fields = { link_bus, link_flags, link_mismatched_checksum, link_resync }
+
+local dxl = Proto("dynamixel", "Dynamixel Protocol 2.0")
+local dxl_id = ProtoField.uint8("dynamixel.id", "Id", base.DEC)
+local dxl_len = ProtoField.uint16("dynamixel.len", "Length", base.DEC)
+local dxl_instruction = ProtoField.uint8("dynamixel.instruction", "Instruction", base.HEX,
+    instructions)
+local dxl_error = ProtoField.uint8("dynamixel.error", "Error", base.HEX)
+local dxl_params = ProtoField.bytes("dynamixel.params", "Parameters")
+local dxl_addr = ProtoField.uint16("dynamixel.addr", "Address", base.DEC)
+local dxl_data_len = ProtoField.uint16("dynamixel.data_len", "Data length", base.DEC)
+local dxl_checksum = ProtoField.uint16("dynamixel.checksum", "Checksum", base.HEX)
+dxl.fields = { dxl_id, dxl_len, dxl_instruction, dxl_error, dxl_params, dxl_addr, dxl_data_len,
+    dxl_checksum }
+
+local mismatched_checksum = ProtoExpert.new("dxl_link.mismatched_checksum",
+    "Mismatched checksum", expert.group.CHECKSUM, expert.severity.ERROR)
+local resync = ProtoExpert.new("dxl_link.resync", "Bytes before the packet were skipped",
+    expert.group.SEQUENCE, expert.severity.WARN)
+link.experts = { mismatched_checksum, resync }
+
+-- works without the bit operations, which differ between the Lua versions of Wireshark
+local function has_flag(flags, flag)
+    return math.floor(flags / flag) % 2 == 1
+end
+
+function link.dissector(buf, pinfo, tree)
+    if buf:len() < 4 then
+        return 0
+    end
+
+    local flags = buf(1, 1):uint()
+    local subtree = tree:add(link, buf(0, 4))
+    subtree:add(link_bus, buf(0, 1))
+    local flags_tree = subtree:add(link_flags, buf(1, 1))
+    flags_tree:add(link_mismatched_checksum, buf(1, 1))
+    flags_tree:add(link_resync, buf(1, 1))
+
+    if has_flag(flags, FLAG_MISMATCHED_CHECKSUM) then
+        subtree:add_proto_expert_info(mismatched_checksum)
+    end
+
+    if has_flag(flags, FLAG_RESYNC) then
+        subtree:add_proto_expert_info(resync)
+    end
+
+    pinfo.cols.protocol = "Dynamixel"
+    pinfo.cols.src = "bus " .. buf(0, 1):uint()
+    dxl.dissector(buf(4):tvb(), pinfo, tree)
+    return buf:len()
+end
+
+function dxl.dissector(buf, pinfo, tree)
+    -- header, id, length, instruction and checksum
+    if buf:len() < 10 then
+        return 0
+    end
+
+    local subtree = tree:add(dxl, buf())
+    local id = buf(4, 1):uint()
+    local instruction = buf(7, 1):uint()
+    local name = instructions[instruction] or string.format("0x%02x", instruction)
+    subtree:add(dxl_id, buf(4, 1))
+    subtree:add_le(dxl_len, buf(5, 2))
+    subtree:add(dxl_instruction, buf(7, 1))
+
+    local params_start = 8
+    local info = name .. " device " .. id
+
+    if instruction == 0x55 then
+        subtree:add(dxl_error, buf(8, 1))
+        info = info .. " error " .. buf(8, 1):uint()
+        params_start = 9
+    end
+
+    -- the parameters may contain byte stuffing, which is not removed
+    local params_len = buf:len() - 2 - params_start
+
+    if params_len > 0 then
+        local params = subtree:add(dxl_params, buf(params_start, params_len))
+
+        -- the start address of reads and writes, followed by the length for all but writes
+        local has_addr = instruction == 0x02 or instruction == 0x03 or instruction == 0x04
+            or instruction == 0x82 or instruction == 0x83 or instruction == 0x8a
+        local has_data_len = has_addr and instruction ~= 0x03 and instruction ~= 0x04
+
+        if has_addr and params_len >= 2 then
+            params:add_le(dxl_addr, buf(params_start, 2))
+            info = info .. " addr " .. buf(params_start, 2):le_uint()
+        end
+
+        if has_data_len and params_len >= 4 then
+            params:add_le(dxl_data_len, buf(params_start + 2, 2))
+            info = info .. " len " .. buf(params_start + 2, 2):le_uint()
+        end
+    end
+
+    subtree:add_le(dxl_checksum, buf(buf:len() - 2, 2))
+    pinfo.cols.info = info
+    return buf:len()
+end
+
+DissectorTable.get("wtap_encap"):add(wtap.USER0, link)
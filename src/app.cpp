@@ -1,137 +1,80 @@
 #include "app.h"
+#include "apply_stage.h"
+#include "bus_scheduler.h"
+#include "clock.h"
+#include "connection.h"
 #include "control_table.h"
 #include "main.h"
+#include "packet_queue.h"
 #include "parser.h"
+#include "processing_budget.h"
+#include "trace.h"
 #include "ui/run_ui.h"
+#include "wake_policy.h"
+
+#include <algorithm>
 
 #include <FreeRTOS.h>
 #include <task.h>
 
-#include <iomanip>
-#include <sstream>
-
-struct Connection {
-    Connection(ReceiveBuf* buf) :
-        last_processing_start(0),
-        buf(buf),
-        parser(Parser()),
-        last_packet(Packet{
-            DeviceId(0),
-            Instruction::Ping,
-            Error(),
-            std::vector<uint8_t>(),
-        }) {
-        // prevent allocations in the main loop
-        this->last_packet.data.reserve(MAX_PACKET_DATA_LEN);
-    }
+/// The minimum time (in us) between processing partially filled segments at light load. Limits
+/// the number of wakeups if the bus is idle after every packet.
+const uint32_t MIN_PROCESSING_INTERVAL_US = 250;
 
-    uint32_t last_processing_start;
-    ReceiveBuf* buf;
-    Parser parser;
-    Packet last_packet;
-};
-
-static void process_buffer(Mutex<Log>&, Connection&, Mutex<ControlTableMap>&);
-
-Log::Log() :
-    max_buf_processing_time_(0),
-    buf_processing_time_sum(0),
-    num_processed_bufs(0),
-    max_time_between_buf_processing_(0),
-    time_between_buf_processing_sum(0),
-    num_times_between_buf_processing(0) {
-    // make sure no allocations are required in the main loop
-    // since std::deque has no reserve method for some reason, we
-    // have to use resize as a workaround
-    this->records.resize(MAX_NUM_LOG_ENTRIES, Record(ParseResult::PacketAvailable));
-    this->records.shrink_to_fit();
-    this->records.resize(0, Record(ParseResult::PacketAvailable));
-}
+/// The time (in us) after which received data is handed over to the packet task under heavy
+/// load. Determines the handover size (see `WakePolicy`).
+const uint32_t HANDOVER_INTERVAL_US = 2000;
 
-void Log::log(Record record) {
-    if (records.size() >= MAX_NUM_LOG_ENTRIES) {
-        this->records.pop_back();
-    }
+/// The maximum time (in ms) the packet task sleeps without processing.
+const uint32_t MAX_WAIT_MS = 20;
 
-    this->records.push_front(record);
-}
+/// The maximum number of bytes a bus may process before the next bus gets its turn. This is
+/// also the size of the slices after which the packet task may yield to the UI.
+const size_t BUS_QUANTUM = 512;
 
-void Log::buf_processing_time(uint32_t time) {
-    this->max_buf_processing_time_ = std::max(time, this->max_buf_processing_time_);
-    this->buf_processing_time_sum += time;
-    this->num_processed_bufs++;
-}
+/// The period (in us) in which the packet task may use `PACKET_BUDGET_US` (see
+/// `ProcessingBudget`). The UI gets the rest of every period.
+const uint32_t BUDGET_PERIOD_US = 10000;
+const uint32_t PACKET_BUDGET_US = 7000;
 
-void Log::time_between_buf_processing(uint32_t time) {
-    this->max_time_between_buf_processing_ = std::max(time, this->max_time_between_buf_processing_);
-    this->time_between_buf_processing_sum += time;
-    this->num_times_between_buf_processing++;
-}
+/// The headroom (in us) below which the packet task keeps processing regardless of its
+/// budget.
+const uint32_t MIN_HEADROOM_US = 5000;
 
-size_t Log::size() const {
-    return this->records.size();
-}
+/// The maximum number of queued packets the apply task applies while holding the control
+/// table lock. Keeps the time the UI has to wait for the lock short.
+const size_t APPLY_BATCH_LEN = 16;
 
-std::deque<Log::Record>::const_iterator Log::begin() const {
-    return this->records.begin();
-}
+/// The packet task, notified by `notify_packet_task_from_isr`. Not set until the task runs.
+static TaskHandle_t volatile packet_task = nullptr;
 
-std::deque<Log::Record>::const_iterator Log::end() const {
-    return this->records.end();
-}
+static void apply_packets(ApplyStage&, Mutex<ControlTableMap>&);
 
-uint32_t Log::max_buf_processing_time() const {
-    return this->max_buf_processing_time_;
-}
+static size_t process_buses(
+    Log&,
+    const std::vector<ReceiveChannel>&,
+    std::vector<Connection>&,
+    BusScheduler&,
+    ProcessingBudget&,
+    PacketQueue&,
+    ApplyStage&,
+    uint32_t* resume_delay);
 
-float Log::avg_buf_processing_time() const {
-    return (float) this->buf_processing_time_sum / (float) this->num_processed_bufs;
-}
+static int32_t min_headroom(const std::vector<ReceiveChannel>&, const std::vector<Connection>&);
 
-uint32_t Log::max_time_between_buf_processing() const {
-    return this->max_time_between_buf_processing_;
-}
-
-float Log::avg_time_between_buf_processing() const {
-    return (float) this->time_between_buf_processing_sum
-        / (float) this->num_times_between_buf_processing;
-}
-
-std::string to_string(const Log::Record& record) {
-    auto minutes = record.tick / (60 * 1000);
-    auto remaining_millis = record.tick % (60 * 1000);
-    auto seconds = remaining_millis / 1000;
-    remaining_millis = remaining_millis % 1000;
-    auto millis = remaining_millis;
-
-    std::stringstream fmt;
-    fmt << "[+" << std::setfill('0') << std::setw(2) << minutes << ":" << std::setfill('0')
-        << std::setw(2) << seconds << "." << std::setfill('0') << std::setw(3) << std::left
-        << millis << "] error: ";
-
-    switch (record.error_type) {
-        case Log::ErrorType::Parser: {
-            fmt << to_string(record.parse_error);
-            break;
-        }
-        case Log::ErrorType::Protocol: {
-            fmt << to_string(record.protocol_error);
-            break;
-        }
-    }
-
-    return fmt.str();
-}
-
-void run(const std::vector<ReceiveBuf*>& bufs) {
-    Mutex<Log> log;
-    Mutex<ControlTableMap> control_table_map;
+void run(const std::vector<ReceiveChannel>& channels) {
+    // the log's histograms are too large for the task's stack
+    static Log log(channels.size());
+    static PacketQueue queue;
+    static ApplyStage apply_stage(&queue);
+    Mutex<ControlTableMap> control_table_map(channels.size());
 
     void* args[2] = {&log, &control_table_map};
+    void* apply_args[2] = {&apply_stage, &control_table_map};
 
     xTaskCreate(
         [](void* args) {
-            auto log = (Mutex<Log>*) ((void**) args)[0];
+            auto log = (Log*) ((void**) args)[0];
             auto control_table_map = (Mutex<ControlTableMap>*) ((void**) args)[1];
             run_ui(*log, *control_table_map);
         },
@@ -141,83 +84,201 @@ void run(const std::vector<ReceiveBuf*>& bufs) {
         0,
         nullptr);
 
+    // applying packets is less urgent than emptying the receive buffers, but it must keep up
+    // with the packet task, so it runs between the packet task and the UI
+    TaskHandle_t apply_task;
+    xTaskCreate(
+        [](void* args) {
+            auto apply_stage = (ApplyStage*) ((void**) args)[0];
+            auto control_table_map = (Mutex<ControlTableMap>*) ((void**) args)[1];
+            apply_packets(*apply_stage, *control_table_map);
+        },
+        "apply",
+        TASK_STACK_SIZE,
+        apply_args,
+        1,
+        &apply_task);
+
     std::vector<Connection> connections;
-    connections.reserve(bufs.size());
+    connections.reserve(channels.size());
 
-    for (auto buf : bufs) {
-        connections.push_back(Connection(buf));
+    for (size_t bus = 0; bus < channels.size(); bus++) {
+        connections.push_back(Connection(bus, channels[bus].buf, channels[bus].baudrate));
     }
 
+    BusScheduler scheduler(channels.size(), BUS_QUANTUM);
+
+    // all buses use the same segment length. A filled half is processed right away, so the
+    // handover never needs to be larger.
+    auto& buf = *channels.front().buf;
+    WakePolicy wake_policy(
+        MIN_PROCESSING_INTERVAL_US * Clock::TICKS_PER_US,
+        HANDOVER_INTERVAL_US * Clock::TICKS_PER_US,
+        MAX_WAIT_MS * 1000 * Clock::TICKS_PER_US,
+        buf.segment_len(),
+        buf.len() / 2);
+    ProcessingBudget budget(
+        BUDGET_PERIOD_US * Clock::TICKS_PER_US,
+        PACKET_BUDGET_US * Clock::TICKS_PER_US,
+        MIN_HEADROOM_US * Clock::TICKS_PER_US);
+    uint32_t events = 0;
+    uint32_t resume_delay = 0;
+    packet_task = xTaskGetCurrentTaskHandle();
+
     while (true) {
-        for (auto& connection : connections) {
-            if (connection.last_processing_start == 0) {
-                connection.last_processing_start = HAL_GetTick();
+        // after a yield, the timeout wakes the task once it may resume
+        if (wake_policy.wake(events, Clock::counter())) {
+            auto num_bytes = process_buses(
+                log,
+                channels,
+                connections,
+                scheduler,
+                budget,
+                queue,
+                apply_stage,
+                &resume_delay);
+            wake_policy.processed(Clock::counter(), num_bytes);
+
+            if (!queue.is_empty()) {
+                xTaskNotifyGive(apply_task);
             }
+        }
+
+        auto timeout = wake_policy.timeout(Clock::counter());
+
+        if (resume_delay > 0 && resume_delay < timeout) {
+            timeout = resume_delay;
+        }
+
+        // round up, so the task does not wake up before the timeout has expired
+        auto ticks_per_ms = 1000 * Clock::TICKS_PER_US;
+        auto timeout_ms = (timeout + ticks_per_ms - 1) / ticks_per_ms;
 
-            process_buffer(log, connection, control_table_map);
+        if (xTaskNotifyWait(0, UINT32_MAX, &events, timeout_ms / portTICK_PERIOD_MS) != pdTRUE) {
+            events = 0;
         }
+    }
+}
+
+void notify_packet_task_from_isr(uint32_t events) {
+    auto task = packet_task;
+
+    if (task == nullptr) {
+        return;
+    }
+
+    BaseType_t higher_priority_task_woken = pdFALSE;
+    xTaskNotifyFromISR(task, events, eSetBits, &higher_priority_task_woken);
+    portYIELD_FROM_ISR(higher_priority_task_woken);
+}
 
-        // delay for a while to allow UI updates
-        // for 2Mbs a delay of up to 16ms between buffers is okay
-        vTaskDelay(4 / portTICK_PERIOD_MS);
+/// Applies the packets queued by the packet task whenever it notifies the apply task. The
+/// control table lock is released after every batch, so the UI never waits for long.
+static void apply_packets(ApplyStage& apply_stage, Mutex<ControlTableMap>& control_table_map) {
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        size_t num_entries;
+
+        do {
+            auto lock_start = Clock::counter();
+            auto& control_table_map_ref = control_table_map.lock();
+            auto lock_wait = Clock::counter() - lock_start;
+            TRACE(Apply, LockAcquired, TraceLock::ControlTableMap, lock_wait);
+
+            num_entries = apply_stage.apply(control_table_map_ref, APPLY_BATCH_LEN);
+
+            control_table_map.unlock();
+            TRACE(Apply, LockReleased, TraceLock::ControlTableMap, 0);
+            apply_stage.lock_wait_time(lock_wait);
+        } while (num_entries == APPLY_BATCH_LEN);
     }
 }
 
-static void process_buffer(
-    Mutex<Log>& log,
-    Connection& connection,
-    Mutex<ControlTableMap>& control_table_map) {
-    Cursor* cursor;
-
-    if (connection.buf->ready == ReceiveBuf::Ready::Front) {
-        connection.buf->back.reset();
-        cursor = &connection.buf->front;
-    } else {
-        connection.buf->front.reset();
-        cursor = &connection.buf->back;
+/// Processes the data received on all buses, taking turns as decided by `scheduler`, and
+/// queues the packets for the apply task. Stops early if `budget` is used up, in which case
+/// `resume_delay` is set to the time until processing should continue (otherwise it is set
+/// to 0). Returns the number of bytes processed.
+static size_t process_buses(
+    Log& log,
+    const std::vector<ReceiveChannel>& channels,
+    std::vector<Connection>& connections,
+    BusScheduler& scheduler,
+    ProcessingBudget& budget,
+    PacketQueue& queue,
+    ApplyStage& apply_stage,
+    uint32_t* resume_delay) {
+    static Clock::Timestamp last_processing_start = Clock::now();
+    auto processing_start = Clock::now();
+    size_t num_bytes = 0;
+
+    // the apply task cannot log on its own
+    apply_stage.drain(log);
+
+    // only process the data received up to now, so a pass always ends
+    uint32_t write_counts[MAX_NUM_BUSES];
+
+    for (size_t bus = 0; bus < channels.size(); bus++) {
+        write_counts[bus] = channels[bus].buf->write_count();
     }
 
-    auto processing_start = HAL_GetTick();
-    auto is_buf_empty = cursor->remaining_bytes() == 0;
-    std::vector<Log::Record> log_records;
+    scheduler.begin();
+    *resume_delay = 0;
+    size_t bus;
 
-    auto& control_table_map_ref = control_table_map.lock();
+    while (scheduler.next(&bus)) {
+        auto slice_start = Clock::counter();
+        auto headroom = min_headroom(channels, connections);
 
-    while (cursor->remaining_bytes() > 0) {
-        auto parse_result = connection.parser.parse(*cursor, &connection.last_packet);
+        if (!budget.may_continue(slice_start, headroom)) {
+            // the parser keeps its state, so the next pass continues where this one stopped
+            *resume_delay = budget.resume_delay(slice_start, headroom);
+            TRACE(Packets, Yield, headroom, *resume_delay);
 
-        if (parse_result != ParseResult::PacketAvailable) {
-            if (parse_result == ParseResult::NeedMoreData) {
-                break;
+            // a pass that yields right away continues the previous yield
+            if (num_bytes > 0) {
+                log.yielded();
             }
 
-            log_records.push_back(Log::Record(parse_result));
-            continue;
+            // make sure the task sleeps at least until the next tick
+            if (*resume_delay == 0) {
+                *resume_delay = 1;
+            }
+
+            break;
         }
 
-        auto result = control_table_map_ref.receive(connection.last_packet);
+        TRACE(Packets, ParseStart, bus, write_counts[bus]);
+        auto num_turn_bytes =
+            connections[bus].process(write_counts[bus], scheduler.quantum(), queue, log);
+        TRACE(Packets, ParseEnd, num_turn_bytes, 0);
 
-        if (result != ProtocolResult::Ok) {
-            log_records.push_back(Log::Record(result));
-        }
+        budget.consumed(slice_start, Clock::counter());
+        scheduler.served(num_turn_bytes);
+        num_bytes += num_turn_bytes;
     }
 
-    // never lock both at the same time to prevent deadlocks
-    control_table_map.unlock();
-    auto& log_ref = log.lock();
-
     // only report time for non empty buffers in order to have useful min and average
-    if (!is_buf_empty) {
-        auto processing_end = HAL_GetTick();
-        log_ref.buf_processing_time(processing_end - processing_start);
+    if (num_bytes > 0) {
+        auto processing_end = Clock::now();
+        log.buf_processing_time(processing_end - processing_start);
     }
 
-    for (auto& record : log_records) {
-        log_ref.log(record);
-    }
+    log.time_between_buf_processing(processing_start - last_processing_start);
+    last_processing_start = processing_start;
 
-    log_ref.time_between_buf_processing(processing_start - connection.last_processing_start);
-    connection.last_processing_start = processing_start;
+    log.publish_stats();
+    return num_bytes;
+}
+
+/// Returns the smallest headroom (see `ReceiveReader::headroom`) of all buses.
+static int32_t min_headroom(
+    const std::vector<ReceiveChannel>& channels,
+    const std::vector<Connection>& connections) {
+    int32_t headroom = INT32_MAX;
+
+    for (size_t bus = 0; bus < channels.size(); bus++) {
+        headroom = std::min(headroom, connections[bus].headroom(channels[bus].buf->write_count()));
+    }
 
-    log.unlock();
+    return headroom;
 }
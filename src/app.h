@@ -3,13 +3,15 @@
 
 #include "control_table.h"
 #include "cursor.h"
+#include "log.h"
 #include "main.h"
 #include "parser.h"
+#include "receive_buf.h"
 
-#include <deque>
 #include <stddef.h>
 #include <stdint.h>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <FreeRTOS.h>
@@ -42,32 +44,6 @@ const int BUTTON_HEIGHT = 36;
 
 const size_t MAX_NUM_LOG_ENTRIES = 50;
 
-/// The buffer that stores data received from a UART. Data is transferred by the DMA
-/// controller. Either the front or the back buffer can be ready, the one that is not
-/// ready is currently used for the transfer.
-struct ReceiveBuf {
-  public:
-    enum class Ready : uint8_t {
-        Front,
-        Back,
-    };
-
-    static const size_t LEN = 8192;
-    static_assert(LEN % 2 == 0);
-
-    ReceiveBuf() :
-        front(Cursor(this->bytes, LEN / 2)),
-        back(Cursor(this->bytes + LEN / 2, LEN / 2)),
-        ready(Ready::Back) {
-        this->back.set_empty();
-    }
-
-    volatile uint8_t bytes[LEN];
-    Cursor front;
-    Cursor back;
-    volatile Ready ready;
-};
-
 /// A quick and dirty wrapper for FreeRTOSs mutex. Stores the value it protects and
 /// only hands out references to it when locking the mutex. Must be unlocked manually
 /// at the moment (this should probably be replaced by a separate type similar to
@@ -75,7 +51,9 @@ struct ReceiveBuf {
 template <typename T>
 class Mutex {
   public:
-    Mutex() {
+    /// Creates the mutex and constructs the protected value from `args`.
+    template <typename... Args>
+    explicit Mutex(Args&&... args) : obj(std::forward<Args>(args)...) {
         this->mutex = xSemaphoreCreateMutex();
 
         if (!this->mutex) {
@@ -114,82 +92,16 @@ class Mutex {
     SemaphoreHandle_t mutex;
 };
 
-/// Stores errors and profiling information. Errors are not converted to strings
-/// to save time while in the packet processing task. Only the last `MAX_NUM_LOG_ENTRIES`
-/// are stored.
-class Log {
-  public:
-    enum class ErrorType {
-        Parser,
-        Protocol,
-    };
-
-    class Record {
-      public:
-        Record(ParseResult parse_error) :
-            tick(HAL_GetTick()),
-            error_type(ErrorType::Parser),
-            parse_error(parse_error) {}
-
-        Record(ProtocolResult protocol_error) :
-            tick(HAL_GetTick()),
-            error_type(ErrorType::Protocol),
-            protocol_error(protocol_error) {}
-
-        ~Record() {
-            static_assert(std::is_trivially_destructible<ParseResult>());
-            static_assert(std::is_trivially_destructible<ProtocolResult>());
-        }
-
-        friend std::string to_string(const Record&);
-
-      private:
-        uint32_t tick;
-        ErrorType error_type;
-        union {
-            ParseResult parse_error;
-            ProtocolResult protocol_error;
-        };
-    };
-
-    Log();
-
-    /// Logs a new record.
-    void log(Record record);
-
-    /// Logs the time spent processing the last buffer.
-    void buf_processing_time(uint32_t time);
-
-    /// Logs the time between the last two points in time where a buffer could be
-    /// processed.
-    void time_between_buf_processing(uint32_t time);
-
-    size_t size() const;
-
-    std::deque<Record>::const_iterator begin() const;
-
-    std::deque<Record>::const_iterator end() const;
-
-    uint32_t max_buf_processing_time() const;
-
-    float avg_buf_processing_time() const;
-
-    uint32_t max_time_between_buf_processing() const;
-
-    float avg_time_between_buf_processing() const;
-
-  private:
-    std::deque<Record> records;
-    uint32_t max_buf_processing_time_;
-    uint32_t buf_processing_time_sum;
-    uint32_t num_processed_bufs;
-    uint32_t max_time_between_buf_processing_;
-    uint32_t time_between_buf_processing_sum;
-    uint32_t num_times_between_buf_processing;
+/// A UART whose received data is transferred to `buf` by a DMA stream.
+struct ReceiveChannel {
+    ReceiveBuf* buf;
+    uint32_t baudrate;
 };
 
-std::string to_string(const Log::Record& record);
+void run(const std::vector<ReceiveChannel>& channels);
 
-void run(const std::vector<ReceiveBuf*>& bufs);
+/// Wakes the packet task from an interrupt. `events` is a combination of the `WAKE_*`
+/// constants. Does nothing if the packet task has not started yet.
+void notify_packet_task_from_isr(uint32_t events);
 
 #endif
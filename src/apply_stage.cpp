@@ -0,0 +1,68 @@
+#include "apply_stage.h"
+
+ApplyStage::ApplyStage(PacketQueue* queue) :
+    queue(queue),
+    packet(Packet{
+        DeviceId(0),
+        Instruction::Ping,
+        Error(),
+        std::vector<uint8_t>(),
+    }) {
+    // prevent allocations in the apply task
+    this->packet.data.reserve(MAX_PACKET_DATA_LEN);
+}
+
+size_t ApplyStage::apply(ControlTableMap& control_table_map, size_t max_entries) {
+    size_t num_entries = 0;
+    size_t bus;
+    PacketKind kind;
+
+    while (num_entries < max_entries && this->queue->pop(&bus, &kind, &this->packet)) {
+        num_entries++;
+
+        switch (kind) {
+            case PacketKind::Packet: {
+                auto result = control_table_map.receive(this->packet, bus);
+
+                // a full ring drops the error like the log itself would
+                if (result != ProtocolResult::Ok) {
+                    this->errors.push(Log::Record(result, (uint8_t) bus));
+                }
+
+                break;
+            }
+            case PacketKind::Fragment: {
+                control_table_map.receive_fragment(this->packet, bus);
+                break;
+            }
+            case PacketKind::DiscardFragments: {
+                control_table_map.discard_fragments(bus);
+                break;
+            }
+            case PacketKind::Gap: {
+                control_table_map.reset_bus(bus);
+                break;
+            }
+        }
+    }
+
+    return num_entries;
+}
+
+void ApplyStage::lock_wait_time(uint32_t time) {
+    this->lock_wait_times.push(time);
+}
+
+void ApplyStage::drain(Log& log) {
+    Log::Record record;
+
+    while (this->errors.pop(&record)) {
+        log.log(record);
+    }
+
+    uint32_t time;
+
+    while (this->lock_wait_times.pop(&time)) {
+        log.lock_wait_time(time);
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef APPLY_STAGE_H
+#define APPLY_STAGE_H
+
+#include "control_table.h"
+#include "log.h"
+#include "packet_queue.h"
+#include "spsc_ring.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// The number of lock wait times that can be buffered until the packet task logs them.
+const size_t APPLY_LOCK_WAIT_RING_LEN = 16;
+
+/// The second stage of packet processing: applies the packets queued by the `Connection`s to
+/// a `ControlTableMap`. Runs in its own task, so it only holds the control table lock while
+/// applying packets, not while parsing them.
+///
+/// The log only supports a single producer (the packet task), so errors and lock wait times
+/// are passed back through rings and logged by the packet task (see `drain`).
+class ApplyStage {
+  public:
+    explicit ApplyStage(PacketQueue* queue);
+
+    ApplyStage(const ApplyStage&) = delete;
+
+    ApplyStage& operator=(const ApplyStage&) = delete;
+
+    /// Applies up to `max_entries` entries of the queue to `control_table_map`. Returns the
+    /// number of entries applied. Apply task only.
+    size_t apply(ControlTableMap& control_table_map, size_t max_entries);
+
+    /// Records the time the apply task waited for the control table lock. Apply task only.
+    void lock_wait_time(uint32_t time);
+
+    /// Moves the errors and lock wait times collected by the apply task to `log`. Packet task
+    /// only.
+    void drain(Log& log);
+
+  private:
+    PacketQueue* queue;
+    Packet packet;
+    SpscRing<Log::Record, LOG_RING_LEN> errors;
+    SpscRing<uint32_t, APPLY_LOCK_WAIT_RING_LEN> lock_wait_times;
+};
+
+#endif
@@ -0,0 +1,35 @@
+#include "bus_scheduler.h"
+
+BusScheduler::BusScheduler(size_t num_buses, size_t quantum) :
+    num_buses(num_buses),
+    quantum_(quantum),
+    first_bus(0),
+    current_bus(0),
+    active_buses(0) {}
+
+void BusScheduler::begin() {
+    this->active_buses = this->num_buses < 32 ? (1u << this->num_buses) - 1 : 0xffffffff;
+    this->current_bus = this->first_bus;
+    this->first_bus = (this->first_bus + 1) % this->num_buses;
+}
+
+bool BusScheduler::next(size_t* bus) {
+    if (this->active_buses == 0) {
+        return false;
+    }
+
+    while ((this->active_buses & (1u << this->current_bus)) == 0) {
+        this->current_bus = (this->current_bus + 1) % this->num_buses;
+    }
+
+    *bus = this->current_bus;
+    return true;
+}
+
+void BusScheduler::served(size_t num_bytes) {
+    if (num_bytes < this->quantum_) {
+        this->active_buses &= ~(1u << this->current_bus);
+    }
+
+    this->current_bus = (this->current_bus + 1) % this->num_buses;
+}
@@ -0,0 +1,46 @@
+#ifndef BUS_SCHEDULER_H
+#define BUS_SCHEDULER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// Shares the packet task's time fairly between several buses, so a busy bus cannot starve
+/// the others. The buses take turns (round robin) and every turn is limited to `quantum`
+/// bytes. A pass over the buses continues until all of them have run out of data, and every
+/// pass starts with the next bus so no bus is always served first.
+class BusScheduler {
+  public:
+    /// `num_buses` must be at most 32.
+    BusScheduler(size_t num_buses, size_t quantum);
+
+    /// Starts a new pass over all buses.
+    void begin();
+
+    /// Selects the bus for the next turn and stores it in `bus`. Returns `false` once all buses
+    /// have run out of data.
+    bool next(size_t* bus);
+
+    /// Ends the turn of the bus selected by `next`. `num_bytes` is the number of bytes
+    /// the bus has processed. If it is less than `quantum`, the bus has run out of data and
+    /// gets no more turns in this pass.
+    void served(size_t num_bytes);
+
+    size_t quantum() const {
+        return this->quantum_;
+    }
+
+  private:
+    size_t num_buses;
+    size_t quantum_;
+
+    /// The bus that starts the next pass.
+    size_t first_bus;
+
+    /// The bus whose turn it is (or will be).
+    size_t current_bus;
+
+    /// A bit for every bus that has not run out of data in the current pass.
+    uint32_t active_buses;
+};
+
+#endif
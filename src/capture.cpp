@@ -0,0 +1,244 @@
+#include "capture.h"
+#include "endian_convert.h"
+
+#include <string.h>
+
+std::string to_string(CaptureResult result) {
+    switch (result) {
+        case CaptureResult::Ok: {
+            return "ok";
+        }
+        case CaptureResult::End: {
+            return "end of capture";
+        }
+        case CaptureResult::InvalidMagic: {
+            return "not a capture";
+        }
+        case CaptureResult::UnsupportedVersion: {
+            return "unsupported capture version";
+        }
+        case CaptureResult::TruncatedChunk: {
+            return "truncated chunk";
+        }
+        case CaptureResult::InvalidBus: {
+            return "invalid bus";
+        }
+        default: { return "unknown"; }
+    }
+}
+
+CaptureWriter::CaptureWriter(std::ostream* out, size_t num_buses) : out(out) {
+    uint8_t header[CAPTURE_HEADER_LEN] = {};
+    memcpy(header, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC));
+    uint16_to_le(&header[4], CAPTURE_VERSION);
+    header[6] = (uint8_t) num_buses;
+    this->out->write((const char*) header, sizeof(header));
+}
+
+void CaptureWriter::write(
+    uint64_t timestamp,
+    size_t bus,
+    const uint8_t* data,
+    size_t len,
+    CaptureChunkKind kind) {
+    uint8_t header[CAPTURE_CHUNK_HEADER_LEN] = {};
+    uint64_to_le(&header[0], timestamp);
+    uint32_to_le(&header[8], (uint32_t) len);
+    header[12] = (uint8_t) bus;
+    header[13] = (uint8_t) kind;
+    this->out->write((const char*) header, sizeof(header));
+    this->out->write((const char*) data, len);
+}
+
+CaptureReader::CaptureReader(const uint8_t* capture, size_t len) :
+    capture(capture),
+    len(len),
+    num_buses_(0),
+    offset_(CAPTURE_HEADER_LEN) {}
+
+CaptureResult CaptureReader::open() {
+    if (this->len < CAPTURE_HEADER_LEN
+        || memcmp(this->capture, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC)) != 0) {
+        return CaptureResult::InvalidMagic;
+    }
+
+    if (uint16_from_le(&this->capture[4]) != CAPTURE_VERSION) {
+        return CaptureResult::UnsupportedVersion;
+    }
+
+    this->num_buses_ = this->capture[6];
+    this->offset_ = CAPTURE_HEADER_LEN;
+    return CaptureResult::Ok;
+}
+
+CaptureResult CaptureReader::next(CaptureChunk* chunk) {
+    auto remaining_len = this->len - this->offset_;
+
+    if (remaining_len == 0) {
+        return CaptureResult::End;
+    }
+
+    if (remaining_len < CAPTURE_CHUNK_HEADER_LEN) {
+        return CaptureResult::TruncatedChunk;
+    }
+
+    auto header = &this->capture[this->offset_];
+    size_t data_len = uint32_from_le(&header[8]);
+
+    if (remaining_len - CAPTURE_CHUNK_HEADER_LEN < data_len) {
+        return CaptureResult::TruncatedChunk;
+    }
+
+    if (header[12] >= this->num_buses_) {
+        return CaptureResult::InvalidBus;
+    }
+
+    *chunk = CaptureChunk{
+        uint64_from_le(&header[0]),
+        header[12],
+        (CaptureChunkKind) header[13],
+        header + CAPTURE_CHUNK_HEADER_LEN,
+        data_len,
+        this->offset_,
+    };
+
+    this->offset_ += CAPTURE_CHUNK_HEADER_LEN + data_len;
+    return CaptureResult::Ok;
+}
+
+/// The maximum number of bytes a packet can occupy on the bus: the header, Id and length
+/// fields followed by the number of bytes given by the length field.
+const size_t MAX_RAW_PACKET_LEN = 7 + 0xffff;
+
+CaptureScanner::BusState::BusState() :
+    packet{DeviceId(0), Instruction::Ping, Error(), {}},
+    start{0, 0} {}
+
+CaptureScanner::CaptureScanner(CaptureReader* reader) :
+    reader(reader),
+    buses(reader->num_buses()),
+    chunk{0, 0, CaptureChunkKind::Data, nullptr, 0, 0},
+    cursor(nullptr, 0) {}
+
+CaptureResult CaptureScanner::next(ScannedPacket* packet) {
+    while (true) {
+        if (this->cursor.remaining_bytes() == 0) {
+            CaptureResult result;
+
+            if (!this->next_chunk(&result)) {
+                return result;
+            }
+        }
+
+        auto& bus = this->buses[this->chunk.bus];
+        auto result = bus.parser.parse(this->cursor, &bus.packet);
+
+        if (result == ParseResult::NeedMoreData) {
+            continue;
+        }
+
+        auto end_pos = this->chunk.len - this->cursor.remaining_bytes();
+        auto stream_pos = bus.spans.back().stream_start + end_pos;
+
+        if (result == ParseResult::PacketAvailable
+            || result == ParseResult::MismatchedChecksum) {
+            stream_pos -= bus.parser.raw_packet_len();
+        }
+
+        *packet = ScannedPacket{
+            this->chunk.bus,
+            result,
+            this->chunk.timestamp,
+            this->locate(bus, stream_pos),
+            PacketLocation{this->chunk.offset, end_pos},
+            &bus.packet,
+        };
+
+        return CaptureResult::Ok;
+    }
+}
+
+void CaptureScanner::seek(const PacketLocation& location) {
+    this->seek(std::vector<PacketLocation>(this->buses.size(), location));
+}
+
+void CaptureScanner::seek(const std::vector<PacketLocation>& locations) {
+    size_t offset = SIZE_MAX;
+    this->buses.assign(this->buses.size(), BusState());
+
+    for (size_t bus = 0; bus < this->buses.size(); bus++) {
+        this->buses[bus].start = locations[bus];
+        offset = std::min(offset, std::max(locations[bus].chunk_offset, CAPTURE_HEADER_LEN));
+    }
+
+    this->reader->seek(offset);
+    this->cursor = Cursor(nullptr, 0);
+}
+
+void CaptureScanner::stop(size_t bus) {
+    this->buses[bus].start = PacketLocation{SIZE_MAX, 0};
+
+    if (this->chunk.bus == bus) {
+        this->cursor = Cursor(nullptr, 0);
+    }
+}
+
+bool CaptureScanner::next_chunk(CaptureResult* result) {
+    do {
+        *result = this->reader->next(&this->chunk);
+
+        if (*result != CaptureResult::Ok) {
+            return false;
+        }
+    } while (this->chunk.kind != CaptureChunkKind::Data
+             || this->chunk.offset < this->buses[this->chunk.bus].start.chunk_offset);
+
+    auto& bus = this->buses[this->chunk.bus];
+    auto& spans = bus.spans;
+    uint64_t stream_start = spans.empty() ? 0 : spans.back().stream_start + spans.back().len;
+    spans.push_back(Span{stream_start, this->chunk.len, this->chunk.offset});
+
+    // only chunks that can still contain the start of a packet are kept
+    while (spans.front().stream_start + spans.front().len + MAX_RAW_PACKET_LEN
+           < stream_start) {
+        spans.pop_front();
+    }
+
+    // the first chunk after a seek starts at the sought location
+    auto pos = this->chunk.offset == bus.start.chunk_offset
+        ? std::min(bus.start.pos, this->chunk.len)
+        : 0;
+    this->cursor = Cursor(this->chunk.data + pos, this->chunk.len - pos);
+    return true;
+}
+
+PacketLocation CaptureScanner::locate(const BusState& bus, uint64_t stream_pos) const {
+    for (auto span = bus.spans.rbegin(); span != bus.spans.rend(); span++) {
+        if (span->stream_start <= stream_pos) {
+            return PacketLocation{span->chunk_offset, (size_t) (stream_pos - span->stream_start)};
+        }
+    }
+
+    return PacketLocation{bus.spans.front().chunk_offset, 0};
+}
+
+ReplayPacer::ReplayPacer(float speed) :
+    speed(speed),
+    is_started(false),
+    first_timestamp(0),
+    start(0) {}
+
+uint64_t ReplayPacer::delay(uint64_t timestamp, uint64_t now) {
+    if (!this->is_started) {
+        this->is_started = true;
+        this->first_timestamp = timestamp;
+        this->start = now;
+    }
+
+    if (this->speed <= 0.0f) {
+        return 0;
+    }
+
+    auto due = this->start + (uint64_t) ((timestamp - this->first_timestamp) / this->speed);
+    return due > now ? due - now : 0;
+}
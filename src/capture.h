@@ -0,0 +1,243 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include "parser.h"
+#include <deque>
+#include <ostream>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/// A capture stores the raw data received on one or more buses together with the time it was
+/// received, so it can be replayed later. All fields are little-endian:
+///
+/// - a header of `CAPTURE_HEADER_LEN` bytes: the magic `DXCP`, the format version (u16), the
+///   number of buses (u8) and reserved bytes
+/// - any number of chunks, each starting with a header of `CAPTURE_CHUNK_HEADER_LEN` bytes:
+///   the time since the capture started in us (u64), the length of the data (u32), the bus
+///   (u8), the `CaptureChunkKind` (u8) and a reserved u16, followed by the data
+///
+/// Chunks are stored in the order they were received, so their timestamps never decrease.
+const uint8_t CAPTURE_MAGIC[4] = {'D', 'X', 'C', 'P'};
+const uint16_t CAPTURE_VERSION = 1;
+const size_t CAPTURE_HEADER_LEN = 16;
+const size_t CAPTURE_CHUNK_HEADER_LEN = 16;
+
+/// The contents of a chunk. Readers skip kinds they do not know.
+enum class CaptureChunkKind : uint8_t {
+    /// Raw bytes received on the chunk's bus.
+    Data,
+};
+
+/// A chunk of a capture. `data` points into the capture itself.
+struct CaptureChunk {
+    /// The time since the capture started, in us.
+    uint64_t timestamp;
+
+    size_t bus;
+    CaptureChunkKind kind;
+    const uint8_t* data;
+    size_t len;
+
+    /// The offset of the chunk's header in the capture.
+    size_t offset;
+};
+
+enum class CaptureResult {
+    Ok,
+
+    /// There are no more chunks.
+    End,
+
+    /// The capture does not start with `CAPTURE_MAGIC`.
+    InvalidMagic,
+
+    UnsupportedVersion,
+
+    /// The capture ends in the middle of a chunk (e.g. because the capture was interrupted).
+    TruncatedChunk,
+
+    /// A chunk refers to a bus that is not part of the capture.
+    InvalidBus,
+};
+
+std::string to_string(CaptureResult result);
+
+/// Writes a capture to a stream.
+class CaptureWriter {
+  public:
+    /// Writes the header for a capture of `num_buses` buses to `out`.
+    CaptureWriter(std::ostream* out, size_t num_buses);
+
+    /// Appends a chunk of `len` bytes received on `bus` at `timestamp` (in us since the
+    /// capture started).
+    void write(
+        uint64_t timestamp,
+        size_t bus,
+        const uint8_t* data,
+        size_t len,
+        CaptureChunkKind kind = CaptureChunkKind::Data);
+
+    /// Returns `false` if writing to the stream failed.
+    bool is_ok() const {
+        return this->out->good();
+    }
+
+  private:
+    std::ostream* out;
+};
+
+/// Reads a capture that is completely in memory (e.g. a mapped file) without copying the
+/// data of its chunks.
+class CaptureReader {
+  public:
+    CaptureReader(const uint8_t* capture, size_t len);
+
+    /// Checks the capture's header. Must be called before reading chunks.
+    CaptureResult open();
+
+    size_t num_buses() const {
+        return this->num_buses_;
+    }
+
+    /// Reads the next chunk into `chunk`. Returns `CaptureResult::End` after the last chunk.
+    /// Chunks of unknown kinds are returned as well, so they can be skipped by the caller.
+    CaptureResult next(CaptureChunk* chunk);
+
+    /// Returns the offset of the next chunk.
+    size_t offset() const {
+        return this->offset_;
+    }
+
+    /// Continues reading at `offset`, which must be the offset of a chunk (see
+    /// `CaptureChunk::offset`).
+    void seek(size_t offset) {
+        this->offset_ = offset;
+    }
+
+  private:
+    const uint8_t* capture;
+    size_t len;
+    size_t num_buses_;
+    size_t offset_;
+};
+
+/// Where a packet starts in a capture: the chunk of the packet's bus that contains its first
+/// byte and the position of that byte in the chunk's data.
+struct PacketLocation {
+    size_t chunk_offset;
+    size_t pos;
+};
+
+inline bool operator==(const PacketLocation& lhs, const PacketLocation& rhs) {
+    return lhs.chunk_offset == rhs.chunk_offset && lhs.pos == rhs.pos;
+}
+
+/// Orders locations like the bytes they refer to are stored in the capture.
+inline bool operator<(const PacketLocation& lhs, const PacketLocation& rhs) {
+    return lhs.chunk_offset < rhs.chunk_offset
+        || (lhs.chunk_offset == rhs.chunk_offset && lhs.pos < rhs.pos);
+}
+
+/// A result of parsing the data of a capture (see `CaptureScanner`).
+struct ScannedPacket {
+    size_t bus;
+
+    /// Any result of `Parser::parse` except `ParseResult::NeedMoreData`.
+    ParseResult result;
+
+    /// The timestamp of the chunk in which the packet was completed.
+    uint64_t timestamp;
+
+    /// Where the packet starts for `ParseResult::PacketAvailable` and
+    /// `ParseResult::MismatchedChecksum`. For all other results, where parsing stopped.
+    PacketLocation location;
+
+    /// Where parsing stopped, i.e. where the next packet of the bus is searched.
+    PacketLocation end;
+
+    /// The parsed packet. Only valid until the next call to `CaptureScanner::next`.
+    const Packet* packet;
+};
+
+/// Parses the packets of all buses of a capture and determines where every packet starts, so
+/// it can be parsed again later without parsing everything before it (see `seek`).
+class CaptureScanner {
+  public:
+    /// Scans the chunks read by `reader`, which must have been opened.
+    explicit CaptureScanner(CaptureReader* reader);
+
+    CaptureScanner(const CaptureScanner&) = delete;
+
+    CaptureScanner& operator=(const CaptureScanner&) = delete;
+
+    /// Parses until the next packet, fragment or error. Returns the result of the reader if
+    /// there are no more chunks or a chunk cannot be read.
+    CaptureResult next(ScannedPacket* packet);
+
+    /// Continues parsing at `location`. Packets that started before it are dropped (on all
+    /// buses), so the first packet on the location's bus is the one starting there.
+    void seek(const PacketLocation& location);
+
+    /// Continues parsing every bus at its own location (e.g. the `end` of the last packet
+    /// that was handled on it). Data of a bus before its location is skipped.
+    void seek(const std::vector<PacketLocation>& locations);
+
+    /// Skips all remaining data of `bus`, including the rest of the current chunk.
+    void stop(size_t bus);
+
+    /// Returns `true` if the parser of `bus` is in the middle of a packet.
+    bool is_in_packet(size_t bus) const {
+        return this->buses[bus].parser.is_in_packet();
+    }
+
+  private:
+    /// A chunk of a bus, positioned in the stream of all bytes received on the bus.
+    struct Span {
+        uint64_t stream_start;
+        size_t len;
+        size_t chunk_offset;
+    };
+
+    struct BusState {
+        BusState();
+
+        Parser parser;
+        Packet packet;
+        std::deque<Span> spans;
+
+        /// The location at which parsing starts after a seek.
+        PacketLocation start;
+    };
+
+    /// Reads the next chunk with data. Returns `false` and sets `result` if there is none.
+    bool next_chunk(CaptureResult* result);
+
+    PacketLocation locate(const BusState& bus, uint64_t stream_pos) const;
+
+    CaptureReader* reader;
+    std::vector<BusState> buses;
+    CaptureChunk chunk;
+    Cursor cursor;
+};
+
+/// Decides when the chunks of a capture are due when replaying them in real time.
+class ReplayPacer {
+  public:
+    /// `speed` is the factor by which the replay is faster than the original. A speed of 0
+    /// replays as fast as possible.
+    explicit ReplayPacer(float speed);
+
+    /// Returns the time (in us) until the chunk with `timestamp` is due, given the time
+    /// `now` (in us, on any monotonic clock). The first chunk is due immediately.
+    uint64_t delay(uint64_t timestamp, uint64_t now);
+
+  private:
+    float speed;
+    bool is_started;
+    uint64_t first_timestamp;
+    uint64_t start;
+};
+
+#endif
@@ -0,0 +1,708 @@
+#include "capture_codec.h"
+#include "endian_convert.h"
+#include "varint.h"
+
+#include <algorithm>
+#include <string.h>
+
+/// The header of a packet, the device id and the length field.
+static const size_t PACKET_PREFIX_LEN = 7;
+
+/// The prefix, the instruction and the checksum.
+static const size_t MIN_RAW_PACKET_LEN = 10;
+
+static const uint8_t PACKET_HEADER[4] = {0xff, 0xff, 0xfd, 0x00};
+static const uint8_t STATUS = (uint8_t) Instruction::Status;
+
+/// Records are written to the stream in blocks of at least this size.
+static const size_t FLUSH_LEN = 64 * 1024;
+
+std::string to_string(CodecResult result) {
+    switch (result) {
+        case CodecResult::Ok: {
+            return "ok";
+        }
+        case CodecResult::End: {
+            return "end of compressed capture";
+        }
+        case CodecResult::InvalidMagic: {
+            return "not a compressed capture";
+        }
+        case CodecResult::UnsupportedVersion: {
+            return "unsupported compressed capture version";
+        }
+        case CodecResult::Corrupted: {
+            return "corrupted compressed capture";
+        }
+        default: { return "unknown"; }
+    }
+}
+
+/// Appends the raw bytes of a packet to `out`: the payload is stuffed and the length and the
+/// checksum are computed.
+static void encode_packet(const PacketShapes::Shape& shape, std::vector<uint8_t>* out) {
+    auto start = out->size();
+    out->insert(out->end(), PACKET_HEADER, PACKET_HEADER + sizeof(PACKET_HEADER));
+    out->push_back(shape.device_id);
+    out->push_back(0);
+    out->push_back(0);
+    auto payload_start = out->size();
+
+    auto append = [&](uint8_t byte) {
+        out->push_back(byte);
+        auto end = out->end();
+
+        if (out->size() - payload_start >= 3 && end[-3] == 0xff && end[-2] == 0xff
+            && end[-1] == 0xfd) {
+            out->push_back(0xfd);
+        }
+    };
+
+    append(shape.instruction);
+
+    if (shape.instruction == STATUS) {
+        append(shape.error);
+    }
+
+    for (auto byte : shape.data) {
+        append(byte);
+    }
+
+    uint16_to_le(&(*out)[start + 5], (uint16_t) (out->size() - payload_start + 2));
+    auto crc = update_crc(0, out->data() + start, out->size() - start);
+    out->push_back(crc & 0xff);
+    out->push_back(crc >> 8);
+}
+
+/// Decodes the `len` bytes at `raw`, which start with a header, into `shape`. Returns `false`
+/// if encoding the packet again does not result in the same bytes (e.g. because the checksum
+/// is invalid). `buf` is used for encoding.
+static bool decode_packet(
+    const uint8_t* raw,
+    size_t len,
+    PacketShapes::Shape* shape,
+    std::vector<uint8_t>* buf) {
+    if (len < MIN_RAW_PACKET_LEN) {
+        return false;
+    }
+
+    // the instruction and error are decoded as part of the data first
+    shape->device_id = raw[4];
+    shape->error = 0;
+    shape->data.clear();
+
+    for (size_t i = PACKET_PREFIX_LEN; i < len - 2; i++) {
+        auto is_stuffing = i >= PACKET_PREFIX_LEN + 3 && raw[i - 3] == 0xff && raw[i - 2] == 0xff
+            && raw[i - 1] == 0xfd && raw[i] == 0xfd;
+
+        if (!is_stuffing) {
+            shape->data.push_back(raw[i]);
+        }
+    }
+
+    shape->instruction = shape->data[0];
+    size_t fields_len = 1;
+
+    if (shape->instruction == STATUS) {
+        if (shape->data.size() < 2) {
+            return false;
+        }
+
+        shape->error = shape->data[1];
+        fields_len = 2;
+    }
+
+    shape->data.erase(shape->data.begin(), shape->data.begin() + fields_len);
+
+    buf->clear();
+    encode_packet(*shape, buf);
+    return buf->size() == len && memcmp(buf->data(), raw, len) == 0;
+}
+
+/// Returns the position of the first header that lies completely in `data[from..to)` or `to`
+/// if there is none.
+static size_t find_header(const uint8_t* data, size_t from, size_t to) {
+    for (auto pos = from; pos + sizeof(PACKET_HEADER) <= to; pos++) {
+        if (data[pos] == 0xff && memcmp(&data[pos], PACKET_HEADER, sizeof(PACKET_HEADER)) == 0) {
+            return pos;
+        }
+    }
+
+    return to;
+}
+
+/// Returns the number of bytes at the end of `data` that may be the start of a header.
+static size_t partial_header_len(const uint8_t* data, size_t len) {
+    for (size_t n = std::min<size_t>(len, sizeof(PACKET_HEADER) - 1); n > 0; n--) {
+        if (memcmp(&data[len - n], PACKET_HEADER, n) == 0) {
+            return n;
+        }
+    }
+
+    return 0;
+}
+
+size_t PacketShapes::find(
+    uint8_t device_id,
+    uint8_t instruction,
+    uint8_t error,
+    const std::vector<uint8_t>& data) const {
+    for (size_t i = 0; i < this->shapes.size(); i++) {
+        auto& shape = this->shapes[i];
+
+        if (shape.device_id == device_id && shape.instruction == instruction
+            && shape.error == error && shape.data.size() == data.size()
+            && (instruction == STATUS || data.size() < 2
+                || (shape.data[0] == data[0] && shape.data[1] == data[1]))) {
+            return i;
+        }
+    }
+
+    return SIZE_MAX;
+}
+
+PacketShapes::Shape& PacketShapes::use(size_t index) {
+    auto begin = this->shapes.begin();
+    std::rotate(begin, begin + index, begin + index + 1);
+    return this->shapes.front();
+}
+
+PacketShapes::Shape& PacketShapes::add() {
+    if (this->shapes.size() < MAX_SHAPES) {
+        this->shapes.insert(this->shapes.begin(), Shape{0, 0, 0, {}});
+    } else {
+        std::rotate(this->shapes.begin(), this->shapes.end() - 1, this->shapes.end());
+    }
+
+    return this->shapes.front();
+}
+
+CaptureEncoder::CaptureEncoder(
+    std::ostream* out,
+    const uint8_t* capture_header,
+    uint64_t capture_len) :
+    out(out),
+    buses(capture_header[6]),
+    last_timestamp(0) {
+    uint8_t header[COMPRESSED_CAPTURE_HEADER_LEN] = {};
+    memcpy(header, COMPRESSED_CAPTURE_MAGIC, sizeof(COMPRESSED_CAPTURE_MAGIC));
+    uint16_to_le(&header[4], COMPRESSED_CAPTURE_VERSION);
+    uint64_to_le(&header[8], capture_len);
+    this->out->write((const char*) header, sizeof(header));
+    this->out->write((const char*) capture_header, CAPTURE_HEADER_LEN);
+}
+
+void CaptureEncoder::add(const CaptureChunk& chunk) {
+    auto reserved = uint16_from_le(chunk.data - CAPTURE_CHUNK_HEADER_LEN + 14);
+
+    // only data chunks are modelled, anything else is stored as it is
+    if (chunk.kind != CaptureChunkKind::Data || reserved != 0) {
+        this->held_chunks.push_back(HeldChunk{chunk, true, 0});
+        this->write_chunks();
+        return;
+    }
+
+    auto& bus = this->buses[chunk.bus];
+    bus.pending.insert(bus.pending.end(), chunk.data, chunk.data + chunk.len);
+    bus.data_len += chunk.len;
+    this->held_chunks.push_back(HeldChunk{chunk, false, bus.data_len});
+    this->tokenize(bus, false);
+    this->write_chunks();
+}
+
+void CaptureEncoder::finish(const uint8_t* tail, size_t len) {
+    for (auto& bus : this->buses) {
+        this->tokenize(bus, true);
+    }
+
+    this->write_chunks();
+
+    if (len > 0) {
+        this->write_record(CodecRecord::Tail, 0);
+        append_varint(len, &this->buf);
+        this->buf.insert(this->buf.end(), tail, tail + len);
+    }
+
+    this->flush();
+}
+
+void CaptureEncoder::tokenize(Bus& bus, bool is_final) {
+    while (bus.start < bus.pending.size()) {
+        auto data = bus.pending.data() + bus.start;
+        auto len = bus.pending.size() - bus.start;
+        auto header = find_header(data, 0, len);
+
+        if (header > 0) {
+            auto literal_len = header == len && !is_final ? len - partial_header_len(data, len)
+                                                          : header;
+
+            if (literal_len == 0) {
+                break;
+            }
+
+            this->add_literal(bus, literal_len);
+            continue;
+        }
+
+        if (len < PACKET_PREFIX_LEN) {
+            if (is_final) {
+                this->add_literal(bus, len);
+            }
+
+            break;
+        }
+
+        // a header before the end of the packet interrupts it
+        size_t raw_len = PACKET_PREFIX_LEN + uint16_from_le(&data[5]);
+        auto packet_end = std::min(raw_len, len);
+        auto next = find_header(data, std::max(bus.search_pos, sizeof(PACKET_HEADER)), packet_end);
+
+        if (next < packet_end) {
+            this->add_literal(bus, next);
+            continue;
+        }
+
+        if (len < raw_len) {
+            if (is_final) {
+                this->add_literal(bus, len);
+            } else {
+                bus.search_pos = len - (sizeof(PACKET_HEADER) - 1);
+            }
+
+            break;
+        }
+
+        Token token{raw_len, true, 0, 0, 0, {}};
+        PacketShapes::Shape shape{0, 0, 0, {}};
+
+        if (!decode_packet(data, raw_len, &shape, &this->raw_packet)) {
+            this->add_literal(bus, sizeof(PACKET_HEADER));
+            continue;
+        }
+
+        token.device_id = shape.device_id;
+        token.instruction = shape.instruction;
+        token.error = shape.error;
+        token.data.swap(shape.data);
+        bus.tokens.push_back(std::move(token));
+        bus.start += raw_len;
+        bus.tokenized_len += raw_len;
+        bus.search_pos = 0;
+    }
+
+    if (bus.start * 2 >= bus.pending.size()) {
+        bus.pending.erase(bus.pending.begin(), bus.pending.begin() + bus.start);
+        bus.start = 0;
+    }
+}
+
+void CaptureEncoder::add_literal(Bus& bus, size_t len) {
+    auto data = bus.pending.data() + bus.start;
+
+    if (bus.tokens.empty() || bus.tokens.back().is_packet) {
+        bus.tokens.push_back(Token{0, false, 0, 0, 0, {}});
+    }
+
+    auto& token = bus.tokens.back();
+    token.len += len;
+    token.data.insert(token.data.end(), data, data + len);
+    bus.start += len;
+    bus.tokenized_len += len;
+    bus.search_pos = 0;
+}
+
+void CaptureEncoder::write_chunks() {
+    while (!this->held_chunks.empty()) {
+        auto& held = this->held_chunks.front();
+        auto& chunk = held.chunk;
+
+        if (held.is_raw) {
+            auto raw_len = CAPTURE_CHUNK_HEADER_LEN + chunk.len;
+            auto raw = chunk.data - CAPTURE_CHUNK_HEADER_LEN;
+            this->write_record(CodecRecord::RawChunk, 0);
+            append_varint(raw_len, &this->buf);
+            this->buf.insert(this->buf.end(), raw, raw + raw_len);
+        } else {
+            auto& bus = this->buses[chunk.bus];
+
+            if (bus.tokenized_len < held.data_end) {
+                break;
+            }
+
+            this->write_record(CodecRecord::Chunk, chunk.bus);
+            auto timestamp_diff = (int64_t) (chunk.timestamp - this->last_timestamp);
+            append_varint(zigzag_encode(timestamp_diff), &this->buf);
+            append_varint(chunk.len, &this->buf);
+            this->last_timestamp = chunk.timestamp;
+
+            // the decoder decodes the bus' data until there is enough for the chunk
+            while (bus.available_len < chunk.len) {
+                auto& token = bus.tokens.front();
+                this->write_token(bus, token);
+                bus.available_len += token.len;
+                bus.tokens.pop_front();
+            }
+
+            bus.available_len -= chunk.len;
+        }
+
+        this->held_chunks.pop_front();
+
+        if (this->buf.size() >= FLUSH_LEN) {
+            this->flush();
+        }
+    }
+}
+
+void CaptureEncoder::write_token(Bus& bus, Token& token) {
+    auto& buf = this->buf;
+
+    if (!token.is_packet) {
+        this->write_record(CodecRecord::Literal, token.len);
+        buf.insert(buf.end(), token.data.begin(), token.data.end());
+        return;
+    }
+
+    auto index = bus.shapes.find(token.device_id, token.instruction, token.error, token.data);
+
+    if (index == SIZE_MAX) {
+        this->write_record(CodecRecord::NewPacket, 0);
+        buf.push_back(token.device_id);
+        buf.push_back(token.instruction);
+
+        if (token.instruction == STATUS) {
+            buf.push_back(token.error);
+        }
+
+        append_varint(token.data.size(), &buf);
+        buf.insert(buf.end(), token.data.begin(), token.data.end());
+
+        auto& shape = bus.shapes.add();
+        shape.device_id = token.device_id;
+        shape.instruction = token.instruction;
+        shape.error = token.error;
+        shape.data.swap(token.data);
+        return;
+    }
+
+    auto& shape = bus.shapes.use(index);
+
+    if (shape.data == token.data) {
+        this->write_record(CodecRecord::RepeatedPacket, index);
+        return;
+    }
+
+    this->write_record(CodecRecord::Packet, index);
+    auto len = token.data.size();
+    auto bitmap = buf.size();
+    buf.resize(bitmap + (len + 7) / 8, 0);
+
+    for (size_t i = 0; i < len; i++) {
+        uint8_t diff = token.data[i] ^ shape.data[i];
+
+        if (diff != 0) {
+            buf[bitmap + i / 8] |= 1 << (i % 8);
+            buf.push_back(diff);
+        }
+    }
+
+    shape.data.swap(token.data);
+}
+
+void CaptureEncoder::write_record(CodecRecord record, uint64_t arg) {
+    if (arg < CODEC_ARG_VARINT) {
+        this->buf.push_back((uint8_t) record | (uint8_t) (arg << 3));
+    } else {
+        this->buf.push_back((uint8_t) record | (uint8_t) (CODEC_ARG_VARINT << 3));
+        append_varint(arg, &this->buf);
+    }
+}
+
+void CaptureEncoder::flush() {
+    if (this->buf.empty()) {
+        return;
+    }
+
+    this->coded.clear();
+    this->entropy_encoder.encode(this->buf.data(), this->buf.size(), &this->coded);
+
+    std::vector<uint8_t> prefix;
+    append_varint(this->buf.size(), &prefix);
+    append_varint(this->coded.size(), &prefix);
+    this->out->write((const char*) prefix.data(), prefix.size());
+    this->out->write((const char*) this->coded.data(), this->coded.size());
+    this->buf.clear();
+}
+
+CaptureResult compress_capture(const uint8_t* capture, size_t len, std::ostream* out) {
+    CaptureReader reader(capture, len);
+    auto result = reader.open();
+
+    if (result != CaptureResult::Ok) {
+        return result;
+    }
+
+    CaptureEncoder encoder(out, capture, len);
+    CaptureChunk chunk;
+
+    while (reader.next(&chunk) == CaptureResult::Ok) {
+        encoder.add(chunk);
+    }
+
+    // an invalid chunk and everything after it is stored as it is
+    encoder.finish(capture + reader.offset(), len - reader.offset());
+    return CaptureResult::Ok;
+}
+
+CaptureDecoder::CaptureDecoder(const uint8_t* compressed, size_t len) :
+    compressed(compressed),
+    compressed_len(len),
+    compressed_offset(0),
+    records(nullptr),
+    len(0),
+    offset(0),
+    capture_len_(0),
+    last_timestamp(0) {}
+
+CodecResult CaptureDecoder::open() {
+    if (this->compressed_len < COMPRESSED_CAPTURE_HEADER_LEN + CAPTURE_HEADER_LEN
+        || memcmp(this->compressed, COMPRESSED_CAPTURE_MAGIC, sizeof(COMPRESSED_CAPTURE_MAGIC))
+            != 0) {
+        return CodecResult::InvalidMagic;
+    }
+
+    if (uint16_from_le(&this->compressed[4]) != COMPRESSED_CAPTURE_VERSION) {
+        return CodecResult::UnsupportedVersion;
+    }
+
+    this->capture_len_ = uint64_from_le(&this->compressed[8]);
+    this->buses.assign(this->capture_header()[6], Bus());
+    this->compressed_offset = COMPRESSED_CAPTURE_HEADER_LEN + CAPTURE_HEADER_LEN;
+    this->records = this->block.data();
+    this->len = 0;
+    this->offset = 0;
+    this->last_timestamp = 0;
+    return CodecResult::Ok;
+}
+
+CodecResult CaptureDecoder::next(std::vector<uint8_t>* out) {
+    // blocks only contain complete chunks
+    if (this->offset == this->len) {
+        if (this->compressed_offset == this->compressed_len) {
+            return CodecResult::End;
+        }
+
+        if (!this->decode_block()) {
+            return CodecResult::Corrupted;
+        }
+    }
+
+    auto tag = this->records[this->offset++];
+    uint64_t arg;
+
+    if (!this->read_arg(tag, &arg)) {
+        return CodecResult::Corrupted;
+    }
+
+    switch ((CodecRecord) (tag & 0x07)) {
+        case CodecRecord::Chunk: {
+            uint64_t timestamp_diff;
+            uint64_t data_len;
+
+            if (arg >= this->buses.size() || !this->read_varint(&timestamp_diff)
+                || !this->read_varint(&data_len)) {
+                return CodecResult::Corrupted;
+            }
+
+            auto& bus = this->buses[arg];
+
+            while (bus.data.size() - bus.start < data_len) {
+                if (!this->decode_data(bus)) {
+                    return CodecResult::Corrupted;
+                }
+            }
+
+            this->last_timestamp += (uint64_t) zigzag_decode(timestamp_diff);
+            uint8_t header[CAPTURE_CHUNK_HEADER_LEN] = {};
+            uint64_to_le(&header[0], this->last_timestamp);
+            uint32_to_le(&header[8], (uint32_t) data_len);
+            header[12] = (uint8_t) arg;
+            header[13] = (uint8_t) CaptureChunkKind::Data;
+            out->insert(out->end(), header, header + sizeof(header));
+
+            auto data = bus.data.begin() + bus.start;
+            out->insert(out->end(), data, data + data_len);
+            bus.start += data_len;
+
+            if (bus.start * 2 >= bus.data.size()) {
+                bus.data.erase(bus.data.begin(), bus.data.begin() + bus.start);
+                bus.start = 0;
+            }
+
+            return CodecResult::Ok;
+        }
+        case CodecRecord::RawChunk:
+        case CodecRecord::Tail: {
+            uint64_t raw_len;
+
+            if (!this->read_varint(&raw_len) || raw_len > this->len - this->offset) {
+                return CodecResult::Corrupted;
+            }
+
+            auto raw = this->records + this->offset;
+            out->insert(out->end(), raw, raw + raw_len);
+            this->offset += raw_len;
+            return CodecResult::Ok;
+        }
+        default: { return CodecResult::Corrupted; }
+    }
+}
+
+bool CaptureDecoder::decode_block() {
+    uint64_t records_len;
+    uint64_t coded_len;
+    auto compressed = this->compressed + this->compressed_offset;
+    auto remaining_len = this->compressed_len - this->compressed_offset;
+    auto prefix_len = ::read_varint(compressed, remaining_len, &records_len);
+
+    if (prefix_len == 0 || records_len == 0) {
+        return false;
+    }
+
+    auto coded_len_len =
+        ::read_varint(compressed + prefix_len, remaining_len - prefix_len, &coded_len);
+    prefix_len += coded_len_len;
+
+    if (coded_len_len == 0 || coded_len > remaining_len - prefix_len) {
+        return false;
+    }
+
+    // the coder never predicts a bit with a probability above 4095/4096, so every byte of
+    // records takes at least 1/2800 of a coded byte. This rejects corrupted lengths before
+    // they are allocated.
+    if (records_len / 4096 > coded_len) {
+        return false;
+    }
+
+    this->block.clear();
+    this->entropy_decoder.decode(
+        compressed + prefix_len, coded_len, records_len, &this->block);
+    this->compressed_offset += prefix_len + coded_len;
+    this->records = this->block.data();
+    this->len = this->block.size();
+    this->offset = 0;
+    return true;
+}
+
+bool CaptureDecoder::read_arg(uint8_t tag, uint64_t* arg) {
+    *arg = tag >> 3;
+    return *arg != CODEC_ARG_VARINT || this->read_varint(arg);
+}
+
+bool CaptureDecoder::read_varint(uint64_t* value) {
+    auto len = ::read_varint(this->records + this->offset, this->len - this->offset, value);
+    this->offset += len;
+    return len > 0;
+}
+
+bool CaptureDecoder::decode_data(Bus& bus) {
+    if (this->offset == this->len) {
+        return false;
+    }
+
+    auto tag = this->records[this->offset++];
+    uint64_t arg;
+
+    if (!this->read_arg(tag, &arg)) {
+        return false;
+    }
+
+    auto remaining_len = [&]() { return this->len - this->offset; };
+
+    switch ((CodecRecord) (tag & 0x07)) {
+        case CodecRecord::Literal: {
+            if (arg > remaining_len()) {
+                return false;
+            }
+
+            auto data = this->records + this->offset;
+            bus.data.insert(bus.data.end(), data, data + arg);
+            this->offset += arg;
+            return true;
+        }
+        case CodecRecord::NewPacket: {
+            if (remaining_len() < 2) {
+                return false;
+            }
+
+            auto device_id = this->records[this->offset++];
+            auto instruction = this->records[this->offset++];
+            uint8_t error = 0;
+            uint64_t data_len;
+
+            if (instruction == STATUS) {
+                if (remaining_len() < 1) {
+                    return false;
+                }
+
+                error = this->records[this->offset++];
+            }
+
+            if (!this->read_varint(&data_len) || data_len > remaining_len()) {
+                return false;
+            }
+
+            auto& shape = bus.shapes.add();
+            auto data = this->records + this->offset;
+            shape.device_id = device_id;
+            shape.instruction = instruction;
+            shape.error = error;
+            shape.data.assign(data, data + data_len);
+            this->offset += data_len;
+            encode_packet(shape, &bus.data);
+            return true;
+        }
+        case CodecRecord::Packet: {
+            if (arg >= bus.shapes.size()) {
+                return false;
+            }
+
+            auto& shape = bus.shapes.use(arg);
+            auto data_len = shape.data.size();
+            auto bitmap_len = (data_len + 7) / 8;
+
+            if (bitmap_len > remaining_len()) {
+                return false;
+            }
+
+            auto bitmap = this->records + this->offset;
+            this->offset += bitmap_len;
+
+            for (size_t i = 0; i < bitmap_len; i++) {
+                for (size_t bit = 0; bitmap[i] >> bit != 0; bit++) {
+                    if ((bitmap[i] >> bit & 1) == 0) {
+                        continue;
+                    }
+
+                    if (remaining_len() == 0 || i * 8 + bit >= data_len) {
+                        return false;
+                    }
+
+                    shape.data[i * 8 + bit] ^= this->records[this->offset++];
+                }
+            }
+
+            encode_packet(shape, &bus.data);
+            return true;
+        }
+        case CodecRecord::RepeatedPacket: {
+            if (arg >= bus.shapes.size()) {
+                return false;
+            }
+
+            encode_packet(bus.shapes.use(arg), &bus.data);
+            return true;
+        }
+        default: { return false; }
+    }
+}
@@ -0,0 +1,278 @@
+#ifndef CAPTURE_CODEC_H
+#define CAPTURE_CODEC_H
+
+#include "capture.h"
+#include "entropy_coder.h"
+
+#include <deque>
+#include <ostream>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/// A compressed capture stores a capture (see `capture.h`) bit-exactly in much less space.
+/// The data of every bus is split into packets and the bytes between them, and every packet
+/// is encoded as the difference to the last packet of the same shape (see `PacketShapes`),
+/// which is usually only a few bytes since the same instructions are sent in every control
+/// cycle. Checksums and byte stuffing are computed again when decoding. The resulting records
+/// repeat in every control cycle as well, so they are compressed further by an
+/// `EntropyEncoder`. All fields are little-endian:
+///
+/// - a header of `COMPRESSED_CAPTURE_HEADER_LEN` bytes: the magic `DXCZ`, the format version
+///   (u16), a reserved u16 and the length of the capture (u64)
+/// - the header of the capture (`CAPTURE_HEADER_LEN` bytes)
+/// - blocks of records, each consisting of the length of the records and the length of the
+///   coded records (both varints, see `varint.h`), followed by the records as coded by the
+///   `EntropyEncoder` of the whole capture. A block only contains complete chunks.
+///
+/// Every record starts with a byte that contains the `CodecRecord` in its lowest 3 bits and
+/// an argument in the others (`CODEC_ARG_VARINT` if the argument follows as a varint).
+///
+/// A `Chunk` record (the argument is the bus) is followed by the records of the data of the
+/// bus until enough data for the chunk has been decoded. Data that was decoded beyond the
+/// chunk is used by the next chunk of the bus.
+const uint8_t COMPRESSED_CAPTURE_MAGIC[4] = {'D', 'X', 'C', 'Z'};
+const uint16_t COMPRESSED_CAPTURE_VERSION = 2;
+const size_t COMPRESSED_CAPTURE_HEADER_LEN = 16;
+const uint8_t CODEC_ARG_VARINT = 0x1f;
+
+enum class CodecRecord : uint8_t {
+    /// A data chunk: the difference of its timestamp to the one of the previous `Chunk`
+    /// (zigzag encoded) and the length of its data.
+    Chunk,
+
+    /// Any other chunk (e.g. of an unknown kind): its length including the header, followed
+    /// by the chunk as it is stored in the capture.
+    RawChunk,
+
+    /// Data that is not part of a packet: the argument is the number of bytes that follow.
+    Literal,
+
+    /// A packet with the shape at the index given by the argument: a bitmap of the bytes of
+    /// the data that differ from the shape's data (bit `i % 8` of byte `i / 8` for byte `i`),
+    /// followed by the XOR of every changed byte with the shape's byte.
+    Packet,
+
+    /// A packet that is the same as the shape at the index given by the argument.
+    RepeatedPacket,
+
+    /// A packet with a new shape: the device id, the instruction, the error (only for
+    /// `Instruction::Status`), the length of the data (varint) and the data.
+    NewPacket,
+
+    /// The end of a capture that is not a valid chunk (e.g. a truncated one): its length,
+    /// followed by the bytes.
+    Tail,
+};
+
+enum class CodecResult {
+    Ok,
+
+    /// The whole capture has been decoded.
+    End,
+
+    /// The compressed capture does not start with `COMPRESSED_CAPTURE_MAGIC`.
+    InvalidMagic,
+
+    UnsupportedVersion,
+
+    /// A record is invalid or exceeds the compressed capture.
+    Corrupted,
+};
+
+std::string to_string(CodecResult result);
+
+/// The last packets of a bus, most recently used first. Packets have the same shape if they
+/// have the same device id, instruction, error and data length and, for instructions, the same
+/// first two bytes (the address of most instructions). Sync and bulk instructions then also
+/// address the same devices in most cases, so only the values written or read differ.
+class PacketShapes {
+  public:
+    struct Shape {
+        uint8_t device_id;
+        uint8_t instruction;
+        uint8_t error;
+        std::vector<uint8_t> data;
+    };
+
+    static const size_t MAX_SHAPES = 64;
+
+    /// Returns the index of the shape of a packet or `SIZE_MAX` if it is not known.
+    size_t find(
+        uint8_t device_id,
+        uint8_t instruction,
+        uint8_t error,
+        const std::vector<uint8_t>& data) const;
+
+    size_t size() const {
+        return this->shapes.size();
+    }
+
+    /// Returns the shape at `index` and makes it the most recently used one.
+    Shape& use(size_t index);
+
+    /// Adds a new shape as the most recently used one. The least recently used one is
+    /// replaced if there are `MAX_SHAPES` shapes.
+    Shape& add();
+
+  private:
+    std::vector<Shape> shapes;
+};
+
+/// Compresses a capture chunk by chunk. The data of a chunk can only be encoded once the
+/// packets at its end are complete, so chunks are held back until then.
+class CaptureEncoder {
+  public:
+    /// Writes the header for the compressed capture of `capture_len` bytes whose header is
+    /// `capture_header` (`CAPTURE_HEADER_LEN` bytes) to `out`.
+    CaptureEncoder(std::ostream* out, const uint8_t* capture_header, uint64_t capture_len);
+
+    /// Adds the next chunk of the capture, as read by a `CaptureReader`. The chunk must remain
+    /// valid until `finish` was called.
+    void add(const CaptureChunk& chunk);
+
+    /// Writes all chunks that are held back, followed by the `len` bytes at `tail` after the
+    /// last valid chunk (if any).
+    void finish(const uint8_t* tail, size_t len);
+
+    /// Returns `false` if writing to the stream failed.
+    bool is_ok() const {
+        return this->out->good();
+    }
+
+  private:
+    struct Token {
+        /// The number of bytes of the bus' data the token stands for.
+        size_t len;
+
+        bool is_packet;
+        uint8_t device_id;
+        uint8_t instruction;
+        uint8_t error;
+
+        /// The data of a packet or the bytes of a literal.
+        std::vector<uint8_t> data;
+    };
+
+    struct Bus {
+        /// The data that has not been split into tokens yet, starting at `start`.
+        std::vector<uint8_t> pending;
+        size_t start = 0;
+
+        /// Where to continue searching for a header in a packet that is not complete yet.
+        size_t search_pos = 0;
+
+        /// The number of bytes of the bus' data that have been split into tokens.
+        uint64_t tokenized_len = 0;
+        uint64_t data_len = 0;
+
+        /// The tokens that have not been written yet and the number of bytes of the written
+        /// ones that have not been used by a chunk yet.
+        std::deque<Token> tokens;
+        size_t available_len = 0;
+
+        PacketShapes shapes;
+    };
+
+    struct HeldChunk {
+        CaptureChunk chunk;
+
+        /// Whether the chunk is written as a `RawChunk`.
+        bool is_raw;
+
+        /// The end of the chunk's data in the data of its bus.
+        uint64_t data_end;
+    };
+
+    /// Splits the pending data of a bus into tokens. Unless `is_final` is set, the data at the
+    /// end that may be part of a packet is kept.
+    void tokenize(Bus& bus, bool is_final);
+
+    void add_literal(Bus& bus, size_t len);
+
+    /// Writes the chunks whose data has been split into tokens.
+    void write_chunks();
+
+    void write_token(Bus& bus, Token& token);
+
+    void write_record(CodecRecord record, uint64_t arg);
+
+    /// Writes the buffered records to the stream as a block.
+    void flush();
+
+    std::ostream* out;
+    EntropyEncoder entropy_encoder;
+    std::vector<uint8_t> coded;
+    std::vector<Bus> buses;
+    std::deque<HeldChunk> held_chunks;
+    uint64_t last_timestamp;
+    std::vector<uint8_t> buf;
+    std::vector<uint8_t> raw_packet;
+};
+
+/// Compresses the capture of `len` bytes at `capture` to `out`. Returns an error if the
+/// capture's header is invalid. Anything after the last valid chunk is stored as it is.
+CaptureResult compress_capture(const uint8_t* capture, size_t len, std::ostream* out);
+
+/// Decompresses a compressed capture that is completely in memory chunk by chunk, so the
+/// capture can be processed while it is decompressed.
+class CaptureDecoder {
+  public:
+    CaptureDecoder(const uint8_t* compressed, size_t len);
+
+    /// Checks the header. Must be called before decoding chunks.
+    CodecResult open();
+
+    /// The length of the decompressed capture.
+    uint64_t capture_len() const {
+        return this->capture_len_;
+    }
+
+    /// The header of the capture (`CAPTURE_HEADER_LEN` bytes).
+    const uint8_t* capture_header() const {
+        return this->compressed + COMPRESSED_CAPTURE_HEADER_LEN;
+    }
+
+    /// Appends the next chunk (with its header) or the tail of the capture to `out`. Returns
+    /// `CodecResult::End` after the last one.
+    CodecResult next(std::vector<uint8_t>* out);
+
+  private:
+    struct Bus {
+        /// The decoded data that has not been used by a chunk yet, starting at `start`.
+        std::vector<uint8_t> data;
+        size_t start = 0;
+
+        PacketShapes shapes;
+    };
+
+    /// Decodes the next block of records. Returns `false` if it exceeds the compressed
+    /// capture.
+    bool decode_block();
+
+    /// Reads the argument of a record that starts with `tag`.
+    bool read_arg(uint8_t tag, uint64_t* arg);
+
+    bool read_varint(uint64_t* value);
+
+    /// Decodes the next record of the data of `bus`.
+    bool decode_data(Bus& bus);
+
+    const uint8_t* compressed;
+    size_t compressed_len;
+    size_t compressed_offset;
+    EntropyDecoder entropy_decoder;
+
+    /// The records of the current block.
+    std::vector<uint8_t> block;
+    const uint8_t* records;
+    size_t len;
+    size_t offset;
+
+    uint64_t capture_len_;
+    std::vector<Bus> buses;
+    uint64_t last_timestamp;
+};
+
+#endif
@@ -0,0 +1,190 @@
+#include "capture_diff.h"
+#include "checkpoint.h"
+#include "field_export.h"
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+/// Returns the absolute difference of two values of a field.
+static double field_diff(ControlTableField::FieldType type, uint32_t lhs, uint32_t rhs) {
+    if (type != ControlTableField::FieldType::Float32) {
+        return lhs > rhs ? lhs - rhs : rhs - lhs;
+    }
+
+    float lhs_float;
+    float rhs_float;
+    memcpy(&lhs_float, &lhs, sizeof(lhs_float));
+    memcpy(&rhs_float, &rhs, sizeof(rhs_float));
+    return fabs((double) lhs_float - (double) rhs_float);
+}
+
+static uint16_t model_number(const ControlTable& control_table) {
+    return control_table.is_unknown_model() ? 0 : control_table.model_number();
+}
+
+CycleReplay::CycleReplay(CaptureReader* reader, Instruction cycle_instruction) :
+    scanner(reader),
+    cycle_instruction(cycle_instruction),
+    control_table_map_(reader->num_buses()),
+    has_pending_packet(false),
+    timestamp_(0) {}
+
+bool CycleReplay::next_cycle(CaptureResult* result) {
+    size_t num_packets = 0;
+
+    // the packet is still valid because the scanner has not been called since
+    if (this->has_pending_packet) {
+        apply_scanned_packet(this->control_table_map_, this->packet);
+        this->timestamp_ = this->packet.timestamp;
+        this->has_pending_packet = false;
+        num_packets++;
+    }
+
+    while ((*result = this->scanner.next(&this->packet)) == CaptureResult::Ok) {
+        if (this->packet.result == ParseResult::PacketAvailable
+            && this->packet.packet->instruction == this->cycle_instruction && num_packets > 0) {
+            this->has_pending_packet = true;
+            return true;
+        }
+
+        if (num_packets == 0) {
+            this->timestamp_ = this->packet.timestamp;
+        }
+
+        apply_scanned_packet(this->control_table_map_, this->packet);
+        num_packets++;
+    }
+
+    return num_packets > 0;
+}
+
+CaptureDiff::CaptureDiff(
+    CaptureReader* first,
+    CaptureReader* second,
+    Instruction cycle_instruction) :
+    replays{{first, cycle_instruction}, {second, cycle_instruction}},
+    results{CaptureResult::Ok, CaptureResult::Ok},
+    num_cycles_(0),
+    num_differing_cycles_(0) {}
+
+bool CaptureDiff::next() {
+    // both captures are replayed even if the first one has ended, so both results are known
+    auto has_first = this->replays[0].next_cycle(&this->results[0]);
+    auto has_second = this->replays[1].next_cycle(&this->results[1]);
+
+    if (!has_first || !has_second) {
+        return false;
+    }
+
+    if (this->compare()) {
+        this->num_differing_cycles_++;
+    }
+
+    this->num_cycles_++;
+    return true;
+}
+
+bool CaptureDiff::compare() {
+    auto& first = this->replays[0].control_table_map();
+    auto& second = this->replays[1].control_table_map();
+    auto is_different = false;
+
+    auto add_device = [&](DeviceId device_id, const ControlTable* tables[2]) {
+        is_different = true;
+
+        if (this->device_indices.count(device_id.to_byte()) != 0) {
+            return;
+        }
+
+        DeviceDiff diff{device_id, this->num_cycles_, {false, false}, {0, 0}};
+
+        for (size_t i = 0; i < 2; i++) {
+            diff.is_present[i] = tables[i] != nullptr;
+            diff.model_numbers[i] = tables[i] != nullptr ? model_number(*tables[i]) : 0;
+        }
+
+        this->device_indices[device_id.to_byte()] = this->devices_.size();
+        this->devices_.push_back(diff);
+    };
+
+    for (auto id_and_table : first) {
+        auto& entry = second.get(id_and_table.first);
+        const ControlTable* tables[2] = {id_and_table.second.get(), nullptr};
+
+        if (!entry.is_present()) {
+            add_device(id_and_table.first, tables);
+            continue;
+        }
+
+        tables[1] = entry.value().get();
+
+        if (tables[0]->is_unknown_model() != tables[1]->is_unknown_model()
+            || model_number(*tables[0]) != model_number(*tables[1])) {
+            add_device(id_and_table.first, tables);
+            continue;
+        }
+
+        is_different |= this->compare_fields(id_and_table.first, *tables[0], *tables[1]);
+    }
+
+    for (auto id_and_table : second) {
+        if (!first.get(id_and_table.first).is_present()) {
+            const ControlTable* tables[2] = {nullptr, id_and_table.second.get()};
+            add_device(id_and_table.first, tables);
+        }
+    }
+
+    return is_different;
+}
+
+bool CaptureDiff::compare_fields(
+    DeviceId device_id,
+    const ControlTable& first,
+    const ControlTable& second) {
+    auto& first_memory = first.memory();
+    auto& second_memory = second.memory();
+
+    // the memory of both devices has the same layout since they have the same model
+    if (first_memory.raw() == second_memory.raw()) {
+        return false;
+    }
+
+    auto is_different = false;
+
+    for (auto& field : first.fields()) {
+        auto first_value = read_field_value(first_memory, field);
+        auto second_value = read_field_value(second_memory, field);
+
+        if (first_value == second_value) {
+            continue;
+        }
+
+        is_different = true;
+        auto key = std::make_pair(device_id.to_byte(), field.addr);
+        auto index = this->field_indices.find(key);
+
+        if (index == this->field_indices.end()) {
+            index = this->field_indices.insert({key, this->fields_.size()}).first;
+            this->fields_.push_back(FieldDiff{
+                device_id,
+                field.type,
+                field.name,
+                this->num_cycles_,
+                {this->replays[0].timestamp(), this->replays[1].timestamp()},
+                {first_value, second_value},
+                0,
+                0.0,
+                0.0,
+            });
+        }
+
+        auto& diff = this->fields_[index->second];
+        auto value_diff = field_diff(field.type, first_value, second_value);
+        diff.num_cycles++;
+        diff.max_diff = std::max(diff.max_diff, value_diff);
+        diff.sum_diff += value_diff;
+    }
+
+    return is_different;
+}
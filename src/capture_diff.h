@@ -0,0 +1,142 @@
+#ifndef CAPTURE_DIFF_H
+#define CAPTURE_DIFF_H
+
+#include "capture.h"
+#include "control_table.h"
+
+#include <map>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+/// Replays a capture one control cycle at a time. A cycle starts with every packet with the
+/// cycle's instruction (e.g. the `SyncWrite` a controller sends in every cycle), the packets
+/// before the first one are a cycle of their own.
+class CycleReplay {
+  public:
+    /// Replays the capture read by `reader`, which must have been opened.
+    CycleReplay(CaptureReader* reader, Instruction cycle_instruction);
+
+    CycleReplay(const CycleReplay&) = delete;
+
+    CycleReplay& operator=(const CycleReplay&) = delete;
+
+    /// Applies the packets of the next cycle. Returns `false` if there are none and sets
+    /// `result` to the result of the scanner (`CaptureResult::End` at the end of the capture).
+    bool next_cycle(CaptureResult* result);
+
+    const ControlTableMap& control_table_map() const {
+        return this->control_table_map_;
+    }
+
+    /// The timestamp of the first packet of the current cycle, in us.
+    uint64_t timestamp() const {
+        return this->timestamp_;
+    }
+
+  private:
+    CaptureScanner scanner;
+    Instruction cycle_instruction;
+    ControlTableMap control_table_map_;
+
+    /// The packet that starts the next cycle, if it has been scanned already.
+    ScannedPacket packet;
+    bool has_pending_packet;
+    uint64_t timestamp_;
+};
+
+/// Where a device differs between two captures: it is only part of one of them or the models
+/// are different. Its fields are not compared then.
+struct DeviceDiff {
+    DeviceId device_id;
+
+    /// The first cycle in which the device differed.
+    uint64_t cycle;
+
+    /// Whether the device is part of the first and the second capture.
+    bool is_present[2];
+
+    /// The model numbers in both captures (0 if unknown).
+    uint16_t model_numbers[2];
+};
+
+/// How a field of a device differs between two captures.
+struct FieldDiff {
+    DeviceId device_id;
+    ControlTableField::FieldType type;
+    std::string name;
+
+    /// The first cycle in which the values differed, the timestamps of that cycle in both
+    /// captures and the values at its end (the bits of a `float` for
+    /// `ControlTableField::FieldType::Float32`).
+    uint64_t first_cycle;
+    uint64_t first_timestamps[2];
+    uint32_t first_values[2];
+
+    /// The number of cycles at whose end the values differed and the largest and the summed
+    /// absolute difference of the values at these times.
+    uint64_t num_cycles;
+    double max_diff;
+    double sum_diff;
+};
+
+/// Replays two captures in lockstep, cycle by cycle (see `CycleReplay`), and compares the
+/// fields of all devices at the end of every cycle. Captures are read sequentially and only
+/// the state of the devices is kept, so the memory does not grow with the captures.
+class CaptureDiff {
+  public:
+    /// Compares the captures read by `first` and `second`, which must have been opened.
+    CaptureDiff(CaptureReader* first, CaptureReader* second, Instruction cycle_instruction);
+
+    /// Replays the next cycle of both captures and compares them. Returns `false` once one of
+    /// the captures has no more cycles (see `result`).
+    bool next();
+
+    /// The number of cycles that have been compared.
+    uint64_t num_cycles() const {
+        return this->num_cycles_;
+    }
+
+    /// The number of cycles after which at least one device or field differed.
+    uint64_t num_differing_cycles() const {
+        return this->num_differing_cycles_;
+    }
+
+    /// The result of the scanner of the first (`capture` 0) or the second capture once `next`
+    /// returned `false`. `CaptureResult::Ok` if the capture has more cycles.
+    CaptureResult result(size_t capture) const {
+        return this->results[capture];
+    }
+
+    /// The devices that differed, in the order in which they started to differ.
+    const std::vector<DeviceDiff>& devices() const {
+        return this->devices_;
+    }
+
+    /// The fields that differed, in the order in which they started to differ.
+    const std::vector<FieldDiff>& fields() const {
+        return this->fields_;
+    }
+
+  private:
+    /// Compares the current state of the captures. Returns `true` if anything differed.
+    bool compare();
+
+    /// Compares the fields of a device that is part of both captures with the same model.
+    bool compare_fields(DeviceId device_id, const ControlTable& first, const ControlTable& second);
+
+    CycleReplay replays[2];
+    CaptureResult results[2];
+    uint64_t num_cycles_;
+    uint64_t num_differing_cycles_;
+    std::vector<DeviceDiff> devices_;
+    std::vector<FieldDiff> fields_;
+
+    /// The index of a device (in `devices_`) or a field (by device and address, in `fields_`).
+    std::map<uint8_t, size_t> device_indices;
+    std::map<std::pair<uint8_t, uint16_t>, size_t> field_indices;
+};
+
+#endif
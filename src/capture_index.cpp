@@ -0,0 +1,373 @@
+#include "capture_index.h"
+#include "endian_convert.h"
+#include "varint.h"
+
+#include <bitset>
+#include <string.h>
+
+std::string to_string(CaptureIndexResult result) {
+    switch (result) {
+        case CaptureIndexResult::Ok: {
+            return "ok";
+        }
+        case CaptureIndexResult::InvalidMagic: {
+            return "not an index";
+        }
+        case CaptureIndexResult::UnsupportedVersion: {
+            return "unsupported index version";
+        }
+        case CaptureIndexResult::MismatchedCapture: {
+            return "index does not match the capture";
+        }
+        case CaptureIndexResult::Corrupted: {
+            return "corrupted index";
+        }
+        default: { return "unknown"; }
+    }
+}
+
+CaptureIndexBuilder::CaptureIndexBuilder(size_t num_buses) :
+    decoders(num_buses),
+    num_packets_(0) {}
+
+void CaptureIndexBuilder::add(const ScannedPacket& packet) {
+    auto& decoder = this->decoders[packet.bus];
+    auto is_instruction = packet.packet->instruction != Instruction::Status;
+
+    if (packet.result == ParseResult::PacketFragment) {
+        if (is_instruction) {
+            decoder.decode(*packet.packet);
+        }
+
+        return;
+    }
+
+    if (packet.result != ParseResult::PacketAvailable) {
+        decoder.reset();
+        return;
+    }
+
+    IndexEntry entry{packet.timestamp, packet.location};
+    this->add_entry(IndexKey::device(packet.packet->device_id), entry);
+    this->add_entry(IndexKey::instruction(packet.packet->instruction), entry);
+    this->num_packets_++;
+
+    switch (packet.packet->instruction) {
+        case Instruction::SyncRead:
+        case Instruction::SyncWrite:
+        case Instruction::BulkRead:
+        case Instruction::BulkWrite:
+        case Instruction::FastSyncRead:
+        case Instruction::FastBulkRead: {
+            break;
+        }
+        default: {
+            // fragments of other instructions still have to be discarded
+            decoder.reset();
+            return;
+        }
+    }
+
+    InstructionPacket instruction_packet;
+    InstructionParseResult result;
+
+    if (packet.packet->data_offset > 0) {
+        decoder.decode(*packet.packet);
+        result = decoder.finish(&instruction_packet);
+    } else {
+        result = parse_instruction_packet(*packet.packet, &instruction_packet);
+    }
+
+    if (result != InstructionParseResult::Ok) {
+        return;
+    }
+
+    // a device is listed once, even if it is addressed multiple times
+    std::bitset<DeviceId::num_values()> devices;
+    devices.set(packet.packet->device_id.to_byte());
+
+    auto add_device = [&](DeviceId device_id) {
+        if (!devices.test(device_id.to_byte())) {
+            devices.set(device_id.to_byte());
+            this->add_entry(IndexKey::device(device_id), entry);
+        }
+    };
+
+    switch (instruction_packet.instruction) {
+        case Instruction::SyncRead: {
+            for (auto device_id : instruction_packet.sync_read.devices) {
+                add_device(device_id);
+            }
+
+            break;
+        }
+        case Instruction::SyncWrite: {
+            for (auto device_id : instruction_packet.sync_write.devices) {
+                add_device(device_id);
+            }
+
+            break;
+        }
+        case Instruction::BulkRead: {
+            for (auto& read : instruction_packet.bulk_read.reads) {
+                add_device(read.device_id);
+            }
+
+            break;
+        }
+        case Instruction::BulkWrite: {
+            for (auto& write : instruction_packet.bulk_write.writes) {
+                add_device(write.device_id);
+            }
+
+            break;
+        }
+        case Instruction::FastSyncRead: {
+            for (auto device_id : instruction_packet.fast_sync_read.devices) {
+                add_device(device_id);
+            }
+
+            break;
+        }
+        case Instruction::FastBulkRead: {
+            for (auto& read : instruction_packet.fast_bulk_read.reads) {
+                add_device(read.device_id);
+            }
+
+            break;
+        }
+        default: { break; }
+    }
+}
+
+void CaptureIndexBuilder::write(std::ostream* out, uint64_t capture_len) {
+    size_t num_blocks = 0;
+
+    for (auto& key_and_list : this->lists) {
+        encode_block(key_and_list.second);
+        num_blocks += key_and_list.second.blocks.size();
+    }
+
+    uint8_t header[CAPTURE_INDEX_HEADER_LEN] = {};
+    memcpy(header, CAPTURE_INDEX_MAGIC, sizeof(CAPTURE_INDEX_MAGIC));
+    uint16_to_le(&header[4], CAPTURE_INDEX_VERSION);
+    uint64_to_le(&header[8], capture_len);
+    uint32_to_le(&header[16], (uint32_t) this->lists.size());
+    out->write((const char*) header, sizeof(header));
+
+    size_t first_block = 0;
+
+    for (auto& key_and_list : this->lists) {
+        auto& list = key_and_list.second;
+        uint8_t entry[CAPTURE_INDEX_LIST_LEN] = {};
+        entry[0] = (uint8_t) key_and_list.first.type;
+        entry[1] = key_and_list.first.value;
+        uint32_to_le(&entry[4], (uint32_t) first_block);
+        uint32_to_le(&entry[8], (uint32_t) list.blocks.size());
+        uint32_to_le(&entry[12], (uint32_t) list.num_entries);
+        out->write((const char*) entry, sizeof(entry));
+        first_block += list.blocks.size();
+    }
+
+    size_t data_offset = 0;
+
+    for (auto& key_and_list : this->lists) {
+        auto& list = key_and_list.second;
+
+        for (size_t i = 0; i < list.blocks.size(); i++) {
+            auto& block = list.blocks[i];
+            auto end = i + 1 < list.blocks.size() ? list.blocks[i + 1].data_offset
+                                                  : list.data.size();
+            uint8_t entry[CAPTURE_INDEX_BLOCK_LEN] = {};
+            uint64_to_le(&entry[0], block.first_timestamp);
+            uint64_to_le(&entry[8], block.last_timestamp);
+            uint64_to_le(&entry[16], data_offset + block.data_offset);
+            uint32_to_le(&entry[24], (uint32_t) block.num_entries);
+            uint32_to_le(&entry[28], (uint32_t) (end - block.data_offset));
+            out->write((const char*) entry, sizeof(entry));
+        }
+
+        data_offset += list.data.size();
+    }
+
+    for (auto& key_and_list : this->lists) {
+        auto& data = key_and_list.second.data;
+        out->write((const char*) data.data(), data.size());
+    }
+}
+
+void CaptureIndexBuilder::add_entry(IndexKey key, const IndexEntry& entry) {
+    auto& list = this->lists[key];
+    list.entries.push_back(entry);
+
+    if (list.entries.size() == CAPTURE_INDEX_BLOCK_ENTRIES) {
+        encode_block(list);
+    }
+}
+
+void CaptureIndexBuilder::encode_block(List& list) {
+    if (list.entries.empty()) {
+        return;
+    }
+
+    list.blocks.push_back(Block{
+        list.entries.front().timestamp,
+        list.entries.back().timestamp,
+        list.data.size(),
+        list.entries.size(),
+    });
+
+    auto timestamp = list.entries.front().timestamp;
+    PacketLocation location{0, 0};
+
+    for (auto& entry : list.entries) {
+        auto chunk_offset_delta = (int64_t) entry.location.chunk_offset
+            - (int64_t) location.chunk_offset;
+        auto pos_delta = (int64_t) entry.location.pos
+            - (int64_t) (chunk_offset_delta == 0 ? location.pos : 0);
+        append_varint(entry.timestamp - timestamp, &list.data);
+        append_varint(zigzag_encode(chunk_offset_delta), &list.data);
+        append_varint(zigzag_encode(pos_delta), &list.data);
+        timestamp = entry.timestamp;
+        location = entry.location;
+    }
+
+    list.num_entries += list.entries.size();
+    list.entries.clear();
+}
+
+CaptureIndex::CaptureIndex(const uint8_t* index, size_t len) :
+    index(index),
+    len(len),
+    num_lists(0),
+    num_blocks(0) {}
+
+CaptureIndexResult CaptureIndex::open(uint64_t capture_len) {
+    if (this->len < CAPTURE_INDEX_HEADER_LEN
+        || memcmp(this->index, CAPTURE_INDEX_MAGIC, sizeof(CAPTURE_INDEX_MAGIC)) != 0) {
+        return CaptureIndexResult::InvalidMagic;
+    }
+
+    if (uint16_from_le(&this->index[4]) != CAPTURE_INDEX_VERSION) {
+        return CaptureIndexResult::UnsupportedVersion;
+    }
+
+    if (uint64_from_le(&this->index[8]) != capture_len) {
+        return CaptureIndexResult::MismatchedCapture;
+    }
+
+    auto num_lists = uint32_from_le(&this->index[16]);
+
+    if ((this->len - CAPTURE_INDEX_HEADER_LEN) / CAPTURE_INDEX_LIST_LEN < num_lists) {
+        return CaptureIndexResult::Corrupted;
+    }
+
+    // the blocks follow the lists in the same order
+    size_t num_blocks = 0;
+
+    for (size_t i = 0; i < num_lists; i++) {
+        auto list = &this->index[CAPTURE_INDEX_HEADER_LEN + i * CAPTURE_INDEX_LIST_LEN];
+
+        if (uint32_from_le(&list[4]) != num_blocks) {
+            return CaptureIndexResult::Corrupted;
+        }
+
+        num_blocks += uint32_from_le(&list[8]);
+    }
+
+    auto blocks_start = CAPTURE_INDEX_HEADER_LEN + num_lists * CAPTURE_INDEX_LIST_LEN;
+
+    if ((this->len - blocks_start) / CAPTURE_INDEX_BLOCK_LEN < num_blocks) {
+        return CaptureIndexResult::Corrupted;
+    }
+
+    this->num_lists = num_lists;
+    this->num_blocks = num_blocks;
+    return CaptureIndexResult::Ok;
+}
+
+CaptureIndexResult CaptureIndex::find(
+    IndexKey key,
+    uint64_t from,
+    uint64_t to,
+    std::vector<IndexEntry>* entries) const {
+    auto lists = &this->index[CAPTURE_INDEX_HEADER_LEN];
+    auto blocks = lists + this->num_lists * CAPTURE_INDEX_LIST_LEN;
+    auto data = blocks + this->num_blocks * CAPTURE_INDEX_BLOCK_LEN;
+    size_t data_len = &this->index[this->len] - data;
+
+    // the lists are sorted by key
+    size_t start = 0;
+    size_t end = this->num_lists;
+
+    while (start < end) {
+        auto middle = start + (end - start) / 2;
+        auto list_key = IndexKey{(IndexKeyType) lists[middle * CAPTURE_INDEX_LIST_LEN],
+                                 lists[middle * CAPTURE_INDEX_LIST_LEN + 1]};
+
+        if (list_key < key) {
+            start = middle + 1;
+        } else {
+            end = middle;
+        }
+    }
+
+    auto list = &lists[start * CAPTURE_INDEX_LIST_LEN];
+
+    if (start == this->num_lists || list[0] != (uint8_t) key.type || list[1] != key.value) {
+        return CaptureIndexResult::Ok;
+    }
+
+    size_t first_block = uint32_from_le(&list[4]);
+    size_t num_blocks = uint32_from_le(&list[8]);
+
+    for (size_t i = first_block; i < first_block + num_blocks; i++) {
+        auto block = &blocks[i * CAPTURE_INDEX_BLOCK_LEN];
+        auto timestamp = uint64_from_le(&block[0]);
+
+        if (timestamp > to) {
+            break;
+        }
+
+        if (uint64_from_le(&block[8]) < from) {
+            continue;
+        }
+
+        auto block_offset = uint64_from_le(&block[16]);
+        size_t num_entries = uint32_from_le(&block[24]);
+        size_t block_len = uint32_from_le(&block[28]);
+
+        if (block_offset > data_len || data_len - block_offset < block_len) {
+            return CaptureIndexResult::Corrupted;
+        }
+
+        auto pos = &data[block_offset];
+        auto block_end = pos + block_len;
+        PacketLocation location{0, 0};
+
+        for (size_t j = 0; j < num_entries; j++) {
+            uint64_t values[3];
+
+            for (auto& value : values) {
+                auto value_len = read_varint(pos, block_end - pos, &value);
+
+                if (value_len == 0) {
+                    return CaptureIndexResult::Corrupted;
+                }
+
+                pos += value_len;
+            }
+
+            auto chunk_offset_delta = zigzag_decode(values[1]);
+            timestamp += values[0];
+            location.chunk_offset += chunk_offset_delta;
+            location.pos = (chunk_offset_delta == 0 ? location.pos : 0) + zigzag_decode(values[2]);
+
+            if (timestamp >= from && timestamp <= to) {
+                entries->push_back(IndexEntry{timestamp, location});
+            }
+        }
+    }
+
+    return CaptureIndexResult::Ok;
+}
@@ -0,0 +1,163 @@
+#ifndef CAPTURE_INDEX_H
+#define CAPTURE_INDEX_H
+
+#include "capture.h"
+#include "parser.h"
+
+#include <map>
+#include <ostream>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/// An index of a capture lists where the packets of every device and every instruction are,
+/// so they can be parsed without parsing the whole capture (see `CaptureScanner::seek`). All
+/// fields are little-endian:
+///
+/// - a header of `CAPTURE_INDEX_HEADER_LEN` bytes: the magic `DXIX`, the format version (u16),
+///   a reserved u16, the length of the indexed capture (u64), the number of lists (u32) and a
+///   reserved u32
+/// - the lists, sorted by key, each `CAPTURE_INDEX_LIST_LEN` bytes: the `IndexKeyType` (u8),
+///   the key's value (u8), a reserved u16, the index of the list's first block (u32), the
+///   number of blocks (u32) and the number of entries (u32)
+/// - the blocks of all lists, each `CAPTURE_INDEX_BLOCK_LEN` bytes: the timestamps of the
+///   first and last entry (u64 each), the offset of the block's data relative to the end of
+///   the blocks (u64), the number of entries (u32) and the length of the data (u32)
+/// - the data of the blocks
+///
+/// The entries of a block are stored as varints (see `varint.h`), each as the difference to
+/// the previous entry (starting at the first timestamp and chunk offset 0): the timestamp,
+/// the chunk offset (zigzag encoded) and the position in the chunk (zigzag encoded, relative
+/// to the previous position only if the chunk is the same).
+const uint8_t CAPTURE_INDEX_MAGIC[4] = {'D', 'X', 'I', 'X'};
+const uint16_t CAPTURE_INDEX_VERSION = 1;
+const size_t CAPTURE_INDEX_HEADER_LEN = 24;
+const size_t CAPTURE_INDEX_LIST_LEN = 16;
+const size_t CAPTURE_INDEX_BLOCK_LEN = 32;
+
+/// The maximum number of entries of a block.
+const size_t CAPTURE_INDEX_BLOCK_ENTRIES = 128;
+
+enum class IndexKeyType : uint8_t {
+    /// The packets sent to or by a device. Sync and bulk instructions are listed for every
+    /// device they address.
+    Device,
+
+    /// The packets with an instruction (including `Instruction::Status`).
+    Instruction,
+};
+
+struct IndexKey {
+    static IndexKey device(DeviceId device_id) {
+        return IndexKey{IndexKeyType::Device, device_id.to_byte()};
+    }
+
+    static IndexKey instruction(Instruction instruction) {
+        return IndexKey{IndexKeyType::Instruction, (uint8_t) instruction};
+    }
+
+    IndexKeyType type;
+    uint8_t value;
+};
+
+inline bool operator<(const IndexKey& lhs, const IndexKey& rhs) {
+    return lhs.type < rhs.type || (lhs.type == rhs.type && lhs.value < rhs.value);
+}
+
+/// A packet in the index.
+struct IndexEntry {
+    /// The timestamp of the chunk in which the packet was completed.
+    uint64_t timestamp;
+
+    PacketLocation location;
+};
+
+enum class CaptureIndexResult {
+    Ok,
+
+    /// The index does not start with `CAPTURE_INDEX_MAGIC`.
+    InvalidMagic,
+
+    UnsupportedVersion,
+
+    /// The index was built for a capture of a different length (e.g. one that was still
+    /// being recorded).
+    MismatchedCapture,
+
+    /// The lists or blocks of the index exceed its length.
+    Corrupted,
+};
+
+std::string to_string(CaptureIndexResult result);
+
+/// Builds the index of a capture from the results of a `CaptureScanner`. Only complete
+/// packets with a valid checksum are indexed. The entries are compressed as soon as a block
+/// is full, so the index is built in a single pass with little memory.
+class CaptureIndexBuilder {
+  public:
+    explicit CaptureIndexBuilder(size_t num_buses);
+
+    /// Adds a scanned packet. Fragments are decoded to find the devices addressed by large
+    /// sync and bulk instructions.
+    void add(const ScannedPacket& packet);
+
+    /// Returns the number of indexed packets.
+    size_t num_packets() const {
+        return this->num_packets_;
+    }
+
+    /// Writes the index of a capture of `capture_len` bytes to `out`.
+    void write(std::ostream* out, uint64_t capture_len);
+
+  private:
+    struct Block {
+        uint64_t first_timestamp;
+        uint64_t last_timestamp;
+        size_t data_offset;
+        size_t num_entries;
+    };
+
+    struct List {
+        std::vector<IndexEntry> entries;
+        std::vector<Block> blocks;
+        std::vector<uint8_t> data;
+        size_t num_entries = 0;
+    };
+
+    void add_entry(IndexKey key, const IndexEntry& entry);
+
+    /// Compresses the entries that are not part of a block yet.
+    static void encode_block(List& list);
+
+    std::map<IndexKey, List> lists;
+    std::vector<InstructionDecoder> decoders;
+    size_t num_packets_;
+};
+
+/// Reads an index that is completely in memory.
+class CaptureIndex {
+  public:
+    CaptureIndex(const uint8_t* index, size_t len);
+
+    /// Checks the index' header. Must be called before `find`. `capture_len` is the length of
+    /// the capture that is searched.
+    CaptureIndexResult open(uint64_t capture_len);
+
+    /// Appends the entries of `key` with a timestamp from `from` to `to` (inclusive) to
+    /// `entries`, in the order of their timestamps. Only the blocks within that range are
+    /// decoded.
+    CaptureIndexResult find(
+        IndexKey key,
+        uint64_t from,
+        uint64_t to,
+        std::vector<IndexEntry>* entries) const;
+
+  private:
+    const uint8_t* index;
+    size_t len;
+    size_t num_lists;
+    size_t num_blocks;
+};
+
+#endif
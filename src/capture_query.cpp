@@ -0,0 +1,560 @@
+#include "capture_query.h"
+
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+
+/// Parses an unsigned number (decimal or hexadecimal with `0x`). Returns `false` if `value`
+/// is not a number.
+static bool parse_number(const std::string& str, uint64_t* value) {
+    char* end;
+    *value = strtoull(str.c_str(), &end, 0);
+    return !str.empty() && str[0] != '-' && *end == '\0';
+}
+
+/// Parses a time like `120`, `120.5s`, `1500ms` or `20us` into us. Returns `false` if `str` is
+/// not a time.
+static bool parse_time(const std::string& str, uint64_t* timestamp) {
+    char* end;
+    auto time = strtod(str.c_str(), &end);
+    double scale;
+
+    if (strcmp(end, "") == 0 || strcmp(end, "s") == 0) {
+        scale = 1e6;
+    } else if (strcmp(end, "ms") == 0) {
+        scale = 1e3;
+    } else if (strcmp(end, "us") == 0) {
+        scale = 1.0;
+    } else {
+        return false;
+    }
+
+    *timestamp = (uint64_t) (time * scale + 0.5);
+    return end != str.c_str() && time >= 0.0;
+}
+
+static bool compare(QueryOp op, uint64_t lhs, uint64_t rhs) {
+    switch (op) {
+        case QueryOp::Equal: {
+            return lhs == rhs;
+        }
+        case QueryOp::NotEqual: {
+            return lhs != rhs;
+        }
+        case QueryOp::Less: {
+            return lhs < rhs;
+        }
+        case QueryOp::LessEqual: {
+            return lhs <= rhs;
+        }
+        case QueryOp::Greater: {
+            return lhs > rhs;
+        }
+        case QueryOp::GreaterEqual: {
+            return lhs >= rhs;
+        }
+        default: { return false; }
+    }
+}
+
+static uint16_t field_len(ControlTableField::FieldType type) {
+    switch (type) {
+        case ControlTableField::FieldType::UInt8: {
+            return 1;
+        }
+        case ControlTableField::FieldType::UInt16: {
+            return 2;
+        }
+        default: { return 4; }
+    }
+}
+
+CaptureQuery::CaptureQuery(size_t num_buses) :
+    from_(0),
+    to_(UINT64_MAX),
+    has_device_filter(false),
+    decoders(num_buses),
+    requests(num_buses) {}
+
+bool CaptureQuery::add_filter(const std::string& filter, std::string* error) {
+    auto op_pos = filter.find_first_of("!<>=");
+
+    if (op_pos == std::string::npos || op_pos == 0) {
+        *error = "expected a filter like `device=5`, got `" + filter + "`";
+        return false;
+    }
+
+    auto key_name = filter.substr(0, op_pos);
+    QueryOp op;
+    size_t op_len = 2;
+
+    if (filter.compare(op_pos, 2, "!=") == 0) {
+        op = QueryOp::NotEqual;
+    } else if (filter.compare(op_pos, 2, "<=") == 0) {
+        op = QueryOp::LessEqual;
+    } else if (filter.compare(op_pos, 2, ">=") == 0) {
+        op = QueryOp::GreaterEqual;
+    } else {
+        op_len = 1;
+
+        switch (filter[op_pos]) {
+            case '=': {
+                op = QueryOp::Equal;
+                break;
+            }
+            case '<': {
+                op = QueryOp::Less;
+                break;
+            }
+            case '>': {
+                op = QueryOp::Greater;
+                break;
+            }
+            default: {
+                *error = "unknown operator in `" + filter + "`";
+                return false;
+            }
+        }
+    }
+
+    auto value = filter.substr(op_pos + op_len);
+
+    if (value.size() >= 2 && value.front() == '"' && value.back() == '"') {
+        value = value.substr(1, value.size() - 2);
+    }
+
+    auto is_equality = op == QueryOp::Equal || op == QueryOp::NotEqual;
+    uint64_t number;
+
+    if (key_name == "bus" || key_name == "device" || key_name == "status.error") {
+        auto key = key_name == "bus" ? QueryKey::Bus
+            : key_name == "device"   ? QueryKey::Device
+                                     : QueryKey::StatusError;
+
+        if (!parse_number(value, &number)) {
+            *error = "expected a number in `" + filter + "`";
+            return false;
+        }
+
+        this->has_device_filter |= key == QueryKey::Device;
+        this->filters.push_back(QueryFilter{key, op, number});
+        return true;
+    }
+
+    if (key_name == "instruction") {
+        Instruction instruction;
+
+        if (!is_equality || !instruction_from_string(value, &instruction)) {
+            *error = "expected `instruction=<name>` or `instruction!=<name>`, got `" + filter
+                + "`";
+            return false;
+        }
+
+        this->filters.push_back(QueryFilter{QueryKey::Instruction, op, (uint64_t) instruction});
+        return true;
+    }
+
+    if (key_name == "t" || key_name == "time") {
+        auto range_pos = value.find("..");
+        std::vector<QueryFilter> time_filters;
+        uint64_t from;
+        uint64_t to;
+
+        // a range includes both ends
+        if (op == QueryOp::Equal && range_pos != std::string::npos) {
+            if (!parse_time(value.substr(0, range_pos), &from)
+                || !parse_time(value.substr(range_pos + 2), &to)) {
+                *error = "expected a time range like `t=120s..180s`, got `" + filter + "`";
+                return false;
+            }
+
+            time_filters.push_back(QueryFilter{QueryKey::Time, QueryOp::GreaterEqual, from});
+            time_filters.push_back(QueryFilter{QueryKey::Time, QueryOp::LessEqual, to});
+        } else if (parse_time(value, &from)) {
+            time_filters.push_back(QueryFilter{QueryKey::Time, op, from});
+        } else {
+            *error = "expected a time in `" + filter + "`";
+            return false;
+        }
+
+        // the range only narrows the part of the capture that has to be scanned
+        for (auto& time_filter : time_filters) {
+            auto timestamp = time_filter.value;
+            this->filters.push_back(time_filter);
+
+            switch (time_filter.op) {
+                case QueryOp::Equal: {
+                    this->from_ = std::max(this->from_, timestamp);
+                    this->to_ = std::min(this->to_, timestamp);
+                    break;
+                }
+                case QueryOp::Less: {
+                    this->to_ = std::min(this->to_, timestamp == 0 ? 0 : timestamp - 1);
+                    break;
+                }
+                case QueryOp::LessEqual: {
+                    this->to_ = std::min(this->to_, timestamp);
+                    break;
+                }
+                case QueryOp::Greater: {
+                    this->from_ = std::max(this->from_, timestamp + 1);
+                    break;
+                }
+                case QueryOp::GreaterEqual: {
+                    this->from_ = std::max(this->from_, timestamp);
+                    break;
+                }
+                default: { break; }
+            }
+        }
+
+        return true;
+    }
+
+    if (key_name == "field") {
+        if (op != QueryOp::Equal || !this->field_name_.empty()) {
+            *error = "expected a single `field=<name>`, got `" + filter + "`";
+            return false;
+        }
+
+        // the model of a device is not known without replaying the capture, so the field is
+        // looked up in all supported models
+        for (auto model_number : ControlTableMap::supported_model_numbers()) {
+            auto control_table = ControlTableMap::create_control_table(model_number);
+
+            for (auto& field : control_table->fields()) {
+                auto len = field_len(field.type);
+                auto is_known = false;
+
+                for (auto& addr : this->field_addrs) {
+                    is_known |= addr.addr == field.addr && addr.len == len;
+                }
+
+                if (value == field.name && !is_known) {
+                    this->field_addrs.push_back(FieldAddr{field.addr, len, field.type});
+                }
+            }
+        }
+
+        if (this->field_addrs.empty()) {
+            *error = "unknown field `" + value + "`";
+            return false;
+        }
+
+        this->field_name_ = value;
+        return true;
+    }
+
+    *error = "unknown filter `" + key_name + "`";
+    return false;
+}
+
+bool CaptureQuery::index_keys(std::vector<IndexKey>* keys) const {
+    keys->clear();
+    auto may_be_status = true;
+
+    for (auto& filter : this->filters) {
+        if (filter.op != QueryOp::Equal) {
+            continue;
+        }
+
+        if (filter.key == QueryKey::Device) {
+            keys->push_back(IndexKey::device(DeviceId((uint8_t) filter.value)));
+        } else if (filter.key == QueryKey::Instruction) {
+            keys->push_back(IndexKey::instruction((Instruction) filter.value));
+            may_be_status &= filter.value == (uint64_t) Instruction::Status;
+        }
+    }
+
+    // status packets match a field with the instruction before them
+    return !keys->empty() && (this->field_name_.empty() || !may_be_status);
+}
+
+bool CaptureQuery::matches(const ScannedPacket& packet) {
+    auto needs_payload = this->has_device_filter || !this->field_name_.empty();
+    auto& decoder = this->decoders[packet.bus];
+    auto& request = this->requests[packet.bus];
+    auto is_status = packet.packet != nullptr
+        && packet.packet->instruction == Instruction::Status;
+
+    if (packet.result == ParseResult::PacketFragment) {
+        if (needs_payload && !is_status) {
+            decoder.decode(*packet.packet);
+        }
+
+        return false;
+    }
+
+    if (packet.result != ParseResult::PacketAvailable) {
+        decoder.reset();
+        request.is_valid = false;
+        return false;
+    }
+
+    // the instruction is needed for the status packets after it even if it does not match
+    auto is_request_needed = !this->field_name_.empty() && !is_status;
+    auto is_decoded = false;
+
+    auto decode = [&](InstructionPacket* instruction_packet) {
+        InstructionParseResult result;
+
+        if (packet.packet->data_offset > 0) {
+            decoder.decode(*packet.packet);
+            result = decoder.finish(instruction_packet);
+        } else {
+            decoder.reset();
+            result = parse_instruction_packet(*packet.packet, instruction_packet);
+        }
+
+        is_decoded = true;
+        return result == InstructionParseResult::Ok;
+    };
+
+    if (is_request_needed) {
+        request.is_valid = decode(&request.packet);
+    } else if (!is_status) {
+        request.is_valid = false;
+    }
+
+    if (!this->matches_header(packet)) {
+        if (!is_decoded) {
+            decoder.reset();
+        }
+
+        return false;
+    }
+
+    this->field_values_.clear();
+
+    if (!needs_payload) {
+        return true;
+    }
+
+    if (is_status) {
+        return this->matches_payload(*packet.packet, nullptr, packet.bus);
+    }
+
+    if (is_request_needed) {
+        return request.is_valid
+            && this->matches_payload(*packet.packet, &request.packet, packet.bus);
+    }
+
+    return decode(&this->instruction_packet)
+        && this->matches_payload(*packet.packet, &this->instruction_packet, packet.bus);
+}
+
+void CaptureQuery::reset() {
+    for (size_t i = 0; i < this->decoders.size(); i++) {
+        this->decoders[i].reset();
+        this->requests[i].is_valid = false;
+    }
+}
+
+bool CaptureQuery::matches_header(const ScannedPacket& packet) const {
+    auto& header = *packet.packet;
+    auto is_status = header.instruction == Instruction::Status;
+
+    if (!this->matches_filters(QueryKey::Bus, packet.bus)
+        || !this->matches_filters(QueryKey::Time, packet.timestamp)
+        || !this->matches_filters(QueryKey::Instruction, (uint64_t) header.instruction)) {
+        return false;
+    }
+
+    for (auto& filter : this->filters) {
+        if (filter.key == QueryKey::StatusError
+            && (!is_status || !compare(filter.op, header.error.to_byte(), filter.value))) {
+            return false;
+        }
+    }
+
+    // only broadcasts address other devices in their payload
+    return !this->has_device_filter || header.device_id.is_broadcast()
+        || this->matches_filters(QueryKey::Device, header.device_id.to_byte());
+}
+
+bool CaptureQuery::matches_filters(QueryKey key, uint64_t value) const {
+    for (auto& filter : this->filters) {
+        if (filter.key == key && !compare(filter.op, value, filter.value)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool CaptureQuery::matches_payload(
+    const Packet& packet,
+    const InstructionPacket* instruction,
+    size_t bus) {
+    std::vector<DeviceId> devices{packet.device_id};
+    auto has_field = this->field_name_.empty();
+    auto is_field_queried = !this->field_name_.empty();
+
+    auto add = [&](DeviceId device_id, uint16_t start_addr, uint16_t len, const uint8_t* data,
+                   size_t data_len) {
+        devices.push_back(device_id);
+
+        if (is_field_queried) {
+            has_field |= this->add_field_access(device_id, start_addr, len, data, data_len);
+        }
+    };
+
+    // fragmented status packets only contain their last fragment
+    auto data = packet.data_offset == 0 ? packet.data.data() : nullptr;
+    auto data_len = packet.data_offset == 0 ? packet.data.size() : 0;
+
+    if (instruction == nullptr) {
+        auto& request = this->requests[bus];
+
+        if (is_field_queried && request.is_valid) {
+            auto& args = request.packet;
+
+            switch (args.instruction) {
+                case Instruction::Read: {
+                    if (args.read.device_id == packet.device_id) {
+                        add(packet.device_id, args.read.start_addr, args.read.len, data, data_len);
+                    }
+
+                    break;
+                }
+                case Instruction::SyncRead: {
+                    for (auto device_id : args.sync_read.devices) {
+                        if (device_id == packet.device_id) {
+                            add(device_id, args.sync_read.start_addr, args.sync_read.len, data,
+                                data_len);
+                        }
+                    }
+
+                    break;
+                }
+                case Instruction::BulkRead: {
+                    for (auto& read : args.bulk_read.reads) {
+                        if (read.device_id == packet.device_id) {
+                            add(read.device_id, read.start_addr, read.len, data, data_len);
+                        }
+                    }
+
+                    break;
+                }
+                default: { break; }
+            }
+        }
+    } else {
+        switch (instruction->instruction) {
+            case Instruction::Read: {
+                auto& args = instruction->read;
+                add(args.device_id, args.start_addr, args.len, nullptr, 0);
+                break;
+            }
+            case Instruction::Write: {
+                auto& args = instruction->write;
+                add(args.device_id, args.start_addr, (uint16_t) args.data.size(),
+                    args.data.data(), args.data.size());
+                break;
+            }
+            case Instruction::RegWrite: {
+                auto& args = instruction->reg_write;
+                add(args.device_id, args.start_addr, (uint16_t) args.data.size(),
+                    args.data.data(), args.data.size());
+                break;
+            }
+            case Instruction::SyncRead: {
+                auto& args = instruction->sync_read;
+
+                for (auto device_id : args.devices) {
+                    add(device_id, args.start_addr, args.len, nullptr, 0);
+                }
+
+                break;
+            }
+            case Instruction::SyncWrite: {
+                auto& args = instruction->sync_write;
+
+                for (size_t i = 0; i < args.devices.size(); i++) {
+                    auto device_data = args.data.data() + i * args.len;
+                    add(args.devices[i], args.start_addr, args.len, device_data, args.len);
+                }
+
+                break;
+            }
+            case Instruction::BulkRead: {
+                for (auto& read : instruction->bulk_read.reads) {
+                    add(read.device_id, read.start_addr, read.len, nullptr, 0);
+                }
+
+                break;
+            }
+            case Instruction::BulkWrite: {
+                for (auto& write : instruction->bulk_write.writes) {
+                    add(write.device_id, write.start_addr, (uint16_t) write.data.size(),
+                        write.data.data(), write.data.size());
+                }
+
+                break;
+            }
+            case Instruction::FastSyncRead: {
+                auto& args = instruction->fast_sync_read;
+
+                for (auto device_id : args.devices) {
+                    add(device_id, args.start_addr, args.len, nullptr, 0);
+                }
+
+                break;
+            }
+            case Instruction::FastBulkRead: {
+                for (auto& read : instruction->fast_bulk_read.reads) {
+                    add(read.device_id, read.start_addr, read.len, nullptr, 0);
+                }
+
+                break;
+            }
+            default: { break; }
+        }
+    }
+
+    if (!has_field) {
+        return false;
+    }
+
+    for (auto device_id : devices) {
+        if (this->matches_filters(QueryKey::Device, device_id.to_byte())) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool CaptureQuery::add_field_access(
+    DeviceId device_id,
+    uint16_t start_addr,
+    uint16_t len,
+    const uint8_t* data,
+    size_t data_len) {
+    // the field of a device that does not match is not part of the result
+    if (!this->matches_filters(QueryKey::Device, device_id.to_byte())) {
+        return false;
+    }
+
+    for (auto& field : this->field_addrs) {
+        if (field.addr < start_addr || field.addr + field.len > start_addr + len) {
+            continue;
+        }
+
+        size_t offset = field.addr - start_addr;
+
+        if (data != nullptr && offset + field.len <= data_len) {
+            uint32_t value = 0;
+
+            for (size_t i = 0; i < field.len; i++) {
+                value |= (uint32_t) data[offset + i] << (8 * i);
+            }
+
+            this->field_values_.push_back(QueryFieldValue{device_id, field.type, value});
+        }
+
+        return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,153 @@
+#ifndef CAPTURE_QUERY_H
+#define CAPTURE_QUERY_H
+
+#include "capture.h"
+#include "capture_index.h"
+#include "control_table.h"
+#include "parser.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/// What a filter of a `CaptureQuery` compares.
+enum class QueryKey {
+    Bus,
+
+    /// The devices of a packet: the device it is sent to or by and, for sync and bulk
+    /// instructions, every device they address. A packet matches if one of its devices
+    /// matches all device filters.
+    Device,
+
+    Instruction,
+
+    /// The error of a status packet. Other packets never match.
+    StatusError,
+
+    /// The timestamp of the chunk in which a packet was completed, in us.
+    Time,
+
+    /// A field (by name) that an instruction reads or writes for one of its devices. Status
+    /// packets match if the instruction before them read the field from their device. Fast
+    /// sync and bulk reads only match with their instruction. Only `=` is supported.
+    Field,
+};
+
+enum class QueryOp {
+    Equal,
+    NotEqual,
+    Less,
+    LessEqual,
+    Greater,
+    GreaterEqual,
+};
+
+struct QueryFilter {
+    QueryKey key;
+    QueryOp op;
+
+    /// The byte of an instruction, the timestamp in us or the number to compare with.
+    uint64_t value;
+};
+
+/// A value of the queried field in a matching packet.
+struct QueryFieldValue {
+    DeviceId device_id;
+    ControlTableField::FieldType type;
+
+    /// The value, the bits of a `float` for `ControlTableField::FieldType::Float32`.
+    uint32_t value;
+};
+
+/// Selects the packets of a capture that match all of its filters. The filters on the
+/// header of a packet (bus, time, instruction, error and the device a packet is sent to or
+/// by) are checked first, so the payload is only decoded for packets that may still match.
+class CaptureQuery {
+  public:
+    /// Creates a query for a capture with `num_buses` buses that matches every packet.
+    explicit CaptureQuery(size_t num_buses);
+
+    /// Adds a filter like `device=5`, `instruction!=Status`, `status.error>0`, `t=120s..180s`
+    /// (times are in seconds unless they end in `ms` or `us`) or `field=Goal Position`.
+    /// Returns `false` and sets `error` if the filter is invalid.
+    bool add_filter(const std::string& filter, std::string* error);
+
+    /// The time range of the matching packets, in us.
+    uint64_t from() const {
+        return this->from_;
+    }
+
+    uint64_t to() const {
+        return this->to_;
+    }
+
+    /// Sets `keys` to index keys (see `CaptureIndex::find`) that every matching packet is
+    /// listed under. Returns `false` if there are none or if packets can only be checked
+    /// together with the packets before them, so the whole capture has to be scanned.
+    bool index_keys(std::vector<IndexKey>* keys) const;
+
+    /// Checks a packet found by a `CaptureScanner`. Unless the packets are found with an
+    /// index (see `index_keys`), it must be called with every result of the scanner in order.
+    /// Only packets with the result `ParseResult::PacketAvailable` can match.
+    bool matches(const ScannedPacket& packet);
+
+    /// Forgets the packets before, e.g. after seeking to another packet.
+    void reset();
+
+    /// The name of the queried field (empty if there is no field filter).
+    const std::string& field_name() const {
+        return this->field_name_;
+    }
+
+    /// The values of the queried field in the last matching packet, if it contains them.
+    const std::vector<QueryFieldValue>& field_values() const {
+        return this->field_values_;
+    }
+
+  private:
+    /// Where the queried field is in the control table of one of the supported models.
+    struct FieldAddr {
+        uint16_t addr;
+        uint16_t len;
+        ControlTableField::FieldType type;
+    };
+
+    /// The instruction before the status packets of a bus.
+    struct Request {
+        bool is_valid = false;
+        InstructionPacket packet;
+    };
+
+    bool matches_header(const ScannedPacket& packet) const;
+
+    /// Checks the filters of `key` against `value`.
+    bool matches_filters(QueryKey key, uint64_t value) const;
+
+    /// Collects the devices and the field values of a packet and checks the device and field
+    /// filters. `instruction` is the decoded packet unless it is a status packet.
+    bool matches_payload(const Packet& packet, const InstructionPacket* instruction, size_t bus);
+
+    /// Checks whether the range `start_addr..start_addr + len` of a device contains the
+    /// queried field and adds its value if `data` (the range's data, `data_len` bytes) does.
+    bool add_field_access(
+        DeviceId device_id,
+        uint16_t start_addr,
+        uint16_t len,
+        const uint8_t* data,
+        size_t data_len);
+
+    std::vector<QueryFilter> filters;
+    uint64_t from_;
+    uint64_t to_;
+    bool has_device_filter;
+    std::string field_name_;
+    std::vector<FieldAddr> field_addrs;
+
+    std::vector<InstructionDecoder> decoders;
+    std::vector<Request> requests;
+    InstructionPacket instruction_packet;
+    std::vector<QueryFieldValue> field_values_;
+};
+
+#endif
@@ -0,0 +1,356 @@
+#include "capture_segments.h"
+
+#include <algorithm>
+#include <iterator>
+
+CaptureResult split_capture(
+    CaptureReader* reader,
+    size_t segment_len,
+    std::vector<size_t>* boundaries) {
+    boundaries->clear();
+    boundaries->push_back(CAPTURE_HEADER_LEN);
+    reader->seek(CAPTURE_HEADER_LEN);
+
+    CaptureChunk chunk;
+    CaptureResult result;
+
+    while ((result = reader->next(&chunk)) == CaptureResult::Ok) {
+        if (reader->offset() - boundaries->back() >= segment_len) {
+            boundaries->push_back(reader->offset());
+        }
+    }
+
+    if (reader->offset() != boundaries->back()) {
+        boundaries->push_back(reader->offset());
+    }
+
+    return result;
+}
+
+/// Returns `true` if `result` completes a packet whose location is known.
+static bool is_complete(ParseResult result) {
+    return result == ParseResult::PacketAvailable || result == ParseResult::MismatchedChecksum;
+}
+
+static void append_packet(const ScannedPacket& packet, CaptureSegment* segment) {
+    auto& data = packet.packet->data;
+    segment->packets.push_back(SegmentPacket{
+        packet.bus,
+        packet.result,
+        packet.timestamp,
+        packet.location,
+        packet.end,
+        packet.packet->device_id,
+        packet.packet->instruction,
+        packet.packet->error,
+        packet.packet->data_offset,
+        segment->data.size(),
+        data.size(),
+    });
+    segment->data.insert(segment->data.end(), data.begin(), data.end());
+}
+
+void scan_segment(
+    const uint8_t* capture,
+    const std::vector<size_t>& boundaries,
+    size_t index,
+    CaptureSegment* segment) {
+    auto start = boundaries[index];
+    auto end = boundaries[index + 1];
+    segment->start = start;
+    segment->end = end;
+    segment->packets.clear();
+    segment->data.clear();
+
+    CaptureReader reader(capture, end);
+    reader.open();
+    reader.seek(start);
+    auto num_buses = reader.num_buses();
+    const PacketLocation NONE{SIZE_MAX, 0};
+
+    // where the data of every bus ends in the segment
+    std::vector<PacketLocation> data_ends(num_buses, NONE);
+    CaptureChunk chunk;
+
+    while (reader.next(&chunk) == CaptureResult::Ok) {
+        if (chunk.kind == CaptureChunkKind::Data && chunk.len > 0) {
+            data_ends[chunk.bus] = PacketLocation{chunk.offset, chunk.len};
+        }
+    }
+
+    CaptureScanner scanner(&reader);
+    scanner.seek(PacketLocation{start, 0});
+    ScannedPacket packet;
+
+    // the index of the first result of the packet that is parsed on every bus, and where the
+    // last packet ended if nothing has been parsed after it
+    std::vector<size_t> packet_starts(num_buses, 0);
+    std::vector<PacketLocation> idle_ends(num_buses, NONE);
+
+    while (scanner.next(&packet) == CaptureResult::Ok) {
+        append_packet(packet, segment);
+
+        if (packet.result != ParseResult::PacketFragment) {
+            packet_starts[packet.bus] = segment->packets.size();
+        }
+
+        idle_ends[packet.bus] = is_complete(packet.result) ? packet.end : NONE;
+    }
+
+    size_t num_pending = 0;
+    segment->handoffs.assign(num_buses, BusHandoff{SegmentHandoff::NoData, NONE});
+
+    for (size_t bus = 0; bus < num_buses; bus++) {
+        auto& handoff = segment->handoffs[bus];
+
+        if (data_ends[bus] == NONE) {
+            scanner.stop(bus);
+        } else if (idle_ends[bus] == data_ends[bus]) {
+            handoff.kind = SegmentHandoff::Idle;
+            scanner.stop(bus);
+        } else {
+            handoff.kind = SegmentHandoff::Unresolved;
+            num_pending++;
+        }
+    }
+
+    // the scanner continues with the following chunks until every bus has completed a packet
+    // that starts after the segment, one segment at a time
+    auto last = boundaries.size() - 1;
+    auto limit = std::min(index + 2, last);
+    reader = CaptureReader(capture, boundaries[limit]);
+    reader.open();
+    reader.seek(end);
+    std::vector<size_t> cuts(num_buses, SIZE_MAX);
+
+    // the limit up to which a bus that is not in the middle of a packet is scanned
+    std::vector<size_t> deadlines(num_buses, limit);
+
+    while (num_pending > 0) {
+        if (scanner.next(&packet) != CaptureResult::Ok) {
+            if (limit == last) {
+                break;
+            }
+
+            for (size_t bus = 0; bus < num_buses; bus++) {
+                if (segment->handoffs[bus].kind == SegmentHandoff::Unresolved
+                    && cuts[bus] == SIZE_MAX && deadlines[bus] <= limit
+                    && !scanner.is_in_packet(bus)) {
+                    scanner.stop(bus);
+                    cuts[bus] = packet_starts[bus];
+                    num_pending--;
+                }
+            }
+
+            reader = CaptureReader(capture, boundaries[limit + 1]);
+            reader.open();
+            reader.seek(boundaries[limit]);
+            limit++;
+            continue;
+        }
+
+        if (is_complete(packet.result) && packet.location.chunk_offset >= end) {
+            // the packet and its fragments are part of the next segment
+            segment->handoffs[packet.bus] = BusHandoff{SegmentHandoff::At, packet.location};
+            cuts[packet.bus] = packet_starts[packet.bus];
+            scanner.stop(packet.bus);
+            num_pending--;
+            continue;
+        }
+
+        append_packet(packet, segment);
+
+        if (packet.result != ParseResult::PacketFragment) {
+            packet_starts[packet.bus] = segment->packets.size();
+        }
+
+        // a packet that was completed after the first limit is followed by the next one if it
+        // starts within the following segment
+        if (limit > index + 2 && !scanner.is_in_packet(packet.bus)) {
+            deadlines[packet.bus] = std::max(deadlines[packet.bus], std::min(limit + 1, last));
+        }
+    }
+
+    auto& packets = segment->packets;
+    size_t len = 0;
+
+    for (size_t i = 0; i < packets.size(); i++) {
+        if (i < cuts[packets[i].bus]) {
+            packets[len] = packets[i];
+            len++;
+        }
+    }
+
+    packets.erase(packets.begin() + len, packets.end());
+}
+
+SegmentMerger::SegmentMerger(size_t num_buses) :
+    buses(num_buses, BusState{BusHandoff{SegmentHandoff::Idle, {0, 0}}, PacketLocation{0, 0}}),
+    current_carry(0),
+    next_ready(0),
+    packet{DeviceId(0), Instruction::Ping, Error(), {}},
+    num_resyncs_(0) {}
+
+void SegmentMerger::add(const CaptureSegment* segment) {
+    auto starts = this->find_starts(*segment);
+    this->committed.clear();
+
+    for (size_t i = 0; i < segment->packets.size(); i++) {
+        auto& packet = segment->packets[i];
+
+        if (i >= starts[packet.bus]) {
+            this->committed.push_back(PacketRef{&packet, segment->data.data()});
+            this->buses[packet.bus].end = packet.end;
+        }
+    }
+
+    // the packets held back before are merged with the new ones by where they end, like a
+    // scanner returns them
+    auto& carry = this->carries[this->current_carry];
+    auto carry_data = this->carry_data[this->current_carry].data();
+    std::vector<PacketRef> carried;
+
+    for (auto& packet : carry) {
+        carried.push_back(PacketRef{&packet, carry_data});
+    }
+
+    this->ready.clear();
+    this->next_ready = 0;
+    std::merge(
+        carried.begin(),
+        carried.end(),
+        this->committed.begin(),
+        this->committed.end(),
+        std::back_inserter(this->ready),
+        [](const PacketRef& lhs, const PacketRef& rhs) {
+            return lhs.packet->end < rhs.packet->end;
+        });
+
+    // packets that end after the segment are only returned after the next one, which may
+    // contain packets of other buses that end before them
+    auto split = std::find_if(this->ready.begin(), this->ready.end(), [&](const PacketRef& ref) {
+        return ref.packet->end.chunk_offset >= segment->end;
+    });
+    auto& next_carry = this->carries[1 - this->current_carry];
+    auto& next_carry_data = this->carry_data[1 - this->current_carry];
+    next_carry.clear();
+    next_carry_data.clear();
+
+    for (auto ref = split; ref != this->ready.end(); ref++) {
+        auto data = ref->data + ref->packet->data_start;
+        next_carry.push_back(*ref->packet);
+        next_carry.back().data_start = next_carry_data.size();
+        next_carry_data.insert(next_carry_data.end(), data, data + ref->packet->data_len);
+    }
+
+    this->ready.erase(split, this->ready.end());
+    this->current_carry = 1 - this->current_carry;
+}
+
+void SegmentMerger::finish() {
+    auto& carry = this->carries[this->current_carry];
+    auto carry_data = this->carry_data[this->current_carry].data();
+    this->ready.clear();
+    this->next_ready = 0;
+
+    for (auto& packet : carry) {
+        this->ready.push_back(PacketRef{&packet, carry_data});
+    }
+}
+
+bool SegmentMerger::next(ScannedPacket* packet) {
+    if (this->next_ready == this->ready.size()) {
+        return false;
+    }
+
+    auto& ref = this->ready[this->next_ready];
+    auto& segment_packet = *ref.packet;
+    auto data = ref.data + segment_packet.data_start;
+    this->next_ready++;
+
+    this->packet.device_id = segment_packet.device_id;
+    this->packet.instruction = segment_packet.instruction;
+    this->packet.error = segment_packet.error;
+    this->packet.data.assign(data, data + segment_packet.data_len);
+    this->packet.data_offset = segment_packet.data_offset;
+
+    *packet = ScannedPacket{
+        segment_packet.bus,
+        segment_packet.result,
+        segment_packet.timestamp,
+        segment_packet.location,
+        segment_packet.end,
+        &this->packet,
+    };
+
+    return true;
+}
+
+std::vector<size_t> SegmentMerger::find_starts(const CaptureSegment& segment) {
+    auto num_buses = this->buses.size();
+    std::vector<size_t> starts(num_buses, SIZE_MAX);
+    std::vector<size_t> resync_starts(num_buses, SIZE_MAX);
+    std::vector<size_t> packet_starts(num_buses, 0);
+
+    for (size_t i = 0; i < segment.packets.size(); i++) {
+        auto& packet = segment.packets[i];
+        auto& bus = this->buses[packet.bus];
+
+        if (is_complete(packet.result)) {
+            if (starts[packet.bus] == SIZE_MAX && bus.handoff.kind == SegmentHandoff::At
+                && packet.location == bus.handoff.location) {
+                starts[packet.bus] = packet_starts[packet.bus];
+            }
+
+            // the first packet after everything merged so far (the parser searched for a
+            // header there, so it found the same one)
+            if (resync_starts[packet.bus] == SIZE_MAX && !(packet.location < bus.end)) {
+                resync_starts[packet.bus] = packet_starts[packet.bus];
+            }
+        }
+
+        if (packet.result != ParseResult::PacketFragment) {
+            packet_starts[packet.bus] = i + 1;
+        }
+    }
+
+    for (size_t bus = 0; bus < num_buses; bus++) {
+        auto& state = this->buses[bus];
+        auto& handoff = segment.handoffs[bus];
+
+        if (handoff.kind == SegmentHandoff::NoData) {
+            continue;
+        }
+
+        switch (state.handoff.kind) {
+            case SegmentHandoff::Idle: {
+                starts[bus] = 0;
+                break;
+            }
+            case SegmentHandoff::At: {
+                // the previous segment has been completed beyond this one
+                if (starts[bus] == SIZE_MAX
+                    && state.handoff.location.chunk_offset >= segment.end) {
+                    continue;
+                }
+
+                break;
+            }
+            default: { break; }
+        }
+
+        if (starts[bus] == SIZE_MAX && resync_starts[bus] != SIZE_MAX) {
+            starts[bus] = resync_starts[bus];
+            this->num_resyncs_++;
+        }
+
+        // the segment's handoff is only known to be right if the segment is in sync, unless it
+        // points after everything merged so far
+        if (starts[bus] != SIZE_MAX
+            || (handoff.kind == SegmentHandoff::At && !(handoff.location < state.end))) {
+            state.handoff = handoff;
+        }
+    }
+
+    return starts;
+}
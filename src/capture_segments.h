@@ -0,0 +1,155 @@
+#ifndef CAPTURE_SEGMENTS_H
+#define CAPTURE_SEGMENTS_H
+
+#include "capture.h"
+#include "parser.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/// Splits the chunks of a capture into segments of about `segment_len` bytes, so they can be
+/// scanned independently (e.g. on multiple threads, see `scan_segment`) and merged again by
+/// a `SegmentMerger`. `boundaries` receives the offset of the first chunk of every segment,
+/// followed by the end of the last one. Returns `CaptureResult::End` if all chunks were read,
+/// otherwise the error of the reader (the segments then end before the invalid chunk).
+CaptureResult split_capture(
+    CaptureReader* reader,
+    size_t segment_len,
+    std::vector<size_t>* boundaries);
+
+/// A result of scanning a segment, like `ScannedPacket`. The data of the packet is stored in
+/// the segment.
+struct SegmentPacket {
+    size_t bus;
+    ParseResult result;
+    uint64_t timestamp;
+    PacketLocation location;
+    PacketLocation end;
+    DeviceId device_id;
+    Instruction instruction;
+    Error error;
+    size_t data_offset;
+
+    /// Where the packet's data is stored in `CaptureSegment::data`.
+    size_t data_start;
+    size_t data_len;
+};
+
+/// How scanning continues on a bus after a segment.
+enum class SegmentHandoff {
+    /// The bus did not receive any data in the segment.
+    NoData,
+
+    /// The last packet of the bus ended with its last byte in the segment, so the next
+    /// segment starts in sync.
+    Idle,
+
+    /// A packet continued after the segment. The next segment is in sync from the packet that
+    /// starts at `BusHandoff::location`, the first one after the segment.
+    At,
+
+    /// No packet started after the segment before the end of the following segment (e.g.
+    /// because the bus only received noise or was silent). The bus is resynchronized at the
+    /// first complete packet after the last one that was merged.
+    Unresolved,
+};
+
+struct BusHandoff {
+    SegmentHandoff kind;
+    PacketLocation location;
+};
+
+/// The packets of a segment of a capture.
+struct CaptureSegment {
+    /// The offset of the segment's first chunk and the end of its last one.
+    size_t start;
+    size_t end;
+
+    /// All results of all buses, in the order in which a `CaptureScanner` returns them. A
+    /// packet that continues after the segment is completed by scanning the following
+    /// chunks until the first packet that starts after the segment (see `handoffs`).
+    std::vector<SegmentPacket> packets;
+    std::vector<uint8_t> data;
+
+    /// How scanning continues after the segment, for every bus.
+    std::vector<BusHandoff> handoffs;
+};
+
+/// Scans the segment with index `index` of a capture that has been opened and split into
+/// `boundaries` (see `split_capture`). Packets that continue after the segment are completed
+/// with the following chunks: up to the end of the following segment for buses that search
+/// for the next packet, and as long as it takes for buses in the middle of a packet (plus one
+/// more segment to find the packet after it). The buffers of `segment` are reused.
+void scan_segment(
+    const uint8_t* capture,
+    const std::vector<size_t>& boundaries,
+    size_t index,
+    CaptureSegment* segment);
+
+/// Merges the scanned segments of a capture into the results a `CaptureScanner` returns for
+/// the whole capture.
+///
+/// Every segment is scanned from its start without knowing the state of the parsers at that
+/// point, so the first packets of a bus may be parsed from the middle of a packet that
+/// started in the previous segment. That packet is completed by the previous segment
+/// instead, which also determines the first packet after it (see `SegmentHandoff`). The
+/// parser state after a header is always the same, so the results of the segment are
+/// exactly those of scanning the whole capture from that packet on.
+class SegmentMerger {
+  public:
+    explicit SegmentMerger(size_t num_buses);
+
+    /// Merges the next segment. `segment` must remain valid until `next` returns `false`.
+    void add(const CaptureSegment* segment);
+
+    /// Makes the packets that were held back for the next segment available. Must be called
+    /// after the last segment.
+    void finish();
+
+    /// Returns the next packet of the added segments. Returns `false` if all packets up to
+    /// the end of the last segment have been returned.
+    bool next(ScannedPacket* packet);
+
+    /// The number of times a bus was resynchronized because the previous segments did not
+    /// determine where to continue. The parser of the bus was searching for a header in that
+    /// case, so the results are still the same as when scanning the whole capture, unless the
+    /// first header after the last merged packet is interrupted by another one (its results
+    /// are then skipped).
+    size_t num_resyncs() const {
+        return this->num_resyncs_;
+    }
+
+  private:
+    struct PacketRef {
+        const SegmentPacket* packet;
+        const uint8_t* data;
+    };
+
+    struct BusState {
+        BusHandoff handoff;
+
+        /// Where the last packet that was merged ended.
+        PacketLocation end;
+    };
+
+    /// Finds the first result of the segment that is merged for every bus (`SIZE_MAX` if
+    /// there is none) and updates the handoffs.
+    std::vector<size_t> find_starts(const CaptureSegment& segment);
+
+    std::vector<BusState> buses;
+
+    /// Packets that end after the last added segment and are merged with the next one. One
+    /// buffer is referenced by `ready` while the other one is filled.
+    std::vector<SegmentPacket> carries[2];
+    std::vector<uint8_t> carry_data[2];
+    size_t current_carry;
+
+    std::vector<PacketRef> committed;
+    std::vector<PacketRef> ready;
+    size_t next_ready;
+    Packet packet;
+    size_t num_resyncs_;
+};
+
+#endif
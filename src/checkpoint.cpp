@@ -0,0 +1,246 @@
+#include "checkpoint.h"
+#include "endian_convert.h"
+
+#include <string.h>
+
+std::string to_string(CheckpointResult result) {
+    switch (result) {
+        case CheckpointResult::Ok: {
+            return "ok";
+        }
+        case CheckpointResult::NotFound: {
+            return "no checkpoint before the time";
+        }
+        case CheckpointResult::InvalidMagic: {
+            return "not a checkpoint file";
+        }
+        case CheckpointResult::UnsupportedVersion: {
+            return "unsupported checkpoint version";
+        }
+        case CheckpointResult::MismatchedCapture: {
+            return "checkpoints do not match the capture";
+        }
+        case CheckpointResult::Corrupted: {
+            return "corrupted checkpoints";
+        }
+        default: { return "unknown"; }
+    }
+}
+
+ProtocolResult apply_scanned_packet(ControlTableMap& map, const ScannedPacket& packet) {
+    switch (packet.result) {
+        case ParseResult::PacketAvailable: {
+            return map.receive(*packet.packet, packet.bus);
+        }
+        case ParseResult::PacketFragment: {
+            map.receive_fragment(*packet.packet, packet.bus);
+            return ProtocolResult::Ok;
+        }
+        default: {
+            map.discard_fragments(packet.bus);
+            return ProtocolResult::Ok;
+        }
+    }
+}
+
+CheckpointWriter::CheckpointWriter(
+    std::ostream* out,
+    size_t num_buses,
+    uint64_t capture_len,
+    uint64_t interval) :
+    out(out),
+    interval(interval),
+    offset(CHECKPOINTS_HEADER_LEN),
+    control_table_map(num_buses),
+    resume(num_buses, PacketLocation{0, 0}),
+    has_packets(false),
+    last_timestamp(0),
+    next_checkpoint(interval) {
+    uint8_t header[CHECKPOINTS_HEADER_LEN] = {};
+    memcpy(header, CHECKPOINTS_MAGIC, sizeof(CHECKPOINTS_MAGIC));
+    uint16_to_le(&header[4], CHECKPOINTS_VERSION);
+    header[6] = (uint8_t) num_buses;
+    uint64_to_le(&header[8], capture_len);
+    uint64_to_le(&header[16], interval);
+    this->out->write((const char*) header, sizeof(header));
+}
+
+void CheckpointWriter::add(const ScannedPacket& packet) {
+    // a checkpoint must contain all packets with the same timestamp
+    if (this->has_packets && packet.timestamp > this->last_timestamp
+        && packet.timestamp >= this->next_checkpoint) {
+        this->write_checkpoint();
+        this->next_checkpoint = this->last_timestamp + this->interval;
+    }
+
+    apply_scanned_packet(this->control_table_map, packet);
+
+    // anything else is parsed again after restoring, so the fragments are staged again
+    if (packet.result == ParseResult::PacketAvailable
+        || packet.result == ParseResult::MismatchedChecksum) {
+        this->resume[packet.bus] = packet.end;
+    }
+
+    this->has_packets = true;
+    this->last_timestamp = packet.timestamp;
+}
+
+void CheckpointWriter::finish() {
+    auto table_offset = this->offset;
+
+    for (auto& entry : this->table) {
+        uint8_t buf[16];
+        uint64_to_le(&buf[0], entry.first);
+        uint64_to_le(&buf[8], entry.second);
+        this->out->write((const char*) buf, sizeof(buf));
+    }
+
+    uint8_t footer[CHECKPOINTS_FOOTER_LEN];
+    uint64_to_le(&footer[0], table_offset);
+    uint64_to_le(&footer[8], this->table.size());
+    this->out->write((const char*) footer, sizeof(footer));
+}
+
+void CheckpointWriter::write_checkpoint() {
+    this->state.clear();
+    this->control_table_map.save(&this->state);
+    this->table.push_back({this->last_timestamp, this->offset});
+
+    uint8_t buf[16];
+    uint64_to_le(&buf[0], this->last_timestamp);
+    uint64_to_le(&buf[8], this->state.size());
+    this->out->write((const char*) buf, sizeof(buf));
+
+    for (auto& location : this->resume) {
+        uint64_to_le(&buf[0], location.chunk_offset);
+        uint64_to_le(&buf[8], location.pos);
+        this->out->write((const char*) buf, sizeof(buf));
+    }
+
+    this->out->write((const char*) this->state.data(), this->state.size());
+    this->offset += 16 * (1 + this->resume.size()) + this->state.size();
+}
+
+CheckpointReader::CheckpointReader(const uint8_t* checkpoints, size_t len) :
+    checkpoints(checkpoints),
+    len(len),
+    num_buses(0),
+    table_offset(0),
+    num_checkpoints_(0) {}
+
+CheckpointResult CheckpointReader::open(uint64_t capture_len, size_t num_buses) {
+    if (this->len < CHECKPOINTS_HEADER_LEN
+        || memcmp(this->checkpoints, CHECKPOINTS_MAGIC, sizeof(CHECKPOINTS_MAGIC)) != 0) {
+        return CheckpointResult::InvalidMagic;
+    }
+
+    if (uint16_from_le(&this->checkpoints[4]) != CHECKPOINTS_VERSION) {
+        return CheckpointResult::UnsupportedVersion;
+    }
+
+    if (this->checkpoints[6] != num_buses
+        || uint64_from_le(&this->checkpoints[8]) != capture_len) {
+        return CheckpointResult::MismatchedCapture;
+    }
+
+    if (this->len < CHECKPOINTS_HEADER_LEN + CHECKPOINTS_FOOTER_LEN) {
+        return CheckpointResult::Corrupted;
+    }
+
+    auto footer = &this->checkpoints[this->len - CHECKPOINTS_FOOTER_LEN];
+    auto table_offset = uint64_from_le(&footer[0]);
+    auto num_checkpoints = uint64_from_le(&footer[8]);
+    auto table_end = this->len - CHECKPOINTS_FOOTER_LEN;
+
+    if (table_offset < CHECKPOINTS_HEADER_LEN || table_offset > table_end
+        || (table_end - table_offset) / 16 != num_checkpoints) {
+        return CheckpointResult::Corrupted;
+    }
+
+    this->num_buses = num_buses;
+    this->table_offset = table_offset;
+    this->num_checkpoints_ = num_checkpoints;
+    return CheckpointResult::Ok;
+}
+
+CheckpointResult CheckpointReader::find(uint64_t timestamp, Checkpoint* checkpoint) const {
+    auto table = &this->checkpoints[this->table_offset];
+
+    // find the first checkpoint after the timestamp
+    size_t start = 0;
+    size_t end = this->num_checkpoints_;
+
+    while (start < end) {
+        auto middle = start + (end - start) / 2;
+
+        if (uint64_from_le(&table[middle * 16]) <= timestamp) {
+            start = middle + 1;
+        } else {
+            end = middle;
+        }
+    }
+
+    if (start == 0) {
+        return CheckpointResult::NotFound;
+    }
+
+    auto offset = uint64_from_le(&table[(start - 1) * 16 + 8]);
+    auto header_len = 16 * (1 + this->num_buses);
+
+    if (offset < CHECKPOINTS_HEADER_LEN || offset > this->table_offset
+        || this->table_offset - offset < header_len) {
+        return CheckpointResult::Corrupted;
+    }
+
+    auto data = &this->checkpoints[offset];
+    auto state_len = uint64_from_le(&data[8]);
+
+    if (this->table_offset - offset - header_len < state_len) {
+        return CheckpointResult::Corrupted;
+    }
+
+    checkpoint->timestamp = uint64_from_le(&data[0]);
+    checkpoint->resume.clear();
+
+    for (size_t bus = 0; bus < this->num_buses; bus++) {
+        auto location = &data[16 * (1 + bus)];
+        checkpoint->resume.push_back(
+            PacketLocation{uint64_from_le(&location[0]), uint64_from_le(&location[8])});
+    }
+
+    checkpoint->state = data + header_len;
+    checkpoint->state_len = state_len;
+    return CheckpointResult::Ok;
+}
+
+CheckpointResult restore_state(
+    CaptureReader* reader,
+    const CheckpointReader* checkpoints,
+    uint64_t timestamp,
+    ControlTableMap* map) {
+    CaptureScanner scanner(reader);
+    Checkpoint checkpoint;
+    auto result = checkpoints ? checkpoints->find(timestamp, &checkpoint)
+                              : CheckpointResult::NotFound;
+
+    if (result == CheckpointResult::Ok) {
+        if (!map->restore(checkpoint.state, checkpoint.state_len)) {
+            return CheckpointResult::Corrupted;
+        }
+
+        scanner.seek(checkpoint.resume);
+    } else if (result == CheckpointResult::NotFound) {
+        map->clear();
+        scanner.seek(PacketLocation{0, 0});
+    } else {
+        return result;
+    }
+
+    ScannedPacket packet;
+
+    while (scanner.next(&packet) == CaptureResult::Ok && packet.timestamp <= timestamp) {
+        apply_scanned_packet(*map, packet);
+    }
+
+    return CheckpointResult::Ok;
+}
@@ -0,0 +1,144 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "capture.h"
+#include "control_table.h"
+
+#include <ostream>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/// Checkpoints store the state of the `ControlTableMap` at regular intervals of a capture, so
+/// the state at any time can be restored by only replaying the packets since the checkpoint
+/// before it. They are stored next to the capture. All fields are little-endian:
+///
+/// - a header of `CHECKPOINTS_HEADER_LEN` bytes: the magic `DXCK`, the format version (u16),
+///   the number of buses (u8), a reserved byte, the length of the capture (u64) and the
+///   interval between checkpoints in us (u64)
+/// - the checkpoints, each starting with its timestamp (u64) and the length of the state
+///   (u64), followed by the location at which parsing resumes for every bus (chunk offset and
+///   position, u64 each) and the state (see `ControlTableMap::save`)
+/// - a table with the timestamp (u64) and offset (u64) of every checkpoint
+/// - a footer of `CHECKPOINTS_FOOTER_LEN` bytes: the offset of the table (u64) and the number
+///   of checkpoints (u64)
+const uint8_t CHECKPOINTS_MAGIC[4] = {'D', 'X', 'C', 'K'};
+const uint16_t CHECKPOINTS_VERSION = 1;
+const size_t CHECKPOINTS_HEADER_LEN = 24;
+const size_t CHECKPOINTS_FOOTER_LEN = 16;
+
+/// The state of the `ControlTableMap` after all packets of a capture up to a time.
+struct Checkpoint {
+    /// The state contains exactly the packets that were completed at or before this time.
+    uint64_t timestamp;
+
+    /// For every bus, where parsing resumes (the end of the bus' last packet in the state).
+    std::vector<PacketLocation> resume;
+
+    /// The saved state. Points into the checkpoints.
+    const uint8_t* state;
+    size_t state_len;
+};
+
+enum class CheckpointResult {
+    Ok,
+
+    /// There is no checkpoint at or before the requested time.
+    NotFound,
+
+    /// The checkpoints do not start with `CHECKPOINTS_MAGIC`.
+    InvalidMagic,
+
+    UnsupportedVersion,
+
+    /// The checkpoints were created for a different capture (or one that was still being
+    /// recorded).
+    MismatchedCapture,
+
+    /// A checkpoint or the table exceeds the length of the checkpoints or a state cannot be
+    /// restored.
+    Corrupted,
+};
+
+std::string to_string(CheckpointResult result);
+
+/// Applies a packet found by a `CaptureScanner` to `map`, like the `ApplyStage` applies the
+/// packets of a `Connection`.
+ProtocolResult apply_scanned_packet(ControlTableMap& map, const ScannedPacket& packet);
+
+/// Replays a capture and writes a checkpoint whenever `interval` (in us) has passed since
+/// the last one. A shorter interval makes restoring faster but the checkpoints larger.
+class CheckpointWriter {
+  public:
+    /// Writes the header for the checkpoints of a capture of `capture_len` bytes with
+    /// `num_buses` buses to `out`.
+    CheckpointWriter(std::ostream* out, size_t num_buses, uint64_t capture_len, uint64_t interval);
+
+    /// Applies the next packet of the capture. Must be called with every result of the
+    /// scanner, in order.
+    void add(const ScannedPacket& packet);
+
+    /// Writes the table of all checkpoints. Must be called after the last packet.
+    void finish();
+
+    size_t num_checkpoints() const {
+        return this->table.size();
+    }
+
+    /// Returns `false` if writing to the stream failed.
+    bool is_ok() const {
+        return this->out->good();
+    }
+
+  private:
+    void write_checkpoint();
+
+    std::ostream* out;
+    uint64_t interval;
+    uint64_t offset;
+    ControlTableMap control_table_map;
+    std::vector<PacketLocation> resume;
+    std::vector<uint8_t> state;
+    bool has_packets;
+    uint64_t last_timestamp;
+    uint64_t next_checkpoint;
+
+    /// The timestamp and offset of every checkpoint.
+    std::vector<std::pair<uint64_t, uint64_t>> table;
+};
+
+/// Reads checkpoints that are completely in memory.
+class CheckpointReader {
+  public:
+    CheckpointReader(const uint8_t* checkpoints, size_t len);
+
+    /// Checks the header and footer. Must be called before `find`. `capture_len` and
+    /// `num_buses` describe the capture that is replayed.
+    CheckpointResult open(uint64_t capture_len, size_t num_buses);
+
+    size_t num_checkpoints() const {
+        return this->num_checkpoints_;
+    }
+
+    /// Finds the last checkpoint at or before `timestamp`.
+    CheckpointResult find(uint64_t timestamp, Checkpoint* checkpoint) const;
+
+  private:
+    const uint8_t* checkpoints;
+    size_t len;
+    size_t num_buses;
+    size_t table_offset;
+    size_t num_checkpoints_;
+};
+
+/// Sets `map` to the state after all packets of the capture read by `reader` up to
+/// `timestamp`. Starts at the last checkpoint before it if `checkpoints` is not null, so
+/// only the packets after the checkpoint are replayed.
+CheckpointResult restore_state(
+    CaptureReader* reader,
+    const CheckpointReader* checkpoints,
+    uint64_t timestamp,
+    ControlTableMap* map);
+
+#endif
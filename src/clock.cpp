@@ -0,0 +1,16 @@
+#include "clock.h"
+
+#ifdef __arm__
+uint32_t Clock::last_counter = 0;
+uint32_t Clock::num_wraps = 0;
+#endif
+
+void Clock::init() {
+#ifdef __arm__
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    // the cortex-m7 requires the lock access register to be unlocked first
+    DWT->LAR = 0xc5acce55;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+}
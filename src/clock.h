@@ -0,0 +1,81 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <stdint.h>
+
+#ifdef __arm__
+#include <stm32f7xx.h>
+#else
+#include <chrono>
+#endif
+
+/// A monotonic time source with sub-microsecond resolution. On the target the cortex-m7's
+/// cycle counter (DWT CYCCNT) is used, on the host `std::chrono::steady_clock`. All times
+/// are measured in ticks, see `Clock::TICKS_PER_US`.
+class Clock {
+  public:
+    /// A point in time, in ticks.
+    using Timestamp = uint64_t;
+
+    /// The number of ticks per microsecond. On the target this is the core clock, on the
+    /// host ticks are nanoseconds.
+#ifdef __arm__
+    static const uint32_t TICKS_PER_US = 216;
+#else
+    static const uint32_t TICKS_PER_US = 1000;
+#endif
+
+    /// Starts the cycle counter. Must be called once after the clocks have been configured.
+    /// Does nothing on the host.
+    static void init();
+
+    /// Returns the current value of the raw 32-bit counter. The counter wraps around (every
+    /// ~20s on the target), so it should only be used to measure short durations. This is
+    /// cheaper than `Clock::now` since it reads the counter only.
+    static uint32_t counter() {
+#ifdef __arm__
+        return DWT->CYCCNT;
+#else
+        return (uint32_t) Clock::now();
+#endif
+    }
+
+    /// Returns the current time. On the target the 32-bit cycle counter is extended to 64 bits
+    /// in software, which requires this function to be called at least once per wrap of the
+    /// counter (the packet task does this for every buffer).
+    static Timestamp now() {
+#ifdef __arm__
+        auto primask = __get_PRIMASK();
+        __disable_irq();
+
+        auto counter = DWT->CYCCNT;
+
+        if (counter < Clock::last_counter) {
+            Clock::num_wraps++;
+        }
+
+        Clock::last_counter = counter;
+        auto timestamp = ((Timestamp) Clock::num_wraps << 32) | counter;
+
+        __set_PRIMASK(primask);
+        return timestamp;
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+#endif
+    }
+
+    /// Converts a number of ticks to microseconds.
+    static float to_us(float ticks) {
+        return ticks / (float) Clock::TICKS_PER_US;
+    }
+
+  private:
+#ifdef __arm__
+    static uint32_t last_counter;
+    static uint32_t num_wraps;
+#endif
+};
+
+#endif
@@ -0,0 +1,109 @@
+#include "connection.h"
+#include "clock.h"
+#include "trace.h"
+
+
+Connection::Connection(size_t bus, ReceiveBuf* buf, uint32_t baudrate) :
+    bus_(bus),
+    buf_(buf),
+    reader(ReceiveMonitor::byte_duration_for_baudrate(baudrate)),
+    parser(Parser()),
+    last_packet(Packet{
+        DeviceId(0),
+        Instruction::Ping,
+        Error(),
+        std::vector<uint8_t>(),
+    }),
+    is_gap_pending(false) {
+    // prevent allocations in the main loop
+    this->last_packet.data.reserve(MAX_PACKET_DATA_LEN);
+}
+
+size_t Connection::process(uint32_t write_count, size_t max_len, PacketQueue& queue, Log& log) {
+    size_t num_bytes = 0;
+    uint32_t num_packets = 0;
+
+    // the received bytes may span several segments
+    while (num_bytes < max_len) {
+        auto cursor = this->reader.next(*this->buf_, write_count, max_len - num_bytes);
+        auto cursor_len = cursor.remaining_bytes();
+        num_bytes += cursor_len;
+        num_packets += this->process_cursor(cursor, queue, log);
+
+        ReceiveCheck check;
+
+        if (this->reader.finish(*this->buf_, &check)) {
+            log.receive_check(this->bus_, check);
+        }
+
+        if (cursor_len == 0) {
+            break;
+        }
+    }
+
+    log.bus_processed(this->bus_, num_bytes, num_packets);
+    return num_bytes;
+}
+
+void Connection::process(Cursor& cursor, PacketQueue& queue, Log& log) {
+    auto num_bytes = cursor.remaining_bytes();
+    auto num_packets = this->process_cursor(cursor, queue, log);
+    log.bus_processed(this->bus_, num_bytes, num_packets);
+}
+
+uint32_t Connection::process_cursor(Cursor& cursor, PacketQueue& queue, Log& log) {
+    uint32_t num_packets = 0;
+
+    while (cursor.remaining_bytes() > 0) {
+        auto packet_start = Clock::counter();
+        auto parse_result = this->parser.parse(cursor, &this->last_packet);
+
+        if (parse_result == ParseResult::PacketFragment) {
+            this->enqueue(PacketKind::Fragment, queue, log);
+            continue;
+        }
+
+        if (parse_result != ParseResult::PacketAvailable) {
+            if (parse_result == ParseResult::NeedMoreData) {
+                break;
+            }
+
+            // any staged fragments belong to the packet that just failed to parse
+            this->enqueue(PacketKind::DiscardFragments, queue, log);
+            log.log(Log::Record(parse_result, (uint8_t) this->bus_));
+            continue;
+        }
+
+        num_packets++;
+        TRACE(
+            Packets,
+            PacketDecoded,
+            this->last_packet.device_id.to_byte(),
+            this->last_packet.instruction);
+
+        this->enqueue(PacketKind::Packet, queue, log);
+        log.packet_processing_time(Clock::counter() - packet_start);
+    }
+
+    return num_packets;
+}
+
+void Connection::enqueue(PacketKind kind, PacketQueue& queue, Log& log) {
+    // the apply stage has to reset the bus before the next entry makes sense again
+    if (this->is_gap_pending) {
+        if (!queue.push(this->bus_, PacketKind::Gap)) {
+            return;
+        }
+
+        this->is_gap_pending = false;
+    }
+
+    auto is_queued = kind == PacketKind::DiscardFragments
+        ? queue.push(this->bus_, kind)
+        : queue.push(this->bus_, kind, this->last_packet);
+
+    if (!is_queued) {
+        this->is_gap_pending = true;
+        log.log(Log::Record(ReceiveResult::QueueOverflow, (uint8_t) this->bus_));
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef CONNECTION_H
+#define CONNECTION_H
+
+#include "log.h"
+#include "packet_queue.h"
+#include "parser.h"
+#include "receive_buf.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// Receives the packets of a single bus. Reads the bus's `ReceiveBuf`, parses the packets
+/// and queues them for the `ApplyStage`.
+class Connection {
+  public:
+    /// `buf` may be null if the received data is only passed in through `process(Cursor&,
+    /// ...)` (e.g. when replaying a capture).
+    Connection(size_t bus, ReceiveBuf* buf, uint32_t baudrate);
+
+    /// Processes up to `max_len` bytes received before the DMA controller reached
+    /// `write_count` (see `ReceiveReader::next`). Returns the number of bytes processed,
+    /// which is less than `max_len` only if all received bytes have been processed.
+    size_t process(uint32_t write_count, size_t max_len, PacketQueue& queue, Log& log);
+
+    /// Processes all bytes in `cursor` instead of the receive buffer, so data that is already
+    /// in memory can be processed without copying it.
+    void process(Cursor& cursor, PacketQueue& queue, Log& log);
+
+    /// Returns the headroom of the oldest unprocessed byte (see `ReceiveReader::headroom`).
+    int32_t headroom(uint32_t write_count) const {
+        return this->reader.headroom(*this->buf_, write_count);
+    }
+
+    size_t bus() const {
+        return this->bus_;
+    }
+
+  private:
+    /// Parses and queues all packets in `cursor`. Returns the number of packets.
+    uint32_t process_cursor(Cursor& cursor, PacketQueue& queue, Log& log);
+
+    /// Queues `last_packet` as an entry of `kind`. If the queue is full, the packet is dropped
+    /// and a gap is queued as soon as there is space again.
+    void enqueue(PacketKind kind, PacketQueue& queue, Log& log);
+
+    size_t bus_;
+    ReceiveBuf* buf_;
+    ReceiveReader reader;
+    Parser parser;
+    Packet last_packet;
+
+    /// Whether packets were dropped since the last queued gap.
+    bool is_gap_pending;
+};
+
+#endif
@@ -290,6 +290,15 @@ uint16_t ControlTableMemory::resolve_addr(uint16_t addr) const {
     return addr;
 }
 
+bool ControlTableMemory::set_raw(const uint8_t* data, size_t len) {
+    if (len != this->buf.size()) {
+        return false;
+    }
+
+    std::copy(data, data + len, this->buf.begin());
+    return true;
+}
+
 bool ControlTable::is_unknown_model() const {
     return false;
 }
@@ -298,6 +307,16 @@ bool ControlTable::write(uint16_t start_addr, const uint8_t* buf, uint16_t len)
     return this->memory().write(start_addr, buf, len);
 }
 
+void ControlTable::factory_reset(FactoryReset reset) {
+    auto& mem = this->memory();
+
+    for (auto& field : this->fields()) {
+        if (field.is_reset_by(reset)) {
+            field.init_memory(mem);
+        }
+    }
+}
+
 std::vector<std::pair<const char*, std::string>> ControlTable::fmt_fields() const {
     auto& mem = this->memory();
     auto& fields = this->fields();
@@ -365,7 +384,22 @@ std::vector<std::pair<const char*, std::string>> ControlTable::fmt_fields() cons
     return formatted_fields;
 }
 
-ControlTableMap::ControlTableMap() : is_last_instruction_packet_known(false) {}
+ControlTableMap::BusContext::BusContext() : is_last_instruction_packet_known(false) {}
+
+ControlTableMap::ControlTableMap(size_t num_buses) : buses(num_buses) {}
+
+/// Removes `device_id` from `devices` (in any order). Returns `false` if it was not part of it.
+static bool remove_device(std::vector<DeviceId>* devices, DeviceId device_id) {
+    auto iter = std::find(devices->begin(), devices->end(), device_id);
+
+    if (iter == devices->end()) {
+        return false;
+    }
+
+    std::iter_swap(iter, devices->end() - 1);
+    devices->pop_back();
+    return true;
+}
 
 bool ControlTableMap::is_disconnected(DeviceId device_id) const {
     auto& entry = this->num_missed_packets.get(device_id);
@@ -376,44 +410,134 @@ bool ControlTableMap::is_disconnected(DeviceId device_id) const {
     return entry.value() > MAX_ALLOWED_MISSED_PACKETS;
 }
 
-ProtocolResult ControlTableMap::receive(const Packet& packet) {
+ProtocolResult ControlTableMap::receive(const Packet& packet, size_t bus) {
+    auto& context = this->buses[bus];
+
+    if (packet.data_offset > 0) {
+        return this->receive_last_fragment(context, packet);
+    }
+
     if (packet.instruction == Instruction::Status) {
-        return this->receive_status_packet(packet);
+        return this->receive_status_packet(context, packet);
 
     } else {
-        return this->receive_instruction_packet(packet);
+        return this->receive_instruction_packet(context, packet);
     }
 }
 
-ProtocolResult ControlTableMap::receive_instruction_packet(const Packet& instruction_packet) {
-    auto result = parse_instruction_packet(instruction_packet, &this->last_instruction_packet);
-    this->is_last_instruction_packet_known = result == InstructionParseResult::Ok;
+void ControlTableMap::receive_fragment(const Packet& fragment, size_t bus) {
+    this->stage_fragment(this->buses[bus], fragment);
+}
+
+void ControlTableMap::discard_fragments(size_t bus) {
+    this->discard_fragments(this->buses[bus]);
+}
+
+void ControlTableMap::reset_bus(size_t bus) {
+    auto& context = this->buses[bus];
+    context.is_last_instruction_packet_known = false;
+    context.pending_responses.clear();
+    this->discard_fragments(context);
+}
 
-    if (result != InstructionParseResult::Ok) {
+void ControlTableMap::stage_fragment(BusContext& context, const Packet& fragment) {
+    if (fragment.instruction != Instruction::Status) {
+        context.instruction_decoder.decode(fragment);
+        return;
+    }
+
+    // a status packet only contains data for a single device, so the data can simply be
+    // staged as is (up to the limit, the length is checked once the packet is complete)
+    if (fragment.data_offset == 0) {
+        context.staged_status_data.clear();
+    }
+
+    if (context.staged_status_data.size() + fragment.data.size()
+        <= MAX_FRAGMENTED_PACKET_DATA_LEN) {
+        context.staged_status_data.insert(
+            context.staged_status_data.end(), fragment.data.begin(), fragment.data.end());
+    }
+}
+
+void ControlTableMap::discard_fragments(BusContext& context) {
+    context.instruction_decoder.reset();
+    context.staged_status_data.clear();
+}
+
+ProtocolResult ControlTableMap::receive_last_fragment(
+    BusContext& context,
+    const Packet& fragment) {
+    this->stage_fragment(context, fragment);
+
+    if (fragment.instruction != Instruction::Status) {
+        auto result = context.instruction_decoder.finish(&context.last_instruction_packet);
+        return this->apply_instruction_packet(context, result);
+    }
+
+    auto data_len = fragment.data_offset + fragment.data.size();
+
+    if (context.staged_status_data.size() != data_len) {
+        this->discard_fragments(context);
+        return ProtocolResult::InvalidPacketLen;
+    }
+
+    Packet status_packet{
+        fragment.device_id,
+        fragment.instruction,
+        fragment.error,
+        std::move(context.staged_status_data),
+    };
+
+    auto result = this->receive_status_packet(context, status_packet);
+
+    // keep the allocation around for the next fragmented packet
+    context.staged_status_data = std::move(status_packet.data);
+    context.staged_status_data.clear();
+
+    return result;
+}
+
+ProtocolResult ControlTableMap::receive_instruction_packet(
+    BusContext& context,
+    const Packet& instruction_packet) {
+    auto result = parse_instruction_packet(instruction_packet, &context.last_instruction_packet);
+    return this->apply_instruction_packet(context, result);
+}
+
+ProtocolResult ControlTableMap::apply_instruction_packet(
+    BusContext& context,
+    InstructionParseResult parse_result) {
+    context.is_last_instruction_packet_known = parse_result == InstructionParseResult::Ok;
+
+    if (parse_result != InstructionParseResult::Ok) {
         return ProtocolResult::InvalidInstructionPacket;
     }
 
     // check if there are any devices that did not respond to the last instruction
-    for (auto device_id : this->pending_responses) {
+    for (auto device_id : context.pending_responses) {
         this->num_missed_packets.get(device_id).or_insert(0)++;
     }
 
-    this->pending_responses.clear();
+    context.pending_responses.clear();
 
     // writes have status packet responses disabled, so we handle them here;
     // in addition, we can set the pending responses for reads
-    switch (this->last_instruction_packet.instruction) {
+    switch (context.last_instruction_packet.instruction) {
         case Instruction::Ping: {
             // we don't know what devices are supposed to answer (that's the whole point of a ping)
             break;
         }
         case Instruction::Read: {
-            if (!this->last_instruction_packet.read.device_id.is_broadcast()) {
-                this->pending_responses.push_back(this->last_instruction_packet.read.device_id);
+            if (!context.last_instruction_packet.read.device_id.is_broadcast()) {
+                context.pending_responses.push_back(context.last_instruction_packet.read.device_id);
             } else {
                 for (auto pair : this->control_tables) {
+                    if (!this->is_on_bus(context, pair.first)) {
+                        continue;
+                    }
+
                     auto device_id = pair.first;
-                    this->pending_responses.push_back(device_id);
+                    context.pending_responses.push_back(device_id);
                 }
             }
 
@@ -422,14 +546,14 @@ ProtocolResult ControlTableMap::receive_instruction_packet(const Packet& instruc
         case Instruction::Write: {
             auto result = ProtocolResult::Ok;
 
-            if (!this->last_instruction_packet.write.device_id.is_broadcast()) {
+            if (!context.last_instruction_packet.write.device_id.is_broadcast()) {
                 auto& control_table =
-                    this->get_or_insert(this->last_instruction_packet.write.device_id);
+                    this->get_or_insert(context.last_instruction_packet.write.device_id);
 
                 auto is_write_ok = control_table.write(
-                    this->last_instruction_packet.write.start_addr,
-                    this->last_instruction_packet.write.data.data(),
-                    this->last_instruction_packet.write.data.size());
+                    context.last_instruction_packet.write.start_addr,
+                    context.last_instruction_packet.write.data.data(),
+                    context.last_instruction_packet.write.data.size());
 
                 if (!is_write_ok) {
                     result = ProtocolResult::InvalidWrite;
@@ -437,13 +561,17 @@ ProtocolResult ControlTableMap::receive_instruction_packet(const Packet& instruc
             } else {
                 // since this is a broadcast, we write to all devices we know of
                 for (auto pair : this->control_tables) {
+                    if (!this->is_on_bus(context, pair.first)) {
+                        continue;
+                    }
+
                     auto device_id = pair.first;
                     auto& control_table = this->get_or_insert(device_id);
 
                     auto is_write_ok = control_table.write(
-                        this->last_instruction_packet.write.start_addr,
-                        this->last_instruction_packet.write.data.data(),
-                        this->last_instruction_packet.write.data.size());
+                        context.last_instruction_packet.write.start_addr,
+                        context.last_instruction_packet.write.data.data(),
+                        context.last_instruction_packet.write.data.size());
 
                     if (!is_write_ok) {
                         result = ProtocolResult::InvalidWrite;
@@ -457,36 +585,128 @@ ProtocolResult ControlTableMap::receive_instruction_packet(const Packet& instruc
 
             break;
         }
-        case Instruction::RegWrite:
-        case Instruction::Action:
-        case Instruction::FactoryReset:
-        case Instruction::Reboot:
+        case Instruction::RegWrite: {
+            auto& reg_write = context.last_instruction_packet.reg_write;
+
+            if (!reg_write.device_id.is_broadcast()) {
+                this->register_write(
+                    context,
+                    reg_write.device_id,
+                    reg_write.start_addr,
+                    reg_write.data);
+            } else {
+                for (auto pair : this->control_tables) {
+                    if (!this->is_on_bus(context, pair.first)) {
+                        continue;
+                    }
+
+                    this->register_write(context, pair.first, reg_write.start_addr, reg_write.data);
+                }
+            }
+
+            break;
+        }
+        case Instruction::Action: {
+            auto result = ProtocolResult::Ok;
+            auto device_id = context.last_instruction_packet.action.device_id;
+
+            if (!device_id.is_broadcast()) {
+                if (remove_device(&context.devices_with_registered_writes, device_id)
+                    && !this->apply_registered_write(device_id)) {
+                    result = ProtocolResult::InvalidWrite;
+                }
+            } else {
+                // only visit the devices that actually have a registered write
+                for (auto registered_device_id : context.devices_with_registered_writes) {
+                    if (!this->apply_registered_write(registered_device_id)) {
+                        result = ProtocolResult::InvalidWrite;
+                    }
+                }
+
+                context.devices_with_registered_writes.clear();
+            }
+
+            if (result != ProtocolResult::Ok) {
+                return result;
+            }
+
+            break;
+        }
+        case Instruction::FactoryReset: {
+            auto& factory_reset = context.last_instruction_packet.factory_reset;
+
+            // devices are identified by the id they had until now, so a table keeps its id
+            // (which must match its key) even if the device resets it
+            auto reset = factory_reset.reset == FactoryReset::ResetAll
+                ? FactoryReset::ResetAllExceptId
+                : factory_reset.reset;
+
+            if (!factory_reset.device_id.is_broadcast()) {
+                this->discard_registered_write(context, factory_reset.device_id);
+                auto& entry = this->control_tables.get(factory_reset.device_id);
+
+                // the defaults of a device that has not been seen yet are unknown
+                if (entry.is_present()) {
+                    entry.value()->factory_reset(reset);
+                }
+            } else {
+                for (auto pair : this->control_tables) {
+                    if (!this->is_on_bus(context, pair.first)) {
+                        continue;
+                    }
+
+                    this->discard_registered_write(context, pair.first);
+                    pair.second->factory_reset(reset);
+                }
+            }
+
+            break;
+        }
+        case Instruction::Reboot: {
+            // a reboot loses the registered instruction, since it's only stored in RAM
+            auto device_id = context.last_instruction_packet.reboot.device_id;
+
+            if (!device_id.is_broadcast()) {
+                this->discard_registered_write(context, device_id);
+            } else {
+                for (auto pair : this->control_tables) {
+                    if (!this->is_on_bus(context, pair.first)) {
+                        continue;
+                    }
+
+                    this->discard_registered_write(context, pair.first);
+                }
+            }
+
+            break;
+        }
         case Instruction::Clear: {
-            // these instructions are ignored for simplicity
+            // only resets the multi-turn revolutions; the resulting position cannot be known
+            // until the device is read again
             break;
         }
         case Instruction::SyncRead: {
-            this->pending_responses = this->last_instruction_packet.sync_read.devices;
+            context.pending_responses = context.last_instruction_packet.sync_read.devices;
             break;
         }
         case Instruction::SyncWrite: {
             auto result = ProtocolResult::Ok;
 
-            for (auto iter = this->last_instruction_packet.sync_write.devices.begin();
-                 iter != this->last_instruction_packet.sync_write.devices.end();
+            for (auto iter = context.last_instruction_packet.sync_write.devices.begin();
+                 iter != context.last_instruction_packet.sync_write.devices.end();
                  ++iter) {
                 auto device_id = *iter;
                 auto& control_table = this->get_or_insert(device_id);
 
                 auto idx =
-                    std::distance(this->last_instruction_packet.sync_write.devices.begin(), iter);
-                auto data_start = this->last_instruction_packet.sync_write.data.data()
-                    + (idx * this->last_instruction_packet.sync_write.len);
+                    std::distance(context.last_instruction_packet.sync_write.devices.begin(), iter);
+                auto data_start = context.last_instruction_packet.sync_write.data.data()
+                    + (idx * context.last_instruction_packet.sync_write.len);
 
                 auto is_write_ok = control_table.write(
-                    this->last_instruction_packet.sync_write.start_addr,
+                    context.last_instruction_packet.sync_write.start_addr,
                     data_start,
-                    this->last_instruction_packet.sync_write.len);
+                    context.last_instruction_packet.sync_write.len);
 
                 if (!is_write_ok) {
                     result = ProtocolResult::InvalidWrite;
@@ -500,8 +720,19 @@ ProtocolResult ControlTableMap::receive_instruction_packet(const Packet& instruc
             break;
         }
         case Instruction::BulkRead: {
-            for (auto& read_arg : this->last_instruction_packet.bulk_read.reads) {
-                this->pending_responses.push_back(read_arg.device_id);
+            for (auto& read_arg : context.last_instruction_packet.bulk_read.reads) {
+                context.pending_responses.push_back(read_arg.device_id);
+            }
+
+            break;
+        }
+        case Instruction::FastSyncRead: {
+            context.pending_responses = context.last_instruction_packet.fast_sync_read.devices;
+            break;
+        }
+        case Instruction::FastBulkRead: {
+            for (auto& read_arg : context.last_instruction_packet.fast_bulk_read.reads) {
+                context.pending_responses.push_back(read_arg.device_id);
             }
 
             break;
@@ -509,7 +740,7 @@ ProtocolResult ControlTableMap::receive_instruction_packet(const Packet& instruc
         case Instruction::BulkWrite: {
             auto result = ProtocolResult::Ok;
 
-            for (auto& write_args : this->last_instruction_packet.bulk_write.writes) {
+            for (auto& write_args : context.last_instruction_packet.bulk_write.writes) {
                 auto& control_table = this->get_or_insert(write_args.device_id);
 
                 auto is_write_ok = control_table.write(
@@ -535,45 +766,36 @@ ProtocolResult ControlTableMap::receive_instruction_packet(const Packet& instruc
     return ProtocolResult::Ok;
 }
 
-ProtocolResult ControlTableMap::receive_status_packet(const Packet& status_packet) {
+ProtocolResult ControlTableMap::receive_status_packet(
+    BusContext& context,
+    const Packet& status_packet) {
     if (status_packet.instruction != Instruction::Status) {
         return ProtocolResult::StatusIsInstruction;
     }
 
-    // Remove the device from the pending responses.
-    // This only removes the first match, both for performance and because it is
-    // not strictly specified whether instructions like `BulkRead` can address the same
-    // device more than once. In this case this would not remove all occurrences and thus
-    // make sure that the correct amount of status packets are counted.
-    for (size_t i = 0; i < this->pending_responses.size(); i++) {
-        if (this->pending_responses[i] == status_packet.device_id) {
-            // use swap to avoid copying elements (we don't care about the order since this
-            // is just a really small set)
-            std::iter_swap(this->pending_responses.begin() + i, this->pending_responses.end() - 1);
-            this->pending_responses.pop_back();
-            break;
-        }
+    // the combined response to fast reads is sent with the broadcast id
+    if (context.is_last_instruction_packet_known && status_packet.device_id.is_broadcast()
+        && (context.last_instruction_packet.instruction == Instruction::FastSyncRead
+            || context.last_instruction_packet.instruction == Instruction::FastBulkRead)) {
+        return this->receive_fast_read_status_packet(context, status_packet);
     }
 
-    // All reset this counter for missed packets, since we just got one. Like above,
-    // an error in the packet does not matter. We only want to know if the device is
-    // actually connected to the bus, not if everything's working correctly.
-    this->num_missed_packets.get(status_packet.device_id).or_insert(0) = 0;
+    this->mark_response(context, status_packet.device_id);
 
     if (!status_packet.error.is_ok()) {
         return ProtocolResult::StatusHasError;
     }
 
     // nothing we can do if we missed the last instruction
-    if (!this->is_last_instruction_packet_known) {
+    if (!context.is_last_instruction_packet_known) {
         return ProtocolResult::Ok;
     }
 
-    switch (this->last_instruction_packet.instruction) {
+    switch (context.last_instruction_packet.instruction) {
         case Instruction::Ping: {
             if (status_packet.device_id.is_broadcast()
-                || (this->last_instruction_packet.ping.device_id != status_packet.device_id
-                    && !this->last_instruction_packet.ping.device_id.is_broadcast())) {
+                || (context.last_instruction_packet.ping.device_id != status_packet.device_id
+                    && !context.last_instruction_packet.ping.device_id.is_broadcast())) {
                 return ProtocolResult::InvalidDeviceId;
             }
 
@@ -592,21 +814,21 @@ ProtocolResult ControlTableMap::receive_status_packet(const Packet& status_packe
         }
         case Instruction::Read: {
             if (status_packet.device_id.is_broadcast()
-                || (this->last_instruction_packet.read.device_id != status_packet.device_id
-                    && !this->last_instruction_packet.read.device_id.is_broadcast())) {
+                || (context.last_instruction_packet.read.device_id != status_packet.device_id
+                    && !context.last_instruction_packet.read.device_id.is_broadcast())) {
                 return ProtocolResult::InvalidDeviceId;
             }
 
-            if (status_packet.data.size() != this->last_instruction_packet.read.len) {
+            if (status_packet.data.size() != context.last_instruction_packet.read.len) {
                 return ProtocolResult::InvalidPacketLen;
             }
 
             auto& control_table = this->get_or_insert(status_packet.device_id);
 
             auto is_write_ok = control_table.write(
-                this->last_instruction_packet.read.start_addr,
+                context.last_instruction_packet.read.start_addr,
                 status_packet.data.data(),
-                this->last_instruction_packet.read.len);
+                context.last_instruction_packet.read.len);
 
             if (!is_write_ok) {
                 return ProtocolResult::InvalidWrite;
@@ -623,30 +845,30 @@ ProtocolResult ControlTableMap::receive_status_packet(const Packet& status_packe
         case Instruction::FactoryReset:
         case Instruction::Reboot:
         case Instruction::Clear: {
-            // We are only really interested in reads and writes, since those make up most of the
-            // traffic, so these instructions are ignored for simplicity
+            // the responses to these instructions do not contain any data (see
+            // `receive_instruction_packet` for how the instructions themselves are handled)
             break;
         }
         case Instruction::SyncRead: {
             auto iter = std::find(
-                this->last_instruction_packet.sync_read.devices.begin(),
-                this->last_instruction_packet.sync_read.devices.end(),
+                context.last_instruction_packet.sync_read.devices.begin(),
+                context.last_instruction_packet.sync_read.devices.end(),
                 status_packet.device_id);
 
-            if (iter == this->last_instruction_packet.sync_read.devices.end()) {
+            if (iter == context.last_instruction_packet.sync_read.devices.end()) {
                 return ProtocolResult::InvalidDeviceId;
             }
 
-            if (status_packet.data.size() != this->last_instruction_packet.sync_read.len) {
+            if (status_packet.data.size() != context.last_instruction_packet.sync_read.len) {
                 return ProtocolResult::InvalidPacketLen;
             }
 
             auto& control_table = this->get_or_insert(status_packet.device_id);
 
             auto is_write_ok = control_table.write(
-                this->last_instruction_packet.sync_read.start_addr,
+                context.last_instruction_packet.sync_read.start_addr,
                 status_packet.data.data(),
-                this->last_instruction_packet.sync_read.len);
+                context.last_instruction_packet.sync_read.len);
 
             if (!is_write_ok) {
                 return ProtocolResult::InvalidWrite;
@@ -660,13 +882,13 @@ ProtocolResult ControlTableMap::receive_status_packet(const Packet& status_packe
         }
         case Instruction::BulkRead: {
             auto iter = std::find_if(
-                this->last_instruction_packet.bulk_read.reads.begin(),
-                this->last_instruction_packet.bulk_read.reads.end(),
+                context.last_instruction_packet.bulk_read.reads.begin(),
+                context.last_instruction_packet.bulk_read.reads.end(),
                 [&](const ReadArgs& read_args) {
                     return read_args.device_id == status_packet.device_id;
                 });
 
-            if (iter == this->last_instruction_packet.bulk_read.reads.end()) {
+            if (iter == context.last_instruction_packet.bulk_read.reads.end()) {
                 return ProtocolResult::InvalidDeviceId;
             }
 
@@ -691,6 +913,11 @@ ProtocolResult ControlTableMap::receive_status_packet(const Packet& status_packe
             // see `receive_instruction_packet`
             break;
         }
+        case Instruction::FastSyncRead:
+        case Instruction::FastBulkRead: {
+            // devices only respond with the combined status packet
+            return ProtocolResult::InvalidDeviceId;
+        }
         case Instruction::Status: {
             return ProtocolResult::InstructionIsStatus;
         }
@@ -700,46 +927,745 @@ ProtocolResult ControlTableMap::receive_status_packet(const Packet& status_packe
     return ProtocolResult::Ok;
 }
 
+/// Computes the checksum of a packet from its unstuffed payload, including the bytes that are
+/// inserted by byte stuffing when it is sent (see `PacketEncoder`).
+class StuffedCrc {
+  public:
+    explicit StuffedCrc(uint16_t crc) : crc(crc), header_len(0), num_stuffed_bytes_(0) {}
+
+    void add_byte(uint8_t byte) {
+        this->crc = update_crc(this->crc, &byte, 1);
+
+        if (byte == 0xff) {
+            this->header_len = this->header_len == 0 ? 1 : 2;
+        } else if (byte == 0xfd && this->header_len == 2) {
+            this->crc = update_crc(this->crc, &byte, 1);
+            this->header_len = 0;
+            this->num_stuffed_bytes_++;
+        } else {
+            this->header_len = 0;
+        }
+    }
+
+    void add_data(const uint8_t* data, size_t len) {
+        for (size_t i = 0; i < len; i++) {
+            this->add_byte(data[i]);
+        }
+    }
+
+    /// Adds the instruction (or error) and the data of `packet`.
+    void add_payload(const Packet& packet) {
+        this->add_byte((uint8_t) packet.instruction);
+
+        if (packet.instruction == Instruction::Status) {
+            this->add_byte(packet.error.to_byte());
+        }
+
+        this->add_data(packet.data.data(), packet.data.size());
+    }
+
+    uint16_t current_crc() const {
+        return this->crc;
+    }
+
+    /// The number of bytes that were inserted by byte stuffing so far.
+    size_t num_stuffed_bytes() const {
+        return this->num_stuffed_bytes_;
+    }
+
+  private:
+    uint16_t crc;
+
+    /// The number of bytes at the end of the payload that are the start of a header.
+    uint8_t header_len;
+    size_t num_stuffed_bytes_;
+};
+
+ProtocolResult ControlTableMap::receive_fast_read_status_packet(
+    BusContext& context,
+    const Packet& status_packet) {
+    // The payload consists of one entry per device, in the order of the instruction. Every
+    // entry has the device's id and data and is followed by a crc. The following entries are
+    // prefixed with the error of their device (the first device's error is stored in the
+    // packet's error field). The crc of the last entry is the checksum of the packet itself.
+    auto num_reads = context.last_instruction_packet.instruction == Instruction::FastSyncRead
+        ? context.last_instruction_packet.fast_sync_read.devices.size()
+        : context.last_instruction_packet.fast_bulk_read.reads.size();
+
+    auto result = ProtocolResult::Ok;
+    auto& data = status_packet.data;
+    size_t offset = 0;
+
+    // The crc of an entry covers all bytes of the packet that were sent before it (from the
+    // header to the end of the entry's data), so it is updated while going through the
+    // entries. This needs the length field, which counts the bytes inserted by byte stuffing.
+    StuffedCrc stuffing(0);
+    stuffing.add_payload(status_packet);
+
+    uint8_t prefix[7] = {0xff, 0xff, 0xfd, 0x00, status_packet.device_id.to_byte()};
+    uint16_to_le(&prefix[5], (uint16_t) (2 + data.size() + stuffing.num_stuffed_bytes() + 2));
+
+    StuffedCrc crc(update_crc(0, prefix, sizeof(prefix)));
+    crc.add_byte((uint8_t) Instruction::Status);
+    crc.add_byte(status_packet.error.to_byte());
+
+    for (size_t i = 0; i < num_reads; i++) {
+        DeviceId device_id(0);
+        uint16_t start_addr;
+        uint16_t len;
+
+        if (context.last_instruction_packet.instruction == Instruction::FastSyncRead) {
+            device_id = context.last_instruction_packet.fast_sync_read.devices[i];
+            start_addr = context.last_instruction_packet.fast_sync_read.start_addr;
+            len = context.last_instruction_packet.fast_sync_read.len;
+        } else {
+            auto& read_args = context.last_instruction_packet.fast_bulk_read.reads[i];
+            device_id = read_args.device_id;
+            start_addr = read_args.start_addr;
+            len = read_args.len;
+        }
+
+        auto error = status_packet.error;
+
+        if (i > 0) {
+            // crc of the previous entry and error of this one
+            if (offset + 3 > data.size()) {
+                return ProtocolResult::InvalidPacketLen;
+            }
+
+            error = Error(data[offset + 2]);
+            offset += 3;
+        }
+
+        if (offset + 1 + len > data.size()) {
+            return ProtocolResult::InvalidPacketLen;
+        }
+
+        if (DeviceId(data[offset]) != device_id) {
+            return ProtocolResult::InvalidDeviceId;
+        }
+
+        this->mark_response(context, device_id);
+
+        crc.add_data(&data[offset], 1 + len);
+
+        // the crc of the last entry has already been checked by the parser
+        bool is_last = i + 1 == num_reads;
+        bool is_crc_ok = is_last
+            || (offset + 1 + len + 2 <= data.size()
+                && uint16_from_le(&data[offset + 1 + len]) == crc.current_crc());
+
+        if (!is_crc_ok) {
+            // the entry is discarded, but the following entries are still valid
+            result = ProtocolResult::InvalidChecksum;
+        } else if (!error.is_ok()) {
+            result = ProtocolResult::StatusHasError;
+        } else {
+            auto& control_table = this->get_or_insert(device_id);
+
+            if (!control_table.write(start_addr, data.data() + offset + 1, len)) {
+                result = ProtocolResult::InvalidWrite;
+            }
+        }
+
+        offset += 1 + len;
+
+        if (!is_last && offset + 3 <= data.size()) {
+            crc.add_data(&data[offset], 3);
+        }
+    }
+
+    if (offset != data.size()) {
+        return ProtocolResult::InvalidPacketLen;
+    }
+
+    return result;
+}
+
+void ControlTableMap::mark_response(BusContext& context, DeviceId device_id) {
+    // Remove the device from the pending responses.
+    // This only removes the first match, both for performance and because it is
+    // not strictly specified whether instructions like `BulkRead` can address the same
+    // device more than once. In this case this would not remove all occurrences and thus
+    // make sure that the correct amount of status packets are counted.
+    for (size_t i = 0; i < context.pending_responses.size(); i++) {
+        if (context.pending_responses[i] == device_id) {
+            // use swap to avoid copying elements (we don't care about the order since this
+            // is just a really small set)
+            std::iter_swap(
+                context.pending_responses.begin() + i,
+                context.pending_responses.end() - 1);
+            context.pending_responses.pop_back();
+            break;
+        }
+    }
+
+    // All reset this counter for missed packets, since we just got one. Like above,
+    // an error in the packet does not matter. We only want to know if the device is
+    // actually connected to the bus, not if everything's working correctly.
+    this->num_missed_packets.get(device_id).or_insert(0) = 0;
+    this->device_buses.get(device_id).set_value((size_t) (&context - this->buses.data()));
+}
+
+bool ControlTableMap::is_on_bus(const BusContext& context, DeviceId device_id) const {
+    auto& entry = this->device_buses.get(device_id);
+    return !entry.is_present() || entry.value() == (size_t) (&context - this->buses.data());
+}
+
+void ControlTableMap::register_write(
+    BusContext& context,
+    DeviceId device_id,
+    uint16_t start_addr,
+    const std::vector<uint8_t>& data) {
+    auto& entry = this->registered_writes.get(device_id);
+
+    // a write registered on another bus is replaced, so only this bus may apply it
+    if (entry.is_present()) {
+        for (auto& bus_context : this->buses) {
+            remove_device(&bus_context.devices_with_registered_writes, device_id);
+        }
+    }
+
+    context.devices_with_registered_writes.push_back(device_id);
+    entry.set_value(RegWriteArgs{device_id, start_addr, data});
+}
+
+bool ControlTableMap::apply_registered_write(DeviceId device_id) {
+    auto& entry = this->registered_writes.get(device_id);
+
+    // a restored state may list a device whose write is missing
+    if (!entry.is_present()) {
+        return true;
+    }
+
+    auto& reg_write = entry.value();
+    auto& control_table = this->get_or_insert(device_id);
+
+    auto is_write_ok =
+        control_table.write(reg_write.start_addr, reg_write.data.data(), reg_write.data.size());
+
+    entry.clear_value();
+    return is_write_ok;
+}
+
+void ControlTableMap::discard_registered_write(BusContext& context, DeviceId device_id) {
+    // a write registered on another bus belongs to a device on that bus
+    if (remove_device(&context.devices_with_registered_writes, device_id)) {
+        this->registered_writes.get(device_id).clear_value();
+    }
+}
+
 ControlTable& ControlTableMap::register_control_table(DeviceId device_id, uint16_t model_number) {
     auto& entry = this->control_tables.get(device_id);
 
     if (!entry.is_present() || entry.value()->is_unknown_model()
         || entry.value()->model_number() != model_number) {
-        // for a new `ControlTable` implementation simply add another case
-        switch (model_number) {
-            case Mx64ControlTable::MODEL_NUMBER: {
-                entry.set_value(std::make_unique<Mx64ControlTable>());
+        entry.set_value(create_control_table(model_number));
+    }
+
+    return *entry.value();
+}
+
+std::unique_ptr<ControlTable> ControlTableMap::create_control_table(uint16_t model_number) {
+    // for a new `ControlTable` implementation simply add another case and the model number to
+    // `supported_model_numbers`
+    switch (model_number) {
+        case Mx64ControlTable::MODEL_NUMBER: {
+            return std::make_unique<Mx64ControlTable>();
+        }
+        case Mx106ControlTable::MODEL_NUMBER: {
+            return std::make_unique<Mx106ControlTable>();
+        }
+        case ImuControlTable::MODEL_NUMBER: {
+            return std::make_unique<ImuControlTable>();
+        }
+        case FootPressureSensorControlTable::MODEL_NUMBER: {
+            return std::make_unique<FootPressureSensorControlTable>();
+        }
+        case CoreBoardControlTable::MODEL_NUMBER: {
+            return std::make_unique<CoreBoardControlTable>();
+        }
+        default: { return std::make_unique<UnknownControlTable>(model_number); }
+    }
+}
+
+const std::vector<uint16_t>& ControlTableMap::supported_model_numbers() {
+    static std::vector<uint16_t> model_numbers{
+        Mx64ControlTable::MODEL_NUMBER,
+        Mx106ControlTable::MODEL_NUMBER,
+        ImuControlTable::MODEL_NUMBER,
+        FootPressureSensorControlTable::MODEL_NUMBER,
+        CoreBoardControlTable::MODEL_NUMBER,
+    };
+
+    return model_numbers;
+}
+
+ControlTable& ControlTableMap::get_or_insert(DeviceId device_id) {
+    return *this->control_tables.get(device_id).or_insert_with(
+        []() { return std::make_unique<UnknownControlTable>(); });
+}
+
+// the parts of a device's state in a saved state (see `ControlTableMap::save`)
+const uint8_t STATE_CONTROL_TABLE = 0x01;
+const uint8_t STATE_UNKNOWN_MODEL = 0x02;
+const uint8_t STATE_MISSED_PACKETS = 0x04;
+const uint8_t STATE_BUS = 0x08;
+const uint8_t STATE_REGISTERED_WRITE = 0x10;
+
+static void append_uint16(std::vector<uint8_t>* out, uint16_t value) {
+    uint8_t buf[2];
+    uint16_to_le(buf, value);
+    out->insert(out->end(), buf, buf + sizeof(buf));
+}
+
+static void append_uint32(std::vector<uint8_t>* out, uint32_t value) {
+    uint8_t buf[4];
+    uint32_to_le(buf, value);
+    out->insert(out->end(), buf, buf + sizeof(buf));
+}
+
+static void append_devices(std::vector<uint8_t>* out, const std::vector<DeviceId>& devices) {
+    append_uint16(out, (uint16_t) devices.size());
+
+    for (auto device_id : devices) {
+        out->push_back(device_id.to_byte());
+    }
+}
+
+static void append_reads(std::vector<uint8_t>* out, const std::vector<ReadArgs>& reads) {
+    append_uint16(out, (uint16_t) reads.size());
+
+    for (auto& read : reads) {
+        out->push_back(read.device_id.to_byte());
+        append_uint16(out, read.start_addr);
+        append_uint16(out, read.len);
+    }
+}
+
+static bool read_uint8(Cursor& cursor, uint8_t* value) {
+    return cursor.read(value, 1) == 1;
+}
+
+static bool read_uint16(Cursor& cursor, uint16_t* value) {
+    uint8_t buf[2];
+
+    if (cursor.read(buf, sizeof(buf)) != sizeof(buf)) {
+        return false;
+    }
+
+    *value = uint16_from_le(buf);
+    return true;
+}
+
+static bool read_uint32(Cursor& cursor, uint32_t* value) {
+    uint8_t buf[4];
+
+    if (cursor.read(buf, sizeof(buf)) != sizeof(buf)) {
+        return false;
+    }
+
+    *value = uint32_from_le(buf);
+    return true;
+}
+
+static bool read_device_id(Cursor& cursor, DeviceId* device_id) {
+    uint8_t id;
+
+    if (!read_uint8(cursor, &id)) {
+        return false;
+    }
+
+    *device_id = DeviceId(id);
+    return true;
+}
+
+static bool read_devices(Cursor& cursor, std::vector<DeviceId>* devices) {
+    uint16_t num_devices;
+
+    if (!read_uint16(cursor, &num_devices)) {
+        return false;
+    }
+
+    for (uint16_t i = 0; i < num_devices; i++) {
+        DeviceId device_id(0);
+
+        if (!read_device_id(cursor, &device_id)) {
+            return false;
+        }
+
+        devices->push_back(device_id);
+    }
+
+    return true;
+}
+
+static bool read_reads(Cursor& cursor, std::vector<ReadArgs>* reads) {
+    uint16_t num_reads;
+
+    if (!read_uint16(cursor, &num_reads)) {
+        return false;
+    }
+
+    for (uint16_t i = 0; i < num_reads; i++) {
+        ReadArgs read{DeviceId(0), 0, 0};
+
+        if (!read_device_id(cursor, &read.device_id) || !read_uint16(cursor, &read.start_addr)
+            || !read_uint16(cursor, &read.len)) {
+            return false;
+        }
+
+        reads->push_back(read);
+    }
+
+    return true;
+}
+
+void ControlTableMap::save(std::vector<uint8_t>* out) const {
+    out->push_back((uint8_t) this->buses.size());
+
+    // the number of devices is only known at the end
+    auto num_devices_pos = out->size();
+    append_uint16(out, 0);
+    uint16_t num_devices = 0;
+
+    for (size_t id = 0; id < DeviceId::num_values(); id++) {
+        DeviceId device_id((uint8_t) id);
+        auto& control_table = this->control_tables.get(device_id);
+        auto& num_missed_packets = this->num_missed_packets.get(device_id);
+        auto& bus = this->device_buses.get(device_id);
+        auto& registered_write = this->registered_writes.get(device_id);
+        uint8_t parts = 0;
+
+        if (control_table.is_present()) {
+            parts |= STATE_CONTROL_TABLE;
+            parts |= control_table.value()->is_unknown_model() ? STATE_UNKNOWN_MODEL : 0;
+        }
+
+        parts |= num_missed_packets.is_present() ? STATE_MISSED_PACKETS : 0;
+        parts |= bus.is_present() ? STATE_BUS : 0;
+        parts |= registered_write.is_present() ? STATE_REGISTERED_WRITE : 0;
+
+        if (parts == 0) {
+            continue;
+        }
+
+        out->push_back(device_id.to_byte());
+        out->push_back(parts);
+        num_devices++;
+
+        if (control_table.is_present()) {
+            auto& memory = control_table.value()->memory().raw();
+            append_uint16(out, control_table.value()->model_number());
+            append_uint16(out, (uint16_t) memory.size());
+            out->insert(out->end(), memory.begin(), memory.end());
+        }
+
+        if (num_missed_packets.is_present()) {
+            append_uint32(out, num_missed_packets.value());
+        }
+
+        if (bus.is_present()) {
+            out->push_back((uint8_t) bus.value());
+        }
+
+        if (registered_write.is_present()) {
+            auto& reg_write = registered_write.value();
+            append_uint16(out, reg_write.start_addr);
+            append_uint16(out, (uint16_t) reg_write.data.size());
+            out->insert(out->end(), reg_write.data.begin(), reg_write.data.end());
+        }
+    }
+
+    uint16_to_le(&(*out)[num_devices_pos], num_devices);
+
+    for (auto& context : this->buses) {
+        append_devices(out, context.pending_responses);
+        append_devices(out, context.devices_with_registered_writes);
+        out->push_back(context.is_last_instruction_packet_known);
+
+        if (!context.is_last_instruction_packet_known) {
+            continue;
+        }
+
+        // only the arguments that are needed to interpret the responses
+        auto& instruction_packet = context.last_instruction_packet;
+        out->push_back((uint8_t) instruction_packet.instruction);
+
+        switch (instruction_packet.instruction) {
+            case Instruction::Ping: {
+                out->push_back(instruction_packet.ping.device_id.to_byte());
                 break;
             }
-            case Mx106ControlTable::MODEL_NUMBER: {
-                entry.set_value(std::make_unique<Mx106ControlTable>());
+            case Instruction::Read: {
+                out->push_back(instruction_packet.read.device_id.to_byte());
+                append_uint16(out, instruction_packet.read.start_addr);
+                append_uint16(out, instruction_packet.read.len);
                 break;
             }
-            case ImuControlTable::MODEL_NUMBER: {
-                entry.set_value(std::make_unique<ImuControlTable>());
+            case Instruction::SyncRead: {
+                append_uint16(out, instruction_packet.sync_read.start_addr);
+                append_uint16(out, instruction_packet.sync_read.len);
+                append_devices(out, instruction_packet.sync_read.devices);
                 break;
             }
-            case FootPressureSensorControlTable::MODEL_NUMBER: {
-                entry.set_value(std::make_unique<FootPressureSensorControlTable>());
+            case Instruction::FastSyncRead: {
+                append_uint16(out, instruction_packet.fast_sync_read.start_addr);
+                append_uint16(out, instruction_packet.fast_sync_read.len);
+                append_devices(out, instruction_packet.fast_sync_read.devices);
                 break;
             }
-            case CoreBoardControlTable::MODEL_NUMBER: {
-                entry.set_value(std::make_unique<CoreBoardControlTable>());
+            case Instruction::BulkRead: {
+                append_reads(out, instruction_packet.bulk_read.reads);
                 break;
             }
-            default: {
-                entry.set_value(std::make_unique<UnknownControlTable>(model_number));
+            case Instruction::FastBulkRead: {
+                append_reads(out, instruction_packet.fast_bulk_read.reads);
                 break;
             }
+            default: { break; }
         }
     }
+}
 
-    return *entry.value();
+bool ControlTableMap::restore(const uint8_t* state, size_t len) {
+    Cursor cursor(state, len);
+    uint8_t num_buses;
+    this->clear();
+
+    if (!read_uint8(cursor, &num_buses) || num_buses != this->buses.size()
+        || !this->restore_devices(cursor)) {
+        this->clear();
+        return false;
+    }
+
+    for (auto& context : this->buses) {
+        if (!this->restore_bus(cursor, context)) {
+            this->clear();
+            return false;
+        }
+    }
+
+    if (cursor.remaining_bytes() > 0) {
+        this->clear();
+        return false;
+    }
+
+    return true;
 }
 
-ControlTable& ControlTableMap::get_or_insert(DeviceId device_id) {
-    return *this->control_tables.get(device_id).or_insert_with(
-        []() { return std::make_unique<UnknownControlTable>(); });
+bool ControlTableMap::restore_devices(Cursor& cursor) {
+    uint16_t num_devices;
+
+    if (!read_uint16(cursor, &num_devices)) {
+        return false;
+    }
+
+    for (uint16_t i = 0; i < num_devices; i++) {
+        DeviceId device_id(0);
+        uint8_t parts;
+
+        if (!read_device_id(cursor, &device_id) || !read_uint8(cursor, &parts)) {
+            return false;
+        }
+
+        if ((parts & STATE_CONTROL_TABLE) != 0) {
+            uint16_t model_number;
+            uint16_t memory_len;
+            std::vector<uint8_t> memory;
+
+            if (!read_uint16(cursor, &model_number) || !read_uint16(cursor, &memory_len)) {
+                return false;
+            }
+
+            memory.resize(memory_len);
+
+            if (cursor.read(memory.data(), memory_len) != memory_len) {
+                return false;
+            }
+
+            auto& control_table = (parts & STATE_UNKNOWN_MODEL) != 0
+                ? this->get_or_insert(device_id)
+                : this->register_control_table(device_id, model_number);
+
+            if (!control_table.memory().set_raw(memory.data(), memory.size())) {
+                return false;
+            }
+        }
+
+        if ((parts & STATE_MISSED_PACKETS) != 0) {
+            uint32_t num_missed_packets;
+
+            if (!read_uint32(cursor, &num_missed_packets)) {
+                return false;
+            }
+
+            this->num_missed_packets.get(device_id).set_value(num_missed_packets);
+        }
+
+        if ((parts & STATE_BUS) != 0) {
+            uint8_t bus;
+
+            if (!read_uint8(cursor, &bus) || bus >= this->buses.size()) {
+                return false;
+            }
+
+            this->device_buses.get(device_id).set_value((size_t) bus);
+        }
+
+        if ((parts & STATE_REGISTERED_WRITE) != 0) {
+            RegWriteArgs reg_write{device_id, 0, {}};
+            uint16_t data_len;
+
+            if (!read_uint16(cursor, &reg_write.start_addr) || !read_uint16(cursor, &data_len)) {
+                return false;
+            }
+
+            reg_write.data.resize(data_len);
+
+            if (cursor.read(reg_write.data.data(), data_len) != data_len) {
+                return false;
+            }
+
+            this->registered_writes.get(device_id).set_value(std::move(reg_write));
+        }
+    }
+
+    return true;
+}
+
+bool ControlTableMap::restore_bus(Cursor& cursor, BusContext& context) {
+    uint8_t is_known;
+    uint8_t instruction;
+
+    if (!read_devices(cursor, &context.pending_responses)
+        || !read_devices(cursor, &context.devices_with_registered_writes)
+        || !read_uint8(cursor, &is_known)) {
+        return false;
+    }
+
+    if (!is_known) {
+        return true;
+    }
+
+    if (!read_uint8(cursor, &instruction)) {
+        return false;
+    }
+
+    // the arguments that are not saved are left empty
+    auto& instruction_packet = context.last_instruction_packet;
+
+    switch ((Instruction) instruction) {
+        case Instruction::Ping: {
+            PingArgs ping{DeviceId(0)};
+
+            if (!read_device_id(cursor, &ping.device_id)) {
+                return false;
+            }
+
+            instruction_packet = InstructionPacket(std::move(ping));
+            break;
+        }
+        case Instruction::Read: {
+            ReadArgs read{DeviceId(0), 0, 0};
+
+            if (!read_device_id(cursor, &read.device_id) || !read_uint16(cursor, &read.start_addr)
+                || !read_uint16(cursor, &read.len)) {
+                return false;
+            }
+
+            instruction_packet = InstructionPacket(std::move(read));
+            break;
+        }
+        case Instruction::SyncRead: {
+            SyncReadArgs sync_read{{}, 0, 0};
+
+            if (!read_uint16(cursor, &sync_read.start_addr) || !read_uint16(cursor, &sync_read.len)
+                || !read_devices(cursor, &sync_read.devices)) {
+                return false;
+            }
+
+            instruction_packet = InstructionPacket(std::move(sync_read));
+            break;
+        }
+        case Instruction::FastSyncRead: {
+            FastSyncReadArgs fast_sync_read{{}, 0, 0};
+
+            if (!read_uint16(cursor, &fast_sync_read.start_addr)
+                || !read_uint16(cursor, &fast_sync_read.len)
+                || !read_devices(cursor, &fast_sync_read.devices)) {
+                return false;
+            }
+
+            instruction_packet = InstructionPacket(std::move(fast_sync_read));
+            break;
+        }
+        case Instruction::BulkRead: {
+            BulkReadArgs bulk_read;
+
+            if (!read_reads(cursor, &bulk_read.reads)) {
+                return false;
+            }
+
+            instruction_packet = InstructionPacket(std::move(bulk_read));
+            break;
+        }
+        case Instruction::FastBulkRead: {
+            FastBulkReadArgs fast_bulk_read;
+
+            if (!read_reads(cursor, &fast_bulk_read.reads)) {
+                return false;
+            }
+
+            instruction_packet = InstructionPacket(std::move(fast_bulk_read));
+            break;
+        }
+        case Instruction::Write: {
+            instruction_packet = InstructionPacket(WriteArgs{DeviceId(0), 0, {}});
+            break;
+        }
+        case Instruction::RegWrite: {
+            instruction_packet = InstructionPacket(RegWriteArgs{DeviceId(0), 0, {}});
+            break;
+        }
+        case Instruction::Action: {
+            instruction_packet = InstructionPacket(ActionArgs{DeviceId(0)});
+            break;
+        }
+        case Instruction::FactoryReset: {
+            instruction_packet =
+                InstructionPacket(FactoryResetArgs{DeviceId(0), FactoryReset::ResetAll});
+            break;
+        }
+        case Instruction::Reboot: {
+            instruction_packet = InstructionPacket(RebootArgs{DeviceId(0)});
+            break;
+        }
+        case Instruction::Clear: {
+            instruction_packet = InstructionPacket(ClearArgs{DeviceId(0)});
+            break;
+        }
+        case Instruction::SyncWrite: {
+            instruction_packet = InstructionPacket(SyncWriteArgs{{}, 0, 0, {}});
+            break;
+        }
+        case Instruction::BulkWrite: {
+            instruction_packet = InstructionPacket(BulkWriteArgs{});
+            break;
+        }
+        default: { return false; }
+    }
+
+    context.is_last_instruction_packet_known = true;
+    return true;
+}
+
+void ControlTableMap::clear() {
+    this->control_tables.clear();
+    this->num_missed_packets.clear();
+    this->device_buses.clear();
+    this->registered_writes.clear();
+    this->buses = std::vector<BusContext>(this->buses.size());
 }
 
 std::string to_string(const ProtocolResult& result) {
@@ -771,6 +1697,9 @@ std::string to_string(const ProtocolResult& result) {
         case ProtocolResult::InvalidInstructionPacket: {
             return "invalid instruction packet";
         }
+        case ProtocolResult::InvalidChecksum: {
+            return "invalid checksum";
+        }
         default: { return "unknown protocol error"; }
     }
 }
@@ -101,14 +101,39 @@ class ControlTableMemory {
 
     uint16_t resolve_addr(uint16_t addr) const;
 
+    /// Returns the raw contents of the memory: the storage of all segments in the order of
+    /// their addresses.
+    const std::vector<uint8_t>& raw() const {
+        return this->buf;
+    }
+
+    /// Replaces the raw contents of the memory (see `raw`). Returns `false` if `len` does not
+    /// match the size of the memory.
+    bool set_raw(const uint8_t* data, size_t len);
+
   private:
     std::vector<Segment> segments;
     std::vector<uint8_t> buf;
 };
 
+/// Which factory resets (see `FactoryReset`) restore the default value of a field.
+enum class FieldReset : uint8_t {
+    /// Reset by every factory reset.
+    Always,
+
+    /// Kept by `FactoryReset::ResetAllExceptIdAndBaudRate` (the baud rate).
+    ExceptBaudRate,
+
+    /// Only reset by `FactoryReset::ResetAll` (the id).
+    ExceptId,
+
+    /// Never reset (fields that identify the model and firmware).
+    Never,
+};
+
 /// Represents a field in a control table. A field has an address and type, a name, a
-/// default value and an optional formatting function that can format the field value as
-/// a human readable string.
+/// default value, the factory resets that restore it and an optional formatting function
+/// that can format the field value as a human readable string.
 struct ControlTableField {
     enum class FieldType {
         UInt8,
@@ -121,9 +146,11 @@ struct ControlTableField {
         uint16_t addr,
         const char* name,
         uint8_t default_value,
-        std::string (*fmt)(uint8_t)) {
+        std::string (*fmt)(uint8_t),
+        FieldReset reset = FieldReset::Always) {
         ControlTableField field;
         field.addr = addr;
+        field.reset = reset;
         field.type = FieldType::UInt8;
         field.name = name;
         field.uint8.default_value = default_value;
@@ -135,9 +162,11 @@ struct ControlTableField {
         uint16_t addr,
         const char* name,
         uint16_t default_value,
-        std::string (*fmt)(uint16_t)) {
+        std::string (*fmt)(uint16_t),
+        FieldReset reset = FieldReset::Always) {
         ControlTableField field;
         field.addr = addr;
+        field.reset = reset;
         field.type = FieldType::UInt16;
         field.name = name;
         field.uint16.default_value = default_value;
@@ -149,9 +178,11 @@ struct ControlTableField {
         uint16_t addr,
         const char* name,
         uint32_t default_value,
-        std::string (*fmt)(uint32_t)) {
+        std::string (*fmt)(uint32_t),
+        FieldReset reset = FieldReset::Always) {
         ControlTableField field;
         field.addr = addr;
+        field.reset = reset;
         field.type = FieldType::UInt32;
         field.name = name;
         field.uint32.default_value = default_value;
@@ -163,9 +194,11 @@ struct ControlTableField {
         uint16_t addr,
         const char* name,
         float default_value,
-        std::string (*fmt)(float)) {
+        std::string (*fmt)(float),
+        FieldReset reset = FieldReset::Always) {
         ControlTableField field;
         field.addr = addr;
+        field.reset = reset;
         field.type = FieldType::Float32;
         field.name = name;
         field.float32.default_value = default_value;
@@ -195,8 +228,28 @@ struct ControlTableField {
         }
     }
 
+    /// Returns `true` if `reset` restores the default value of the field.
+    bool is_reset_by(FactoryReset reset) const {
+        switch (this->reset) {
+            case FieldReset::Always: {
+                return true;
+            }
+            case FieldReset::ExceptBaudRate: {
+                return reset != FactoryReset::ResetAllExceptIdAndBaudRate;
+            }
+            case FieldReset::ExceptId: {
+                return reset == FactoryReset::ResetAll;
+            }
+            case FieldReset::Never: {
+                return false;
+            }
+            default: { return true; }
+        }
+    }
+
     uint16_t addr;
     FieldType type;
+    FieldReset reset;
     const char* name;
     union {
         struct {
@@ -254,6 +307,11 @@ class ControlTable {
     /// may have been written already.
     bool write(uint16_t start_addr, const uint8_t* buf, uint16_t len);
 
+    /// Restores the default value of every field, like the device does when it receives a
+    /// factory reset instruction. The defaults and the resets that restore them are taken from
+    /// the field definitions (see `FieldReset`).
+    void factory_reset(FactoryReset reset);
+
     /// Returns pairs of field name and value for every field of the control table. The values
     /// are formatted using the formatting function specified by the field definition. They are
     /// read from the `ControlTableMemory` returned by the `memory` method.
@@ -317,14 +375,26 @@ class UnknownControlTable : public ControlTable {
     const std::vector<ControlTableField>& fields() const final {
         static std::vector<ControlTableField> fields{
             ControlTableField::new_uint16(
-                0, "Model Number", 0, [](uint16_t number) { return std::to_string(number); }),
+                0,
+                "Model Number",
+                0,
+                [](uint16_t number) { return std::to_string(number); },
+                FieldReset::Never),
             ControlTableField::new_uint8(
-                2, "Firmware Version", 0, [](uint8_t version) { return std::to_string(version); }),
+                2,
+                "Firmware Version",
+                0,
+                [](uint8_t version) { return std::to_string(version); },
+                FieldReset::Never),
         };
 
         static std::vector<ControlTableField> fields_no_model{
             ControlTableField::new_uint8(
-                2, "Firmware Version", 0, [](uint8_t version) { return std::to_string(version); }),
+                2,
+                "Firmware Version",
+                0,
+                [](uint8_t version) { return std::to_string(version); },
+                FieldReset::Never),
         };
 
         if (this->is_unknown_model()) {
@@ -366,19 +436,35 @@ enum class ProtocolResult {
 
     /// The payload of an instruction packet could not be parsed.
     InvalidInstructionPacket,
+
+    /// An entry of a combined status packet (see `FastSyncRead`) has an invalid checksum.
+    InvalidChecksum,
 };
 
 std::string to_string(const ProtocolResult& result);
 
+/// The maximum number of buses that can be captured at the same time.
+const size_t MAX_NUM_BUSES = 4;
+
 /// Maps `DeviceId`s to `ControlTable`s. The control tables are updated with every
 /// call to `receive`.
+///
+/// The packets of several buses can be received by the same map. Each bus has its own
+/// instruction context (the last instruction, pending responses and staged fragments), so
+/// the order of packets is only relevant within a bus. The control tables are shared, so
+/// device ids must be unique across all buses.
 class ControlTableMap {
   public:
     /// The number of times a device is allowed to not respond before it is
     /// considered disconnected.
     static const uint32_t MAX_ALLOWED_MISSED_PACKETS = 4;
 
-    ControlTableMap();
+    /// Creates a map for `num_buses` buses (at most `MAX_NUM_BUSES`).
+    explicit ControlTableMap(size_t num_buses = 1);
+
+    size_t num_buses() const {
+        return this->buses.size();
+    }
 
     /// Determines if the device identified by `device_id` is disconnected. If
     /// the device was not encountered before, `false` is returned.
@@ -389,9 +475,49 @@ class ControlTableMap {
         return this->control_tables.get(device_id);
     }
 
-    /// Processes the next packet and updates the control tables and disconnected state
-    /// of the affected devices.
-    ProtocolResult receive(const Packet& packet);
+    /// Processes the next packet received on `bus` and updates the control tables and
+    /// disconnected state of the affected devices. If the packet is the last fragment of a
+    /// fragmented packet, the previously staged fragments are applied as well.
+    ProtocolResult receive(const Packet& packet, size_t bus = 0);
+
+    /// Stages a fragment of a packet whose payload is larger than `MAX_PACKET_DATA_LEN`.
+    /// The fragment is decoded immediately, but the control tables are not updated until
+    /// the last fragment is passed to `receive` (i.e. the checksum has been validated).
+    ///
+    /// Applying the fragments as they arrive would not save any memory: rolling back a packet
+    /// with an invalid checksum needs the previous values of every written byte, which take as
+    /// much space as the staged values. It would also expose the writes of an invalid packet
+    /// to the UI and to checkpoints, which read the control tables between two fragments.
+    void receive_fragment(const Packet& fragment, size_t bus = 0);
+
+    /// Discards all fragments staged for `bus`. Must be called if a fragmented packet turns
+    /// out to be invalid.
+    void discard_fragments(size_t bus = 0);
+
+    /// Forgets the last instruction, pending responses and staged fragments of `bus`. Must be
+    /// called if packets of the bus were lost, so the next status packets are not matched with
+    /// the wrong instruction. Registered writes are kept, like on the devices.
+    void reset_bus(size_t bus);
+
+    /// Forgets all devices and the state of every bus.
+    void clear();
+
+    /// Creates the control table for a device of the model `model_number`, or an
+    /// `UnknownControlTable` if the model is not supported.
+    static std::unique_ptr<ControlTable> create_control_table(uint16_t model_number);
+
+    /// Returns the model numbers of all supported devices (see `create_control_table`).
+    static const std::vector<uint16_t>& supported_model_numbers();
+
+    /// Appends the state of the map to `out`: the control table, missed packets and bus of
+    /// every device, the registered writes and, for every bus, the last instruction (only the
+    /// parts needed to interpret its responses) and the pending responses. Staged fragments
+    /// are not part of the state.
+    void save(std::vector<uint8_t>* out) const;
+
+    /// Replaces the state of the map with one saved by `save` for the same number of buses.
+    /// Returns `false` if the state is invalid, in which case the map is left empty.
+    bool restore(const uint8_t* state, size_t len);
 
     size_t size() const {
         return this->control_tables.size();
@@ -406,9 +532,72 @@ class ControlTableMap {
     }
 
   private:
-    ProtocolResult receive_instruction_packet(const Packet& instruction_packet);
+    /// The state of a single bus that is needed to interpret its next packet.
+    struct BusContext {
+        BusContext();
+
+        InstructionPacket last_instruction_packet;
+        bool is_last_instruction_packet_known;
+        std::vector<DeviceId> pending_responses;
+        /// Fragmented packets are staged until the last fragment has validated the checksum
+        /// (see `receive_fragment`). Instructions are decoded while their fragments arrive,
+        /// the payload of status packets is copied. Each takes up to
+        /// `MAX_FRAGMENTED_PACKET_DATA_LEN` bytes, which are kept allocated for the next
+        /// fragmented packet.
+        InstructionDecoder instruction_decoder;
+        std::vector<uint8_t> staged_status_data;
+
+        /// The devices whose entry in `registered_writes` was registered on this bus, so that
+        /// an `Action` only has to visit these instead of every possible device. Every entry
+        /// belongs to exactly one bus.
+        std::vector<DeviceId> devices_with_registered_writes;
+    };
+
+    ProtocolResult receive_instruction_packet(
+        BusContext& context,
+        const Packet& instruction_packet);
+
+    void stage_fragment(BusContext& context, const Packet& fragment);
+
+    void discard_fragments(BusContext& context);
+
+    ProtocolResult receive_last_fragment(BusContext& context, const Packet& fragment);
+
+    /// Stages a registered write for `device_id`, replacing any write that was registered
+    /// before (on any bus).
+    void register_write(
+        BusContext& context,
+        DeviceId device_id,
+        uint16_t start_addr,
+        const std::vector<uint8_t>& data);
+
+    /// Applies the write registered for `device_id`, if there is one.
+    bool apply_registered_write(DeviceId device_id);
 
-    ProtocolResult receive_status_packet(const Packet& status_packet);
+    /// Drops the write registered for `device_id` without applying it, if it was registered
+    /// on the bus of `context`.
+    void discard_registered_write(BusContext& context, DeviceId device_id);
+
+    /// Updates the control tables for the instruction that was just parsed into
+    /// `last_instruction_packet`.
+    ProtocolResult apply_instruction_packet(
+        BusContext& context,
+        InstructionParseResult parse_result);
+
+    ProtocolResult receive_status_packet(BusContext& context, const Packet& status_packet);
+
+    /// Splits the combined status packet sent in response to a `FastSyncRead` or
+    /// `FastBulkRead` into the responses of the individual devices.
+    ProtocolResult receive_fast_read_status_packet(
+        BusContext& context,
+        const Packet& status_packet);
+
+    /// Marks that `device_id` has responded to the last instruction on its bus.
+    void mark_response(BusContext& context, DeviceId device_id);
+
+    /// Determines if `device_id` may be connected to the bus of `context`, i.e. it has not
+    /// responded on another bus. Broadcasts only affect the devices of their own bus.
+    bool is_on_bus(const BusContext& context, DeviceId device_id) const;
 
     /// Creates the correct control table for the given `model_number` and inserts it for
     /// the `device_id`. If a control table already existed for the id it is only replaced
@@ -418,11 +607,20 @@ class ControlTableMap {
     /// Gets the `ControlTable` for `device_id` or inserts an unknown table if it does not exist.
     ControlTable& get_or_insert(DeviceId device_id);
 
+    bool restore_devices(Cursor& cursor);
+
+    bool restore_bus(Cursor& cursor, BusContext& context);
+
     DeviceIdMap<std::unique_ptr<ControlTable>> control_tables;
     DeviceIdMap<uint32_t> num_missed_packets;
-    InstructionPacket last_instruction_packet;
-    bool is_last_instruction_packet_known;
-    std::vector<DeviceId> pending_responses;
+    std::vector<BusContext> buses;
+
+    /// The bus each device has last responded on.
+    DeviceIdMap<size_t> device_buses;
+
+    /// The writes registered with `RegWrite` that are waiting for an `Action`. Every
+    /// device can only have a single registered write.
+    DeviceIdMap<RegWriteArgs> registered_writes;
 };
 
 #endif
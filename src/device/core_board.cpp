@@ -8,8 +8,9 @@ const std::vector<ControlTableField> CoreBoardControlTable::FIELDS{
         0,
         "Model Number",
         CoreBoardControlTable::MODEL_NUMBER,
-        fmt_number),
-    ControlTableField::new_uint8(2, "Firmware Version", 0, fmt_number),
+        fmt_number,
+        FieldReset::Never),
+    ControlTableField::new_uint8(2, "Firmware Version", 0, fmt_number, FieldReset::Never),
 
     ControlTableField::new_uint16(10, "LED", 0, fmt_bool_on_off),
     ControlTableField::new_uint16(12, "Power", 0, fmt_number),
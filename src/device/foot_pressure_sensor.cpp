@@ -8,8 +8,9 @@ const std::vector<ControlTableField> FootPressureSensorControlTable::FIELDS{
         0,
         "Model Number",
         FootPressureSensorControlTable::MODEL_NUMBER,
-        fmt_number),
-    ControlTableField::new_uint8(2, "Firmware Version", 0, fmt_number),
+        fmt_number,
+        FieldReset::Never),
+    ControlTableField::new_uint8(2, "Firmware Version", 0, fmt_number, FieldReset::Never),
 
     ControlTableField::new_uint32(36, "Front Left", 0, fmt_number),
     ControlTableField::new_uint32(40, "Front Right", 0, fmt_number),
@@ -4,8 +4,13 @@
 const uint16_t ImuControlTable::MODEL_NUMBER;
 
 const std::vector<ControlTableField> ImuControlTable::FIELDS{
-    ControlTableField::new_uint16(0, "Model Number", ImuControlTable::MODEL_NUMBER, fmt_number),
-    ControlTableField::new_uint8(2, "Firmware Version", 0, fmt_number),
+    ControlTableField::new_uint16(
+        0,
+        "Model Number",
+        ImuControlTable::MODEL_NUMBER,
+        fmt_number,
+        FieldReset::Never),
+    ControlTableField::new_uint8(2, "Firmware Version", 0, fmt_number, FieldReset::Never),
 
     ControlTableField::new_float32(36, "Acceleration X", 0, fmt_imu_accel),
     ControlTableField::new_float32(40, "Acceleration Y", 0, fmt_imu_accel),
@@ -6,11 +6,16 @@
 const uint16_t Mx106ControlTable::MODEL_NUMBER;
 
 const std::vector<ControlTableField> Mx106ControlTable::FIELDS{
-    ControlTableField::new_uint16(0, "Model Number", Mx106ControlTable::MODEL_NUMBER, fmt_number),
-    ControlTableField::new_uint32(2, "Model Information", 0, fmt_number),
-    ControlTableField::new_uint8(6, "Firmware Version", 0, fmt_number),
-    ControlTableField::new_uint8(7, "Id", 1, fmt_number),
-    ControlTableField::new_uint8(8, "Baud Rate", 1, fmt_mx_baud_rate),
+    ControlTableField::new_uint16(
+        0,
+        "Model Number",
+        Mx106ControlTable::MODEL_NUMBER,
+        fmt_number,
+        FieldReset::Never),
+    ControlTableField::new_uint32(2, "Model Information", 0, fmt_number, FieldReset::Never),
+    ControlTableField::new_uint8(6, "Firmware Version", 0, fmt_number, FieldReset::Never),
+    ControlTableField::new_uint8(7, "Id", 1, fmt_number, FieldReset::ExceptId),
+    ControlTableField::new_uint8(8, "Baud Rate", 1, fmt_mx_baud_rate, FieldReset::ExceptBaudRate),
     ControlTableField::new_uint8(9, "Return Delay Time", 250, fmt_mx_return_delay),
     ControlTableField::new_uint8(10, "Drive Mode", 0, fmt_mx_drive_mode),
     ControlTableField::new_uint8(11, "Operating Mode", 3, fmt_mx_operating_mode),
@@ -0,0 +1,326 @@
+#include "device_farm.h"
+#include "field_export.h"
+#include "packet_encoder.h"
+
+#include <algorithm>
+#include <string.h>
+
+const uint8_t DeviceFarm::ERROR_INSTRUCTION;
+const uint8_t DeviceFarm::ERROR_DATA_RANGE;
+
+/// The unit of the Return Delay Time, in us.
+static const uint32_t RETURN_DELAY_UNIT_US = 2;
+
+/// The Status Return Levels at which a device answers pings only and pings and reads.
+static const uint32_t STATUS_RETURN_PING = 0;
+static const uint32_t STATUS_RETURN_READ = 1;
+
+static const ControlTableField* find_field(const ControlTable& control_table, const char* name) {
+    for (auto& field : control_table.fields()) {
+        if (strcmp(field.name, name) == 0) {
+            return &field;
+        }
+    }
+
+    return nullptr;
+}
+
+DeviceFarm::Device::Device(std::unique_ptr<ControlTable>&& control_table) :
+    control_table(std::move(control_table)),
+    firmware_version(find_field(*this->control_table, "Firmware Version")),
+    return_delay_time(find_field(*this->control_table, "Return Delay Time")),
+    status_return_level(find_field(*this->control_table, "Status Return Level")),
+    registered_instruction(find_field(*this->control_table, "Registered Instruction")),
+    has_registered_write(false),
+    registered_addr(0) {}
+
+DeviceFarm::DeviceFarm() {}
+
+bool DeviceFarm::add_device(DeviceId device_id, uint16_t model_number) {
+    if (device_id.is_broadcast() || this->devices.count(device_id.to_byte()) != 0) {
+        return false;
+    }
+
+    auto& model_numbers = ControlTableMap::supported_model_numbers();
+
+    if (std::find(model_numbers.begin(), model_numbers.end(), model_number)
+        == model_numbers.end()) {
+        return false;
+    }
+
+    this->devices.emplace(
+        device_id.to_byte(), Device(ControlTableMap::create_control_table(model_number)));
+    return true;
+}
+
+ControlTable* DeviceFarm::control_table(DeviceId device_id) {
+    auto device = this->devices.find(device_id.to_byte());
+    return device != this->devices.end() ? device->second.control_table.get() : nullptr;
+}
+
+template <typename F>
+void DeviceFarm::for_each_device(DeviceId device_id, F f) {
+    if (device_id.is_broadcast()) {
+        for (auto& id_and_device : this->devices) {
+            f(DeviceId(id_and_device.first), id_and_device.second);
+        }
+
+        return;
+    }
+
+    auto device = this->devices.find(device_id.to_byte());
+
+    if (device != this->devices.end()) {
+        f(device_id, device->second);
+    }
+}
+
+void DeviceFarm::receive(const InstructionPacket& packet) {
+    this->responses_.clear();
+    this->buf.clear();
+
+    switch (packet.instruction) {
+        case Instruction::Ping: {
+            this->for_each_device(packet.ping.device_id, [&](DeviceId device_id, Device& device) {
+                auto& control_table = *device.control_table;
+                uint8_t data[3];
+                uint16_to_le(data, control_table.model_number());
+                data[2] = device.firmware_version != nullptr
+                    ? (uint8_t) read_field_value(control_table.memory(), *device.firmware_version)
+                    : 0;
+
+                this->respond(device_id, device, StatusKind::Ping, 0, data, sizeof(data));
+            });
+
+            break;
+        }
+        case Instruction::Read: {
+            auto& args = packet.read;
+
+            // there is no response to a broadcast read
+            if (!args.device_id.is_broadcast()) {
+                this->for_each_device(args.device_id, [&](DeviceId device_id, Device& device) {
+                    this->respond_read(device_id, device, args.start_addr, args.len);
+                });
+            }
+
+            break;
+        }
+        case Instruction::Write: {
+            auto& args = packet.write;
+
+            this->for_each_device(args.device_id, [&](DeviceId device_id, Device& device) {
+                auto error =
+                    this->write(device, args.start_addr, args.data.data(), args.data.size());
+
+                if (!args.device_id.is_broadcast()) {
+                    this->respond(device_id, device, StatusKind::Other, error, nullptr, 0);
+                }
+            });
+
+            break;
+        }
+        case Instruction::RegWrite: {
+            auto& args = packet.reg_write;
+
+            this->for_each_device(args.device_id, [&](DeviceId device_id, Device& device) {
+                device.registered_addr = args.start_addr;
+                device.registered_data = args.data;
+                this->set_registered_instruction(device, true);
+
+                if (!args.device_id.is_broadcast()) {
+                    this->respond(device_id, device, StatusKind::Other, 0, nullptr, 0);
+                }
+            });
+
+            break;
+        }
+        case Instruction::Action: {
+            auto& args = packet.action;
+
+            this->for_each_device(args.device_id, [&](DeviceId device_id, Device& device) {
+                auto error = ERROR_INSTRUCTION;
+
+                if (device.has_registered_write) {
+                    error = this->write(
+                        device,
+                        device.registered_addr,
+                        device.registered_data.data(),
+                        device.registered_data.size());
+                    this->set_registered_instruction(device, false);
+                }
+
+                if (!args.device_id.is_broadcast()) {
+                    this->respond(device_id, device, StatusKind::Other, error, nullptr, 0);
+                }
+            });
+
+            break;
+        }
+        case Instruction::FactoryReset: {
+            auto& args = packet.factory_reset;
+
+            this->for_each_device(args.device_id, [&](DeviceId device_id, Device& device) {
+                // the device answers before it resets itself
+                if (!args.device_id.is_broadcast()) {
+                    this->respond(device_id, device, StatusKind::Other, 0, nullptr, 0);
+                }
+
+                device.control_table->factory_reset(args.reset);
+                this->set_registered_instruction(device, false);
+            });
+
+            break;
+        }
+        case Instruction::Reboot: {
+            auto& args = packet.reboot;
+
+            this->for_each_device(args.device_id, [&](DeviceId device_id, Device& device) {
+                if (!args.device_id.is_broadcast()) {
+                    this->respond(device_id, device, StatusKind::Other, 0, nullptr, 0);
+                }
+
+                // the registered instruction is only stored in RAM
+                this->set_registered_instruction(device, false);
+            });
+
+            break;
+        }
+        case Instruction::Clear: {
+            auto& args = packet.clear;
+
+            this->for_each_device(args.device_id, [&](DeviceId device_id, Device& device) {
+                if (!args.device_id.is_broadcast()) {
+                    this->respond(device_id, device, StatusKind::Other, 0, nullptr, 0);
+                }
+            });
+
+            break;
+        }
+        case Instruction::SyncRead: {
+            auto& args = packet.sync_read;
+
+            // the devices answer in the order of the instruction
+            for (auto device_id : args.devices) {
+                auto device = this->devices.find(device_id.to_byte());
+
+                if (device != this->devices.end()) {
+                    this->respond_read(device_id, device->second, args.start_addr, args.len);
+                }
+            }
+
+            break;
+        }
+        case Instruction::SyncWrite: {
+            auto& args = packet.sync_write;
+
+            for (size_t i = 0; i < args.devices.size(); i++) {
+                auto device = this->devices.find(args.devices[i].to_byte());
+
+                if (device != this->devices.end()) {
+                    auto data = args.data.data() + i * args.len;
+                    this->write(device->second, args.start_addr, data, args.len);
+                }
+            }
+
+            break;
+        }
+        case Instruction::BulkRead: {
+            for (auto& read : packet.bulk_read.reads) {
+                auto device = this->devices.find(read.device_id.to_byte());
+
+                if (device != this->devices.end()) {
+                    this->respond_read(read.device_id, device->second, read.start_addr, read.len);
+                }
+            }
+
+            break;
+        }
+        case Instruction::BulkWrite: {
+            for (auto& write : packet.bulk_write.writes) {
+                auto device = this->devices.find(write.device_id.to_byte());
+
+                if (device != this->devices.end()) {
+                    this->write(
+                        device->second, write.start_addr, write.data.data(), write.data.size());
+                }
+            }
+
+            break;
+        }
+        default: {
+            // fast reads and status packets of other devices
+            break;
+        }
+    }
+}
+
+uint8_t DeviceFarm::write(Device& device, uint16_t start_addr, const uint8_t* data, size_t len) {
+    if (len > UINT16_MAX || !device.control_table->write(start_addr, data, (uint16_t) len)) {
+        return ERROR_DATA_RANGE;
+    }
+
+    return 0;
+}
+
+void DeviceFarm::set_registered_instruction(Device& device, bool has_registered_write) {
+    device.has_registered_write = has_registered_write;
+
+    if (device.registered_instruction != nullptr) {
+        device.control_table->memory().write_uint8(
+            device.registered_instruction->addr, has_registered_write ? 1 : 0);
+    }
+}
+
+void DeviceFarm::respond(
+    DeviceId device_id,
+    const Device& device,
+    StatusKind kind,
+    uint8_t error,
+    const uint8_t* data,
+    size_t len) {
+    auto& memory = device.control_table->memory();
+
+    if (device.status_return_level != nullptr) {
+        auto level = read_field_value(memory, *device.status_return_level);
+
+        if ((level == STATUS_RETURN_PING && kind != StatusKind::Ping)
+            || (level == STATUS_RETURN_READ && kind == StatusKind::Other)) {
+            return;
+        }
+    }
+
+    uint32_t delay_us = 0;
+
+    if (device.return_delay_time != nullptr) {
+        delay_us = read_field_value(memory, *device.return_delay_time) * RETURN_DELAY_UNIT_US;
+    }
+
+    // the header, id, length, instruction, error and checksum and the worst case of stuffing
+    auto offset = this->buf.size();
+    this->buf.resize(offset + 11 + len + len / 3 + 1);
+    PacketEncoder encoder(&this->buf[offset], this->buf.size() - offset);
+
+    if (!encode_status_packet(device_id, Error(error), data, len, &encoder)) {
+        this->buf.resize(offset);
+        return;
+    }
+
+    this->buf.resize(offset + encoder.len());
+    this->responses_.push_back(FarmResponse{device_id, delay_us, offset, encoder.len()});
+}
+
+void DeviceFarm::respond_read(
+    DeviceId device_id,
+    const Device& device,
+    uint16_t start_addr,
+    uint16_t len) {
+    this->read_buf.resize(len);
+
+    if (!device.control_table->memory().read(start_addr, this->read_buf.data(), len)) {
+        this->respond(device_id, device, StatusKind::Read, ERROR_DATA_RANGE, nullptr, 0);
+        return;
+    }
+
+    this->respond(device_id, device, StatusKind::Read, 0, this->read_buf.data(), len);
+}
@@ -0,0 +1,119 @@
+#ifndef DEVICE_FARM_H
+#define DEVICE_FARM_H
+
+#include "control_table.h"
+#include "parser.h"
+
+#include <map>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/// A status packet a device of a `DeviceFarm` sends in response to an instruction.
+struct FarmResponse {
+    DeviceId device_id;
+
+    /// How long the device waits before it sends the packet, in us (its Return Delay Time).
+    /// The first response is delayed from the end of the instruction packet, every following
+    /// one from the end of the response before it.
+    uint32_t delay_us;
+
+    /// The encoded packet (see `DeviceFarm::response_data`).
+    size_t offset;
+    size_t len;
+};
+
+/// Emulates devices of the supported models (see `ControlTableMap::create_control_table`) on
+/// a bus. Every device has a control table with the model's default values. Instructions
+/// sent to the devices are applied to the control tables and answered from them like the real
+/// devices do: reads return the data of the control table, writes change it and the Status
+/// Return Level and Return Delay Time fields of a device are honoured if its model has them.
+/// Fast reads are not answered.
+class DeviceFarm {
+  public:
+    /// The error of a status packet whose instruction could not be executed.
+    static const uint8_t ERROR_INSTRUCTION = 0x02;
+    static const uint8_t ERROR_DATA_RANGE = 0x04;
+
+    DeviceFarm();
+
+    /// Adds a device with the model `model_number`. Returns `false` if the model is not
+    /// supported, `device_id` is the broadcast id or the farm already has such a device.
+    bool add_device(DeviceId device_id, uint16_t model_number);
+
+    /// Returns the control table of a device or `nullptr` if the farm has no such device.
+    ControlTable* control_table(DeviceId device_id);
+
+    size_t num_devices() const {
+        return this->devices.size();
+    }
+
+    /// Executes an instruction received on the bus. Afterwards `responses` are the status
+    /// packets the devices send in response, in the order in which they are sent.
+    void receive(const InstructionPacket& packet);
+
+    const std::vector<FarmResponse>& responses() const {
+        return this->responses_;
+    }
+
+    /// The encoded status packets of all `responses`, one after the other.
+    const uint8_t* response_data() const {
+        return this->buf.data();
+    }
+
+  private:
+    struct Device {
+        explicit Device(std::unique_ptr<ControlTable>&& control_table);
+
+        std::unique_ptr<ControlTable> control_table;
+
+        /// The fields the farm needs, `nullptr` if the model does not have them.
+        const ControlTableField* firmware_version;
+        const ControlTableField* return_delay_time;
+        const ControlTableField* status_return_level;
+        const ControlTableField* registered_instruction;
+
+        /// The write of the last `RegWrite`, which is executed by the next `Action`.
+        bool has_registered_write;
+        uint16_t registered_addr;
+        std::vector<uint8_t> registered_data;
+    };
+
+    /// Which status packets a device sends, see the Status Return Level.
+    enum class StatusKind {
+        Ping,
+        Read,
+        Other,
+    };
+
+    /// Calls `f` with every device `device_id` refers to (all devices for a broadcast).
+    template <typename F>
+    void for_each_device(DeviceId device_id, F f);
+
+    /// Applies a write to the control table of a device. Returns the error of the status.
+    uint8_t write(Device& device, uint16_t start_addr, const uint8_t* data, size_t len);
+
+    void set_registered_instruction(Device& device, bool has_registered_write);
+
+    /// Encodes the status packet of a device if its Status Return Level allows it.
+    void respond(
+        DeviceId device_id,
+        const Device& device,
+        StatusKind kind,
+        uint8_t error,
+        const uint8_t* data,
+        size_t len);
+
+    /// Responds to a read of `len` bytes starting at `start_addr`.
+    void respond_read(DeviceId device_id, const Device& device, uint16_t start_addr, uint16_t len);
+
+    std::map<uint8_t, Device> devices;
+    std::vector<FarmResponse> responses_;
+    std::vector<uint8_t> buf;
+
+    /// The data of a read.
+    std::vector<uint8_t> read_buf;
+};
+
+#endif
@@ -99,6 +99,7 @@ class DeviceIdMap {
             if (this->is_present_) {
                 this->is_present_ = false;
                 this->value_.~V();
+                map->size_--;
             }
         }
 
@@ -146,8 +147,6 @@ class DeviceIdMap {
     /// Clears all the present values, calling their destructors. After this call,
     /// the size of the map is 0.
     void clear() {
-        this->size_ = 0;
-
         for (auto& entry : this->entries) {
             entry.clear_value();
         }
@@ -20,6 +20,14 @@ inline uint32_t uint32_from_le(const uint8_t bytes[4]) {
     return val;
 }
 
+/// Converts `bytes` into a 64-bit unsigned integer. The bytes are interpreted as
+/// little-endian.
+inline uint64_t uint64_from_le(const uint8_t bytes[8]) {
+    uint64_t val;
+    memcpy(&val, bytes, 8);
+    return val;
+}
+
 /// Converts `bytes` into a single precision floating point number. The bytes are
 /// interpreted as little-endian.
 inline float float32_from_le(const uint8_t bytes[4]) {
@@ -40,6 +48,12 @@ inline void uint32_to_le(uint8_t dst[4], uint32_t val) {
     memcpy(dst, &val, 4);
 }
 
+/// Converts the 64-bit unsigned integer `val` into bytes with little-endian byte order.
+/// The bytes are written to `dst`.
+inline void uint64_to_le(uint8_t dst[8], uint64_t val) {
+    memcpy(dst, &val, 8);
+}
+
 /// Converts the single precision floating point number `val` into bytes with little-endian
 /// byte order. The bytes are written to `dst`.
 inline void float32_to_le(uint8_t dst[4], float val) {
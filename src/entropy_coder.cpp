@@ -0,0 +1,205 @@
+#include "entropy_coder.h"
+
+#include <math.h>
+
+const size_t BitPredictor::NUM_MODELS;
+const size_t BitPredictor::TABLE_BITS;
+
+/// The number of preceding bytes that form the context of every model.
+static const uint32_t MODEL_ORDERS[] = {0, 1, 2, 3, 4, 6};
+
+/// How quickly the models adapt to new data (as a shift: higher is slower).
+static const uint32_t MODEL_RATE = 4;
+
+/// How quickly the mixer's weights adapt (as a shift: higher is slower).
+static const uint32_t MIXER_RATE = 10;
+
+/// Probabilities (12 bits) are mixed in the logistic domain, where `stretch(p)` is
+/// `ln(p / (1 - p))` scaled to -2047..2047 and `squash` is its inverse.
+struct LogisticTables {
+    LogisticTables() {
+        for (int32_t i = 0; i < 4096; i++) {
+            auto value = 4096 / (1 + exp(-(i - 2048) / 256.0));
+            this->squash[i] = (uint16_t) (value > 4095 ? 4095 : value < 1 ? 1 : value);
+        }
+
+        // the inverse of `squash`, rounded to the closest value
+        int32_t stretched = -2047;
+
+        for (uint32_t p = 0; p < 4096; p++) {
+            while (stretched < 2047 && this->squash[stretched + 2049] <= p) {
+                stretched++;
+            }
+
+            this->stretch[p] = (int16_t) stretched;
+        }
+    }
+
+    uint16_t squash[4096];
+    int16_t stretch[4096];
+};
+
+static const LogisticTables& logistic_tables() {
+    static const LogisticTables tables;
+    return tables;
+}
+
+static uint32_t squash(int32_t value) {
+    value = value < -2047 ? -2047 : value > 2047 ? 2047 : value;
+    return logistic_tables().squash[value + 2048];
+}
+
+static int32_t stretch(uint32_t p) {
+    return logistic_tables().stretch[p];
+}
+
+BitPredictor::BitPredictor() :
+    weights((1 << 8) * NUM_MODELS, (1 << 16) / 4),
+    partial_byte(1),
+    partial_nibble(1),
+    history(0),
+    p_(2048) {
+    for (size_t i = 0; i < NUM_MODELS; i++) {
+        this->tables[i].assign((size_t) 1 << TABLE_BITS, 1 << 15);
+        this->context_hashes[i] = 0;
+    }
+
+    this->find_buckets();
+    this->predict();
+}
+
+void BitPredictor::update(uint32_t bit) {
+    // learn the bit
+    for (size_t i = 0; i < NUM_MODELS; i++) {
+        auto& p = this->tables[i][this->buckets[i] + this->partial_nibble];
+        p += ((int32_t) (bit << 16) - (int32_t) p) >> MODEL_RATE;
+    }
+
+    auto error = (int32_t) (bit << 12) - (int32_t) this->p_;
+    auto weights = &this->weights[this->partial_byte * NUM_MODELS];
+
+    for (size_t i = 0; i < NUM_MODELS; i++) {
+        weights[i] += (this->inputs[i] * error) >> MIXER_RATE;
+    }
+
+    // continue with the next bit, or with the next byte once it is complete
+    this->partial_byte = (this->partial_byte << 1) | bit;
+    this->partial_nibble = (this->partial_nibble << 1) | bit;
+
+    if (this->partial_byte >= 0x100) {
+        this->history = (this->history << 8) | (this->partial_byte & 0xff);
+        this->partial_byte = 1;
+
+        for (size_t i = 0; i < NUM_MODELS; i++) {
+            auto order = MODEL_ORDERS[i];
+            auto context = order == 0 ? 0 : this->history & (UINT64_MAX >> (64 - 8 * order));
+            auto hash = (context + order) * 0x9e3779b97f4a7c15;
+            this->context_hashes[i] = (uint32_t) (hash >> 32);
+        }
+    }
+
+    if (this->partial_nibble >= 0x10) {
+        this->find_buckets();
+    }
+
+    this->predict();
+}
+
+void BitPredictor::find_buckets() {
+    // the slots of a nibble share a bucket, so they are in the same cache line
+    for (size_t i = 0; i < NUM_MODELS; i++) {
+        auto hash = (this->context_hashes[i] + this->partial_byte) * 0x9e3779b1;
+        this->buckets[i] = (hash >> (32 - TABLE_BITS)) & ~(uint32_t) 0x0f;
+    }
+
+    this->partial_nibble = 1;
+}
+
+void BitPredictor::predict() {
+    auto weights = &this->weights[this->partial_byte * NUM_MODELS];
+    int64_t dot_product = 0;
+
+    for (size_t i = 0; i < NUM_MODELS; i++) {
+        auto p = this->tables[i][this->buckets[i] + this->partial_nibble];
+        this->inputs[i] = stretch(p >> 4);
+        dot_product += (int64_t) weights[i] * this->inputs[i];
+    }
+
+    this->p_ = squash((int32_t) (dot_product >> 16));
+}
+
+void EntropyEncoder::encode(const uint8_t* data, size_t len, std::vector<uint8_t>* out) {
+    // the range [low, high] shrinks with every bit, its leading bytes are final once they are
+    // the same for both ends
+    uint32_t low = 0;
+    uint32_t high = UINT32_MAX;
+
+    for (size_t i = 0; i < len; i++) {
+        for (int32_t shift = 7; shift >= 0; shift--) {
+            uint32_t bit = (data[i] >> shift) & 1;
+            auto mid = low + (uint32_t) (((uint64_t) (high - low) * this->predictor.p()) >> 12);
+
+            if (bit) {
+                high = mid;
+            } else {
+                low = mid + 1;
+            }
+
+            this->predictor.update(bit);
+
+            while (((low ^ high) & 0xff000000) == 0) {
+                out->push_back((uint8_t) (high >> 24));
+                low <<= 8;
+                high = (high << 8) | 0xff;
+            }
+        }
+    }
+
+    // any value in the range decodes the block, the decoder reads zeros after its end
+    for (int32_t shift = 24; shift >= 0; shift -= 8) {
+        out->push_back((uint8_t) (low >> shift));
+    }
+}
+
+void EntropyDecoder::decode(
+    const uint8_t* coded,
+    size_t coded_len,
+    size_t len,
+    std::vector<uint8_t>* out) {
+    uint32_t low = 0;
+    uint32_t high = UINT32_MAX;
+    uint32_t value = 0;
+    size_t pos = 0;
+
+    auto next_byte = [&]() { return pos < coded_len ? coded[pos++] : 0; };
+
+    for (size_t i = 0; i < 4; i++) {
+        value = (value << 8) | next_byte();
+    }
+
+    for (size_t i = 0; i < len; i++) {
+        uint32_t byte = 0;
+
+        for (size_t j = 0; j < 8; j++) {
+            auto mid = low + (uint32_t) (((uint64_t) (high - low) * this->predictor.p()) >> 12);
+            uint32_t bit = value <= mid;
+
+            if (bit) {
+                high = mid;
+            } else {
+                low = mid + 1;
+            }
+
+            this->predictor.update(bit);
+            byte = (byte << 1) | bit;
+
+            while (((low ^ high) & 0xff000000) == 0) {
+                low <<= 8;
+                high = (high << 8) | 0xff;
+                value = (value << 8) | next_byte();
+            }
+        }
+
+        out->push_back((uint8_t) byte);
+    }
+}
@@ -0,0 +1,78 @@
+#ifndef ENTROPY_CODER_H
+#define ENTROPY_CODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/// Predicts the bits of a byte stream, most significant bit first. The predictions of context
+/// models of the preceding 0 to 6 bytes are mixed by a small neural network (logistic mixing),
+/// whose weights are chosen by the bits of the current byte that are already known. Data that
+/// repeats costs only a small fraction of a bit per byte once the models have learned it.
+class BitPredictor {
+  public:
+    BitPredictor();
+
+    /// The probability that the next bit is 1, with 12 bits of precision (never 0 or 4096).
+    uint32_t p() const {
+        return this->p_;
+    }
+
+    /// Learns the value of the predicted bit and predicts the next one.
+    void update(uint32_t bit);
+
+  private:
+    static const size_t NUM_MODELS = 6;
+    static const size_t TABLE_BITS = 20;
+
+    /// Finds the buckets of the models for the next nibble.
+    void find_buckets();
+
+    /// Mixes the predictions of the models for the next bit.
+    void predict();
+
+    /// Every model maps the hash of its context and the known bits of the current byte to a
+    /// probability with 16 bits of precision. The probabilities of the bits of a nibble are
+    /// stored in a bucket of 16 slots.
+    std::vector<uint16_t> tables[NUM_MODELS];
+    uint32_t context_hashes[NUM_MODELS];
+    uint32_t buckets[NUM_MODELS];
+
+    /// The mixer's weights (16.16 fixed point) for every value of `partial_byte`.
+    std::vector<int32_t> weights;
+    int32_t inputs[NUM_MODELS];
+
+    /// The known bits of the current byte and nibble, each with a leading 1 bit.
+    uint32_t partial_byte;
+    uint32_t partial_nibble;
+
+    /// The previous bytes, the most recent one in the lowest bits.
+    uint64_t history;
+
+    uint32_t p_;
+};
+
+/// Compresses data with an adaptive binary arithmetic coder driven by a `BitPredictor`. The
+/// models keep learning across calls, so a stream can be coded in blocks, which can then be
+/// decoded one after the other by an `EntropyDecoder`. Every block ends on a byte boundary.
+class EntropyEncoder {
+  public:
+    /// Appends the coded `len` bytes at `data` to `out`.
+    void encode(const uint8_t* data, size_t len, std::vector<uint8_t>* out);
+
+  private:
+    BitPredictor predictor;
+};
+
+/// Decodes the blocks written by an `EntropyEncoder`, in the same order.
+class EntropyDecoder {
+  public:
+    /// Decodes the `coded_len` bytes at `coded` into `len` bytes, which are appended to `out`.
+    /// Corrupted data is not detected, it is just decoded into other bytes.
+    void decode(const uint8_t* coded, size_t coded_len, size_t len, std::vector<uint8_t>* out);
+
+  private:
+    BitPredictor predictor;
+};
+
+#endif
@@ -0,0 +1,340 @@
+#include "field_export.h"
+#include "checkpoint.h"
+#include "endian_convert.h"
+#include "varint.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+std::string to_string(FieldColumnsResult result) {
+    switch (result) {
+        case FieldColumnsResult::Ok: {
+            return "ok";
+        }
+        case FieldColumnsResult::InvalidMagic: {
+            return "not a field columns file";
+        }
+        case FieldColumnsResult::UnsupportedVersion: {
+            return "unsupported field columns version";
+        }
+        case FieldColumnsResult::Corrupted: {
+            return "corrupted field columns";
+        }
+        default: { return "unknown"; }
+    }
+}
+
+std::string fmt_field_value(ControlTableField::FieldType type, uint32_t value) {
+    if (type != ControlTableField::FieldType::Float32) {
+        return std::to_string(value);
+    }
+
+    float float_value;
+    memcpy(&float_value, &value, sizeof(float_value));
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.9g", float_value);
+    return buf;
+}
+
+uint32_t read_field_value(const ControlTableMemory& memory, const ControlTableField& field) {
+    switch (field.type) {
+        case ControlTableField::FieldType::UInt8: {
+            uint8_t value = 0;
+            memory.read_uint8(field.addr, &value);
+            return value;
+        }
+        case ControlTableField::FieldType::UInt16: {
+            uint16_t value = 0;
+            memory.read_uint16(field.addr, &value);
+            return value;
+        }
+        case ControlTableField::FieldType::UInt32: {
+            uint32_t value = 0;
+            memory.read_uint32(field.addr, &value);
+            return value;
+        }
+        case ControlTableField::FieldType::Float32: {
+            float value = 0.0f;
+            memory.read_float32(field.addr, &value);
+            uint32_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            return bits;
+        }
+        default: { return 0; }
+    }
+}
+
+FieldTracker::FieldTracker(size_t num_buses) :
+    control_table_map_(num_buses),
+    devices(DeviceId::num_values()) {}
+
+void FieldTracker::add(const ScannedPacket& packet, std::vector<FieldChange>* changes) {
+    apply_scanned_packet(this->control_table_map_, packet);
+
+    // fragments are only applied with the last one
+    if (packet.result != ParseResult::PacketAvailable) {
+        return;
+    }
+
+    auto device_id = packet.packet->device_id;
+
+    if (!device_id.is_broadcast()) {
+        this->check(device_id, packet.timestamp, changes);
+        return;
+    }
+
+    for (auto id_and_table : this->control_table_map_) {
+        this->check(id_and_table.first, packet.timestamp, changes);
+    }
+}
+
+void FieldTracker::check(
+    DeviceId device_id,
+    uint64_t timestamp,
+    std::vector<FieldChange>* changes) {
+    auto& entry = this->control_table_map_.get(device_id);
+
+    if (!entry.is_present()) {
+        return;
+    }
+
+    auto& control_table = *entry.value();
+    auto& memory = control_table.memory();
+    auto& fields = control_table.fields();
+    auto& device = this->devices[device_id.to_byte()];
+
+    // the model of a device changes once it has been pinged
+    auto is_new = device.fields != &fields;
+
+    if (!is_new && device.memory == memory.raw()) {
+        return;
+    }
+
+    if (is_new) {
+        device.fields = &fields;
+        device.columns.clear();
+        device.values.assign(fields.size(), 0);
+
+        for (auto& field : fields) {
+            device.columns.push_back(this->find_column(device_id, field));
+        }
+    }
+
+    for (size_t i = 0; i < fields.size(); i++) {
+        auto value = read_field_value(memory, fields[i]);
+
+        if (is_new || value != device.values[i]) {
+            device.values[i] = value;
+            changes->push_back(FieldChange{device.columns[i], timestamp, value});
+        }
+    }
+
+    device.memory = memory.raw();
+}
+
+size_t FieldTracker::find_column(DeviceId device_id, const ControlTableField& field) {
+    for (size_t i = 0; i < this->columns_.size(); i++) {
+        auto& column = this->columns_[i];
+
+        if (column.device_id == device_id && column.type == field.type
+            && column.name == field.name) {
+            return i;
+        }
+    }
+
+    this->columns_.push_back(FieldColumn{device_id, field.type, field.name});
+    return this->columns_.size() - 1;
+}
+
+FieldColumnWriter::FieldColumnWriter(std::ostream* out) :
+    out(out),
+    offset(FIELD_COLUMNS_HEADER_LEN) {
+    uint8_t header[FIELD_COLUMNS_HEADER_LEN] = {};
+    memcpy(header, FIELD_COLUMNS_MAGIC, sizeof(FIELD_COLUMNS_MAGIC));
+    uint16_to_le(&header[4], FIELD_COLUMNS_VERSION);
+    this->out->write((const char*) header, sizeof(header));
+}
+
+void FieldColumnWriter::add(const FieldColumn& column, const FieldChange& change) {
+    if (change.column >= this->indices.size()) {
+        this->indices.resize(change.column + 1, SIZE_MAX);
+    }
+
+    auto& index = this->indices[change.column];
+
+    if (index == SIZE_MAX) {
+        index = this->columns.size();
+        this->columns.push_back(Column{column, 0, {}});
+    }
+
+    auto& samples = this->columns[index].samples;
+    samples.emplace_back(change.timestamp, change.value);
+    this->columns[index].num_samples++;
+
+    if (samples.size() == FIELD_COLUMNS_BLOCK_SAMPLES) {
+        this->write_block(index);
+    }
+}
+
+void FieldColumnWriter::finish() {
+    for (size_t i = 0; i < this->columns.size(); i++) {
+        this->write_block(i);
+    }
+
+    auto table_offset = this->offset;
+    this->buf.clear();
+
+    for (auto& column : this->columns) {
+        auto name_len = std::min<size_t>(column.column.name.size(), UINT8_MAX);
+        uint8_t num_samples[8];
+        uint64_to_le(num_samples, column.num_samples);
+
+        this->buf.push_back(column.column.device_id.to_byte());
+        this->buf.push_back((uint8_t) column.column.type);
+        this->buf.push_back((uint8_t) name_len);
+        this->buf.insert(this->buf.end(), column.column.name.begin(),
+                         column.column.name.begin() + name_len);
+        this->buf.insert(this->buf.end(), num_samples, num_samples + sizeof(num_samples));
+    }
+
+    uint8_t footer[FIELD_COLUMNS_FOOTER_LEN];
+    uint64_to_le(&footer[0], table_offset);
+    uint64_to_le(&footer[8], this->columns.size());
+    this->buf.insert(this->buf.end(), footer, footer + sizeof(footer));
+    this->out->write((const char*) this->buf.data(), this->buf.size());
+    this->offset += this->buf.size();
+}
+
+void FieldColumnWriter::write_block(size_t index) {
+    auto& samples = this->columns[index].samples;
+
+    if (samples.empty()) {
+        return;
+    }
+
+    uint64_t last_timestamp = 0;
+    uint32_t last_value = 0;
+    this->buf.clear();
+
+    for (auto& sample : samples) {
+        append_varint(sample.first - last_timestamp, &this->buf);
+        append_varint(zigzag_encode((int64_t) sample.second - (int64_t) last_value), &this->buf);
+        last_timestamp = sample.first;
+        last_value = sample.second;
+    }
+
+    std::vector<uint8_t> header;
+    append_varint(index, &header);
+    append_varint(samples.size(), &header);
+    append_varint(this->buf.size(), &header);
+    this->out->write((const char*) header.data(), header.size());
+    this->out->write((const char*) this->buf.data(), this->buf.size());
+    this->offset += header.size() + this->buf.size();
+    samples.clear();
+}
+
+FieldColumnReader::FieldColumnReader(const uint8_t* columns, size_t len) :
+    data(columns),
+    len(len),
+    table_offset(0) {}
+
+FieldColumnsResult FieldColumnReader::open() {
+    if (this->len < FIELD_COLUMNS_HEADER_LEN + FIELD_COLUMNS_FOOTER_LEN
+        || memcmp(this->data, FIELD_COLUMNS_MAGIC, sizeof(FIELD_COLUMNS_MAGIC)) != 0) {
+        return FieldColumnsResult::InvalidMagic;
+    }
+
+    if (uint16_from_le(&this->data[4]) != FIELD_COLUMNS_VERSION) {
+        return FieldColumnsResult::UnsupportedVersion;
+    }
+
+    auto footer = &this->data[this->len - FIELD_COLUMNS_FOOTER_LEN];
+    auto table_offset = uint64_from_le(&footer[0]);
+    auto num_columns = uint64_from_le(&footer[8]);
+    auto table_end = this->len - FIELD_COLUMNS_FOOTER_LEN;
+
+    if (table_offset < FIELD_COLUMNS_HEADER_LEN || table_offset > table_end) {
+        return FieldColumnsResult::Corrupted;
+    }
+
+    this->columns_.clear();
+    auto offset = (size_t) table_offset;
+
+    for (uint64_t i = 0; i < num_columns; i++) {
+        if (table_end - offset < 3) {
+            return FieldColumnsResult::Corrupted;
+        }
+
+        auto entry = &this->data[offset];
+        size_t name_len = entry[2];
+
+        if (table_end - offset < 3 + name_len + 8
+            || entry[1] > (uint8_t) ControlTableField::FieldType::Float32) {
+            return FieldColumnsResult::Corrupted;
+        }
+
+        FieldColumnInfo info{
+            FieldColumn{
+                DeviceId(entry[0]),
+                (ControlTableField::FieldType) entry[1],
+                std::string((const char*) &entry[3], name_len),
+            },
+            uint64_from_le(&entry[3 + name_len]),
+        };
+        this->columns_.push_back(std::move(info));
+        offset += 3 + name_len + 8;
+    }
+
+    this->table_offset = table_offset;
+    return FieldColumnsResult::Ok;
+}
+
+FieldColumnsResult FieldColumnReader::read(size_t index, std::vector<FieldSample>* samples) const {
+    auto offset = FIELD_COLUMNS_HEADER_LEN;
+
+    auto read = [&](size_t end, uint64_t* value) {
+        auto varint_len = read_varint(&this->data[offset], end - offset, value);
+        offset += varint_len;
+        return varint_len > 0;
+    };
+
+    while (offset < this->table_offset) {
+        uint64_t column;
+        uint64_t num_samples;
+        uint64_t block_len;
+
+        if (!read(this->table_offset, &column) || !read(this->table_offset, &num_samples)
+            || !read(this->table_offset, &block_len)
+            || block_len > this->table_offset - offset) {
+            return FieldColumnsResult::Corrupted;
+        }
+
+        auto block_end = offset + block_len;
+
+        if (column != index) {
+            offset = block_end;
+            continue;
+        }
+
+        uint64_t timestamp = 0;
+        uint32_t value = 0;
+
+        for (uint64_t i = 0; i < num_samples; i++) {
+            uint64_t timestamp_diff;
+            uint64_t value_diff;
+
+            if (!read(block_end, &timestamp_diff) || !read(block_end, &value_diff)) {
+                return FieldColumnsResult::Corrupted;
+            }
+
+            timestamp += timestamp_diff;
+            value = (uint32_t) ((int64_t) value + zigzag_decode(value_diff));
+            samples->push_back(FieldSample{timestamp, value});
+        }
+
+        offset = block_end;
+    }
+
+    return FieldColumnsResult::Ok;
+}
@@ -0,0 +1,189 @@
+#ifndef FIELD_EXPORT_H
+#define FIELD_EXPORT_H
+
+#include "capture.h"
+#include "control_table.h"
+
+#include <ostream>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/// Field columns store the values of the fields of every device over the time of a capture,
+/// one column per device and field, so a single field can be loaded without reading the
+/// others. A column has a sample for every change of the field's value. All fields are
+/// little-endian:
+///
+/// - a header of `FIELD_COLUMNS_HEADER_LEN` bytes: the magic `DXFC`, the format version (u16)
+///   and a reserved u16
+/// - blocks of at most `FIELD_COLUMNS_BLOCK_SAMPLES` samples of a column, in the order they
+///   were filled: the index of the column, the number of samples and the length of the
+///   samples (varints, see `varint.h`), followed by the samples
+/// - a table with every column: the device id (u8), the `ControlTableField::FieldType` (u8),
+///   the length of the field's name (u8), the name and the number of samples (u64)
+/// - a footer of `FIELD_COLUMNS_FOOTER_LEN` bytes: the offset of the table (u64) and the
+///   number of columns (u64)
+///
+/// Every sample is stored as the difference to the previous sample of its block (starting at
+/// 0): the timestamp and the value (zigzag encoded). Values are stored as unsigned integers,
+/// `float`s as their bits.
+const uint8_t FIELD_COLUMNS_MAGIC[4] = {'D', 'X', 'F', 'C'};
+const uint16_t FIELD_COLUMNS_VERSION = 1;
+const size_t FIELD_COLUMNS_HEADER_LEN = 8;
+const size_t FIELD_COLUMNS_FOOTER_LEN = 16;
+const size_t FIELD_COLUMNS_BLOCK_SAMPLES = 1024;
+
+/// A field of a device.
+struct FieldColumn {
+    DeviceId device_id;
+    ControlTableField::FieldType type;
+    std::string name;
+};
+
+/// A new value of a column.
+struct FieldChange {
+    size_t column;
+
+    /// The timestamp of the packet that changed the value.
+    uint64_t timestamp;
+
+    /// The value, the bits of a `float` for `ControlTableField::FieldType::Float32`.
+    uint32_t value;
+};
+
+enum class FieldColumnsResult {
+    Ok,
+
+    /// The columns do not start with `FIELD_COLUMNS_MAGIC`.
+    InvalidMagic,
+
+    UnsupportedVersion,
+
+    /// A block or the table exceeds the length of the columns.
+    Corrupted,
+};
+
+std::string to_string(FieldColumnsResult result);
+
+/// Formats a value of a field as a number, e.g. for CSV files.
+std::string fmt_field_value(ControlTableField::FieldType type, uint32_t value);
+
+/// Reads the value of `field` from `memory`, the bits for a `float`.
+uint32_t read_field_value(const ControlTableMemory& memory, const ControlTableField& field);
+
+/// Replays the packets of a capture and finds the fields whose values changed. Only the
+/// devices a packet is addressed to (or sent by) are checked, all devices for broadcasts.
+class FieldTracker {
+  public:
+    /// Creates a tracker for a capture with `num_buses` buses.
+    explicit FieldTracker(size_t num_buses);
+
+    /// Applies the next packet of the capture (see `apply_scanned_packet`) and appends the
+    /// fields that changed to `changes`. A device's fields are all changed when it is seen
+    /// for the first time.
+    void add(const ScannedPacket& packet, std::vector<FieldChange>* changes);
+
+    /// The columns of all devices seen so far.
+    const std::vector<FieldColumn>& columns() const {
+        return this->columns_;
+    }
+
+    const ControlTableMap& control_table_map() const {
+        return this->control_table_map_;
+    }
+
+  private:
+    struct Device {
+        /// The fields of the device's control table when it was last checked.
+        const std::vector<ControlTableField>* fields = nullptr;
+        std::vector<uint8_t> memory;
+
+        /// The column and the last value of every field.
+        std::vector<size_t> columns;
+        std::vector<uint32_t> values;
+    };
+
+    /// Appends the fields of a device that changed since it was last checked.
+    void check(DeviceId device_id, uint64_t timestamp, std::vector<FieldChange>* changes);
+
+    size_t find_column(DeviceId device_id, const ControlTableField& field);
+
+    ControlTableMap control_table_map_;
+    std::vector<Device> devices;
+    std::vector<FieldColumn> columns_;
+};
+
+/// Writes field columns. Only the samples of one block per column are held in memory, so
+/// the memory does not depend on the length of the capture.
+class FieldColumnWriter {
+  public:
+    /// Writes the header to `out`.
+    explicit FieldColumnWriter(std::ostream* out);
+
+    /// Adds a sample to the column `column` (as in `change.column`). Columns are written in
+    /// the order they got their first sample.
+    void add(const FieldColumn& column, const FieldChange& change);
+
+    /// Writes the remaining blocks and the table.
+    void finish();
+
+    /// Returns `false` if writing to the stream failed.
+    bool is_ok() const {
+        return this->out->good();
+    }
+
+  private:
+    struct Column {
+        FieldColumn column;
+        uint64_t num_samples;
+        std::vector<std::pair<uint64_t, uint32_t>> samples;
+    };
+
+    void write_block(size_t index);
+
+    std::ostream* out;
+    uint64_t offset;
+
+    /// The index of every column of the `FieldChange`s in `columns`.
+    std::vector<size_t> indices;
+
+    std::vector<Column> columns;
+    std::vector<uint8_t> buf;
+};
+
+/// A column in the table of field columns.
+struct FieldColumnInfo {
+    FieldColumn column;
+    uint64_t num_samples;
+};
+
+/// A sample of a column.
+struct FieldSample {
+    uint64_t timestamp;
+    uint32_t value;
+};
+
+/// Reads field columns that are completely in memory (e.g. a mapped file).
+class FieldColumnReader {
+  public:
+    FieldColumnReader(const uint8_t* columns, size_t len);
+
+    /// Checks the header and reads the table. Must be called before reading columns.
+    FieldColumnsResult open();
+
+    const std::vector<FieldColumnInfo>& columns() const {
+        return this->columns_;
+    }
+
+    /// Appends the samples of the column at `index` to `samples`.
+    FieldColumnsResult read(size_t index, std::vector<FieldSample>* samples) const;
+
+  private:
+    const uint8_t* data;
+    size_t len;
+    size_t table_offset;
+    std::vector<FieldColumnInfo> columns_;
+};
+
+#endif
@@ -0,0 +1,106 @@
+#include "histogram.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string.h>
+
+const uint32_t Histogram::SUB_BUCKET_BITS;
+const uint32_t Histogram::SUB_BUCKETS;
+const size_t Histogram::NUM_BUCKETS;
+
+Histogram::Histogram() {
+    this->reset();
+}
+
+void Histogram::record(uint32_t value) {
+    auto& bucket = this->buckets[Histogram::bucket_index(value)];
+
+    // saturate instead of wrapping around, which would corrupt the percentiles
+    if (bucket < std::numeric_limits<uint32_t>::max()) {
+        bucket++;
+    }
+
+    this->count_++;
+    this->sum += value;
+    this->min_ = std::min(value, this->min_);
+    this->max_ = std::max(value, this->max_);
+}
+
+void Histogram::reset() {
+    memset(this->buckets, 0, sizeof(this->buckets));
+    this->count_ = 0;
+    this->sum = 0;
+    this->min_ = std::numeric_limits<uint32_t>::max();
+    this->max_ = 0;
+}
+
+uint64_t Histogram::count() const {
+    return this->count_;
+}
+
+uint32_t Histogram::min() const {
+    return this->count_ > 0 ? this->min_ : 0;
+}
+
+uint32_t Histogram::max() const {
+    return this->max_;
+}
+
+float Histogram::mean() const {
+    if (this->count_ == 0) {
+        return 0.0f;
+    }
+
+    return (float) ((double) this->sum / (double) this->count_);
+}
+
+uint32_t Histogram::percentile(float percentile) const {
+    if (this->count_ == 0) {
+        return 0;
+    }
+
+    percentile = std::min(std::max(percentile, 0.0f), 100.0f);
+
+    // the rank of the value we are looking for (at least the first value)
+    auto rank = (uint64_t) std::ceil((double) percentile / 100.0 * (double) this->count_);
+    rank = std::max(rank, (uint64_t) 1);
+
+    uint64_t num_values = 0;
+
+    for (size_t i = 0; i < NUM_BUCKETS; i++) {
+        num_values += this->buckets[i];
+
+        if (num_values >= rank) {
+            return std::min(Histogram::bucket_highest_value(i), this->max_);
+        }
+    }
+
+    return this->max_;
+}
+
+size_t Histogram::bucket_index(uint32_t value) {
+    if (value < SUB_BUCKETS) {
+        return value;
+    }
+
+    // position of the highest set bit, at least `SUB_BUCKET_BITS`
+    uint32_t exponent = 31 - __builtin_clz(value);
+    uint32_t shift = exponent - SUB_BUCKET_BITS;
+
+    // the `SUB_BUCKET_BITS` bits below the highest set bit select the linear bucket
+    auto sub_bucket = (value >> shift) - SUB_BUCKETS;
+
+    return (shift + 1) * SUB_BUCKETS + sub_bucket;
+}
+
+uint32_t Histogram::bucket_highest_value(size_t index) {
+    if (index < SUB_BUCKETS) {
+        return index;
+    }
+
+    uint32_t shift = index / SUB_BUCKETS - 1;
+    uint64_t lowest_value = (uint64_t) (SUB_BUCKETS + index % SUB_BUCKETS) << shift;
+
+    return (uint32_t) (lowest_value + ((uint64_t) 1 << shift) - 1);
+}
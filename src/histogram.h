@@ -0,0 +1,58 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// A fixed-size histogram for latencies (or any other unsigned 32-bit values). Buckets are
+/// log-linear (like HdrHistogram): Every power of two is split into `Histogram::SUB_BUCKETS`
+/// linear buckets, which bounds the relative error of all reported values to
+/// 1 / `Histogram::SUB_BUCKETS` (6.25%) while only requiring 2 KiB of memory. Values smaller
+/// than `Histogram::SUB_BUCKETS` are stored exactly.
+class Histogram {
+  public:
+    static const uint32_t SUB_BUCKET_BITS = 4;
+    static const uint32_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static const size_t NUM_BUCKETS = (32 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    Histogram();
+
+    /// Records a single value.
+    void record(uint32_t value);
+
+    /// Removes all recorded values (starts a new window).
+    void reset();
+
+    /// Returns the number of recorded values.
+    uint64_t count() const;
+
+    /// Returns the smallest recorded value or 0 if the histogram is empty.
+    uint32_t min() const;
+
+    /// Returns the largest recorded value or 0 if the histogram is empty.
+    uint32_t max() const;
+
+    /// Returns the mean of all recorded values or 0 if the histogram is empty.
+    float mean() const;
+
+    /// Returns the value below or at which `percentile` percent of the recorded values lie
+    /// (e.g. `percentile(99.9f)`). The result is the highest value of the bucket the
+    /// percentile falls into (but never larger than `max()`). Returns 0 if the histogram is
+    /// empty.
+    uint32_t percentile(float percentile) const;
+
+    /// Returns the index of the bucket `value` is counted in.
+    static size_t bucket_index(uint32_t value);
+
+    /// Returns the highest value that is counted in the bucket at `index`.
+    static uint32_t bucket_highest_value(size_t index);
+
+  private:
+    uint32_t buckets[NUM_BUCKETS];
+    uint64_t count_;
+    uint64_t sum;
+    uint32_t min_;
+    uint32_t max_;
+};
+
+#endif
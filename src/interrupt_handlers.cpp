@@ -12,7 +12,11 @@ extern "C" void SysTick_Handler() {
 }
 
 extern "C" void DMA2_Stream1_IRQHandler() {
-    HAL_DMA_IRQHandler(&DMA2_STREAM1);
+    handle_bus_dma_interrupt(0);
+}
+
+extern "C" void USART6_IRQHandler() {
+    handle_bus_uart_interrupt(0);
 }
 
 extern "C" void I2C3_EV_IRQHandler() {
@@ -0,0 +1,150 @@
+#include "log.h"
+
+#include <iomanip>
+#include <sstream>
+
+BusStats::BusStats() :
+    num_bytes(0),
+    num_packets(0),
+    num_errors(0),
+    num_skipped_segments(0),
+    num_overwritten_segments(0) {}
+
+LogStats::LogStats() : num_yields(0) {}
+
+void LogStats::reset() {
+    this->buf_processing_times.reset();
+    this->times_between_buf_processing.reset();
+    this->packet_processing_times.reset();
+    this->lock_wait_times.reset();
+    this->receive_headroom.reset();
+    this->num_yields = 0;
+
+    for (auto& bus : this->buses) {
+        bus = BusStats();
+    }
+}
+
+Log::Log(size_t num_buses) :
+    num_buses_(num_buses),
+    next_sequence(0),
+    is_reset_requested(false),
+    is_stats_requested(false),
+    is_stats_published(false) {}
+
+void Log::log(Record record) {
+    // the sequence number is used up even if the record is dropped to reveal the gap
+    record.sequence_ = this->next_sequence++;
+    this->records.push(record);
+
+    if (record.error_type != ErrorType::Receive) {
+        this->stats.buses[record.bus].num_errors++;
+    }
+}
+
+void Log::bus_processed(size_t bus, uint32_t num_bytes, uint32_t num_packets) {
+    this->stats.buses[bus].num_bytes += num_bytes;
+    this->stats.buses[bus].num_packets += num_packets;
+}
+
+void Log::buf_processing_time(uint32_t time) {
+    this->stats.buf_processing_times.record(time);
+}
+
+void Log::time_between_buf_processing(uint32_t time) {
+    this->stats.times_between_buf_processing.record(time);
+}
+
+void Log::packet_processing_time(uint32_t time) {
+    this->stats.packet_processing_times.record(time);
+}
+
+void Log::lock_wait_time(uint32_t time) {
+    this->stats.lock_wait_times.record(time);
+}
+
+void Log::yielded() {
+    this->stats.num_yields++;
+}
+
+void Log::receive_check(size_t bus, const ReceiveCheck& check) {
+    this->stats.receive_headroom.record(check.headroom > 0 ? check.headroom : 0);
+    this->stats.buses[bus].num_skipped_segments += check.num_skipped_segments;
+
+    if (check.result == ReceiveResult::OverwrittenSegment) {
+        this->stats.buses[bus].num_overwritten_segments++;
+    }
+
+    if (check.result != ReceiveResult::Ok) {
+        this->log(Record(check.result, (uint8_t) bus));
+    }
+}
+
+void Log::publish_stats() {
+    if (this->is_reset_requested.exchange(false, std::memory_order_acquire)) {
+        this->stats.reset();
+    }
+
+    // the published copy belongs to the consumer until it has read it
+    if (this->is_stats_requested.load(std::memory_order_acquire)
+        && !this->is_stats_published.load(std::memory_order_acquire)) {
+        this->published_stats = this->stats;
+        this->is_stats_requested.store(false, std::memory_order_relaxed);
+        this->is_stats_published.store(true, std::memory_order_release);
+    }
+}
+
+bool Log::pop(Record* record) {
+    return this->records.pop(record);
+}
+
+void Log::request_stats() {
+    // discard an outdated copy that has not been read
+    this->is_stats_published.store(false, std::memory_order_release);
+    this->is_stats_requested.store(true, std::memory_order_release);
+}
+
+bool Log::read_stats(LogStats* stats) {
+    if (!this->is_stats_published.load(std::memory_order_acquire)) {
+        return false;
+    }
+
+    *stats = this->published_stats;
+    this->is_stats_published.store(false, std::memory_order_release);
+    return true;
+}
+
+void Log::reset_stats() {
+    this->is_reset_requested.store(true, std::memory_order_release);
+}
+
+std::string to_string(const Log::Record& record) {
+    auto micros = record.timestamp / Clock::TICKS_PER_US;
+    auto minutes = micros / (60 * 1000 * 1000);
+    auto remaining_micros = micros % (60 * 1000 * 1000);
+    auto seconds = remaining_micros / (1000 * 1000);
+    remaining_micros = remaining_micros % (1000 * 1000);
+
+    std::stringstream fmt;
+    fmt << "[+" << std::setfill('0') << std::setw(2) << minutes << ":" << std::setfill('0')
+        << std::setw(2) << seconds << "." << std::setfill('0') << std::setw(6)
+        << remaining_micros << "] error: ";
+
+    switch (record.error_type) {
+        case Log::ErrorType::Parser: {
+            fmt << to_string(record.parse_error);
+            break;
+        }
+        case Log::ErrorType::Protocol: {
+            fmt << to_string(record.protocol_error);
+            break;
+        }
+        case Log::ErrorType::Receive: {
+            fmt << to_string(record.receive_error);
+            break;
+        }
+    }
+
+    fmt << " (bus " << (unsigned) record.bus << ")";
+    return fmt.str();
+}
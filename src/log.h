@@ -0,0 +1,202 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include "clock.h"
+#include "control_table.h"
+#include "histogram.h"
+#include "parser.h"
+#include "receive_buf.h"
+#include "spsc_ring.h"
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <type_traits>
+
+/// The number of records that can be buffered until the consumer reads them.
+const size_t LOG_RING_LEN = 64;
+
+/// The counters collected for every bus.
+struct BusStats {
+    BusStats();
+
+    uint64_t num_bytes;
+    uint32_t num_packets;
+
+    /// The number of parser and protocol errors.
+    uint32_t num_errors;
+
+    uint32_t num_skipped_segments;
+    uint32_t num_overwritten_segments;
+};
+
+/// The profiling information collected by `Log`. All times are measured in `Clock` ticks.
+struct LogStats {
+    LogStats();
+
+    /// Resets all histograms and counters.
+    void reset();
+
+    Histogram buf_processing_times;
+    Histogram times_between_buf_processing;
+    Histogram packet_processing_times;
+    Histogram lock_wait_times;
+
+    /// The headroom left after processing each receive buffer segment (negative headroom is
+    /// counted as 0). See `ReceiveCheck::headroom`.
+    Histogram receive_headroom;
+
+    /// The number of times the packet task yielded to the UI because its processing budget
+    /// was used up (see `ProcessingBudget`).
+    uint32_t num_yields;
+
+    /// Indexed by bus, see `Log::num_buses` for the number of buses in use.
+    BusStats buses[MAX_NUM_BUSES];
+};
+
+/// Stores errors and profiling information. The log is shared by two tasks without any
+/// locks: The producer (the packet task) logs records and times, the consumer (the UI)
+/// reads them at its own pace. Errors are not converted to strings to save time while in the
+/// packet processing task.
+///
+/// Records are passed through a ring buffer. If the consumer does not keep up, new records
+/// are dropped, which can be detected through gaps in the records' sequence numbers.
+/// The profiling information is owned by the producer, the consumer has to request a copy
+/// of it (see `Log::request_stats`).
+class Log {
+  public:
+    enum class ErrorType : uint8_t {
+        Parser,
+        Protocol,
+        Receive,
+    };
+
+    class Record {
+      public:
+        Record() :
+            timestamp(0),
+            sequence_(0),
+            error_type(ErrorType::Parser),
+            bus(0),
+            parse_error(ParseResult::PacketAvailable) {}
+
+        Record(ParseResult parse_error, uint8_t bus = 0) :
+            timestamp(Clock::now()),
+            sequence_(0),
+            error_type(ErrorType::Parser),
+            bus(bus),
+            parse_error(parse_error) {}
+
+        Record(ProtocolResult protocol_error, uint8_t bus = 0) :
+            timestamp(Clock::now()),
+            sequence_(0),
+            error_type(ErrorType::Protocol),
+            bus(bus),
+            protocol_error(protocol_error) {}
+
+        Record(ReceiveResult receive_error, uint8_t bus = 0) :
+            timestamp(Clock::now()),
+            sequence_(0),
+            error_type(ErrorType::Receive),
+            bus(bus),
+            receive_error(receive_error) {}
+
+        /// Returns the sequence number assigned when the record was logged. Sequence numbers
+        /// are consecutive, so a gap means that records have been dropped.
+        uint32_t sequence() const {
+            return this->sequence_;
+        }
+
+        friend class Log;
+
+        friend std::string to_string(const Record&);
+
+      private:
+        Clock::Timestamp timestamp;
+        uint32_t sequence_;
+        ErrorType error_type;
+        uint8_t bus;
+        union {
+            ParseResult parse_error;
+            ProtocolResult protocol_error;
+            ReceiveResult receive_error;
+        };
+    };
+
+    /// Creates a log for `num_buses` buses (at most `MAX_NUM_BUSES`).
+    explicit Log(size_t num_buses = 1);
+
+    Log(const Log&) = delete;
+
+    Log& operator=(const Log&) = delete;
+
+    /// Returns the number of buses. Can be called by both sides.
+    size_t num_buses() const {
+        return this->num_buses_;
+    }
+
+    /// Logs a new record. The record is dropped if the ring buffer is full. Parser and
+    /// protocol errors are counted for the record's bus. Producer only.
+    void log(Record record);
+
+    /// Logs the number of bytes and packets processed on `bus`. Producer only.
+    void bus_processed(size_t bus, uint32_t num_bytes, uint32_t num_packets);
+
+    /// Logs the time spent processing the last buffer. Producer only.
+    void buf_processing_time(uint32_t time);
+
+    /// Logs the time between the last two points in time where a buffer could be
+    /// processed. Producer only.
+    void time_between_buf_processing(uint32_t time);
+
+    /// Logs the time spent parsing and queueing a single packet. Producer only.
+    void packet_processing_time(uint32_t time);
+
+    /// Logs the time the apply task had to wait for the control table lock (passed on by
+    /// `ApplyStage::drain`). Producer only.
+    void lock_wait_time(uint32_t time);
+
+    /// Logs that the packet task yielded to the UI. Producer only.
+    void yielded();
+
+    /// Logs the result of checking a receive buffer segment of `bus` for overruns. Also logs a
+    /// record if the check failed. Producer only.
+    void receive_check(size_t bus, const ReceiveCheck& check);
+
+    /// Handles pending requests of the consumer (resetting or copying the profiling
+    /// information). Must be called regularly by the producer.
+    void publish_stats();
+
+    /// Removes the oldest record from the log and stores it in `record`. Returns `false` if
+    /// there are no records. Consumer only.
+    bool pop(Record* record);
+
+    /// Asks the producer to copy the profiling information on its next call to
+    /// `publish_stats`. Consumer only.
+    void request_stats();
+
+    /// Stores the copy of the profiling information in `stats` if the producer has published
+    /// one since the last call to `request_stats`. Returns `false` otherwise. Consumer only.
+    bool read_stats(LogStats* stats);
+
+    /// Asks the producer to reset the profiling information on its next call to
+    /// `publish_stats`. Consumer only.
+    void reset_stats();
+
+  private:
+    size_t num_buses_;
+    SpscRing<Record, LOG_RING_LEN> records;
+    uint32_t next_sequence;
+    LogStats stats;
+    LogStats published_stats;
+    std::atomic<bool> is_reset_requested;
+    std::atomic<bool> is_stats_requested;
+    std::atomic<bool> is_stats_published;
+};
+
+static_assert(std::is_trivially_copyable<Log::Record>::value, "");
+
+std::string to_string(const Log::Record& record);
+
+#endif
@@ -1,5 +1,9 @@
 #include "main.h"
 #include "app.h"
+#include "clock.h"
+#include "packet_queue.h"
+#include "trace.h"
+#include "wake_policy.h"
 
 #include <FreeRTOS.h>
 #include <task.h>
@@ -14,10 +18,83 @@
 
 LTDC_HandleTypeDef LCD_CONTROLLER;
 I2C_HandleTypeDef I2C_BUS3;
-DMA_HandleTypeDef DMA2_STREAM1;
 TIM_HandleTypeDef TIMER2;
 TIM_HandleTypeDef TIMER3;
 
+/// A GPIO pin.
+struct Pin {
+    GPIO_TypeDef* port;
+    uint32_t pin;
+
+    /// The pull resistor of the pin (e.g. `GPIO_PULLUP`).
+    uint32_t pull;
+};
+
+/// The configuration of a bus that is captured. To capture another bus, add an entry to
+/// `BUS_CONFIGS` and forward the interrupts of its UART and DMA stream to
+/// `handle_bus_uart_interrupt` and `handle_bus_dma_interrupt` (see interrupt_handlers.cpp).
+struct BusConfig {
+    USART_TypeDef* uart;
+    void (*enable_uart_clock)();
+    IRQn_Type uart_irq;
+    uint32_t baudrate;
+
+    /// The rx/tx pins of the UART, all on `pin_port`.
+    GPIO_TypeDef* pin_port;
+    uint32_t pins;
+    uint8_t pin_alternate;
+
+    /// The enable pins of the RS-485 transceiver, which are held low (`port` is `nullptr`
+    /// if unused).
+    Pin transceiver_pins[2];
+
+    DMA_Stream_TypeDef* dma_stream;
+    uint32_t dma_channel;
+    IRQn_Type dma_irq;
+};
+
+static const BusConfig BUS_CONFIGS[] = {
+    // uart rx/tx on D0/D1, transceiver data and receive enable on D2/D3
+    BusConfig{
+        USART6,
+        [] { __HAL_RCC_USART6_CLK_ENABLE(); },
+        USART6_IRQn,
+        UART_BAUDRATE,
+        GPIOC,
+        GPIO_PIN_7 | GPIO_PIN_6,
+        GPIO_AF8_USART6,
+        {Pin{GPIOG, GPIO_PIN_6, GPIO_PULLUP}, Pin{GPIOB, GPIO_PIN_4, GPIO_NOPULL}},
+        DMA2_Stream1,
+        DMA_CHANNEL_5,
+        DMA2_Stream1_IRQn,
+    },
+};
+
+static const size_t NUM_BUSES = sizeof(BUS_CONFIGS) / sizeof(BusConfig);
+static_assert(NUM_BUSES <= MAX_NUM_BUSES, "");
+
+/// The receive buffer of every bus is a ring of `RECEIVE_NUM_SEGMENTS` segments. Smaller
+/// segments allow handing over data in smaller chunks at light load (see `WakePolicy`).
+const size_t RECEIVE_NUM_SEGMENTS = 32;
+const size_t RECEIVE_SEGMENT_LEN = 256;
+const size_t RECEIVE_BUF_LEN = RECEIVE_NUM_SEGMENTS * RECEIVE_SEGMENT_LEN;
+static_assert(RECEIVE_NUM_SEGMENTS % 2 == 0, "");
+static_assert((RECEIVE_BUF_LEN & (RECEIVE_BUF_LEN - 1)) == 0, "");
+
+// A pass of the packet task processes at most a whole receive buffer of every bus and the
+// apply task empties the packet queue while the packet task sleeps, so the queue must hold
+// the packets of a pass, whatever their lengths.
+static_assert(
+    NUM_BUSES * PacketQueue::num_entries_for(RECEIVE_BUF_LEN) <= PacketQueue::NUM_ENTRIES,
+    "");
+static_assert(
+    NUM_BUSES * PacketQueue::arena_len_for(RECEIVE_BUF_LEN) + PacketQueue::MAX_ARENA_SKIP_LEN
+        <= PacketQueue::ARENA_LEN,
+    "");
+
+static DMA_HandleTypeDef BUS_DMAS[NUM_BUSES];
+static UART_HandleTypeDef BUS_UARTS[NUM_BUSES];
+
 static void init_mpu();
 static void init_clocks();
 static void init_tick_timer();
@@ -25,33 +102,34 @@ static void init_lcd_controller();
 static void reset_lcd_controller();
 static void init_touch_controller();
 static void init_sdram();
-static void init_uarts(std::vector<ReceiveBuf*>&);
+static void init_buses(std::vector<ReceiveChannel>&);
 static void init_gui();
 
 int main() {
-    static std::vector<ReceiveBuf*> bufs;
+    static std::vector<ReceiveChannel> channels;
 
     if (HAL_Init() != HAL_OK) {
         on_error();
     }
 
     init_clocks();
+    Clock::init();
     init_mpu();
     init_tick_timer();
     init_sdram();
-    init_uarts(bufs);
+    init_buses(channels);
     init_lcd_controller();
     init_touch_controller();
     init_gui();
 
     xTaskCreate(
         [](void* arg) {
-            auto bufs = (std::vector<ReceiveBuf*>*) arg;
-            run(*bufs);
+            auto channels = (std::vector<ReceiveChannel>*) arg;
+            run(*channels);
         },
         "main",
         TASK_STACK_SIZE,
-        &bufs,
+        &channels,
         6,
         nullptr);
 
@@ -549,106 +627,167 @@ static void init_sdram() {
     }
 }
 
-static void init_uarts(std::vector<ReceiveBuf*>& bufs) {
-    // init dma stream
-    __HAL_RCC_DMA2_CLK_ENABLE();
-    HAL_NVIC_SetPriority(DMA2_Stream1_IRQn, 1, 0);
-    HAL_NVIC_EnableIRQ(DMA2_Stream1_IRQn);
-
-    DMA2_STREAM1.Instance = DMA2_Stream1;
-    DMA2_STREAM1.Init.Channel = DMA_CHANNEL_5;
-    DMA2_STREAM1.Init.Direction = DMA_PERIPH_TO_MEMORY;
-    DMA2_STREAM1.Init.PeriphInc = DMA_PINC_DISABLE;
-    DMA2_STREAM1.Init.MemInc = DMA_MINC_ENABLE;
-    DMA2_STREAM1.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
-    DMA2_STREAM1.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
-    DMA2_STREAM1.Init.Mode = DMA_CIRCULAR;
-    DMA2_STREAM1.Init.Priority = DMA_PRIORITY_VERY_HIGH;
-    DMA2_STREAM1.Init.FIFOMode = DMA_FIFOMODE_ENABLE;
-    DMA2_STREAM1.Init.FIFOThreshold = DMA_FIFO_THRESHOLD_HALFFULL;
-    DMA2_STREAM1.Init.MemBurst = DMA_MBURST_INC8;
-    DMA2_STREAM1.Init.PeriphBurst = DMA_PBURST_SINGLE;
-
-    if (HAL_DMA_Init(&DMA2_STREAM1) != HAL_OK) {
+static void enable_gpio_clock(GPIO_TypeDef* port) {
+    if (port == GPIOA) {
+        __HAL_RCC_GPIOA_CLK_ENABLE();
+    } else if (port == GPIOB) {
+        __HAL_RCC_GPIOB_CLK_ENABLE();
+    } else if (port == GPIOC) {
+        __HAL_RCC_GPIOC_CLK_ENABLE();
+    } else if (port == GPIOD) {
+        __HAL_RCC_GPIOD_CLK_ENABLE();
+    } else if (port == GPIOE) {
+        __HAL_RCC_GPIOE_CLK_ENABLE();
+    } else if (port == GPIOF) {
+        __HAL_RCC_GPIOF_CLK_ENABLE();
+    } else if (port == GPIOG) {
+        __HAL_RCC_GPIOG_CLK_ENABLE();
+    } else {
         on_error();
     }
+}
 
-    // init uart
-    __HAL_RCC_USART6_CLK_ENABLE();
-    __HAL_RCC_GPIOB_CLK_ENABLE();
-    __HAL_RCC_GPIOC_CLK_ENABLE();
-    __HAL_RCC_GPIOG_CLK_ENABLE();
+static size_t bus_for_dma(DMA_HandleTypeDef* dma) {
+    return dma - BUS_DMAS;
+}
 
-    // uart rx/tx (D0/D1)
-    GPIO_InitTypeDef gpio_config;
-    gpio_config.Pin = GPIO_PIN_7 | GPIO_PIN_6;
-    gpio_config.Mode = GPIO_MODE_AF_PP;
-    gpio_config.Pull = GPIO_NOPULL;
-    gpio_config.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
-    gpio_config.Alternate = GPIO_AF8_USART6;
-    HAL_GPIO_Init(GPIOC, &gpio_config);
+static void init_buses(std::vector<ReceiveChannel>& channels) {
+    // every bus needs its own receive buffer (in the fast DTCM)
+    static volatile uint8_t buf_bytes[NUM_BUSES][RECEIVE_BUF_LEN]
+        __attribute__((section(".dtcm_data")));
+    static ReceiveBuf* bufs[NUM_BUSES];
 
-    // data and receive enable for rs485 transceiver (D2/D3)
-    // we're only receiving, so they can simply stay low
-    gpio_config.Pin = GPIO_PIN_6;
-    gpio_config.Mode = GPIO_MODE_OUTPUT_PP;
-    gpio_config.Pull = GPIO_PULLUP;
-    gpio_config.Speed = GPIO_SPEED_FREQ_LOW;
-    HAL_GPIO_Init(GPIOG, &gpio_config);
-    HAL_GPIO_WritePin(GPIOG, GPIO_PIN_6, GPIO_PIN_RESET);
+    __HAL_RCC_DMA1_CLK_ENABLE();
+    __HAL_RCC_DMA2_CLK_ENABLE();
 
-    gpio_config.Pin = GPIO_PIN_4;
-    gpio_config.Mode = GPIO_MODE_OUTPUT_PP;
-    gpio_config.Pull = GPIO_NOPULL;
-    gpio_config.Speed = GPIO_SPEED_FREQ_LOW;
-    HAL_GPIO_Init(GPIOB, &gpio_config);
-    HAL_GPIO_WritePin(GPIOB, GPIO_PIN_4, GPIO_PIN_RESET);
-
-    static UART_HandleTypeDef uart;
-    uart.Instance = USART6;
-    uart.Init.BaudRate = UART_BAUDRATE;
-    uart.Init.WordLength = UART_WORDLENGTH_8B;
-    uart.Init.StopBits = UART_STOPBITS_1;
-    uart.Init.Parity = UART_PARITY_NONE;
-    uart.Init.Mode = UART_MODE_RX;
-    uart.Init.HwFlowCtl = UART_HWCONTROL_NONE;
-    uart.Init.OverSampling = UART_OVERSAMPLING_16;
-    uart.Init.OneBitSampling = UART_ONE_BIT_SAMPLE_DISABLE;
-    uart.AdvancedInit.AdvFeatureInit = UART_ADVFEATURE_NO_INIT;
-
-    uart.hdmarx = &DMA2_STREAM1;
-    DMA2_STREAM1.Parent = &uart;
-
-    if (HAL_UART_Init(&uart) != HAL_OK) {
-        on_error();
+    for (size_t bus = 0; bus < NUM_BUSES; bus++) {
+        auto& config = BUS_CONFIGS[bus];
+        auto& dma = BUS_DMAS[bus];
+        auto& uart = BUS_UARTS[bus];
+
+        // init dma stream (the callbacks notify the packet task, so the priority must not be
+        // higher than configMAX_SYSCALL_INTERRUPT_PRIORITY)
+        HAL_NVIC_SetPriority(config.dma_irq, 5, 0);
+        HAL_NVIC_EnableIRQ(config.dma_irq);
+
+        dma.Instance = config.dma_stream;
+        dma.Init.Channel = config.dma_channel;
+        dma.Init.Direction = DMA_PERIPH_TO_MEMORY;
+        dma.Init.PeriphInc = DMA_PINC_DISABLE;
+        dma.Init.MemInc = DMA_MINC_ENABLE;
+        dma.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+        dma.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+        dma.Init.Mode = DMA_CIRCULAR;
+        dma.Init.Priority = DMA_PRIORITY_VERY_HIGH;
+        dma.Init.FIFOMode = DMA_FIFOMODE_ENABLE;
+        dma.Init.FIFOThreshold = DMA_FIFO_THRESHOLD_HALFFULL;
+        dma.Init.MemBurst = DMA_MBURST_INC8;
+        dma.Init.PeriphBurst = DMA_PBURST_SINGLE;
+
+        if (HAL_DMA_Init(&dma) != HAL_OK) {
+            on_error();
+        }
+
+        // init uart
+        config.enable_uart_clock();
+        enable_gpio_clock(config.pin_port);
+
+        GPIO_InitTypeDef gpio_config;
+        gpio_config.Pin = config.pins;
+        gpio_config.Mode = GPIO_MODE_AF_PP;
+        gpio_config.Pull = GPIO_NOPULL;
+        gpio_config.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
+        gpio_config.Alternate = config.pin_alternate;
+        HAL_GPIO_Init(config.pin_port, &gpio_config);
+
+        // we're only receiving, so the transceiver's enable pins can simply stay low
+        for (auto& enable_pin : config.transceiver_pins) {
+            if (enable_pin.port == nullptr) {
+                continue;
+            }
+
+            enable_gpio_clock(enable_pin.port);
+            gpio_config.Pin = enable_pin.pin;
+            gpio_config.Mode = GPIO_MODE_OUTPUT_PP;
+            gpio_config.Pull = enable_pin.pull;
+            gpio_config.Speed = GPIO_SPEED_FREQ_LOW;
+            HAL_GPIO_Init(enable_pin.port, &gpio_config);
+            HAL_GPIO_WritePin(enable_pin.port, enable_pin.pin, GPIO_PIN_RESET);
+        }
+
+        uart.Instance = config.uart;
+        uart.Init.BaudRate = config.baudrate;
+        uart.Init.WordLength = UART_WORDLENGTH_8B;
+        uart.Init.StopBits = UART_STOPBITS_1;
+        uart.Init.Parity = UART_PARITY_NONE;
+        uart.Init.Mode = UART_MODE_RX;
+        uart.Init.HwFlowCtl = UART_HWCONTROL_NONE;
+        uart.Init.OverSampling = UART_OVERSAMPLING_16;
+        uart.Init.OneBitSampling = UART_ONE_BIT_SAMPLE_DISABLE;
+        uart.AdvancedInit.AdvFeatureInit = UART_ADVFEATURE_NO_INIT;
+
+        uart.hdmarx = &dma;
+        dma.Parent = &uart;
+
+        if (HAL_UART_Init(&uart) != HAL_OK) {
+            on_error();
+        }
+
+        // setup buffer/callbacks and start transfer
+        bufs[bus] = new ReceiveBuf(
+            buf_bytes[bus],
+            RECEIVE_NUM_SEGMENTS,
+            RECEIVE_SEGMENT_LEN,
+            &config.dma_stream->NDTR);
+
+        HAL_DMA_RegisterCallback(&dma, HAL_DMA_XFER_HALFCPLT_CB_ID, [](auto dma) {
+            auto bus = bus_for_dma(dma);
+            bufs[bus]->complete_half(ReceiveBuf::Half::Front);
+            TRACE(Interrupt, BufferHandover, 2 * bus, bufs[bus]->num_completed_halves);
+            notify_packet_task_from_isr(WAKE_HALF_COMPLETE);
+        });
+
+        HAL_DMA_RegisterCallback(&dma, HAL_DMA_XFER_CPLT_CB_ID, [](auto dma) {
+            auto bus = bus_for_dma(dma);
+            bufs[bus]->complete_half(ReceiveBuf::Half::Back);
+            TRACE(Interrupt, BufferHandover, 2 * bus + 1, bufs[bus]->num_completed_halves);
+            notify_packet_task_from_isr(WAKE_HALF_COMPLETE);
+        });
+
+        HAL_DMA_RegisterCallback(&dma, HAL_DMA_XFER_ERROR_CB_ID, [](auto) { on_error(); });
+
+        auto src_addr = (uint32_t) &uart.Instance->RDR;
+        auto dst_addr = (uint32_t) buf_bytes[bus];
+
+        if (HAL_DMA_Start_IT(&dma, src_addr, dst_addr, RECEIVE_BUF_LEN) != HAL_OK) {
+            on_error();
+        }
+
+        // enable idle line interrupt, which wakes the packet task after the end of a packet
+        uart.Instance->ICR = USART_ICR_IDLECF;
+        uart.Instance->CR1 |= USART_CR1_IDLEIE;
+        HAL_NVIC_SetPriority(config.uart_irq, 5, 0);
+        HAL_NVIC_EnableIRQ(config.uart_irq);
+
+        // set DMA as receiver
+        uart.Instance->CR3 |= USART_CR3_DMAR;
+
+        channels.push_back(ReceiveChannel{bufs[bus], config.baudrate});
     }
+}
 
-    // setup buffer/callbacks and start transfer
-    static ReceiveBuf buf __attribute__((section(".dtcm_data")));
-
-    HAL_DMA_RegisterCallback(&DMA2_STREAM1, HAL_DMA_XFER_HALFCPLT_CB_ID, [](auto) {
-        buf.ready = ReceiveBuf::Ready::Front;
-    });
-
-    HAL_DMA_RegisterCallback(
-        &DMA2_STREAM1, HAL_DMA_XFER_CPLT_CB_ID, [](auto) { buf.ready = ReceiveBuf::Ready::Back; });
-
-    HAL_DMA_RegisterCallback(&DMA2_STREAM1, HAL_DMA_XFER_ERROR_CB_ID, [](auto) { on_error(); });
+void handle_bus_dma_interrupt(size_t bus) {
+    HAL_DMA_IRQHandler(&BUS_DMAS[bus]);
+}
 
-    auto src_addr = (uint32_t) &uart.Instance->RDR;
-    auto dst_addr = (uint32_t) buf.bytes;
+void handle_bus_uart_interrupt(size_t bus) {
+    auto uart = BUS_UARTS[bus].Instance;
 
-    if (HAL_DMA_Start_IT(&DMA2_STREAM1, src_addr, dst_addr, ReceiveBuf::LEN) != HAL_OK) {
-        on_error();
+    if ((uart->ISR & USART_ISR_IDLE) != 0) {
+        uart->ICR = USART_ICR_IDLECF;
+        TRACE(Interrupt, IdleLine, RECEIVE_BUF_LEN - __HAL_DMA_GET_COUNTER(&BUS_DMAS[bus]), bus);
+        notify_packet_task_from_isr(WAKE_IDLE_LINE);
     }
-
-    // enable rx register not empty interrupt (handled by DMA controller)
-    uart.Instance->CR1 |= USART_CR1_RXNEIE;
-
-    // set DMA as receiver
-    uart.Instance->CR3 |= USART_CR3_DMAR;
-
-    bufs.push_back(&buf);
 }
 
 static void init_gui() {
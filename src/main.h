@@ -18,13 +18,18 @@ const uintptr_t QSPI_START_ADDR = 0x90000000;
 
 extern LTDC_HandleTypeDef LCD_CONTROLLER;
 extern I2C_HandleTypeDef I2C_BUS3;
-extern DMA_HandleTypeDef DMA2_STREAM1;
 extern TIM_HandleTypeDef TIMER2;
 extern TIM_HandleTypeDef TIMER3;
 
 /// Polls the touch controller and updates emWin's input queue.
 void poll_touch_state();
 
+/// Handles the interrupt of the DMA stream that receives the data of `bus`.
+void handle_bus_dma_interrupt(size_t bus);
+
+/// Handles the interrupt of the UART of `bus`.
+void handle_bus_uart_interrupt(size_t bus);
+
 /// Enters an infinite loop (technically undefined behaviour). The function
 /// will not be inlined to preserve the stacktrace. Call this function when an
 /// unrecoverable error occurs.
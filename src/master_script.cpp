@@ -0,0 +1,447 @@
+#include "master_script.h"
+#include "packet_encoder.h"
+
+#include <stdlib.h>
+
+const size_t MasterScript::UNKNOWN_NUM_RESPONSES;
+
+/// The longest packet the length field allows: the header, id and length followed by 65535
+/// bytes.
+static const size_t MAX_ENCODED_PACKET_LEN = 7 + UINT16_MAX;
+
+/// Parses an unsigned number (decimal or hexadecimal with `0x`) of at most `max`. Returns
+/// `false` if `str` is not such a number.
+static bool parse_number(const std::string& str, uint32_t max, uint32_t* value) {
+    char* end;
+    auto number = strtoull(str.c_str(), &end, 0);
+    *value = (uint32_t) number;
+    return !str.empty() && str[0] != '-' && *end == '\0' && number <= max;
+}
+
+static bool parse_device_id(const std::string& str, DeviceId* device_id) {
+    uint32_t id;
+
+    if (!parse_number(str, DeviceId::broadcast().to_byte(), &id)) {
+        return false;
+    }
+
+    *device_id = DeviceId((uint8_t) id);
+    return true;
+}
+
+static bool parse_uint16(const std::string& str, uint16_t* value) {
+    uint32_t number;
+
+    if (!parse_number(str, UINT16_MAX, &number)) {
+        return false;
+    }
+
+    *value = (uint16_t) number;
+    return true;
+}
+
+/// Appends a value of `len` bytes (1, 2 or 4) to `data`, least significant byte first.
+static bool append_value(const std::string& str, uint16_t len, std::vector<uint8_t>* data) {
+    if (len != 1 && len != 2 && len != 4) {
+        return false;
+    }
+
+    uint32_t value;
+
+    if (!parse_number(str, len == 4 ? UINT32_MAX : (1u << (8 * len)) - 1, &value)) {
+        return false;
+    }
+
+    for (uint16_t i = 0; i < len; i++) {
+        data->push_back((uint8_t) (value >> (8 * i)));
+    }
+
+    return true;
+}
+
+/// Splits `str` at every `separator`.
+static std::vector<std::string> split(const std::string& str, char separator) {
+    std::vector<std::string> parts;
+    size_t start = 0;
+
+    while (true) {
+        auto end = str.find(separator, start);
+
+        if (end == std::string::npos) {
+            parts.push_back(str.substr(start));
+            return parts;
+        }
+
+        parts.push_back(str.substr(start, end - start));
+        start = end + 1;
+    }
+}
+
+/// Splits a line into words, without the comment at its end.
+static std::vector<std::string> split_words(const std::string& line) {
+    std::vector<std::string> words;
+    auto end = line.find('#');
+    std::string word;
+
+    for (size_t i = 0; i < line.size() && i < end; i++) {
+        if (line[i] == ' ' || line[i] == '\t' || line[i] == '\r') {
+            if (!word.empty()) {
+                words.push_back(word);
+                word.clear();
+            }
+        } else {
+            word.push_back(line[i]);
+        }
+    }
+
+    if (!word.empty()) {
+        words.push_back(word);
+    }
+
+    return words;
+}
+
+/// Parses a read like `1:132:4`.
+static bool parse_read(const std::string& str, ReadArgs* read) {
+    auto parts = split(str, ':');
+    return parts.size() == 3 && parse_device_id(parts[0], &read->device_id)
+        && parse_uint16(parts[1], &read->start_addr) && parse_uint16(parts[2], &read->len);
+}
+
+/// Parses a write like `1:116:4=2048`.
+static bool parse_write(const std::string& str, WriteArgs* write) {
+    auto value_pos = str.find('=');
+    ReadArgs read{DeviceId(0), 0, 0};
+
+    if (value_pos == std::string::npos || !parse_read(str.substr(0, value_pos), &read)) {
+        return false;
+    }
+
+    write->device_id = read.device_id;
+    write->start_addr = read.start_addr;
+    return append_value(str.substr(value_pos + 1), read.len, &write->data);
+}
+
+/// Returns the syntax of an instruction's line, for error messages.
+static const char* usage(Instruction instruction) {
+    switch (instruction) {
+        case Instruction::Ping: {
+            return "Ping <id>";
+        }
+        case Instruction::Read: {
+            return "Read <id> <addr> <len>";
+        }
+        case Instruction::Write: {
+            return "Write <id> <addr> <len> <value>";
+        }
+        case Instruction::RegWrite: {
+            return "RegWrite <id> <addr> <len> <value>";
+        }
+        case Instruction::Action: {
+            return "Action <id>";
+        }
+        case Instruction::FactoryReset: {
+            return "FactoryReset <id> <0xff, 0x01 or 0x02>";
+        }
+        case Instruction::Reboot: {
+            return "Reboot <id>";
+        }
+        case Instruction::Clear: {
+            return "Clear <id>";
+        }
+        case Instruction::SyncRead: {
+            return "SyncRead <addr> <len> <id>...";
+        }
+        case Instruction::SyncWrite: {
+            return "SyncWrite <addr> <len> <id>=<value>...";
+        }
+        case Instruction::BulkRead: {
+            return "BulkRead <id>:<addr>:<len>...";
+        }
+        case Instruction::BulkWrite: {
+            return "BulkWrite <id>:<addr>:<len>=<value>...";
+        }
+        case Instruction::FastSyncRead: {
+            return "FastSyncRead <addr> <len> <id>...";
+        }
+        case Instruction::FastBulkRead: {
+            return "FastBulkRead <id>:<addr>:<len>...";
+        }
+        default: { return "an instruction"; }
+    }
+}
+
+/// Parses the words of a line into `packet`. Returns `false` if they do not match the
+/// instruction's syntax.
+static bool parse_packet(
+    Instruction instruction,
+    const std::vector<std::string>& words,
+    InstructionPacket* packet) {
+    DeviceId device_id(0);
+
+    switch (instruction) {
+        case Instruction::Ping:
+        case Instruction::Action:
+        case Instruction::Reboot:
+        case Instruction::Clear: {
+            if (words.size() != 2 || !parse_device_id(words[1], &device_id)) {
+                return false;
+            }
+
+            if (instruction == Instruction::Ping) {
+                *packet = InstructionPacket(PingArgs{device_id});
+            } else if (instruction == Instruction::Action) {
+                *packet = InstructionPacket(ActionArgs{device_id});
+            } else if (instruction == Instruction::Reboot) {
+                *packet = InstructionPacket(RebootArgs{device_id});
+            } else {
+                *packet = InstructionPacket(ClearArgs{device_id});
+            }
+
+            return true;
+        }
+        case Instruction::Read: {
+            ReadArgs read{DeviceId(0), 0, 0};
+
+            if (words.size() != 4 || !parse_device_id(words[1], &read.device_id)
+                || !parse_uint16(words[2], &read.start_addr)
+                || !parse_uint16(words[3], &read.len)) {
+                return false;
+            }
+
+            *packet = InstructionPacket(std::move(read));
+            return true;
+        }
+        case Instruction::Write:
+        case Instruction::RegWrite: {
+            WriteArgs write{DeviceId(0), 0, {}};
+            uint16_t len;
+
+            if (words.size() != 5 || !parse_device_id(words[1], &write.device_id)
+                || !parse_uint16(words[2], &write.start_addr) || !parse_uint16(words[3], &len)
+                || !append_value(words[4], len, &write.data)) {
+                return false;
+            }
+
+            if (instruction == Instruction::Write) {
+                *packet = InstructionPacket(std::move(write));
+            } else {
+                *packet = InstructionPacket(
+                    RegWriteArgs{write.device_id, write.start_addr, std::move(write.data)});
+            }
+
+            return true;
+        }
+        case Instruction::FactoryReset: {
+            uint32_t reset;
+
+            if (words.size() != 3 || !parse_device_id(words[1], &device_id)
+                || !parse_number(words[2], UINT8_MAX, &reset)
+                || (reset != (uint32_t) FactoryReset::ResetAll
+                    && reset != (uint32_t) FactoryReset::ResetAllExceptId
+                    && reset != (uint32_t) FactoryReset::ResetAllExceptIdAndBaudRate)) {
+                return false;
+            }
+
+            *packet = InstructionPacket(FactoryResetArgs{device_id, (FactoryReset) reset});
+            return true;
+        }
+        case Instruction::SyncRead:
+        case Instruction::FastSyncRead: {
+            SyncReadArgs args{{}, 0, 0};
+
+            if (words.size() < 4 || !parse_uint16(words[1], &args.start_addr)
+                || !parse_uint16(words[2], &args.len)) {
+                return false;
+            }
+
+            for (size_t i = 3; i < words.size(); i++) {
+                if (!parse_device_id(words[i], &device_id)) {
+                    return false;
+                }
+
+                args.devices.push_back(device_id);
+            }
+
+            if (instruction == Instruction::SyncRead) {
+                *packet = InstructionPacket(std::move(args));
+            } else {
+                *packet = InstructionPacket(
+                    FastSyncReadArgs{std::move(args.devices), args.start_addr, args.len});
+            }
+
+            return true;
+        }
+        case Instruction::SyncWrite: {
+            SyncWriteArgs args{{}, 0, 0, {}};
+
+            if (words.size() < 4 || !parse_uint16(words[1], &args.start_addr)
+                || !parse_uint16(words[2], &args.len)) {
+                return false;
+            }
+
+            for (size_t i = 3; i < words.size(); i++) {
+                auto parts = split(words[i], '=');
+
+                if (parts.size() != 2 || !parse_device_id(parts[0], &device_id)
+                    || !append_value(parts[1], args.len, &args.data)) {
+                    return false;
+                }
+
+                args.devices.push_back(device_id);
+            }
+
+            *packet = InstructionPacket(std::move(args));
+            return true;
+        }
+        case Instruction::BulkRead:
+        case Instruction::FastBulkRead: {
+            std::vector<ReadArgs> reads;
+
+            if (words.size() < 2) {
+                return false;
+            }
+
+            for (size_t i = 1; i < words.size(); i++) {
+                ReadArgs read{DeviceId(0), 0, 0};
+
+                if (!parse_read(words[i], &read)) {
+                    return false;
+                }
+
+                reads.push_back(read);
+            }
+
+            if (instruction == Instruction::BulkRead) {
+                *packet = InstructionPacket(BulkReadArgs{std::move(reads)});
+            } else {
+                *packet = InstructionPacket(FastBulkReadArgs{std::move(reads)});
+            }
+
+            return true;
+        }
+        case Instruction::BulkWrite: {
+            std::vector<WriteArgs> writes;
+
+            if (words.size() < 2) {
+                return false;
+            }
+
+            for (size_t i = 1; i < words.size(); i++) {
+                WriteArgs write{DeviceId(0), 0, {}};
+
+                if (!parse_write(words[i], &write)) {
+                    return false;
+                }
+
+                writes.push_back(std::move(write));
+            }
+
+            *packet = InstructionPacket(BulkWriteArgs{std::move(writes)});
+            return true;
+        }
+        default: { return false; }
+    }
+}
+
+/// Returns the number of status packets that answer `packet` if every device answers every
+/// instruction.
+static size_t num_responses(const InstructionPacket& packet) {
+    // answered by the addressed device, but not by any device for a broadcast
+    auto single_response = [](DeviceId device_id) { return device_id.is_broadcast() ? 0 : 1; };
+
+    switch (packet.instruction) {
+        case Instruction::Ping: {
+            return packet.ping.device_id.is_broadcast() ? MasterScript::UNKNOWN_NUM_RESPONSES : 1;
+        }
+        case Instruction::Read: {
+            return single_response(packet.read.device_id);
+        }
+        case Instruction::Write: {
+            return single_response(packet.write.device_id);
+        }
+        case Instruction::RegWrite: {
+            return single_response(packet.reg_write.device_id);
+        }
+        case Instruction::Action: {
+            return single_response(packet.action.device_id);
+        }
+        case Instruction::FactoryReset: {
+            return single_response(packet.factory_reset.device_id);
+        }
+        case Instruction::Reboot: {
+            return single_response(packet.reboot.device_id);
+        }
+        case Instruction::Clear: {
+            return single_response(packet.clear.device_id);
+        }
+        case Instruction::SyncRead: {
+            return packet.sync_read.devices.size();
+        }
+        case Instruction::BulkRead: {
+            return packet.bulk_read.reads.size();
+        }
+        case Instruction::FastSyncRead: {
+            // all devices answer with a single status packet
+            return packet.fast_sync_read.devices.empty() ? 0 : 1;
+        }
+        case Instruction::FastBulkRead: {
+            return packet.fast_bulk_read.reads.empty() ? 0 : 1;
+        }
+        default: { return 0; }
+    }
+}
+
+bool MasterScript::parse(const std::string& text, std::string* error) {
+    this->steps_.clear();
+    this->buf.clear();
+
+    auto lines = split(text, '\n');
+
+    for (size_t i = 0; i < lines.size(); i++) {
+        auto words = split_words(lines[i]);
+        auto line = std::to_string(i + 1);
+
+        if (words.empty()) {
+            continue;
+        }
+
+        Instruction instruction;
+
+        if (!instruction_from_string(words[0], &instruction)
+            || instruction == Instruction::Status) {
+            *error = "line " + line + ": unknown instruction `" + words[0] + "`";
+            return false;
+        }
+
+        InstructionPacket packet;
+
+        if (!parse_packet(instruction, words, &packet)) {
+            *error = "line " + line + ": expected `" + usage(instruction) + "`";
+            return false;
+        }
+
+        if (!this->add_step(packet, i + 1)) {
+            *error = "line " + line + ": the packet is too long";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool MasterScript::add_step(const InstructionPacket& packet, size_t line) {
+    auto offset = this->buf.size();
+    this->buf.resize(offset + MAX_ENCODED_PACKET_LEN);
+    PacketEncoder encoder(&this->buf[offset], MAX_ENCODED_PACKET_LEN);
+    auto is_ok = encode_instruction_packet(packet, &encoder);
+    this->buf.resize(offset + encoder.len());
+
+    if (!is_ok) {
+        return false;
+    }
+
+    this->steps_.push_back(
+        MasterStep{packet.instruction, line, offset, encoder.len(), num_responses(packet)});
+    return true;
+}
@@ -0,0 +1,79 @@
+#ifndef MASTER_SCRIPT_H
+#define MASTER_SCRIPT_H
+
+#include "parser.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/// An instruction packet of a `MasterScript`.
+struct MasterStep {
+    Instruction instruction;
+
+    /// The line of the script, starting at 1.
+    size_t line;
+
+    /// The encoded packet (see `MasterScript::data`).
+    size_t offset;
+    size_t len;
+
+    /// The number of status packets the master waits for, assuming that every device answers
+    /// every instruction (see `MasterScript::UNKNOWN_NUM_RESPONSES`).
+    size_t num_responses;
+};
+
+/// The instruction packets a master sends in a control cycle, e.g. to drive the devices of a
+/// `DeviceFarm`. A script has one instruction per line, named like the instructions in the
+/// protocol's documentation, followed by its arguments. Values are written as numbers of the
+/// given length (1, 2 or 4 bytes), empty lines and everything after a `#` are ignored:
+///
+///     Ping <id>
+///     Read <id> <addr> <len>
+///     Write <id> <addr> <len> <value>
+///     RegWrite <id> <addr> <len> <value>
+///     Action <id>
+///     FactoryReset <id> <0xff, 0x01 or 0x02>
+///     Reboot <id>
+///     Clear <id>
+///     SyncRead <addr> <len> <id>...
+///     SyncWrite <addr> <len> <id>=<value>...
+///     BulkRead <id>:<addr>:<len>...
+///     BulkWrite <id>:<addr>:<len>=<value>...
+///     FastSyncRead <addr> <len> <id>...
+///     FastBulkRead <id>:<addr>:<len>...
+///
+/// Ids and numbers may be hexadecimal (`0x...`), 254 is the broadcast id.
+class MasterScript {
+  public:
+    /// The `num_responses` of a broadcast ping: the master waits until it times out.
+    static const size_t UNKNOWN_NUM_RESPONSES = SIZE_MAX;
+
+    /// Parses a script and encodes its packets. Returns `false` and sets `error` if a line is
+    /// invalid.
+    bool parse(const std::string& text, std::string* error);
+
+    const std::vector<MasterStep>& steps() const {
+        return this->steps_;
+    }
+
+    /// The encoded packets of all `steps`, one after the other.
+    const uint8_t* data() const {
+        return this->buf.data();
+    }
+
+    /// The number of bytes of all packets.
+    size_t len() const {
+        return this->buf.size();
+    }
+
+  private:
+    /// Encodes a parsed packet and adds it as a step.
+    bool add_step(const InstructionPacket& packet, size_t line);
+
+    std::vector<MasterStep> steps_;
+    std::vector<uint8_t> buf;
+};
+
+#endif
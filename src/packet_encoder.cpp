@@ -0,0 +1,237 @@
+#include "packet_encoder.h"
+#include "endian_convert.h"
+
+/// The header, the device id and the length.
+static const size_t PACKET_PREFIX_LEN = 7;
+
+/// The parameters of a clear instruction that clears the multi-turn information.
+static const uint8_t CLEAR_MULTI_TURN[5] = {0x01, 0x44, 0x58, 0x4c, 0x22};
+
+PacketEncoder::PacketEncoder(uint8_t* buf, size_t buf_len) :
+    buf(buf),
+    buf_len(buf_len),
+    len_(0),
+    pos(0),
+    header_len(0),
+    is_overflow(false) {}
+
+void PacketEncoder::begin(DeviceId device_id, Instruction instruction) {
+    this->begin_packet(device_id);
+    this->add_byte((uint8_t) instruction);
+}
+
+void PacketEncoder::begin_status(DeviceId device_id, Error error) {
+    this->begin_packet(device_id);
+    this->add_byte((uint8_t) Instruction::Status);
+    this->add_byte(error.to_byte());
+}
+
+void PacketEncoder::begin_packet(DeviceId device_id) {
+    // an unfinished packet is discarded
+    this->pos = this->len_;
+    this->header_len = 0;
+    this->is_overflow = this->buf_len - this->pos < PACKET_PREFIX_LEN;
+
+    if (this->is_overflow) {
+        return;
+    }
+
+    auto prefix = &this->buf[this->pos];
+    prefix[0] = 0xff;
+    prefix[1] = 0xff;
+    prefix[2] = 0xfd;
+    prefix[3] = 0x00;
+    prefix[4] = device_id.to_byte();
+    this->pos += PACKET_PREFIX_LEN;
+}
+
+void PacketEncoder::add_data(const uint8_t* data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        this->add_byte(data[i]);
+    }
+}
+
+bool PacketEncoder::end() {
+    auto packet = &this->buf[this->len_];
+    auto packet_len = this->pos - this->len_;
+
+    // the length covers the stuffed payload and the checksum
+    if (this->is_overflow || this->buf_len - this->pos < 2
+        || packet_len - PACKET_PREFIX_LEN + 2 > UINT16_MAX) {
+        this->pos = this->len_;
+        this->is_overflow = false;
+        return false;
+    }
+
+    uint16_to_le(&packet[5], (uint16_t) (packet_len - PACKET_PREFIX_LEN + 2));
+    uint16_to_le(&packet[packet_len], update_crc(0, packet, packet_len));
+    this->pos += 2;
+    this->len_ = this->pos;
+    return true;
+}
+
+/// Starts a (fast) sync read and adds its parameters.
+static void begin_sync_read(
+    Instruction instruction,
+    uint16_t start_addr,
+    uint16_t len,
+    const std::vector<DeviceId>& devices,
+    PacketEncoder* encoder) {
+    encoder->begin(DeviceId::broadcast(), instruction);
+    encoder->add_uint16(start_addr);
+    encoder->add_uint16(len);
+
+    for (auto device_id : devices) {
+        encoder->add_uint8(device_id.to_byte());
+    }
+}
+
+/// Starts a (fast) bulk read and adds its parameters.
+static void begin_bulk_read(
+    Instruction instruction,
+    const std::vector<ReadArgs>& reads,
+    PacketEncoder* encoder) {
+    encoder->begin(DeviceId::broadcast(), instruction);
+
+    for (auto& read : reads) {
+        encoder->add_uint8(read.device_id.to_byte());
+        encoder->add_uint16(read.start_addr);
+        encoder->add_uint16(read.len);
+    }
+}
+
+bool encode_packet(const Packet& packet, PacketEncoder* encoder) {
+    if (packet.data_offset != 0) {
+        return false;
+    }
+
+    if (packet.instruction == Instruction::Status) {
+        encoder->begin_status(packet.device_id, packet.error);
+    } else {
+        encoder->begin(packet.device_id, packet.instruction);
+    }
+
+    encoder->add_data(packet.data.data(), packet.data.size());
+    return encoder->end();
+}
+
+bool encode_instruction_packet(const InstructionPacket& packet, PacketEncoder* encoder) {
+    switch (packet.instruction) {
+        case Instruction::Ping: {
+            encoder->begin(packet.ping.device_id, Instruction::Ping);
+            break;
+        }
+        case Instruction::Read: {
+            auto& args = packet.read;
+            encoder->begin(args.device_id, Instruction::Read);
+            encoder->add_uint16(args.start_addr);
+            encoder->add_uint16(args.len);
+            break;
+        }
+        case Instruction::Write: {
+            auto& args = packet.write;
+            encoder->begin(args.device_id, Instruction::Write);
+            encoder->add_uint16(args.start_addr);
+            encoder->add_data(args.data.data(), args.data.size());
+            break;
+        }
+        case Instruction::RegWrite: {
+            auto& args = packet.reg_write;
+            encoder->begin(args.device_id, Instruction::RegWrite);
+            encoder->add_uint16(args.start_addr);
+            encoder->add_data(args.data.data(), args.data.size());
+            break;
+        }
+        case Instruction::Action: {
+            encoder->begin(packet.action.device_id, Instruction::Action);
+            break;
+        }
+        case Instruction::FactoryReset: {
+            auto& args = packet.factory_reset;
+            encoder->begin(args.device_id, Instruction::FactoryReset);
+            encoder->add_uint8((uint8_t) args.reset);
+            break;
+        }
+        case Instruction::Reboot: {
+            encoder->begin(packet.reboot.device_id, Instruction::Reboot);
+            break;
+        }
+        case Instruction::Clear: {
+            encoder->begin(packet.clear.device_id, Instruction::Clear);
+            encoder->add_data(CLEAR_MULTI_TURN, sizeof(CLEAR_MULTI_TURN));
+            break;
+        }
+        case Instruction::SyncRead: {
+            auto& args = packet.sync_read;
+            begin_sync_read(
+                Instruction::SyncRead, args.start_addr, args.len, args.devices, encoder);
+            break;
+        }
+        case Instruction::FastSyncRead: {
+            auto& args = packet.fast_sync_read;
+            begin_sync_read(
+                Instruction::FastSyncRead, args.start_addr, args.len, args.devices, encoder);
+            break;
+        }
+        case Instruction::SyncWrite: {
+            auto& args = packet.sync_write;
+            encoder->begin(DeviceId::broadcast(), Instruction::SyncWrite);
+            encoder->add_uint16(args.start_addr);
+            encoder->add_uint16(args.len);
+
+            for (size_t i = 0; i < args.devices.size(); i++) {
+                encoder->add_uint8(args.devices[i].to_byte());
+                encoder->add_data(args.data.data() + i * args.len, args.len);
+            }
+
+            break;
+        }
+        case Instruction::BulkRead: {
+            begin_bulk_read(Instruction::BulkRead, packet.bulk_read.reads, encoder);
+            break;
+        }
+        case Instruction::FastBulkRead: {
+            begin_bulk_read(Instruction::FastBulkRead, packet.fast_bulk_read.reads, encoder);
+            break;
+        }
+        case Instruction::BulkWrite: {
+            encoder->begin(DeviceId::broadcast(), Instruction::BulkWrite);
+
+            for (auto& write : packet.bulk_write.writes) {
+                encoder->add_uint8(write.device_id.to_byte());
+                encoder->add_uint16(write.start_addr);
+                encoder->add_uint16((uint16_t) write.data.size());
+                encoder->add_data(write.data.data(), write.data.size());
+            }
+
+            break;
+        }
+        default: { return false; }
+    }
+
+    return encoder->end();
+}
+
+bool encode_status_packet(
+    DeviceId device_id,
+    Error error,
+    const uint8_t* data,
+    size_t len,
+    PacketEncoder* encoder) {
+    encoder->begin_status(device_id, error);
+    encoder->add_data(data, len);
+    return encoder->end();
+}
+
+size_t encode_instruction_packets(
+    const InstructionPacket* packets,
+    size_t num_packets,
+    PacketEncoder* encoder) {
+    for (size_t i = 0; i < num_packets; i++) {
+        if (!encode_instruction_packet(packets[i], encoder)) {
+            return i;
+        }
+    }
+
+    return num_packets;
+}
@@ -0,0 +1,120 @@
+#ifndef PACKET_ENCODER_H
+#define PACKET_ENCODER_H
+
+#include "parser.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// Encodes packets into a buffer provided by the caller, one after the other, so a whole
+/// control cycle can be encoded into a single buffer and sent at once. Byte stuffing is applied
+/// while the payload is added, the length and checksum are filled in by `end`. Never
+/// allocates.
+///
+/// A packet is encoded with `begin` (or `begin_status`), any number of `add_*` calls and
+/// `end`. If the buffer is too small for a packet, it is discarded by `end` and the packets
+/// before it are kept.
+class PacketEncoder {
+  public:
+    /// Encodes packets into the `buf_len` bytes at `buf`.
+    PacketEncoder(uint8_t* buf, size_t buf_len);
+
+    /// Starts an instruction packet.
+    void begin(DeviceId device_id, Instruction instruction);
+
+    /// Starts a status packet.
+    void begin_status(DeviceId device_id, Error error);
+
+    void add_uint8(uint8_t value) {
+        this->add_byte(value);
+    }
+
+    void add_uint16(uint16_t value) {
+        this->add_byte((uint8_t) value);
+        this->add_byte((uint8_t) (value >> 8));
+    }
+
+    void add_uint32(uint32_t value) {
+        this->add_uint16((uint16_t) value);
+        this->add_uint16((uint16_t) (value >> 16));
+    }
+
+    void add_data(const uint8_t* data, size_t len);
+
+    /// Finishes the current packet. Returns `false` and discards it if it does not fit into
+    /// the buffer or is longer than a packet can be.
+    bool end();
+
+    /// The number of bytes of all finished packets.
+    size_t len() const {
+        return this->len_;
+    }
+
+    const uint8_t* data() const {
+        return this->buf;
+    }
+
+    /// Discards all packets, so the buffer can be reused.
+    void clear() {
+        this->len_ = 0;
+        this->pos = 0;
+    }
+
+  private:
+    void begin_packet(DeviceId device_id);
+
+    /// Adds a byte of the payload (including instruction and error) and stuffs it if it
+    /// completes a header.
+    void add_byte(uint8_t byte) {
+        if (this->buf_len - this->pos < 2) {
+            this->is_overflow = true;
+            return;
+        }
+
+        this->buf[this->pos++] = byte;
+
+        if (byte == 0xff) {
+            this->header_len = this->header_len == 0 ? 1 : 2;
+        } else if (byte == 0xfd && this->header_len == 2) {
+            this->buf[this->pos++] = 0xfd;
+            this->header_len = 0;
+        } else {
+            this->header_len = 0;
+        }
+    }
+
+    uint8_t* buf;
+    size_t buf_len;
+    size_t len_;
+
+    /// Where the next byte of the current packet is stored.
+    size_t pos;
+
+    /// The number of bytes at the end of the payload that are the start of a header (`0xff`,
+    /// `0xff`, `0xfd`).
+    uint8_t header_len;
+    bool is_overflow;
+};
+
+/// Encodes a packet, e.g. one returned by `Parser::parse`. Fragments cannot be encoded.
+bool encode_packet(const Packet& packet, PacketEncoder* encoder);
+
+/// Encodes an instruction packet, e.g. one returned by `parse_instruction_packet`.
+bool encode_instruction_packet(const InstructionPacket& packet, PacketEncoder* encoder);
+
+/// Encodes a status packet with the `len` bytes at `data` as its payload.
+bool encode_status_packet(
+    DeviceId device_id,
+    Error error,
+    const uint8_t* data,
+    size_t len,
+    PacketEncoder* encoder);
+
+/// Encodes the instruction packets of a control cycle one after the other. Returns the number
+/// of packets that were encoded before the buffer was full.
+size_t encode_instruction_packets(
+    const InstructionPacket* packets,
+    size_t num_packets,
+    PacketEncoder* encoder);
+
+#endif
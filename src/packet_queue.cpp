@@ -0,0 +1,78 @@
+#include "packet_queue.h"
+
+#include <string.h>
+
+const size_t PacketQueue::NUM_ENTRIES;
+const size_t PacketQueue::ARENA_LEN;
+const size_t PacketQueue::MIN_PACKET_LEN;
+const size_t PacketQueue::MAX_ARENA_SKIP_LEN;
+
+PacketQueue::PacketQueue() : arena_write_count(0), arena_read_count(0) {}
+
+bool PacketQueue::push(size_t bus, PacketKind kind, const Packet& packet) {
+    auto data_len = (uint32_t) packet.data.size();
+    auto data_start = this->arena_write_count;
+    auto arena_pos = data_start & (ARENA_LEN - 1);
+
+    // payloads never wrap around the end of the arena, so they can be copied in one go
+    if (arena_pos + data_len > ARENA_LEN) {
+        data_start += ARENA_LEN - arena_pos;
+        arena_pos = 0;
+    }
+
+    auto used = data_start + data_len - this->arena_read_count.load(std::memory_order_acquire);
+
+    if (used > ARENA_LEN) {
+        return false;
+    }
+
+    memcpy(&this->arena[arena_pos], packet.data.data(), data_len);
+
+    Entry entry{
+        (uint8_t) bus,
+        kind,
+        packet.device_id.to_byte(),
+        packet.instruction,
+        packet.error.to_byte(),
+        (uint16_t) data_len,
+        data_start,
+        (uint32_t) packet.data_offset,
+    };
+
+    // the ring publishes the payload together with the entry
+    if (!this->entries.push(entry)) {
+        return false;
+    }
+
+    this->arena_write_count = data_start + data_len;
+    return true;
+}
+
+bool PacketQueue::push(size_t bus, PacketKind kind) {
+    return this->push(
+        bus,
+        kind,
+        Packet{DeviceId(0), Instruction::Ping, Error(), std::vector<uint8_t>()});
+}
+
+bool PacketQueue::pop(size_t* bus, PacketKind* kind, Packet* packet) {
+    Entry entry;
+
+    if (!this->entries.pop(&entry)) {
+        return false;
+    }
+
+    *bus = entry.bus;
+    *kind = entry.kind;
+    packet->device_id = DeviceId(entry.device_id);
+    packet->instruction = entry.instruction;
+    packet->error = Error(entry.error);
+    packet->data_offset = entry.data_offset;
+
+    auto data = &this->arena[entry.data_start & (ARENA_LEN - 1)];
+    packet->data.assign(data, data + entry.data_len);
+
+    // this also releases the bytes skipped before the payload
+    this->arena_read_count.store(entry.data_start + entry.data_len, std::memory_order_release);
+    return true;
+}
@@ -0,0 +1,127 @@
+#ifndef PACKET_QUEUE_H
+#define PACKET_QUEUE_H
+
+#include "parser.h"
+#include "spsc_ring.h"
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+/// What the apply stage has to do with an entry of a `PacketQueue`.
+enum class PacketKind : uint8_t {
+    /// A complete packet (or the last fragment of one), see `ControlTableMap::receive`.
+    Packet,
+
+    /// A fragment of a packet, see `ControlTableMap::receive_fragment`.
+    Fragment,
+
+    /// The staged fragments turned out to be invalid, see
+    /// `ControlTableMap::discard_fragments`.
+    DiscardFragments,
+
+    /// Entries of the bus were dropped because the queue was full, so its context is no
+    /// longer valid (see `ControlTableMap::reset_bus`).
+    Gap,
+};
+
+/// Passes parsed packets from the packet task (the producer), which finds and validates
+/// them, to the task that applies them to the control tables (the consumer). Like
+/// `SpscRing`, neither side ever blocks or allocates.
+///
+/// The packets' payloads are copied into an arena in the order they are pushed, so only a
+/// compact descriptor has to be passed through the ring. The payload cannot be referenced
+/// in the receive buffer since the DMA controller reuses it and byte stuffing has already
+/// been removed by the parser.
+class PacketQueue {
+  public:
+    /// The maximum number of entries in the queue. Large enough for the packets of a whole
+    /// receive buffer (see `num_entries_for`), so the packet task never has to wait for the
+    /// apply task.
+    static const size_t NUM_ENTRIES = 1024;
+
+    /// The number of bytes available for payloads. Must be a power of two and at least
+    /// `MAX_PACKET_DATA_LEN`, see `arena_len_for` for the length needed by a receive buffer.
+    static const size_t ARENA_LEN = 16384;
+
+    /// The length of the shortest packet (an instruction without parameters), which limits
+    /// the number of entries parsed from the received data.
+    static const size_t MIN_PACKET_LEN = 10;
+
+    /// The maximum number of entries pushed for the packets parsed from `num_bytes` received
+    /// bytes of a bus: one per packet, another one for the packet whose start was processed
+    /// before and a gap that could not be pushed before.
+    static constexpr size_t num_entries_for(size_t num_bytes) {
+        return num_bytes / MIN_PACKET_LEN + 2;
+    }
+
+    /// The maximum number of arena bytes used by the packets parsed from `num_bytes` received
+    /// bytes of a bus. Byte stuffing and the packet framing only make payloads shorter than
+    /// the received bytes, but the parser may carry over the payload of a packet whose start
+    /// was processed before (up to `MAX_PACKET_DATA_LEN` bytes, then it is fragmented).
+    static constexpr size_t arena_len_for(size_t num_bytes) {
+        return num_bytes + MAX_PACKET_DATA_LEN;
+    }
+
+    /// The number of arena bytes that may be skipped at its end to keep a payload
+    /// contiguous. Needs to be added once to the lengths from `arena_len_for`.
+    static const size_t MAX_ARENA_SKIP_LEN = MAX_PACKET_DATA_LEN - 1;
+
+    PacketQueue();
+
+    PacketQueue(const PacketQueue&) = delete;
+
+    PacketQueue& operator=(const PacketQueue&) = delete;
+
+    /// Appends `packet` as an entry of `kind` for `bus`. Returns `false` if there is not
+    /// enough space for the entry or its payload. Producer only.
+    bool push(size_t bus, PacketKind kind, const Packet& packet);
+
+    /// Appends an entry of `kind` without a packet (`DiscardFragments` or `Gap`). Returns
+    /// `false` if the queue is full. Producer only.
+    bool push(size_t bus, PacketKind kind);
+
+    /// Removes the oldest entry. Its packet is copied into `packet`, whose payload should
+    /// have `MAX_PACKET_DATA_LEN` bytes reserved to prevent allocations. Returns `false` if
+    /// the queue is empty. Consumer only.
+    bool pop(size_t* bus, PacketKind* kind, Packet* packet);
+
+    /// Returns the number of entries in the queue (see `SpscRing::size`).
+    size_t size() const {
+        return this->entries.size();
+    }
+
+    bool is_empty() const {
+        return this->entries.is_empty();
+    }
+
+  private:
+    static_assert((ARENA_LEN & (ARENA_LEN - 1)) == 0, "arena length must be a power of two");
+    static_assert(ARENA_LEN >= MAX_PACKET_DATA_LEN, "arena must hold the largest payload");
+
+    struct Entry {
+        uint8_t bus;
+        PacketKind kind;
+        uint8_t device_id;
+        Instruction instruction;
+        uint8_t error;
+        uint16_t data_len;
+
+        /// The position of the payload in the arena (modulo 2^32, like `arena_write_count`).
+        uint32_t data_start;
+
+        uint32_t data_offset;
+    };
+
+    SpscRing<Entry, NUM_ENTRIES> entries;
+    uint8_t arena[ARENA_LEN];
+
+    /// The number of arena bytes used by the producer since the queue was created, including
+    /// the bytes skipped to keep every payload contiguous. Producer only.
+    uint32_t arena_write_count;
+
+    /// The number of arena bytes released by the consumer.
+    std::atomic<uint32_t> arena_read_count;
+};
+
+#endif
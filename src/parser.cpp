@@ -88,6 +88,10 @@ void Receiver::push_last_byte(uint8_t byte) {
     this->last_bytes[2] = byte;
 }
 
+bool Receiver::is_in_header() const {
+    return this->last_bytes[2] == HEADER[0] || this->last_bytes == HEADER;
+}
+
 uint16_t Receiver::current_crc() const {
     return this->crc;
 }
@@ -96,8 +100,8 @@ void Receiver::reset_crc() {
     this->crc = 0;
 }
 
-void Receiver::update_crc(uint8_t byte) {
-    const uint16_t CRC_TABLE[256] = {
+uint16_t update_crc(uint16_t crc, const uint8_t* data, size_t len) {
+    static const uint16_t CRC_TABLE[256] = {
         0x0000, 0x8005, 0x800f, 0x000a, 0x801b, 0x001e, 0x0014, 0x8011, 0x8033, 0x0036, 0x003c,
         0x8039, 0x0028, 0x802d, 0x8027, 0x0022, 0x8063, 0x0066, 0x006c, 0x8069, 0x0078, 0x807d,
         0x8077, 0x0072, 0x0050, 0x8055, 0x805f, 0x005a, 0x804b, 0x004e, 0x0044, 0x8041, 0x80c3,
@@ -123,8 +127,16 @@ void Receiver::update_crc(uint8_t byte) {
         0x822f, 0x022a, 0x823b, 0x023e, 0x0234, 0x8231, 0x8213, 0x0216, 0x021c, 0x8219, 0x0208,
         0x820d, 0x8207, 0x0202};
 
-    size_t index = ((uint16_t)(this->crc >> 8) ^ byte) & 0xff;
-    this->crc = (this->crc << 8) ^ CRC_TABLE[index];
+    for (size_t i = 0; i < len; i++) {
+        size_t index = ((uint16_t)(crc >> 8) ^ data[i]) & 0xff;
+        crc = (crc << 8) ^ CRC_TABLE[index];
+    }
+
+    return crc;
+}
+
+void Receiver::update_crc(uint8_t byte) {
+    this->crc = ::update_crc(this->crc, &byte, 1);
 }
 
 ParseResult Parser::parse(Cursor& cursor, Packet* packet) {
@@ -171,6 +183,9 @@ ParseResult Parser::parse(Cursor& cursor, Packet* packet) {
             // part of the stuffing range and the allowed values for the instruction guarantee that
             // no stuffing can happen for it or the (possibly) following error
 
+            // the length field counts everything after itself
+            this->raw_packet_len_ = 7 + uint16_from_le(buf + 1);
+
             // clang-format off
             this->raw_remaining_data_len = uint16_from_le(buf + 1) 
                 - 1                                                     // instruction field
@@ -211,25 +226,36 @@ ParseResult Parser::parse(Cursor& cursor, Packet* packet) {
             }
 
             packet->data.clear();
+            packet->data_offset = 0;
+            this->has_returned_fragment = false;
             this->current_state = ParserState::Data;
         }
         // fallthrough
         case ParserState::Data: {
+            // the previous fragment has been handed out, continue with the next one
+            if (this->has_returned_fragment) {
+                packet->data_offset += packet->data.size();
+                packet->data.clear();
+                this->has_returned_fragment = false;
+            }
+
             while (this->raw_remaining_data_len > 0) {
                 auto result = this->receiver.read_byte(cursor, Receiver::Crc::Enable);
 
                 switch (result.state) {
                     case Receiver::ReadState::Ok: {
                         if (result.is_data_byte) {
-                            if (packet->data.size() >= MAX_PACKET_DATA_LEN) {
-                                this->current_state = ParserState::Header;
-                                return ParseResult::BufferOverflow;
-                            }
-
                             packet->data.push_back(result.byte);
                         }
 
                         this->raw_remaining_data_len--;
+
+                        if (packet->data.size() >= MAX_PACKET_DATA_LEN
+                            && this->raw_remaining_data_len > 0) {
+                            this->has_returned_fragment = true;
+                            return ParseResult::PacketFragment;
+                        }
+
                         break;
                     }
                     case Receiver::ReadState::NeedMoreData: {
@@ -339,6 +365,14 @@ InstructionPacket::~InstructionPacket() {
             this->bulk_write.~BulkWriteArgs();
             break;
         }
+        case Instruction::FastSyncRead: {
+            this->fast_sync_read.~FastSyncReadArgs();
+            break;
+        }
+        case Instruction::FastBulkRead: {
+            this->fast_bulk_read.~FastBulkReadArgs();
+            break;
+        }
     }
 }
 
@@ -398,6 +432,14 @@ InstructionPacket& InstructionPacket::operator=(InstructionPacket&& rhs) noexcep
             new (&this->bulk_write) BulkWriteArgs(std::move(rhs.bulk_write));
             break;
         }
+        case Instruction::FastSyncRead: {
+            new (&this->fast_sync_read) FastSyncReadArgs(std::move(rhs.fast_sync_read));
+            break;
+        }
+        case Instruction::FastBulkRead: {
+            new (&this->fast_bulk_read) FastBulkReadArgs(std::move(rhs.fast_bulk_read));
+            break;
+        }
     }
 
     return *this;
@@ -478,7 +520,7 @@ InstructionParseResult
                 return InstructionParseResult::InvalidPacketLen;
             }
 
-            *instruction_packet = InstructionPacket(ActionArgs{});
+            *instruction_packet = InstructionPacket(ActionArgs{packet.device_id});
             break;
         }
         case Instruction::FactoryReset: {
@@ -498,7 +540,7 @@ InstructionParseResult
                 return InstructionParseResult::InvalidPacketLen;
             }
 
-            *instruction_packet = InstructionPacket(RebootArgs{});
+            *instruction_packet = InstructionPacket(RebootArgs{packet.device_id});
             break;
         }
         case Instruction::Clear: {
@@ -506,10 +548,11 @@ InstructionParseResult
                 return InstructionParseResult::InvalidPacketLen;
             }
 
-            *instruction_packet = InstructionPacket(ClearArgs{});
+            *instruction_packet = InstructionPacket(ClearArgs{packet.device_id});
             break;
         }
-        case Instruction::SyncRead: {
+        case Instruction::SyncRead:
+        case Instruction::FastSyncRead: {
             if (packet.data.size() < 4) {
                 return InstructionParseResult::InvalidPacketLen;
             }
@@ -534,11 +577,19 @@ InstructionParseResult
                 devices.push_back(device_id);
             }
 
-            *instruction_packet = InstructionPacket(SyncReadArgs{
-                std::move(devices),
-                start_addr,
-                len,
-            });
+            if (packet.instruction == Instruction::SyncRead) {
+                *instruction_packet = InstructionPacket(SyncReadArgs{
+                    std::move(devices),
+                    start_addr,
+                    len,
+                });
+            } else {
+                *instruction_packet = InstructionPacket(FastSyncReadArgs{
+                    std::move(devices),
+                    start_addr,
+                    len,
+                });
+            }
 
             break;
         }
@@ -590,7 +641,8 @@ InstructionParseResult
 
             break;
         }
-        case Instruction::BulkRead: {
+        case Instruction::BulkRead:
+        case Instruction::FastBulkRead: {
             if (packet.data.size() % 5 != 0) {
                 return InstructionParseResult::InvalidPacketLen;
             }
@@ -619,7 +671,12 @@ InstructionParseResult
                 });
             }
 
-            *instruction_packet = InstructionPacket(BulkReadArgs{std::move(reads)});
+            if (packet.instruction == Instruction::BulkRead) {
+                *instruction_packet = InstructionPacket(BulkReadArgs{std::move(reads)});
+            } else {
+                *instruction_packet = InstructionPacket(FastBulkReadArgs{std::move(reads)});
+            }
+
             break;
         }
         case Instruction::BulkWrite: {
@@ -679,6 +736,401 @@ InstructionParseResult
     return InstructionParseResult::Ok;
 }
 
+void InstructionDecoder::reset() {
+    this->result = InstructionParseResult::Ok;
+    this->instruction = Instruction::Ping;
+    this->data_len = 0;
+    this->header_len = 0;
+    this->remaining_entry_len = 0;
+    this->start_addr = 0;
+    this->len = 0;
+    this->devices.clear();
+    this->data.clear();
+    this->reads.clear();
+    this->writes.clear();
+}
+
+void InstructionDecoder::decode(const Packet& fragment) {
+    if (fragment.data_offset == 0) {
+        this->reset();
+        this->device_id = fragment.device_id;
+        this->instruction = fragment.instruction;
+
+        switch (this->instruction) {
+            case Instruction::Write:
+            case Instruction::RegWrite: {
+                break;
+            }
+            case Instruction::SyncRead:
+            case Instruction::SyncWrite:
+            case Instruction::BulkRead:
+            case Instruction::BulkWrite:
+            case Instruction::FastSyncRead:
+            case Instruction::FastBulkRead: {
+                if (!this->device_id.is_broadcast()) {
+                    this->result = InstructionParseResult::InvalidDeviceId;
+                }
+
+                break;
+            }
+            case Instruction::Status: {
+                this->result = InstructionParseResult::InstructionIsStatus;
+                break;
+            }
+            case Instruction::Ping:
+            case Instruction::Read:
+            case Instruction::Action:
+            case Instruction::FactoryReset:
+            case Instruction::Reboot:
+            case Instruction::Clear: {
+                // these have a fixed size that is much smaller than a fragment
+                this->result = InstructionParseResult::InvalidPacketLen;
+                break;
+            }
+            default: {
+                this->result = InstructionParseResult::UnknownInstruction;
+                break;
+            }
+        }
+    } else if (fragment.data_offset != this->data_len) {
+        // a fragment is missing (or the first one was never decoded)
+        this->result = InstructionParseResult::InvalidPacketLen;
+    }
+
+    this->data_len += fragment.data.size();
+
+    if (this->data_len > MAX_FRAGMENTED_PACKET_DATA_LEN) {
+        this->result = InstructionParseResult::InvalidPacketLen;
+    }
+
+    for (auto byte : fragment.data) {
+        if (this->result != InstructionParseResult::Ok) {
+            return;
+        }
+
+        this->result = this->decode_byte(byte);
+    }
+}
+
+InstructionParseResult InstructionDecoder::decode_byte(uint8_t byte) {
+    switch (this->instruction) {
+        case Instruction::Write:
+        case Instruction::RegWrite: {
+            if (this->header_len < 2) {
+                this->header[this->header_len] = byte;
+                this->header_len++;
+                this->start_addr = uint16_from_le(this->header);
+            } else {
+                this->data.push_back(byte);
+            }
+
+            break;
+        }
+        case Instruction::SyncRead:
+        case Instruction::FastSyncRead: {
+            if (this->header_len < 4) {
+                this->header[this->header_len] = byte;
+                this->header_len++;
+                this->start_addr = uint16_from_le(this->header);
+                this->len = uint16_from_le(this->header + 2);
+                break;
+            }
+
+            DeviceId device_id(byte);
+
+            if (device_id.is_broadcast()) {
+                return InstructionParseResult::InvalidDeviceId;
+            }
+
+            this->devices.push_back(device_id);
+            break;
+        }
+        case Instruction::SyncWrite: {
+            if (this->header_len < 4) {
+                this->header[this->header_len] = byte;
+                this->header_len++;
+                this->start_addr = uint16_from_le(this->header);
+                this->len = uint16_from_le(this->header + 2);
+                break;
+            }
+
+            // every entry starts with the id, followed by `len` bytes of data
+            if (this->remaining_entry_len == 0) {
+                DeviceId device_id(byte);
+
+                if (device_id.is_broadcast()) {
+                    return InstructionParseResult::InvalidDeviceId;
+                }
+
+                this->devices.push_back(device_id);
+                this->remaining_entry_len = this->len;
+            } else {
+                this->data.push_back(byte);
+                this->remaining_entry_len--;
+            }
+
+            break;
+        }
+        case Instruction::BulkRead:
+        case Instruction::FastBulkRead: {
+            this->header[this->header_len] = byte;
+            this->header_len++;
+
+            if (this->header_len == 5) {
+                DeviceId device_id(this->header[0]);
+
+                if (device_id.is_broadcast()) {
+                    return InstructionParseResult::InvalidDeviceId;
+                }
+
+                this->reads.push_back(ReadArgs{
+                    device_id,
+                    uint16_from_le(this->header + 1),
+                    uint16_from_le(this->header + 3),
+                });
+
+                this->header_len = 0;
+            }
+
+            break;
+        }
+        case Instruction::BulkWrite: {
+            // every entry has a 5 byte header (id, address and length), followed by the data
+            if (this->header_len < 5) {
+                this->header[this->header_len] = byte;
+                this->header_len++;
+
+                if (this->header_len == 5) {
+                    DeviceId device_id(this->header[0]);
+
+                    if (device_id.is_broadcast()) {
+                        return InstructionParseResult::InvalidDeviceId;
+                    }
+
+                    this->remaining_entry_len = uint16_from_le(this->header + 3);
+                    this->writes.push_back(WriteArgs{
+                        device_id,
+                        uint16_from_le(this->header + 1),
+                        std::vector<uint8_t>(),
+                    });
+
+                    this->writes.back().data.reserve(this->remaining_entry_len);
+
+                    if (this->remaining_entry_len == 0) {
+                        this->header_len = 0;
+                    }
+                }
+            } else {
+                this->writes.back().data.push_back(byte);
+                this->remaining_entry_len--;
+
+                if (this->remaining_entry_len == 0) {
+                    this->header_len = 0;
+                }
+            }
+
+            break;
+        }
+        default: { return InstructionParseResult::UnknownInstruction; }
+    }
+
+    return InstructionParseResult::Ok;
+}
+
+InstructionParseResult InstructionDecoder::finish(InstructionPacket* instruction_packet) {
+    auto result = this->result;
+
+    if (result == InstructionParseResult::Ok) {
+        switch (this->instruction) {
+            case Instruction::Write: {
+                if (this->header_len < 2) {
+                    result = InstructionParseResult::InvalidPacketLen;
+                    break;
+                }
+
+                *instruction_packet = InstructionPacket(WriteArgs{
+                    this->device_id,
+                    this->start_addr,
+                    std::move(this->data),
+                });
+
+                break;
+            }
+            case Instruction::RegWrite: {
+                if (this->header_len < 2) {
+                    result = InstructionParseResult::InvalidPacketLen;
+                    break;
+                }
+
+                *instruction_packet = InstructionPacket(RegWriteArgs{
+                    this->device_id,
+                    this->start_addr,
+                    std::move(this->data),
+                });
+
+                break;
+            }
+            case Instruction::SyncRead: {
+                if (this->header_len < 4) {
+                    result = InstructionParseResult::InvalidPacketLen;
+                    break;
+                }
+
+                *instruction_packet = InstructionPacket(SyncReadArgs{
+                    std::move(this->devices),
+                    this->start_addr,
+                    this->len,
+                });
+
+                break;
+            }
+            case Instruction::FastSyncRead: {
+                if (this->header_len < 4) {
+                    result = InstructionParseResult::InvalidPacketLen;
+                    break;
+                }
+
+                *instruction_packet = InstructionPacket(FastSyncReadArgs{
+                    std::move(this->devices),
+                    this->start_addr,
+                    this->len,
+                });
+
+                break;
+            }
+            case Instruction::SyncWrite: {
+                if (this->header_len < 4 || this->remaining_entry_len > 0) {
+                    result = InstructionParseResult::InvalidPacketLen;
+                    break;
+                }
+
+                *instruction_packet = InstructionPacket(SyncWriteArgs{
+                    std::move(this->devices),
+                    this->start_addr,
+                    this->len,
+                    std::move(this->data),
+                });
+
+                break;
+            }
+            case Instruction::BulkRead: {
+                if (this->header_len > 0) {
+                    result = InstructionParseResult::InvalidPacketLen;
+                    break;
+                }
+
+                *instruction_packet = InstructionPacket(BulkReadArgs{std::move(this->reads)});
+                break;
+            }
+            case Instruction::FastBulkRead: {
+                if (this->header_len > 0) {
+                    result = InstructionParseResult::InvalidPacketLen;
+                    break;
+                }
+
+                *instruction_packet = InstructionPacket(FastBulkReadArgs{std::move(this->reads)});
+                break;
+            }
+            case Instruction::BulkWrite: {
+                if (this->header_len > 0) {
+                    result = InstructionParseResult::InvalidPacketLen;
+                    break;
+                }
+
+                *instruction_packet = InstructionPacket(BulkWriteArgs{std::move(this->writes)});
+                break;
+            }
+            default: {
+                result = InstructionParseResult::UnknownInstruction;
+                break;
+            }
+        }
+    }
+
+    this->reset();
+    return result;
+}
+
+std::string to_string(const Instruction& instruction) {
+    switch (instruction) {
+        case Instruction::Ping: {
+            return "Ping";
+        }
+        case Instruction::Read: {
+            return "Read";
+        }
+        case Instruction::Write: {
+            return "Write";
+        }
+        case Instruction::RegWrite: {
+            return "RegWrite";
+        }
+        case Instruction::Action: {
+            return "Action";
+        }
+        case Instruction::FactoryReset: {
+            return "FactoryReset";
+        }
+        case Instruction::Reboot: {
+            return "Reboot";
+        }
+        case Instruction::Clear: {
+            return "Clear";
+        }
+        case Instruction::Status: {
+            return "Status";
+        }
+        case Instruction::SyncRead: {
+            return "SyncRead";
+        }
+        case Instruction::SyncWrite: {
+            return "SyncWrite";
+        }
+        case Instruction::BulkRead: {
+            return "BulkRead";
+        }
+        case Instruction::BulkWrite: {
+            return "BulkWrite";
+        }
+        case Instruction::FastSyncRead: {
+            return "FastSyncRead";
+        }
+        case Instruction::FastBulkRead: {
+            return "FastBulkRead";
+        }
+        default: { return "Unknown"; }
+    }
+}
+
+bool instruction_from_string(const std::string& name, Instruction* instruction) {
+    const Instruction instructions[] = {
+        Instruction::Ping,
+        Instruction::Read,
+        Instruction::Write,
+        Instruction::RegWrite,
+        Instruction::Action,
+        Instruction::FactoryReset,
+        Instruction::Reboot,
+        Instruction::Clear,
+        Instruction::Status,
+        Instruction::SyncRead,
+        Instruction::SyncWrite,
+        Instruction::BulkRead,
+        Instruction::BulkWrite,
+        Instruction::FastSyncRead,
+        Instruction::FastBulkRead,
+    };
+
+    for (auto candidate : instructions) {
+        if (to_string(candidate) == name) {
+            *instruction = candidate;
+            return true;
+        }
+    }
+
+    return false;
+}
+
 std::string to_string(const ParseResult& result) {
     switch (result) {
         case ParseResult::PacketAvailable: {
@@ -687,8 +1139,8 @@ std::string to_string(const ParseResult& result) {
         case ParseResult::NeedMoreData: {
             return "need more data";
         }
-        case ParseResult::BufferOverflow: {
-            return "buffer overflow";
+        case ParseResult::PacketFragment: {
+            return "packet fragment";
         }
         case ParseResult::MismatchedChecksum: {
             return "mismatched checksum";
@@ -5,14 +5,23 @@
 
 #include "cursor.h"
 #include <array>
+#include <functional>
+#include <limits>
+#include <ostream>
 #include <stddef.h>
 #include <stdint.h>
+#include <string>
 #include <vector>
 
-/// The maximum length of the packet payload. Packets with a larger payload are
-/// rejected by the parser.
+/// The maximum length of the payload stored in a `Packet`. Packets with a larger payload
+/// are returned by the parser in multiple fragments of at most this size.
 const uint32_t MAX_PACKET_DATA_LEN = 256;
 
+/// The maximum length of a fragmented packet's payload. Larger packets are rejected once
+/// they have been received. This also bounds the memory needed to stage a fragmented packet
+/// until its checksum has been validated (see `ControlTableMap::receive_fragment`).
+const uint32_t MAX_FRAGMENTED_PACKET_DATA_LEN = 4096;
+
 /// The Id of a device.
 class DeviceId {
   public:
@@ -103,8 +112,17 @@ enum class Instruction : uint8_t {
     SyncWrite = 0x83,
     BulkRead = 0x92,
     BulkWrite = 0x93,
+    FastSyncRead = 0x8a,
+    FastBulkRead = 0x9a,
 };
 
+/// Returns the name of `instruction` as in the protocol's documentation, e.g. `SyncWrite`.
+std::string to_string(const Instruction& instruction);
+
+/// Sets `instruction` to the instruction named `name` (see `to_string`). Returns `false` if
+/// there is no such instruction.
+bool instruction_from_string(const std::string& name, Instruction* instruction);
+
 /// Represents the error field of a `Packet`.
 class Error {
   public:
@@ -120,6 +138,11 @@ class Error {
         return (this->code & 0b01000000) != 0;
     }
 
+    /// Returns the byte representation of this `Error`.
+    uint8_t to_byte() const {
+        return this->code;
+    }
+
     friend bool operator==(const Error& lhs, const Error& rhs);
 
   private:
@@ -142,10 +165,19 @@ struct Packet {
     /// ok otherwise.
     Error error;
 
-    /// The payload of the packet.
+    /// The payload of the packet. For fragmented packets, this only contains the
+    /// current fragment.
     std::vector<uint8_t> data;
+
+    /// The offset of `data` in the packet's complete payload. Always 0 unless the packet
+    /// is larger than `MAX_PACKET_DATA_LEN` and `data` is not its first fragment.
+    size_t data_offset = 0;
 };
 
+/// Updates the checksum `crc` of a packet with `len` bytes and returns it. The checksum covers
+/// all bytes of a packet from its header to the end of its (stuffed) payload.
+uint16_t update_crc(uint16_t crc, const uint8_t* data, size_t len);
+
 /// Stores enough previously encountered bytes to detect packet headers and byte stuffing.
 class Receiver {
   public:
@@ -176,6 +208,9 @@ class Receiver {
 
     uint16_t current_crc() const;
 
+    /// Returns `true` if the last bytes may be the start of a header.
+    bool is_in_header() const;
+
   private:
     enum class ByteType {
         Data,
@@ -203,8 +238,10 @@ enum class ParseResult {
     /// More data is required to parse a packet.
     NeedMoreData,
 
-    /// The packet's payload is too large.
-    BufferOverflow,
+    /// A fragment of a packet's payload is available. Further fragments follow until the
+    /// last one is returned with `PacketAvailable`. Fragments are not validated until the
+    /// checksum has been checked for the last one.
+    PacketFragment,
 
     /// The packet's checksum did not match the calculated one.
     MismatchedChecksum,
@@ -229,12 +266,31 @@ enum class ParserState {
 /// Stores the state required for parsing packets.
 class Parser {
   public:
-    Parser() : buf_len(0), current_state(ParserState::Header), raw_remaining_data_len(0) {}
+    Parser() :
+        buf_len(0),
+        current_state(ParserState::Header),
+        raw_remaining_data_len(0),
+        raw_packet_len_(0),
+        has_returned_fragment(false) {}
 
     /// Parses the next packet into `packet`. If only parts of a packet were parsed,
-    /// a pointer to the same packet must be passed for the next call.
+    /// a pointer to the same packet must be passed for the next call. This also applies
+    /// to packets that are returned in fragments.
     ParseResult parse(Cursor& cursor, Packet* packet);
 
+    /// Returns the number of bytes the last packet occupied on the bus (including header,
+    /// byte stuffing and checksum) after `parse` returned `PacketAvailable` or
+    /// `MismatchedChecksum`.
+    size_t raw_packet_len() const {
+        return this->raw_packet_len_;
+    }
+
+    /// Returns `true` if a header has been found (or the last bytes may start one) and the
+    /// rest of the packet is still parsed.
+    bool is_in_packet() const {
+        return this->current_state != ParserState::Header || this->receiver.is_in_header();
+    }
+
   private:
     // only need this for storing partial reads that are not data (data is
     // stored in the packet directly)
@@ -243,6 +299,8 @@ class Parser {
     Receiver receiver;
     ParserState current_state;
     size_t raw_remaining_data_len;
+    size_t raw_packet_len_;
+    bool has_returned_fragment;
 };
 
 struct PingArgs {
@@ -267,7 +325,9 @@ struct RegWriteArgs {
     std::vector<uint8_t> data;
 };
 
-struct ActionArgs {};
+struct ActionArgs {
+    DeviceId device_id;
+};
 
 enum class FactoryReset : uint8_t {
     ResetAll = 0xff,
@@ -280,9 +340,13 @@ struct FactoryResetArgs {
     FactoryReset reset;
 };
 
-struct RebootArgs {};
+struct RebootArgs {
+    DeviceId device_id;
+};
 
-struct ClearArgs {};
+struct ClearArgs {
+    DeviceId device_id;
+};
 
 struct SyncReadArgs {
     std::vector<DeviceId> devices;
@@ -305,8 +369,20 @@ struct BulkWriteArgs {
     std::vector<WriteArgs> writes;
 };
 
+/// Same as `SyncReadArgs`, but all devices respond with a single status packet.
+struct FastSyncReadArgs {
+    std::vector<DeviceId> devices;
+    uint16_t start_addr;
+    uint16_t len;
+};
+
+/// Same as `BulkReadArgs`, but all devices respond with a single status packet.
+struct FastBulkReadArgs {
+    std::vector<ReadArgs> reads;
+};
+
 struct InstructionPacket {
-    InstructionPacket() noexcept : InstructionPacket(ClearArgs{}) {}
+    InstructionPacket() noexcept : InstructionPacket(ClearArgs{DeviceId(0)}) {}
 
     explicit InstructionPacket(PingArgs&& args) noexcept :
         instruction(Instruction::Ping),
@@ -356,6 +432,14 @@ struct InstructionPacket {
         instruction(Instruction::BulkWrite),
         bulk_write(std::move(args)) {}
 
+    explicit InstructionPacket(FastSyncReadArgs&& args) noexcept :
+        instruction(Instruction::FastSyncRead),
+        fast_sync_read(std::move(args)) {}
+
+    explicit InstructionPacket(FastBulkReadArgs&& args) noexcept :
+        instruction(Instruction::FastBulkRead),
+        fast_bulk_read(std::move(args)) {}
+
     ~InstructionPacket();
 
     InstructionPacket& operator=(InstructionPacket&& rhs) noexcept;
@@ -374,6 +458,8 @@ struct InstructionPacket {
         SyncWriteArgs sync_write;
         BulkReadArgs bulk_read;
         BulkWriteArgs bulk_write;
+        FastSyncReadArgs fast_sync_read;
+        FastBulkReadArgs fast_bulk_read;
     };
 };
 
@@ -390,4 +476,43 @@ enum class InstructionParseResult {
 InstructionParseResult
     parse_instruction_packet(const Packet& packet, InstructionPacket* instruction_packet);
 
+/// Parses instruction packets that are received in fragments (see
+/// `ParseResult::PacketFragment`). Every fragment is decoded as soon as it is available and
+/// only the decoded arguments are kept, so the complete payload is never buffered. Only
+/// instructions with a variable length payload can be fragmented.
+class InstructionDecoder {
+  public:
+    InstructionDecoder() : device_id(0) {
+        this->reset();
+    }
+
+    /// Discards the packet that is currently being decoded.
+    void reset();
+
+    /// Decodes the next fragment. A fragment with a `data_offset` of 0 starts a new packet.
+    /// Errors are only reported by `finish`.
+    void decode(const Packet& fragment);
+
+    /// Finishes decoding the current packet. The result is constructed at
+    /// `instruction_packet`. Afterwards the decoder is reset.
+    InstructionParseResult finish(InstructionPacket* instruction_packet);
+
+  private:
+    InstructionParseResult decode_byte(uint8_t byte);
+
+    DeviceId device_id;
+    Instruction instruction;
+    InstructionParseResult result;
+    size_t data_len;
+    uint8_t header[5];
+    size_t header_len;
+    size_t remaining_entry_len;
+    uint16_t start_addr;
+    uint16_t len;
+    std::vector<DeviceId> devices;
+    std::vector<uint8_t> data;
+    std::vector<ReadArgs> reads;
+    std::vector<WriteArgs> writes;
+};
+
 #endif
@@ -0,0 +1,151 @@
+#include "pcap_export.h"
+#include "endian_convert.h"
+
+#include <algorithm>
+#include <string.h>
+
+/// The magic of pcap files with nanosecond timestamps.
+static const uint32_t PCAP_MAGIC = 0xa1b23c4d;
+static const size_t PCAP_HEADER_LEN = 24;
+static const size_t PCAP_RECORD_HEADER_LEN = 16;
+
+const size_t PcapExporter::HISTORY_LEN;
+const size_t PcapExporter::MAX_CHUNK_LEN;
+
+PcapWriter::PcapWriter(std::ostream* out, uint32_t link_type, size_t buf_len) :
+    out(out),
+    buf(std::max(buf_len, PCAP_RECORD_HEADER_LEN + PCAP_MAX_FRAME_LEN)),
+    buf_len(0) {
+    uint8_t header[PCAP_HEADER_LEN] = {};
+    uint32_to_le(&header[0], PCAP_MAGIC);
+    uint16_to_le(&header[4], 2);
+    uint16_to_le(&header[6], 4);
+    uint32_to_le(&header[16], PCAP_MAX_FRAME_LEN);
+    uint32_to_le(&header[20], link_type);
+    this->out->write((const char*) header, sizeof(header));
+}
+
+PcapWriter::~PcapWriter() {
+    this->flush();
+}
+
+uint8_t* PcapWriter::add_record(uint64_t timestamp, size_t len) {
+    if (this->buf.size() - this->buf_len < PCAP_RECORD_HEADER_LEN + len) {
+        this->flush();
+    }
+
+    auto header = &this->buf[this->buf_len];
+    uint32_to_le(&header[0], (uint32_t) (timestamp / 1000000000));
+    uint32_to_le(&header[4], (uint32_t) (timestamp % 1000000000));
+    uint32_to_le(&header[8], (uint32_t) len);
+    uint32_to_le(&header[12], (uint32_t) len);
+    this->buf_len += PCAP_RECORD_HEADER_LEN + len;
+    return &header[PCAP_RECORD_HEADER_LEN];
+}
+
+void PcapWriter::flush() {
+    this->out->write((const char*) this->buf.data(), this->buf_len);
+    this->buf_len = 0;
+}
+
+PcapExporter::Bus::Bus() :
+    packet{DeviceId(0), Instruction::Ping, Error(), {}},
+    history(HISTORY_LEN),
+    stream_len(0),
+    frame_end(0),
+    last_timestamp(0),
+    is_resync(false) {}
+
+PcapExporter::PcapExporter(PcapWriter* writer, size_t num_buses, uint32_t baudrate) :
+    writer(writer),
+    buses(num_buses),
+    byte_time(baudrate == 0 ? 0 : 10000000000 / baudrate),
+    num_frames_(0) {}
+
+void PcapExporter::add(uint64_t timestamp, size_t bus, const uint8_t* data, size_t len) {
+    // the ring buffer only holds parts of large chunks
+    for (size_t pos = 0; pos < len; pos += MAX_CHUNK_LEN) {
+        auto part_len = std::min(len - pos, MAX_CHUNK_LEN);
+        this->add_part(timestamp * 1000, len - pos - part_len, bus, &data[pos], part_len);
+    }
+}
+
+void PcapExporter::add_part(
+    uint64_t chunk_end,
+    size_t num_later_bytes,
+    size_t bus_index,
+    const uint8_t* data,
+    size_t len) {
+    auto& bus = this->buses[bus_index];
+    auto part_start = bus.stream_len;
+
+    for (size_t i = 0; i < len; i++) {
+        bus.history[(part_start + i) % HISTORY_LEN] = data[i];
+    }
+
+    bus.stream_len += len;
+    Cursor cursor(data, len);
+
+    while (true) {
+        auto result = bus.parser.parse(cursor, &bus.packet);
+
+        switch (result) {
+            case ParseResult::NeedMoreData: {
+                return;
+            }
+            case ParseResult::PacketFragment: {
+                break;
+            }
+            case ParseResult::PacketAvailable:
+            case ParseResult::MismatchedChecksum: {
+                auto end_pos = len - cursor.remaining_bytes();
+                auto frame_len = bus.parser.raw_packet_len();
+                auto frame_end = part_start + end_pos;
+                uint8_t flags = 0;
+
+                if (result == ParseResult::MismatchedChecksum) {
+                    flags |= PCAP_FLAG_MISMATCHED_CHECKSUM;
+                }
+
+                if (bus.is_resync || frame_end - frame_len > bus.frame_end) {
+                    flags |= PCAP_FLAG_RESYNC;
+                }
+
+                // the packet ended when its last byte was received
+                auto num_bytes_after = (uint64_t) (num_later_bytes + len - end_pos);
+                auto received_later = num_bytes_after * this->byte_time;
+                auto timestamp = chunk_end > received_later ? chunk_end - received_later : 0;
+                bus.last_timestamp = std::max(bus.last_timestamp, timestamp);
+
+                this->add_frame(bus_index, frame_end, frame_len, bus.last_timestamp, flags);
+                bus.frame_end = frame_end;
+                bus.is_resync = false;
+                break;
+            }
+            default: {
+                bus.is_resync = true;
+                break;
+            }
+        }
+    }
+}
+
+void PcapExporter::add_frame(
+    size_t bus_index,
+    uint64_t end,
+    size_t len,
+    uint64_t timestamp,
+    uint8_t flags) {
+    auto& bus = this->buses[bus_index];
+    auto frame = this->writer->add_record(timestamp, PCAP_FRAME_HEADER_LEN + len);
+    frame[0] = (uint8_t) bus_index;
+    frame[1] = flags;
+    uint16_to_le(&frame[2], 0);
+
+    // the frame may wrap around the end of the ring buffer
+    auto start = (size_t) ((end - len) % HISTORY_LEN);
+    auto first_len = std::min(len, HISTORY_LEN - start);
+    memcpy(&frame[PCAP_FRAME_HEADER_LEN], &bus.history[start], first_len);
+    memcpy(&frame[PCAP_FRAME_HEADER_LEN + first_len], bus.history.data(), len - first_len);
+    this->num_frames_++;
+}
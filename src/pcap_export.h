@@ -0,0 +1,124 @@
+#ifndef PCAP_EXPORT_H
+#define PCAP_EXPORT_H
+
+#include "parser.h"
+
+#include <ostream>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/// The link type of exported frames, `LINKTYPE_USER0` (`DLT_USER0`). Wireshark decodes it with
+/// `etc/dynamixel.lua`.
+const uint32_t PCAP_LINK_TYPE = 147;
+
+/// Every frame starts with a link-layer header of `PCAP_FRAME_HEADER_LEN` bytes: the bus (u8),
+/// the `PCAP_FLAG_*` flags (u8) and a reserved u16, followed by the raw packet as it was
+/// received on the bus (including header, byte stuffing and checksum).
+const size_t PCAP_FRAME_HEADER_LEN = 4;
+
+/// The largest frame, a packet with the largest length field and the link-layer header.
+const size_t PCAP_MAX_FRAME_LEN = PCAP_FRAME_HEADER_LEN + 7 + 0xffff;
+
+/// The flags of a frame. The packet's checksum did not match the calculated one.
+const uint8_t PCAP_FLAG_MISMATCHED_CHECKSUM = 0x01;
+
+/// Bytes before the packet were skipped because they were not part of a valid packet, so the
+/// parser had to find the start of a packet again.
+const uint8_t PCAP_FLAG_RESYNC = 0x02;
+
+/// Writes records to a pcap file with nanosecond timestamps. Records are collected in a buffer
+/// that is allocated once and written to the stream when it is full, so writing a record
+/// never allocates.
+class PcapWriter {
+  public:
+    /// Writes the header of a pcap file with `link_type` to `out`. `buf_len` is the size of the
+    /// buffer, at least the size of the largest record.
+    PcapWriter(std::ostream* out, uint32_t link_type, size_t buf_len = 1 << 20);
+
+    PcapWriter(const PcapWriter&) = delete;
+
+    PcapWriter& operator=(const PcapWriter&) = delete;
+
+    ~PcapWriter();
+
+    /// Adds a record of `len` bytes with `timestamp` (in ns). Returns where the caller has to
+    /// store the record's data, which is valid until the next call.
+    uint8_t* add_record(uint64_t timestamp, size_t len);
+
+    /// Writes the buffered records to the stream.
+    void flush();
+
+    /// Returns `false` if writing to the stream failed.
+    bool is_ok() const {
+        return this->out->good();
+    }
+
+  private:
+    std::ostream* out;
+    std::vector<uint8_t> buf;
+    size_t buf_len;
+};
+
+/// Parses the data received on buses and adds every packet as a frame to a `PcapWriter`,
+/// including packets with mismatched checksums. The raw bytes of the last packets of every bus
+/// are kept in a ring buffer, so the frames are exactly what was received.
+class PcapExporter {
+  public:
+    /// Exports the packets of `num_buses` buses to `writer`. If `baudrate` is not 0, the time
+    /// at which a packet ended is calculated from the time its chunk ended instead of using the
+    /// chunk's timestamp for all packets of a chunk.
+    PcapExporter(PcapWriter* writer, size_t num_buses, uint32_t baudrate);
+
+    /// Parses `len` bytes received on `bus`, the last of them at `timestamp` (in us).
+    void add(uint64_t timestamp, size_t bus, const uint8_t* data, size_t len);
+
+    uint64_t num_frames() const {
+        return this->num_frames_;
+    }
+
+  private:
+    /// The size of the ring buffer of a bus. It holds a chunk of at most `MAX_CHUNK_LEN` bytes
+    /// together with a packet of the largest length that started before the chunk.
+    static const size_t HISTORY_LEN = 1 << 18;
+    static const size_t MAX_CHUNK_LEN = 1 << 16;
+
+    struct Bus {
+        Bus();
+
+        Parser parser;
+        Packet packet;
+        std::vector<uint8_t> history;
+
+        /// The number of bytes received on the bus so far.
+        uint64_t stream_len;
+
+        /// Where the last frame ended in the stream of bytes of the bus.
+        uint64_t frame_end;
+        uint64_t last_timestamp;
+
+        /// Whether the parser found an error since the last frame.
+        bool is_resync;
+    };
+
+    /// Parses a part of a chunk that is followed by `num_later_bytes` bytes of the chunk, which
+    /// ended at `chunk_end` (in ns).
+    void add_part(
+        uint64_t chunk_end,
+        size_t num_later_bytes,
+        size_t bus,
+        const uint8_t* data,
+        size_t len);
+
+    /// Adds the `len` bytes before `end` in the stream of `bus` as a frame.
+    void add_frame(size_t bus, uint64_t end, size_t len, uint64_t timestamp, uint8_t flags);
+
+    PcapWriter* writer;
+    std::vector<Bus> buses;
+
+    /// The time it takes to receive a byte (in ns, with start and stop bit), 0 if unknown.
+    uint64_t byte_time;
+    uint64_t num_frames_;
+};
+
+#endif
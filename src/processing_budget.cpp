@@ -0,0 +1,50 @@
+#include "processing_budget.h"
+
+ProcessingBudget::ProcessingBudget(uint32_t period, uint32_t budget, uint32_t min_headroom) :
+    period(period),
+    budget(budget),
+    min_headroom(min_headroom),
+    period_start(0),
+    used_(0) {}
+
+bool ProcessingBudget::may_continue(uint32_t now, int32_t headroom) {
+    this->update_period(now);
+
+    if (headroom < (int32_t) this->min_headroom) {
+        return true;
+    }
+
+    return this->used_ < this->budget;
+}
+
+void ProcessingBudget::consumed(uint32_t start, uint32_t end) {
+    this->update_period(start);
+    this->used_ += end - start;
+}
+
+uint32_t ProcessingBudget::resume_delay(uint32_t now, int32_t headroom) const {
+    auto elapsed = now - this->period_start;
+    auto delay = elapsed < this->period ? this->period - elapsed : 0;
+
+    // wake up in time to process the data before the headroom drops below the minimum
+    auto slack = headroom - (int32_t) this->min_headroom;
+
+    if (slack <= 0) {
+        return 0;
+    }
+
+    return delay < (uint32_t) slack ? delay : (uint32_t) slack;
+}
+
+void ProcessingBudget::update_period(uint32_t now) {
+    auto elapsed = now - this->period_start;
+
+    if (elapsed < this->period) {
+        return;
+    }
+
+    // periods are aligned to the first period, unless the task slept for longer than a
+    // whole period
+    this->period_start = elapsed < 2 * this->period ? this->period_start + this->period : now;
+    this->used_ = 0;
+}
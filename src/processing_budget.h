@@ -0,0 +1,49 @@
+#ifndef PROCESSING_BUDGET_H
+#define PROCESSING_BUDGET_H
+
+#include <stdint.h>
+
+/// Shares the CPU between the packet task and the UI task. Time is divided into periods of
+/// `period` ticks and the packet task may use up to `budget` ticks of every period; the rest
+/// is left to the UI, which runs whenever the packet task sleeps. The packet task processes
+/// received data in bounded slices and asks `may_continue` before every slice. Once its
+/// budget is used up, it yields until the next period starts.
+///
+/// Keeping up with the bus always takes precedence: as long as the headroom (the time until
+/// the DMA controller overwrites the oldest unprocessed byte at full load) is less than
+/// `min_headroom`, processing continues regardless of the budget, and a yield never lasts
+/// longer than the headroom allows.
+///
+/// All times are measured in `Clock` ticks.
+class ProcessingBudget {
+  public:
+    ProcessingBudget(uint32_t period, uint32_t budget, uint32_t min_headroom);
+
+    /// Returns `true` if the packet task may process the next slice. `headroom` is the
+    /// smallest headroom of all receive buffers.
+    bool may_continue(uint32_t now, int32_t headroom);
+
+    /// Accounts for a slice that was processed from `start` to `end`.
+    void consumed(uint32_t start, uint32_t end);
+
+    /// Returns the time the packet task should sleep after `may_continue` returned `false`,
+    /// i.e. until the next period starts or the headroom runs out.
+    uint32_t resume_delay(uint32_t now, int32_t headroom) const;
+
+    /// The time the packet task has used in the current period.
+    uint32_t used() const {
+        return this->used_;
+    }
+
+  private:
+    /// Starts a new period if the current one is over.
+    void update_period(uint32_t now);
+
+    uint32_t period;
+    uint32_t budget;
+    uint32_t min_headroom;
+    uint32_t period_start;
+    uint32_t used_;
+};
+
+#endif
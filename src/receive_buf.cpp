@@ -0,0 +1,124 @@
+#include "receive_buf.h"
+#include "clock.h"
+
+#include <algorithm>
+
+ReceiveBuf::ReceiveBuf(
+    volatile uint8_t* bytes,
+    size_t num_segments,
+    size_t segment_len,
+    const volatile uint32_t* dma_counter) :
+    num_completed_halves(0),
+    bytes_(bytes),
+    len_(num_segments * segment_len),
+    segment_len_(segment_len),
+    dma_counter(dma_counter) {}
+
+uint32_t ReceiveBuf::write_count() const {
+    // the counter is read after the number of halves, so the DMA controller is somewhere in
+    // the lap that started at the end of the last completed half, even if a callback has
+    // not run yet (the length is a power of two, so the counts wrap around at the end of a
+    // lap)
+    uint32_t last_half_end = this->num_completed_halves * (this->len_ / 2);
+    size_t write_pos = this->len_ - *this->dma_counter;
+    auto num_written = (write_pos + this->len_ - last_half_end % this->len_) % this->len_;
+    return last_half_end + num_written;
+}
+
+std::string to_string(const ReceiveResult& result) {
+    switch (result) {
+        case ReceiveResult::Ok: {
+            return "ok";
+        }
+        case ReceiveResult::SkippedSegments: {
+            return "skipped segments";
+        }
+        case ReceiveResult::OverwrittenSegment: {
+            return "segment overwritten while parsing";
+        }
+        case ReceiveResult::QueueOverflow: {
+            return "packet queue overflow";
+        }
+        default: { return "unknown"; }
+    }
+}
+
+ReceiveMonitor::ReceiveMonitor(uint32_t byte_duration) : byte_duration(byte_duration) {}
+
+uint32_t ReceiveMonitor::byte_duration_for_baudrate(uint32_t baudrate) {
+    // every byte is framed by a start and a stop bit
+    return (uint32_t) (10ull * 1000000 * Clock::TICKS_PER_US / baudrate);
+}
+
+ReceiveCheck ReceiveMonitor::check(
+    const ReceiveBuf& buf,
+    uint32_t segment_start,
+    uint32_t write_count,
+    uint32_t num_skipped_segments) const {
+    ReceiveCheck check{ReceiveResult::Ok, num_skipped_segments, 0};
+    check.headroom = this->headroom(buf, segment_start, write_count);
+
+    if (check.headroom < 0) {
+        check.result = ReceiveResult::OverwrittenSegment;
+    } else if (num_skipped_segments > 0) {
+        check.result = ReceiveResult::SkippedSegments;
+    }
+
+    return check;
+}
+
+int32_t ReceiveMonitor::headroom(const ReceiveBuf& buf, uint32_t pos, uint32_t write_count) const {
+    // the DMA controller overwrites the byte once it is a whole ring ahead of it
+    auto remaining_bytes = (int32_t) (pos + buf.len() - write_count);
+    return remaining_bytes * (int32_t) this->byte_duration;
+}
+
+ReceiveReader::ReceiveReader(uint32_t byte_duration) :
+    monitor(byte_duration),
+    read_count(0),
+    is_segment_complete(false),
+    num_skipped_segments(0) {}
+
+Cursor ReceiveReader::next(const ReceiveBuf& buf, uint32_t write_count, size_t max_len) {
+    auto segment_len = buf.segment_len();
+    uint32_t segment_start = this->read_count - this->read_count % segment_len;
+
+    // the DMA controller has lapped the reader and is overwriting the segment being read, so
+    // continue with the oldest segment that is still intact
+    if (write_count - segment_start >= buf.len()) {
+        uint32_t oldest_start = write_count - write_count % segment_len + segment_len - buf.len();
+        this->num_skipped_segments += (oldest_start - segment_start) / segment_len;
+        segment_start = oldest_start;
+        this->read_count = oldest_start;
+    }
+
+    uint32_t end = segment_start + segment_len;
+
+    if (write_count - segment_start < segment_len) {
+        // the segment is still being filled
+        end = write_count;
+    }
+
+    auto len = std::min((size_t) (end - this->read_count), max_len);
+    Cursor cursor(buf.bytes() + this->read_count % buf.len(), len);
+    this->read_count += len;
+    this->is_segment_complete = len > 0 && this->read_count % segment_len == 0;
+
+    return cursor;
+}
+
+bool ReceiveReader::finish(const ReceiveBuf& buf, ReceiveCheck* check) {
+    if (!this->is_segment_complete) {
+        return false;
+    }
+
+    *check = this->monitor.check(
+        buf,
+        this->read_count - buf.segment_len(),
+        buf.write_count(),
+        this->num_skipped_segments);
+    this->is_segment_complete = false;
+    this->num_skipped_segments = 0;
+
+    return true;
+}
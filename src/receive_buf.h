@@ -0,0 +1,173 @@
+#ifndef RECEIVE_BUF_H
+#define RECEIVE_BUF_H
+
+#include "cursor.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+/// The ring buffer that stores data received from a UART. Data is transferred by the DMA
+/// controller in circular mode. The ring is divided into segments, which are the unit in
+/// which the consumer (a `ReceiveReader`) hands over data and detects overruns. The DMA
+/// controller only signals when the front or the back half has been filled, which is used
+/// to count the laps around the ring; the position within the ring is read from the DMA
+/// controller's counter.
+class ReceiveBuf {
+  public:
+    enum class Half : uint8_t {
+        Front,
+        Back,
+    };
+
+    /// Creates a ring of `num_segments` segments with `segment_len` bytes each, stored in
+    /// `bytes`. The number of segments must be even (so the halves end at a segment
+    /// boundary) and the length of the ring a power of two. `dma_counter` points to the
+    /// number of bytes the DMA controller has left until it reaches the end of the ring
+    /// (the stream's `NDTR` register).
+    ReceiveBuf(
+        volatile uint8_t* bytes,
+        size_t num_segments,
+        size_t segment_len,
+        const volatile uint32_t* dma_counter);
+
+    size_t len() const {
+        return this->len_;
+    }
+
+    size_t segment_len() const {
+        return this->segment_len_;
+    }
+
+    size_t num_segments() const {
+        return this->len_ / this->segment_len_;
+    }
+
+    const volatile uint8_t* bytes() const {
+        return this->bytes_;
+    }
+
+    /// Returns the number of bytes the DMA controller has written since the transfer
+    /// started (modulo 2^32). The DMA callbacks must not fall behind by more than a half.
+    uint32_t write_count() const;
+
+    /// Marks `half` as filled. Called by the DMA callbacks (the producer).
+    void complete_half(Half half) {
+        // the front half is completed on odd and the back half on even counts
+        uint32_t count = this->num_completed_halves + 1;
+
+        if (count % 2 != (half == Half::Front ? 1 : 0)) {
+            count++;
+        }
+
+        this->num_completed_halves = count;
+    }
+
+    /// The number of halves that have been filled since the transfer started.
+    volatile uint32_t num_completed_halves;
+
+  private:
+    volatile uint8_t* bytes_;
+    size_t len_;
+    size_t segment_len_;
+    const volatile uint32_t* dma_counter;
+};
+
+/// The result of checking whether the packet task kept up with the DMA controller.
+enum class ReceiveResult {
+    Ok,
+
+    /// At least one segment was overwritten before it could be processed.
+    SkippedSegments,
+
+    /// The DMA controller started to overwrite the segment while it was being processed.
+    OverwrittenSegment,
+
+    /// A packet was dropped because the apply stage did not keep up (see `PacketQueue`).
+    QueueOverflow,
+};
+
+std::string to_string(const ReceiveResult& result);
+
+/// The result of `ReceiveMonitor::check`.
+struct ReceiveCheck {
+    ReceiveResult result;
+
+    /// The number of segments that were never processed.
+    uint32_t num_skipped_segments;
+
+    /// The time (in `Clock` ticks) the DMA controller would need to reach the processed
+    /// segment again if the bus was fully loaded. Negative if processing took too long.
+    int32_t headroom;
+};
+
+/// Detects when the consumer of a `ReceiveBuf` falls behind the DMA controller. Check
+/// every segment once it has been processed completely.
+class ReceiveMonitor {
+  public:
+    /// `byte_duration` is the minimum number of `Clock` ticks the DMA controller needs to
+    /// receive a byte (i.e. if the bus is fully loaded).
+    explicit ReceiveMonitor(uint32_t byte_duration);
+
+    /// Returns the minimum time needed to receive a byte at `baudrate` (8N1 framing), in
+    /// `Clock` ticks.
+    static uint32_t byte_duration_for_baudrate(uint32_t baudrate);
+
+    /// Checks the segment starting at `segment_start` (a `ReceiveBuf::write_count`) after
+    /// its last byte has been processed. `write_count` is the current position of the DMA
+    /// controller and `num_skipped_segments` the number of segments that were skipped
+    /// before this one.
+    ReceiveCheck check(
+        const ReceiveBuf& buf,
+        uint32_t segment_start,
+        uint32_t write_count,
+        uint32_t num_skipped_segments) const;
+
+    /// Returns the time the DMA controller needs at full load to overwrite the byte at
+    /// `pos` (a `ReceiveBuf::write_count`) if it is currently at `write_count`. Negative if
+    /// the byte has already been overwritten.
+    int32_t headroom(const ReceiveBuf& buf, uint32_t pos, uint32_t write_count) const;
+
+  private:
+    uint32_t byte_duration;
+};
+
+/// Reads a `ReceiveBuf` while the DMA controller is still writing to it. Instead of waiting
+/// until a segment has been filled, the bytes up to the DMA controller's current position
+/// can be processed right away.
+class ReceiveReader {
+  public:
+    explicit ReceiveReader(uint32_t byte_duration);
+
+    /// Returns a `Cursor` over the bytes that have been received since the last call (at
+    /// most `max_len`), up to `write_count` (a recent `ReceiveBuf::write_count`). The cursor
+    /// never extends past the end of a segment, so call `finish` and then `next` again until
+    /// the returned cursor is empty. The cursor must be read completely.
+    Cursor next(const ReceiveBuf& buf, uint32_t write_count, size_t max_len = SIZE_MAX);
+
+    /// Finishes reading the bytes returned by `next`. If they were the last bytes of a
+    /// segment, the segment is checked for overruns against the DMA controller's current
+    /// position, `check` is set and `true` is returned.
+    bool finish(const ReceiveBuf& buf, ReceiveCheck* check);
+
+    /// Returns the headroom (see `ReceiveMonitor::headroom`) of the oldest byte that has not
+    /// been read yet.
+    int32_t headroom(const ReceiveBuf& buf, uint32_t write_count) const {
+        return this->monitor.headroom(buf, this->read_count, write_count);
+    }
+
+  private:
+    ReceiveMonitor monitor;
+
+    /// The number of bytes read since the transfer started (modulo 2^32, like
+    /// `ReceiveBuf::write_count`).
+    uint32_t read_count;
+
+    /// Whether the last cursor returned by `next` ended at the end of a segment.
+    bool is_segment_complete;
+
+    /// The number of segments skipped since the last check.
+    uint32_t num_skipped_segments;
+};
+
+#endif
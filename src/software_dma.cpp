@@ -0,0 +1,33 @@
+#include "software_dma.h"
+
+#include <algorithm>
+#include <string.h>
+
+SoftwareDma::SoftwareDma(size_t num_segments, size_t segment_len) :
+    bytes(new uint8_t[num_segments * segment_len]),
+    dma_counter(num_segments * segment_len),
+    buf_(this->bytes.get(), num_segments, segment_len, &this->dma_counter),
+    write_pos(0) {}
+
+void SoftwareDma::write(const uint8_t* data, size_t len) {
+    auto buf_len = this->buf_.len();
+
+    while (len > 0) {
+        // stop at the end of every half to complete it before writing on
+        auto half_end = this->write_pos < buf_len / 2 ? buf_len / 2 : buf_len;
+        auto chunk_len = std::min(len, half_end - this->write_pos);
+        memcpy(&this->bytes[this->write_pos], data, chunk_len);
+        data += chunk_len;
+        len -= chunk_len;
+
+        // the counter is reloaded at the end of the ring before the callback runs
+        this->write_pos = (this->write_pos + chunk_len) % buf_len;
+        this->dma_counter = buf_len - this->write_pos;
+
+        if (this->write_pos == buf_len / 2) {
+            this->buf_.complete_half(ReceiveBuf::Half::Front);
+        } else if (this->write_pos == 0) {
+            this->buf_.complete_half(ReceiveBuf::Half::Back);
+        }
+    }
+}
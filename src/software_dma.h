@@ -0,0 +1,40 @@
+#ifndef SOFTWARE_DMA_H
+#define SOFTWARE_DMA_H
+
+#include "receive_buf.h"
+
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+
+/// Fills a `ReceiveBuf` like the DMA controller does on the target, for data that is
+/// received some other way (e.g. read from a serial port or a file on the host). This allows
+/// the unchanged packet pipeline (`Connection`, `PacketQueue`, `ApplyStage`) to run off the
+/// target.
+class SoftwareDma {
+  public:
+    /// Creates a ring of `num_segments` segments with `segment_len` bytes each (see
+    /// `ReceiveBuf::ReceiveBuf`).
+    SoftwareDma(size_t num_segments, size_t segment_len);
+
+    SoftwareDma(const SoftwareDma&) = delete;
+
+    SoftwareDma& operator=(const SoftwareDma&) = delete;
+
+    ReceiveBuf& buf() {
+        return this->buf_;
+    }
+
+    /// Appends `len` bytes to the ring, completing the halves on the way. Like the DMA
+    /// controller, this overwrites data that has not been processed yet, so the consumer
+    /// should process the ring after every half at the latest.
+    void write(const uint8_t* data, size_t len);
+
+  private:
+    std::unique_ptr<uint8_t[]> bytes;
+    volatile uint32_t dma_counter;
+    ReceiveBuf buf_;
+    size_t write_pos;
+};
+
+#endif
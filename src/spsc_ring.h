@@ -0,0 +1,75 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <type_traits>
+
+/// A wait-free ring buffer for exactly one producer and one consumer (e.g. two tasks or a
+/// task and an interrupt). Neither side ever blocks or allocates: `push` fails if the ring is
+/// full and `pop` fails if it is empty. `LEN` must be a power of two.
+template <typename T, size_t LEN>
+class SpscRing {
+  public:
+    static_assert(LEN > 0 && (LEN & (LEN - 1)) == 0, "length must be a power of two");
+    static_assert(std::is_trivially_copyable<T>::value, "items must be trivially copyable");
+
+    SpscRing() : write_index(0), read_index(0) {}
+
+    SpscRing(const SpscRing&) = delete;
+
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    /// Appends `item`. Returns `false` if the ring is full. Must only be called by the
+    /// producer.
+    bool push(const T& item) {
+        auto write_index = this->write_index.load(std::memory_order_relaxed);
+
+        if (write_index - this->read_index.load(std::memory_order_acquire) >= LEN) {
+            return false;
+        }
+
+        this->items[write_index & (LEN - 1)] = item;
+        this->write_index.store(write_index + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Removes the oldest item and stores it in `item`. Returns `false` if the ring is
+    /// empty. Must only be called by the consumer.
+    bool pop(T* item) {
+        auto read_index = this->read_index.load(std::memory_order_relaxed);
+
+        if (read_index == this->write_index.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        *item = this->items[read_index & (LEN - 1)];
+        this->read_index.store(read_index + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Returns the number of items in the ring. The result may already be outdated when
+    /// called concurrently.
+    size_t size() const {
+        // load the read index first, so it can never be ahead of the write index
+        auto read_index = this->read_index.load(std::memory_order_acquire);
+        return this->write_index.load(std::memory_order_acquire) - read_index;
+    }
+
+    /// Returns `true` if the ring is empty (see `size`).
+    bool is_empty() const {
+        return this->size() == 0;
+    }
+
+    static constexpr size_t capacity() {
+        return LEN;
+    }
+
+  private:
+    std::atomic<uint32_t> write_index;
+    std::atomic<uint32_t> read_index;
+    T items[LEN];
+};
+
+#endif
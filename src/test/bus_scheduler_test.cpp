@@ -0,0 +1,52 @@
+#include "bus_scheduler.h"
+#include <catch2/catch.hpp>
+
+#include <vector>
+
+/// Runs a pass where the buses have `num_bytes` bytes left each and returns the order of the
+/// turns.
+static std::vector<size_t> run_pass(BusScheduler& scheduler, std::vector<size_t> num_bytes) {
+    std::vector<size_t> turns;
+    size_t bus;
+    scheduler.begin();
+
+    while (scheduler.next(&bus)) {
+        turns.push_back(bus);
+        auto served = std::min(num_bytes[bus], scheduler.quantum());
+        num_bytes[bus] -= served;
+        scheduler.served(served);
+    }
+
+    return turns;
+}
+
+TEST_CASE("take turns", "[BusScheduler]") {
+    BusScheduler scheduler(3, 100);
+
+    SECTION("idle buses") {
+        REQUIRE(run_pass(scheduler, {0, 0, 0}) == std::vector<size_t>{0, 1, 2});
+    }
+
+    SECTION("a busy bus does not starve the others") {
+        auto turns = run_pass(scheduler, {350, 50, 150});
+        REQUIRE(turns == std::vector<size_t>{0, 1, 2, 0, 2, 0, 0});
+    }
+
+    SECTION("the first bus rotates") {
+        REQUIRE(run_pass(scheduler, {0, 0, 0}).front() == 0);
+        REQUIRE(run_pass(scheduler, {0, 0, 0}).front() == 1);
+        REQUIRE(run_pass(scheduler, {0, 0, 0}).front() == 2);
+        REQUIRE(run_pass(scheduler, {0, 0, 0}).front() == 0);
+    }
+
+    SECTION("a bus that uses its whole quantum gets another turn") {
+        // exactly one quantum left, the bus only notices that it ran out on its second turn
+        REQUIRE(run_pass(scheduler, {100, 0, 0}) == std::vector<size_t>{0, 1, 2, 0});
+    }
+}
+
+TEST_CASE("single bus", "[BusScheduler]") {
+    BusScheduler scheduler(1, 100);
+    REQUIRE(run_pass(scheduler, {250}) == std::vector<size_t>{0, 0, 0});
+    REQUIRE(run_pass(scheduler, {0}) == std::vector<size_t>{0});
+}
@@ -0,0 +1,121 @@
+#include "capture.h"
+#include "capture_codec.h"
+#include "test_packets.h"
+#include <catch2/catch.hpp>
+
+#include <sstream>
+
+/// Compresses a capture and decompresses it again.
+static std::string round_trip(const std::string& capture, size_t* compressed_len) {
+    std::stringstream out;
+    REQUIRE(compress_capture((const uint8_t*) capture.data(), capture.size(), &out)
+            == CaptureResult::Ok);
+
+    auto compressed = out.str();
+    *compressed_len = compressed.size();
+    CaptureDecoder decoder((const uint8_t*) compressed.data(), compressed.size());
+    REQUIRE(decoder.open() == CodecResult::Ok);
+    REQUIRE(decoder.capture_len() == capture.size());
+
+    std::vector<uint8_t> decompressed(
+        decoder.capture_header(),
+        decoder.capture_header() + CAPTURE_HEADER_LEN);
+    CodecResult result;
+
+    while ((result = decoder.next(&decompressed)) == CodecResult::Ok) {
+    }
+
+    REQUIRE(result == CodecResult::End);
+    return std::string(decompressed.begin(), decompressed.end());
+}
+
+TEST_CASE("compress captures", "[CaptureCodec]") {
+    std::stringstream out;
+    CaptureWriter writer(&out, 2);
+
+    // a control cycle: a sync write of changing goal positions and reads of every device
+    for (uint32_t i = 0; i < 500; i++) {
+        std::vector<uint8_t> sync_write{0x74, 0x00, 0x04, 0x00};
+
+        for (uint8_t id : {1, 2}) {
+            sync_write.push_back(id);
+            sync_write.insert(sync_write.end(), {(uint8_t) i, (uint8_t) (i >> 8), 0x00, 0x00});
+        }
+
+        auto packet = encode(0xfe, Instruction::SyncWrite, sync_write);
+
+        // split the packet across chunks
+        writer.write(i * 1000, 0, packet.data(), 5);
+        writer.write(i * 1000 + 10, 0, packet.data() + 5, packet.size() - 5);
+
+        for (uint8_t id : {1, 2}) {
+            auto read = encode(id, Instruction::Read, {0x84, 0x00, 0x04, 0x00});
+            auto status = encode(id, Instruction::Status, {(uint8_t) (i * id), 0x00, 0x00, 0x00});
+            read.insert(read.end(), status.begin(), status.end());
+            writer.write(i * 1000 + 100 * id, 1, read.data(), read.size());
+        }
+    }
+
+    // noise, an invalid checksum, a packet with byte stuffing and an interrupted packet
+    auto invalid = encode(1, Instruction::Ping, {});
+    invalid.back() ^= 0xff;
+    std::vector<uint8_t> stuffed{
+        0xff, 0xff, 0xfd, 0x00, 0x01, 0x09, 0x00, 0x03, 0x74, 0x00, 0xff, 0xff, 0xfd, 0xfd};
+    auto crc = update_crc(0, stuffed.data(), stuffed.size());
+    stuffed.push_back(crc & 0xff);
+    stuffed.push_back(crc >> 8);
+    auto interrupted = encode(2, Instruction::Read, {0x84, 0x00, 0x04, 0x00});
+    interrupted.resize(8);
+
+    std::vector<uint8_t> data{0x00, 0xff, 0xff, 0xfd, 0x12, 0x34};
+    data.insert(data.end(), invalid.begin(), invalid.end());
+    data.insert(data.end(), stuffed.begin(), stuffed.end());
+    data.insert(data.end(), interrupted.begin(), interrupted.end());
+    data.insert(data.end(), invalid.begin(), invalid.end());
+    writer.write(600000, 0, data.data(), data.size());
+
+    // a chunk that is stored as it is and a timestamp that goes back
+    writer.write(600001, 1, data.data(), 3, (CaptureChunkKind) 7);
+    writer.write(500000, 1, data.data(), 3);
+
+    // a packet that is not complete at the end of the capture
+    auto incomplete = encode(1, Instruction::Read, {0x84, 0x00, 0x04, 0x00});
+    writer.write(700000, 1, incomplete.data(), 9);
+
+    auto capture = out.str();
+    size_t compressed_len;
+
+    SECTION("restore them bit-exactly") {
+        REQUIRE(round_trip(capture, &compressed_len) == capture);
+        REQUIRE(compressed_len * 20 < capture.size());
+    }
+
+    SECTION("store truncated captures") {
+        capture.resize(capture.size() - 4);
+        REQUIRE(round_trip(capture, &compressed_len) == capture);
+    }
+
+    SECTION("detect invalid compressed captures") {
+        std::stringstream compressed_out;
+        compress_capture((const uint8_t*) capture.data(), capture.size(), &compressed_out);
+        auto compressed = compressed_out.str();
+
+        CaptureDecoder truncated((const uint8_t*) compressed.data(), compressed.size() / 2);
+        REQUIRE(truncated.open() == CodecResult::Ok);
+        std::vector<uint8_t> decompressed;
+        CodecResult result;
+
+        while ((result = truncated.next(&decompressed)) == CodecResult::Ok) {
+        }
+
+        REQUIRE(result == CodecResult::Corrupted);
+
+        compressed[4] = COMPRESSED_CAPTURE_VERSION + 1;
+        CaptureDecoder newer((const uint8_t*) compressed.data(), compressed.size());
+        REQUIRE(newer.open() == CodecResult::UnsupportedVersion);
+
+        compressed[0] = 'X';
+        CaptureDecoder invalid((const uint8_t*) compressed.data(), compressed.size());
+        REQUIRE(invalid.open() == CodecResult::InvalidMagic);
+    }
+}
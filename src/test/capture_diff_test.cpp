@@ -0,0 +1,108 @@
+#include "capture_diff.h"
+#include "test_packets.h"
+#include <catch2/catch.hpp>
+
+#include <sstream>
+
+/// Creates a capture of a control loop with two MX-64s that runs every 10 ms, starting at
+/// `start`. From cycle 10 on, the goal position of device 2 is off by `offset`. Device 3 is
+/// only pinged if `has_device_3` is set.
+static std::string create_capture(uint64_t start, uint8_t offset, bool has_device_3) {
+    std::stringstream out;
+    CaptureWriter writer(&out, 1);
+    std::vector<uint8_t> data;
+
+    for (uint8_t id = 1; id <= (has_device_3 ? 3 : 2); id++) {
+        data.clear();
+        append_mx64_ping(&data, id);
+        writer.write(start, 0, data.data(), data.size());
+    }
+
+    for (uint8_t i = 1; i <= 20; i++) {
+        uint8_t position = i >= 10 ? i + offset : i;
+        data = encode(
+            0xfe,
+            Instruction::SyncWrite,
+            {0x74, 0x00, 0x04, 0x00, 0x01, i, 0x00, 0x00, 0x00, 0x02, position, 0x00, 0x00, 0x00});
+        writer.write(start + i * 10000, 0, data.data(), data.size());
+
+        data = encode(1, Instruction::Read, {0x84, 0x00, 0x04, 0x00});
+        auto status = encode(1, Instruction::Status, {i, 0x00, 0x00, 0x00});
+        data.insert(data.end(), status.begin(), status.end());
+        writer.write(start + i * 10000 + 2000, 0, data.data(), data.size());
+    }
+
+    return out.str();
+}
+
+TEST_CASE("compare captures by cycle", "[CaptureDiff]") {
+    auto good = create_capture(0, 0, false);
+    CaptureReader good_reader((const uint8_t*) good.data(), good.size());
+    REQUIRE(good_reader.open() == CaptureResult::Ok);
+
+    SECTION("equal captures with different timing") {
+        auto bad = create_capture(3000, 0, false);
+        CaptureReader bad_reader((const uint8_t*) bad.data(), bad.size());
+        REQUIRE(bad_reader.open() == CaptureResult::Ok);
+
+        CaptureDiff diff(&good_reader, &bad_reader, Instruction::SyncWrite);
+
+        while (diff.next()) {
+        }
+
+        REQUIRE(diff.num_cycles() == 21);
+        REQUIRE(diff.num_differing_cycles() == 0);
+        REQUIRE(diff.result(0) == CaptureResult::End);
+        REQUIRE(diff.result(1) == CaptureResult::End);
+    }
+
+    SECTION("different captures") {
+        auto bad = create_capture(3000, 5, true);
+        CaptureReader bad_reader((const uint8_t*) bad.data(), bad.size());
+        REQUIRE(bad_reader.open() == CaptureResult::Ok);
+
+        CaptureDiff diff(&good_reader, &bad_reader, Instruction::SyncWrite);
+
+        while (diff.next()) {
+        }
+
+        REQUIRE(diff.num_cycles() == 21);
+        REQUIRE(diff.num_differing_cycles() == 21);
+
+        REQUIRE(diff.devices().size() == 1);
+        auto& device = diff.devices()[0];
+        REQUIRE(device.device_id == DeviceId(3));
+        REQUIRE(device.cycle == 0);
+        REQUIRE_FALSE(device.is_present[0]);
+        REQUIRE(device.is_present[1]);
+        REQUIRE(device.model_numbers[1] == 311);
+
+        REQUIRE(diff.fields().size() == 1);
+        auto& field = diff.fields()[0];
+        REQUIRE(field.device_id == DeviceId(2));
+        REQUIRE(field.name == "Goal Position");
+        REQUIRE(field.first_cycle == 10);
+        REQUIRE(field.first_timestamps[0] == 100000);
+        REQUIRE(field.first_timestamps[1] == 103000);
+        REQUIRE(field.first_values[0] == 10);
+        REQUIRE(field.first_values[1] == 15);
+        REQUIRE(field.num_cycles == 11);
+        REQUIRE(field.max_diff == 5.0);
+        REQUIRE(field.sum_diff == 55.0);
+    }
+
+    SECTION("captures of different lengths") {
+        auto bad = good.substr(0, good.size() / 2);
+        CaptureReader bad_reader((const uint8_t*) bad.data(), bad.size());
+        REQUIRE(bad_reader.open() == CaptureResult::Ok);
+
+        CaptureDiff diff(&good_reader, &bad_reader, Instruction::SyncWrite);
+
+        while (diff.next()) {
+        }
+
+        REQUIRE(diff.num_cycles() < 21);
+        REQUIRE(diff.result(0) == CaptureResult::Ok);
+        REQUIRE(diff.result(1) != CaptureResult::Ok);
+    }
+}
@@ -0,0 +1,131 @@
+#include "capture.h"
+#include "capture_index.h"
+#include "test_packets.h"
+#include "varint.h"
+#include <catch2/catch.hpp>
+
+#include <sstream>
+
+/// Scans a capture and returns its index.
+static std::string build_index(const std::string& capture) {
+    CaptureReader reader((const uint8_t*) capture.data(), capture.size());
+    REQUIRE(reader.open() == CaptureResult::Ok);
+
+    CaptureScanner scanner(&reader);
+    CaptureIndexBuilder builder(reader.num_buses());
+    ScannedPacket packet;
+
+    while (scanner.next(&packet) == CaptureResult::Ok) {
+        builder.add(packet);
+    }
+
+    std::stringstream out;
+    builder.write(&out, capture.size());
+    return out.str();
+}
+
+TEST_CASE("encode varints", "[CaptureIndex]") {
+    std::vector<uint8_t> data;
+    append_varint(0, &data);
+    append_varint(300, &data);
+    append_varint(UINT64_MAX, &data);
+    append_varint(zigzag_encode(-3), &data);
+    REQUIRE(data.size() == 1 + 2 + 10 + 1);
+
+    uint64_t value;
+    REQUIRE(read_varint(&data[1], data.size() - 1, &value) == 2);
+    REQUIRE(value == 300);
+    REQUIRE(read_varint(&data[3], data.size() - 3, &value) == 10);
+    REQUIRE(value == UINT64_MAX);
+    REQUIRE(read_varint(&data[13], 1, &value) == 1);
+    REQUIRE(zigzag_decode(value) == -3);
+
+    // truncated
+    REQUIRE(read_varint(&data[1], 1, &value) == 0);
+}
+
+TEST_CASE("index captures", "[CaptureIndex]") {
+    std::stringstream out;
+    CaptureWriter writer(&out, 2);
+    std::vector<size_t> chunk_offsets;
+    size_t offset = CAPTURE_HEADER_LEN;
+
+    auto write = [&](uint64_t timestamp, size_t bus, const std::vector<uint8_t>& data) {
+        writer.write(timestamp, bus, data.data(), data.size());
+        chunk_offsets.push_back(offset);
+        offset += CAPTURE_CHUNK_HEADER_LEN + data.size();
+    };
+
+    // enough reads of device 1 for several blocks
+    for (uint64_t i = 0; i < 300; i++) {
+        write(i * 1000, 0, encode(1, Instruction::Read, {0x84, 0x00, 0x04, 0x00}));
+        write(i * 1000 + 500, 0, encode(1, Instruction::Status, {0x01, 0x02, 0x03, 0x04}));
+    }
+
+    // a sync write to devices 2 and 3 that is received in fragments
+    std::vector<uint8_t> sync_write{0x74, 0x00, 0xc8, 0x00};
+
+    for (uint8_t id : {2, 3}) {
+        sync_write.push_back(id);
+        sync_write.insert(sync_write.end(), 200, id);
+    }
+
+    write(400000, 1, encode(0xfe, Instruction::SyncWrite, sync_write));
+
+    auto capture = out.str();
+    auto index_data = build_index(capture);
+    CaptureIndex index((const uint8_t*) index_data.data(), index_data.size());
+    REQUIRE(index.open(capture.size()) == CaptureIndexResult::Ok);
+
+    std::vector<IndexEntry> entries;
+    REQUIRE(index.find(IndexKey::device(DeviceId(1)), 0, UINT64_MAX, &entries)
+            == CaptureIndexResult::Ok);
+    REQUIRE(entries.size() == 600);
+    REQUIRE(entries[1].timestamp == 500);
+    REQUIRE(entries[1].location == PacketLocation{chunk_offsets[1], 0});
+    REQUIRE(entries[599].location == PacketLocation{chunk_offsets[599], 0});
+
+    entries.clear();
+    REQUIRE(index.find(IndexKey::instruction(Instruction::Status), 200000, 201000, &entries)
+            == CaptureIndexResult::Ok);
+    REQUIRE(entries.size() == 1);
+    REQUIRE(entries[0].timestamp == 200500);
+    REQUIRE(entries[0].location == PacketLocation{chunk_offsets[401], 0});
+
+    for (uint8_t id : {2, 3, 0xfe}) {
+        entries.clear();
+        REQUIRE(index.find(IndexKey::device(DeviceId(id)), 0, UINT64_MAX, &entries)
+                == CaptureIndexResult::Ok);
+        REQUIRE(entries.size() == 1);
+        REQUIRE(entries[0].location == PacketLocation{chunk_offsets.back(), 0});
+    }
+
+    entries.clear();
+    REQUIRE(index.find(IndexKey::device(DeviceId(4)), 0, UINT64_MAX, &entries)
+            == CaptureIndexResult::Ok);
+    REQUIRE(entries.empty());
+
+    SECTION("parse indexed packets") {
+        CaptureReader reader((const uint8_t*) capture.data(), capture.size());
+        REQUIRE(reader.open() == CaptureResult::Ok);
+        CaptureScanner scanner(&reader);
+        ScannedPacket packet;
+
+        scanner.seek(PacketLocation{chunk_offsets[401], 0});
+        REQUIRE(scanner.next(&packet) == CaptureResult::Ok);
+        REQUIRE(packet.result == ParseResult::PacketAvailable);
+        REQUIRE(packet.timestamp == 200500);
+        REQUIRE(packet.packet->instruction == Instruction::Status);
+    }
+
+    SECTION("mismatched captures") {
+        REQUIRE(index.open(capture.size() + 1) == CaptureIndexResult::MismatchedCapture);
+
+        CaptureIndex truncated_index((const uint8_t*) index_data.data(), 100);
+        REQUIRE(truncated_index.open(capture.size()) == CaptureIndexResult::Corrupted);
+
+        index_data[0] = 'X';
+        CaptureIndex invalid_index((const uint8_t*) index_data.data(), index_data.size());
+        REQUIRE(invalid_index.open(capture.size()) == CaptureIndexResult::InvalidMagic);
+    }
+}
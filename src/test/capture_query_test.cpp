@@ -0,0 +1,142 @@
+#include "capture.h"
+#include "capture_query.h"
+#include "test_packets.h"
+#include <catch2/catch.hpp>
+
+#include <sstream>
+
+/// Runs a query over the whole capture and returns the timestamps of the matching packets.
+static std::vector<uint64_t> run_query(
+    const std::string& capture,
+    const std::vector<std::string>& filters,
+    std::vector<QueryFieldValue>* field_values = nullptr) {
+    CaptureReader reader((const uint8_t*) capture.data(), capture.size());
+    REQUIRE(reader.open() == CaptureResult::Ok);
+
+    CaptureQuery query(reader.num_buses());
+    std::string error;
+
+    for (auto& filter : filters) {
+        REQUIRE(query.add_filter(filter, &error));
+    }
+
+    CaptureScanner scanner(&reader);
+    ScannedPacket packet;
+    std::vector<uint64_t> timestamps;
+
+    while (scanner.next(&packet) == CaptureResult::Ok) {
+        if (query.matches(packet)) {
+            timestamps.push_back(packet.timestamp);
+
+            if (field_values != nullptr) {
+                auto& values = query.field_values();
+                field_values->insert(field_values->end(), values.begin(), values.end());
+            }
+        }
+    }
+
+    return timestamps;
+}
+
+TEST_CASE("query captures", "[CaptureQuery]") {
+    std::stringstream out;
+    CaptureWriter writer(&out, 2);
+    std::vector<uint8_t> data;
+
+    for (uint8_t id : {1, 2}) {
+        data.clear();
+        append_mx64_ping(&data, id);
+        writer.write(0, 0, data.data(), data.size());
+    }
+
+    // a goal position for both devices and the present position of device 1 every 10 ms
+    for (uint8_t i = 1; i <= 30; i++) {
+        data = encode(
+            0xfe,
+            Instruction::SyncWrite,
+            {0x74, 0x00, 0x04, 0x00, 0x01, i, 0x00, 0x00, 0x00, 0x02, (uint8_t) (i + 100), 0x00,
+             0x00, 0x00});
+        writer.write(i * 10000, 0, data.data(), data.size());
+
+        data = encode(1, Instruction::Read, {0x84, 0x00, 0x04, 0x00});
+        auto status = encode(1, Instruction::Status, {i, 0x01, 0x00, 0x00}, i == 20 ? 0x80 : 0);
+        data.insert(data.end(), status.begin(), status.end());
+        writer.write(i * 10000 + 5000, 1, data.data(), data.size());
+    }
+
+    auto capture = out.str();
+    std::vector<QueryFieldValue> values;
+
+    SECTION("filter by header") {
+        REQUIRE(run_query(capture, {"instruction=SyncWrite"}).size() == 30);
+        REQUIRE(run_query(capture, {"bus=1", "instruction!=Read"}).size() == 30);
+        REQUIRE(run_query(capture, {"status.error!=0"}) == std::vector<uint64_t>{205000});
+        REQUIRE(
+            run_query(capture, {"instruction=SyncWrite", "t=100ms..120ms"})
+            == std::vector<uint64_t>{100000, 110000, 120000});
+        REQUIRE(run_query(capture, {"instruction=SyncWrite", "t>0.29s"}).size() == 1);
+    }
+
+    SECTION("filter by device") {
+        // the sync writes address both devices
+        REQUIRE(run_query(capture, {"device=2"}).size() == 2 + 30);
+        REQUIRE(run_query(capture, {"device=1"}).size() == 2 + 30 * 3);
+        REQUIRE(run_query(capture, {"device=3"}).empty());
+    }
+
+    SECTION("filter by field") {
+        auto timestamps = run_query(
+            capture,
+            {"device=2", "instruction=SyncWrite", "field=\"Goal Position\"", "t=120s..180s"});
+        REQUIRE(timestamps.empty());
+
+        timestamps = run_query(
+            capture,
+            {"device=2", "instruction=SyncWrite", "field=Goal Position", "t=120ms..180ms"},
+            &values);
+        REQUIRE(timestamps.size() == 7);
+        REQUIRE(values.size() == 7);
+        REQUIRE(values[0].device_id == DeviceId(2));
+        REQUIRE(values[0].value == 112);
+
+        // status packets are matched with the read before them
+        values.clear();
+        timestamps = run_query(capture, {"instruction=Status", "field=Present Position"}, &values);
+        REQUIRE(timestamps.size() == 30);
+        REQUIRE(values.size() == 30);
+        REQUIRE(values[29].device_id == DeviceId(1));
+        REQUIRE(values[29].value == 30 + 256);
+
+        REQUIRE(run_query(capture, {"field=Present Position"}).size() == 60);
+        REQUIRE(run_query(capture, {"field=Goal Velocity"}).empty());
+    }
+
+    SECTION("use indices") {
+        CaptureQuery query(2);
+        std::vector<IndexKey> keys;
+        std::string error;
+        REQUIRE_FALSE(query.index_keys(&keys));
+
+        REQUIRE(query.add_filter("device=5", &error));
+        REQUIRE(query.add_filter("instruction=Status", &error));
+        REQUIRE(query.index_keys(&keys));
+        REQUIRE(keys.size() == 2);
+
+        // status packets need the instruction before them
+        REQUIRE(query.add_filter("field=Goal Position", &error));
+        REQUIRE_FALSE(query.index_keys(&keys));
+    }
+
+    SECTION("reject invalid filters") {
+        CaptureQuery query(2);
+        std::string error;
+        REQUIRE_FALSE(query.add_filter("device", &error));
+        REQUIRE_FALSE(query.add_filter("device=x", &error));
+        REQUIRE_FALSE(query.add_filter("instruction>Status", &error));
+        REQUIRE_FALSE(query.add_filter("instruction=Jump", &error));
+        REQUIRE_FALSE(query.add_filter("t=1s..", &error));
+        REQUIRE_FALSE(query.add_filter("field=Color", &error));
+        REQUIRE_FALSE(query.add_filter("color=red", &error));
+        REQUIRE(error == "unknown filter `color`");
+    }
+}
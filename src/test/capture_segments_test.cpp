@@ -0,0 +1,225 @@
+#include "capture.h"
+#include "capture_segments.h"
+#include "test_packets.h"
+#include <catch2/catch.hpp>
+
+#include <sstream>
+
+/// Appends bytes that never contain a header.
+static void append_noise(std::vector<uint8_t>* data, size_t len, uint32_t* seed) {
+    for (size_t i = 0; i < len; i++) {
+        *seed = *seed * 1103515245 + 12345;
+        data->push_back((uint8_t) (*seed >> 16) & 0x7f);
+    }
+}
+
+/// Returns all fields of a result, so results can be compared.
+static std::string describe(const ScannedPacket& packet) {
+    std::stringstream out;
+    out << packet.bus << " " << to_string(packet.result) << " " << packet.timestamp << " "
+        << packet.location.chunk_offset << ":" << packet.location.pos << " "
+        << packet.end.chunk_offset << ":" << packet.end.pos << " "
+        << (int) packet.packet->device_id.to_byte() << " " << to_string(packet.packet->instruction)
+        << " " << (int) packet.packet->error.to_byte() << " " << packet.packet->data_offset << ":";
+
+    for (auto byte : packet.packet->data) {
+        out << " " << (int) byte;
+    }
+
+    return out.str();
+}
+
+/// Scans all segments and merges them.
+static std::vector<std::string> scan_segments(
+    const std::string& capture,
+    size_t segment_len,
+    size_t* num_resyncs) {
+    auto data = (const uint8_t*) capture.data();
+    CaptureReader reader(data, capture.size());
+    REQUIRE(reader.open() == CaptureResult::Ok);
+
+    std::vector<size_t> boundaries;
+    REQUIRE(split_capture(&reader, segment_len, &boundaries) == CaptureResult::End);
+    REQUIRE(boundaries.front() == CAPTURE_HEADER_LEN);
+    REQUIRE(boundaries.back() == capture.size());
+
+    SegmentMerger merger(reader.num_buses());
+    CaptureSegment segment;
+    ScannedPacket packet;
+    std::vector<std::string> packets;
+
+    for (size_t i = 0; i + 1 < boundaries.size(); i++) {
+        scan_segment(data, boundaries, i, &segment);
+        merger.add(&segment);
+
+        while (merger.next(&packet)) {
+            packets.push_back(describe(packet));
+        }
+    }
+
+    merger.finish();
+
+    while (merger.next(&packet)) {
+        packets.push_back(describe(packet));
+    }
+
+    *num_resyncs = merger.num_resyncs();
+    return packets;
+}
+
+TEST_CASE("scan segments of a capture", "[CaptureSegments]") {
+    std::vector<std::vector<uint8_t>> buses(3);
+    uint32_t seed = 1;
+
+    for (uint8_t i = 0; i < 150; i++) {
+        append(
+            &buses[0], encode(0xfe, Instruction::SyncRead, {0x84, 0x00, 0x04, 0x00, 0x01, 0x02}));
+        append(&buses[0], encode(1, Instruction::Status, {i, 0x00, 0x00, 0x00}));
+        append(&buses[0], encode(2, Instruction::Status, {i, 0x01, 0x00, 0x00}));
+
+        // large packets are returned in fragments
+        if (i % 20 == 0) {
+            std::vector<uint8_t> sync_write{0x74, 0x00, 0xc8, 0x00};
+
+            for (uint8_t id : {1, 2}) {
+                sync_write.push_back(id);
+                sync_write.insert(sync_write.end(), 200, i);
+            }
+
+            append(&buses[0], encode(0xfe, Instruction::SyncWrite, sync_write));
+        }
+
+        if (i % 7 == 0) {
+            auto packet = encode(1, Instruction::Status, {i, 0x00, 0x00, 0x00});
+            packet.back() ^= 0x01;
+            append(&buses[0], packet);
+        }
+
+        // the next header interrupts the packet
+        if (i % 11 == 0) {
+            auto packet = encode(1, Instruction::Status, {i, 0x00, 0x00, 0x00});
+            buses[0].insert(buses[0].end(), packet.begin(), packet.begin() + 9);
+        }
+
+        // the second bus is silent after a while
+        if (i < 70) {
+            append(&buses[1], encode(3, Instruction::Read, {0x00, 0x00, 0x02, 0x00}));
+            append(&buses[1], encode(3, Instruction::Status, {i, 0x02}));
+        }
+    }
+
+    // the third bus receives noise that spans several segments
+    append_noise(&buses[2], 20000, &seed);
+
+    for (uint8_t i = 0; i < 100; i++) {
+        append_mx64_ping(&buses[2], i);
+    }
+
+    append_noise(&buses[2], 500, &seed);
+
+    // the chunks of all buses are interleaved and have different lengths
+    std::stringstream out;
+    CaptureWriter writer(&out, buses.size());
+    std::vector<size_t> positions(buses.size(), 0);
+    uint64_t timestamp = 0;
+    auto is_done = false;
+
+    while (!is_done) {
+        is_done = true;
+
+        for (size_t bus = 0; bus < buses.size(); bus++) {
+            auto& pos = positions[bus];
+            seed = seed * 1103515245 + 12345;
+            auto len = std::min<size_t>(1 + (seed >> 16) % 64, buses[bus].size() - pos);
+
+            if (len > 0) {
+                writer.write(timestamp, bus, buses[bus].data() + pos, len);
+                pos += len;
+                timestamp += 10;
+                is_done = false;
+            }
+        }
+    }
+
+    auto capture = out.str();
+    CaptureReader reader((const uint8_t*) capture.data(), capture.size());
+    REQUIRE(reader.open() == CaptureResult::Ok);
+
+    CaptureScanner scanner(&reader);
+    ScannedPacket packet;
+    std::vector<std::string> expected;
+
+    while (scanner.next(&packet) == CaptureResult::Ok) {
+        expected.push_back(describe(packet));
+    }
+
+    size_t num_resyncs;
+
+    SECTION("the merged segments are the same as the whole capture") {
+        for (size_t segment_len : {0, 300, 2000, 5000, 30000, 1000000}) {
+            REQUIRE(scan_segments(capture, segment_len, &num_resyncs) == expected);
+        }
+    }
+
+    SECTION("buses are resynchronized after long packets and noise") {
+        std::vector<std::vector<uint8_t>> parts(3);
+        std::vector<uint8_t> sync_write{0x74, 0x00, 0xc8, 0x00};
+
+        for (uint8_t id = 1; id <= 20; id++) {
+            sync_write.push_back(id);
+            sync_write.insert(sync_write.end(), 200, id);
+        }
+
+        for (uint8_t id : {1, 2, 3}) {
+            append(&parts[0], encode(id, Instruction::Ping, {}));
+            append(&parts[2], encode(id, Instruction::Ping, {}));
+        }
+
+        append_noise(&parts[0], 600, &seed);
+        append(&parts[0], encode(0xfe, Instruction::SyncWrite, sync_write));
+
+        // the first bus is silent for several segments
+        for (uint8_t id = 0; id < 100; id++) {
+            append(&parts[1], encode(id, Instruction::Ping, {}));
+        }
+
+        std::stringstream large_out;
+        CaptureWriter large_writer(&large_out, 2);
+        uint64_t large_timestamp = 0;
+
+        for (size_t part = 0; part < parts.size(); part++) {
+            auto& data = parts[part];
+
+            for (size_t pos = 0; pos < data.size(); pos += 50) {
+                auto len = std::min<size_t>(50, data.size() - pos);
+                large_writer.write(large_timestamp, part % 2, data.data() + pos, len);
+                large_timestamp += 10;
+            }
+        }
+
+        auto large_capture = large_out.str();
+        CaptureReader large_reader((const uint8_t*) large_capture.data(), large_capture.size());
+        REQUIRE(large_reader.open() == CaptureResult::Ok);
+
+        CaptureScanner large_scanner(&large_reader);
+        std::vector<std::string> large_expected;
+
+        while (large_scanner.next(&packet) == CaptureResult::Ok) {
+            large_expected.push_back(describe(packet));
+        }
+
+        REQUIRE(scan_segments(large_capture, 1000000, &num_resyncs) == large_expected);
+        REQUIRE(num_resyncs == 0);
+
+        REQUIRE(scan_segments(large_capture, 200, &num_resyncs) == large_expected);
+        REQUIRE(num_resyncs > 0);
+    }
+
+    SECTION("an empty capture has no segments") {
+        std::stringstream empty_out;
+        CaptureWriter empty_writer(&empty_out, 1);
+        auto empty = empty_out.str();
+
+        REQUIRE(scan_segments(empty, 1000, &num_resyncs).empty());
+    }
+}
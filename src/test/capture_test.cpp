@@ -0,0 +1,175 @@
+#include "capture.h"
+#include "test_packets.h"
+#include <catch2/catch.hpp>
+
+#include <sstream>
+
+TEST_CASE("write and read captures", "[Capture]") {
+    std::stringstream out;
+    CaptureWriter writer(&out, 2);
+    const uint8_t data_0[] = {0xff, 0xff, 0xfd, 0x00};
+    const uint8_t data_1[] = {0x01};
+    writer.write(10, 0, data_0, sizeof(data_0));
+    writer.write(2000, 1, data_1, sizeof(data_1));
+    writer.write(2000, 1, nullptr, 0);
+    REQUIRE(writer.is_ok());
+
+    auto capture = out.str();
+    REQUIRE(capture.size() == CAPTURE_HEADER_LEN + 3 * CAPTURE_CHUNK_HEADER_LEN + 5);
+
+    CaptureReader reader((const uint8_t*) capture.data(), capture.size());
+    CaptureChunk chunk;
+    REQUIRE(reader.open() == CaptureResult::Ok);
+    REQUIRE(reader.num_buses() == 2);
+
+    REQUIRE(reader.next(&chunk) == CaptureResult::Ok);
+    REQUIRE(chunk.timestamp == 10);
+    REQUIRE(chunk.bus == 0);
+    REQUIRE(chunk.kind == CaptureChunkKind::Data);
+    REQUIRE(chunk.len == sizeof(data_0));
+    REQUIRE(chunk.offset == CAPTURE_HEADER_LEN);
+
+    // the data is not copied
+    REQUIRE(chunk.data == (const uint8_t*) capture.data() + CAPTURE_HEADER_LEN
+            + CAPTURE_CHUNK_HEADER_LEN);
+    REQUIRE(chunk.data[2] == 0xfd);
+
+    auto second_offset = reader.offset();
+    REQUIRE(reader.next(&chunk) == CaptureResult::Ok);
+    REQUIRE(chunk.timestamp == 2000);
+    REQUIRE(chunk.bus == 1);
+    REQUIRE(chunk.len == 1);
+    REQUIRE(chunk.data[0] == 0x01);
+
+    REQUIRE(reader.next(&chunk) == CaptureResult::Ok);
+    REQUIRE(chunk.len == 0);
+    REQUIRE(reader.next(&chunk) == CaptureResult::End);
+
+    reader.seek(second_offset);
+    REQUIRE(reader.next(&chunk) == CaptureResult::Ok);
+    REQUIRE(chunk.offset == second_offset);
+
+    SECTION("truncated chunks") {
+        CaptureReader truncated_reader((const uint8_t*) capture.data(), capture.size() - 1);
+        REQUIRE(truncated_reader.open() == CaptureResult::Ok);
+        REQUIRE(truncated_reader.next(&chunk) == CaptureResult::Ok);
+        REQUIRE(truncated_reader.next(&chunk) == CaptureResult::Ok);
+        REQUIRE(truncated_reader.next(&chunk) == CaptureResult::TruncatedChunk);
+
+        CaptureReader truncated_data_reader(
+            (const uint8_t*) capture.data(),
+            CAPTURE_HEADER_LEN + CAPTURE_CHUNK_HEADER_LEN + 1);
+        REQUIRE(truncated_data_reader.open() == CaptureResult::Ok);
+        REQUIRE(truncated_data_reader.next(&chunk) == CaptureResult::TruncatedChunk);
+    }
+
+    SECTION("invalid headers") {
+        capture[6] = 1;
+        CaptureReader one_bus_reader((const uint8_t*) capture.data(), capture.size());
+        REQUIRE(one_bus_reader.open() == CaptureResult::Ok);
+        REQUIRE(one_bus_reader.next(&chunk) == CaptureResult::Ok);
+        REQUIRE(one_bus_reader.next(&chunk) == CaptureResult::InvalidBus);
+
+        capture[4] = 2;
+        CaptureReader version_reader((const uint8_t*) capture.data(), capture.size());
+        REQUIRE(version_reader.open() == CaptureResult::UnsupportedVersion);
+
+        capture[0] = 'X';
+        CaptureReader magic_reader((const uint8_t*) capture.data(), capture.size());
+        REQUIRE(magic_reader.open() == CaptureResult::InvalidMagic);
+    }
+}
+
+TEST_CASE("scan the packets of captures", "[Capture]") {
+    std::stringstream out;
+    CaptureWriter writer(&out, 2);
+    auto packet_0 = encode(1, Instruction::Status, {0x10, 0x11});
+    auto packet_1 = encode(2, Instruction::Status, std::vector<uint8_t>(300, 0x20));
+    auto packet_2 = encode(3, Instruction::Status, {});
+
+    // the second packet starts after some garbage and is split over chunks of both buses
+    std::vector<uint8_t> data_0(packet_0);
+    data_0.push_back(0x42);
+    data_0.insert(data_0.end(), packet_1.begin(), packet_1.begin() + 20);
+    std::vector<uint8_t> data_1(packet_1.begin() + 20, packet_1.end());
+    data_1.insert(data_1.end(), packet_2.begin(), packet_2.end());
+
+    writer.write(10, 0, data_0.data(), data_0.size());
+    writer.write(20, 1, packet_2.data(), packet_2.size());
+    writer.write(30, 0, data_1.data(), data_1.size());
+
+    auto capture = out.str();
+    CaptureReader reader((const uint8_t*) capture.data(), capture.size());
+    REQUIRE(reader.open() == CaptureResult::Ok);
+
+    CaptureScanner scanner(&reader);
+    ScannedPacket packet;
+    auto first_chunk = CAPTURE_HEADER_LEN;
+    auto second_chunk = first_chunk + CAPTURE_CHUNK_HEADER_LEN + data_0.size();
+    auto third_chunk = second_chunk + CAPTURE_CHUNK_HEADER_LEN + packet_2.size();
+
+    REQUIRE(scanner.next(&packet) == CaptureResult::Ok);
+    REQUIRE(packet.bus == 0);
+    REQUIRE(packet.result == ParseResult::PacketAvailable);
+    REQUIRE(packet.timestamp == 10);
+    REQUIRE(packet.location == PacketLocation{first_chunk, 0});
+    REQUIRE(packet.packet->device_id == DeviceId(1));
+
+    REQUIRE(scanner.next(&packet) == CaptureResult::Ok);
+    REQUIRE(packet.bus == 1);
+    REQUIRE(packet.location == PacketLocation{second_chunk, 0});
+
+    REQUIRE(scanner.next(&packet) == CaptureResult::Ok);
+    REQUIRE(packet.result == ParseResult::PacketFragment);
+
+    REQUIRE(scanner.next(&packet) == CaptureResult::Ok);
+    REQUIRE(packet.bus == 0);
+    REQUIRE(packet.result == ParseResult::PacketAvailable);
+    REQUIRE(packet.timestamp == 30);
+    REQUIRE(packet.location == PacketLocation{first_chunk, packet_0.size() + 1});
+    REQUIRE(packet.packet->device_id == DeviceId(2));
+
+    REQUIRE(scanner.next(&packet) == CaptureResult::Ok);
+    REQUIRE(packet.location == PacketLocation{third_chunk, packet_1.size() - 20});
+    REQUIRE(packet.packet->device_id == DeviceId(3));
+    REQUIRE(scanner.next(&packet) == CaptureResult::End);
+
+    SECTION("seek to packets") {
+        scanner.seek(PacketLocation{first_chunk, packet_0.size() + 1});
+
+        // the packet of the other bus is still returned
+        REQUIRE(scanner.next(&packet) == CaptureResult::Ok);
+        REQUIRE(packet.bus == 1);
+
+        REQUIRE(scanner.next(&packet) == CaptureResult::Ok);
+        REQUIRE(packet.result == ParseResult::PacketFragment);
+        REQUIRE(scanner.next(&packet) == CaptureResult::Ok);
+        REQUIRE(packet.result == ParseResult::PacketAvailable);
+        REQUIRE(packet.location == PacketLocation{first_chunk, packet_0.size() + 1});
+        REQUIRE(packet.packet->device_id == DeviceId(2));
+        REQUIRE(packet.packet->data_offset == MAX_PACKET_DATA_LEN);
+    }
+}
+
+TEST_CASE("pace replays", "[Capture]") {
+    SECTION("real time") {
+        ReplayPacer pacer(1.0f);
+
+        // the first chunk starts the replay
+        REQUIRE(pacer.delay(5000, 100) == 0);
+        REQUIRE(pacer.delay(6000, 400) == 700);
+        REQUIRE(pacer.delay(6000, 1200) == 0);
+    }
+
+    SECTION("faster") {
+        ReplayPacer pacer(4.0f);
+        REQUIRE(pacer.delay(0, 0) == 0);
+        REQUIRE(pacer.delay(4000, 0) == 1000);
+    }
+
+    SECTION("maximum speed") {
+        ReplayPacer pacer(0.0f);
+        REQUIRE(pacer.delay(0, 0) == 0);
+        REQUIRE(pacer.delay(1000000, 0) == 0);
+    }
+}
@@ -0,0 +1,122 @@
+#include "capture.h"
+#include "checkpoint.h"
+#include "test_packets.h"
+#include <catch2/catch.hpp>
+
+#include <sstream>
+
+/// Writes the data in two chunks, so packets are split between chunks.
+static void write_split(
+    CaptureWriter& writer,
+    uint64_t timestamp,
+    size_t bus,
+    const std::vector<uint8_t>& data) {
+    auto split = data.size() / 3;
+    writer.write(timestamp, bus, data.data(), split);
+    writer.write(timestamp + 100, bus, data.data() + split, data.size() - split);
+}
+
+/// Returns the saved state of `map`.
+static std::vector<uint8_t> save(const ControlTableMap& map) {
+    std::vector<uint8_t> state;
+    map.save(&state);
+    return state;
+}
+
+TEST_CASE("restore states from checkpoints", "[Checkpoint]") {
+    std::stringstream out;
+    CaptureWriter writer(&out, 2);
+    std::vector<uint8_t> data;
+
+    for (uint8_t id : {1, 2}) {
+        append_mx64_ping(&data, id);
+    }
+
+    writer.write(0, 0, data.data(), data.size());
+
+    for (uint64_t i = 1; i <= 200; i++) {
+        auto value = (uint8_t) i;
+        data.clear();
+        append(&data, encode(0xfe, Instruction::SyncRead, {0x84, 0x00, 0x04, 0x00, 0x01, 0x02}));
+        append(&data, encode(1, Instruction::Status, {value, 0x00, 0x00, 0x00}));
+
+        // device 2 only responds every other time
+        if (i % 2 == 0) {
+            append(&data, encode(2, Instruction::Status, {value, 0x01, 0x00, 0x00}));
+        }
+
+        // a large sync write that is received in fragments
+        if (i % 50 == 0) {
+            std::vector<uint8_t> sync_write{0x74, 0x00, 0xc8, 0x00};
+
+            for (uint8_t id : {1, 2}) {
+                sync_write.push_back(id);
+                sync_write.insert(sync_write.end(), 200, value);
+            }
+
+            append(&data, encode(0xfe, Instruction::SyncWrite, sync_write));
+        }
+
+        write_split(writer, i * 1000, 0, data);
+
+        data.clear();
+        append(&data, encode(3, Instruction::Read, {0x00, 0x00, 0x02, 0x00}));
+        append(&data, encode(3, Instruction::Status, {value, 0x02}));
+        write_split(writer, i * 1000 + 300, 1, data);
+    }
+
+    auto capture = out.str();
+    CaptureReader reader((const uint8_t*) capture.data(), capture.size());
+    REQUIRE(reader.open() == CaptureResult::Ok);
+
+    std::stringstream checkpoints_out;
+    CheckpointWriter checkpoint_writer(&checkpoints_out, 2, capture.size(), 10000);
+    CaptureScanner scanner(&reader);
+    ScannedPacket packet;
+
+    while (scanner.next(&packet) == CaptureResult::Ok) {
+        checkpoint_writer.add(packet);
+    }
+
+    checkpoint_writer.finish();
+    REQUIRE(checkpoint_writer.is_ok());
+    REQUIRE(checkpoint_writer.num_checkpoints() == 21);
+
+    auto checkpoints_data = checkpoints_out.str();
+    CheckpointReader checkpoints(
+        (const uint8_t*) checkpoints_data.data(), checkpoints_data.size());
+    REQUIRE(checkpoints.open(capture.size(), 2) == CheckpointResult::Ok);
+    REQUIRE(checkpoints.num_checkpoints() == 21);
+
+    Checkpoint checkpoint;
+    REQUIRE(checkpoints.find(5000, &checkpoint) == CheckpointResult::NotFound);
+    REQUIRE(checkpoints.find(20500, &checkpoint) == CheckpointResult::Ok);
+    REQUIRE(checkpoint.timestamp <= 20500);
+    REQUIRE(checkpoint.timestamp > 10000);
+
+    // the state after a seek is the same as after replaying everything before it
+    for (uint64_t timestamp : {0, 1000, 10400, 49100, 50000, 50100, 123456, 250000}) {
+        ControlTableMap map(2);
+        ControlTableMap replayed_map(2);
+        REQUIRE(restore_state(&reader, &checkpoints, timestamp, &map) == CheckpointResult::Ok);
+        REQUIRE(restore_state(&reader, nullptr, timestamp, &replayed_map) == CheckpointResult::Ok);
+        REQUIRE(save(map) == save(replayed_map));
+    }
+
+    ControlTableMap map(2);
+    REQUIRE(restore_state(&reader, &checkpoints, 123456, &map) == CheckpointResult::Ok);
+    uint8_t value;
+    REQUIRE(map.get(DeviceId(1)).value()->memory().read_uint8(0x84, &value));
+    REQUIRE(value == 123);
+    REQUIRE(map.get(DeviceId(3)).value()->memory().read_uint8(0x00, &value));
+    REQUIRE(value == 123);
+
+    SECTION("mismatched checkpoints") {
+        REQUIRE(checkpoints.open(capture.size() + 1, 2) == CheckpointResult::MismatchedCapture);
+        REQUIRE(checkpoints.open(capture.size(), 1) == CheckpointResult::MismatchedCapture);
+
+        CheckpointReader truncated(
+            (const uint8_t*) checkpoints_data.data(), checkpoints_data.size() - 1);
+        REQUIRE(truncated.open(capture.size(), 2) == CheckpointResult::Corrupted);
+    }
+}
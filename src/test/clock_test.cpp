@@ -0,0 +1,16 @@
+#include "clock.h"
+#include <catch2/catch.hpp>
+
+#include <thread>
+
+TEST_CASE("measure time", "[Clock]") {
+    auto start = Clock::now();
+    auto counter_start = Clock::counter();
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    auto end = Clock::now();
+    auto counter_end = Clock::counter();
+
+    REQUIRE(end - start >= 2000 * Clock::TICKS_PER_US);
+    REQUIRE(counter_end - counter_start >= 2000 * Clock::TICKS_PER_US);
+    REQUIRE(Clock::to_us(end - start) >= 2000.0f);
+}
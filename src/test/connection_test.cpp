@@ -0,0 +1,282 @@
+#include "apply_stage.h"
+#include "bus_scheduler.h"
+#include "connection.h"
+#include "software_dma.h"
+#include "test_packets.h"
+#include <catch2/catch.hpp>
+
+#include <memory>
+
+/// A simulated bus: writes encoded packets to a `ReceiveBuf` like the DMA controller.
+struct SimulatedBus {
+    static const size_t NUM_SEGMENTS = 16;
+    static const size_t SEGMENT_LEN = 256;
+    static const size_t LEN = NUM_SEGMENTS * SEGMENT_LEN;
+
+    explicit SimulatedBus(size_t bus) :
+        dma(NUM_SEGMENTS, SEGMENT_LEN),
+        write_pos(0),
+        connection(bus, &dma.buf(), 1000000) {}
+
+    void send(const Packet& packet) {
+        auto raw_packet = encode(packet);
+        this->dma.write(raw_packet.data(), raw_packet.size());
+        this->write_pos = (this->write_pos + raw_packet.size()) % LEN;
+    }
+
+    SoftwareDma dma;
+    size_t write_pos;
+    Connection connection;
+};
+
+/// Both stages of packet processing, shared by several `SimulatedBus`es.
+struct Pipeline {
+    explicit Pipeline(size_t num_buses) :
+        log(new Log(num_buses)),
+        queue(new PacketQueue()),
+        apply_stage(queue.get()),
+        control_table_map(num_buses) {}
+
+    /// Parses up to `max_len` bytes received on `bus` without applying them.
+    size_t parse(SimulatedBus& bus, size_t max_len) {
+        auto write_count = bus.dma.buf().write_count();
+        return bus.connection.process(write_count, max_len, *this->queue, *this->log);
+    }
+
+    /// Applies all queued packets.
+    void apply() {
+        this->apply_stage.apply(this->control_table_map, SIZE_MAX);
+        this->apply_stage.drain(*this->log);
+    }
+
+    size_t process(SimulatedBus& bus, size_t max_len) {
+        auto num_bytes = this->parse(bus, max_len);
+        this->apply();
+        return num_bytes;
+    }
+
+    std::unique_ptr<Log> log;
+    std::unique_ptr<PacketQueue> queue;
+    ApplyStage apply_stage;
+    ControlTableMap control_table_map;
+};
+
+static Packet new_packet(uint8_t id, Instruction instruction, std::vector<uint8_t> data) {
+    return Packet{
+        id == 0xfe ? DeviceId::broadcast() : DeviceId(id),
+        instruction,
+        Error(),
+        data,
+    };
+}
+
+TEST_CASE("process packets of several buses", "[Connection]") {
+    Pipeline pipeline(2);
+    auto& log = pipeline.log;
+    auto& control_table_map = pipeline.control_table_map;
+    SimulatedBus bus_0(0);
+    SimulatedBus bus_1(1);
+
+    // both devices respond to a ping on their own bus
+    bus_0.send(new_packet(4, Instruction::Ping, {}));
+    bus_1.send(new_packet(5, Instruction::Ping, {}));
+    bus_0.send(new_packet(4, Instruction::Status, {0x37, 0x01, 0x06}));
+    bus_1.send(new_packet(5, Instruction::Status, {0x41, 0x01, 0x08}));
+
+    // an instruction on bus 1 does not interrupt the one on bus 0 even if it is processed
+    // in the middle of it
+    bus_0.send(new_packet(4, Instruction::Read, {0x40, 0x00, 0x02, 0x00}));
+    REQUIRE(pipeline.process(bus_0, SimulatedBus::LEN) == bus_0.write_pos);
+    bus_1.send(new_packet(0xfe, Instruction::Write, {0x0a, 0x00, 0x07}));
+    REQUIRE(pipeline.process(bus_1, SimulatedBus::LEN) == bus_1.write_pos);
+    auto bus_0_start = bus_0.write_pos;
+    bus_0.send(new_packet(4, Instruction::Status, {0x12, 0x34}));
+    auto num_bytes = pipeline.process(bus_0, SimulatedBus::LEN);
+    REQUIRE(num_bytes == bus_0.write_pos - bus_0_start);
+
+    Log::Record record;
+    REQUIRE_FALSE(log->pop(&record));
+
+    auto& dev_4 = *control_table_map.get(DeviceId(4)).value();
+    auto& dev_5 = *control_table_map.get(DeviceId(5)).value();
+    uint8_t value;
+    REQUIRE(dev_4.memory().read_uint8(0x40, &value));
+    REQUIRE(value == 0x12);
+
+    // the broadcast on bus 1 only reaches the devices of bus 1
+    REQUIRE(dev_5.memory().read_uint8(0x0a, &value));
+    REQUIRE(value == 0x07);
+    REQUIRE(dev_4.memory().read_uint8(0x0a, &value));
+    REQUIRE(value == 0x00);
+
+    log->request_stats();
+    log->publish_stats();
+    std::unique_ptr<LogStats> stats(new LogStats());
+    REQUIRE(log->read_stats(stats.get()));
+    REQUIRE(stats->buses[0].num_packets == 4);
+    REQUIRE(stats->buses[0].num_bytes == bus_0.write_pos);
+    REQUIRE(stats->buses[1].num_packets == 3);
+    REQUIRE(stats->buses[1].num_bytes == bus_1.write_pos);
+}
+
+TEST_CASE("share processing fairly between buses", "[Connection]") {
+    Pipeline pipeline(2);
+    SimulatedBus bus_0(0);
+    SimulatedBus bus_1(1);
+    BusScheduler scheduler(2, 64);
+
+    // bus 0 is flooded while bus 1 only sends a single ping
+    for (size_t i = 0; i < 100; i++) {
+        bus_0.send(new_packet(4, Instruction::Ping, {}));
+    }
+
+    bus_1.send(new_packet(5, Instruction::Ping, {}));
+
+    std::vector<SimulatedBus*> buses{&bus_0, &bus_1};
+    std::vector<size_t> processed{0, 0};
+    size_t bus;
+    size_t num_turns = 0;
+    scheduler.begin();
+
+    while (scheduler.next(&bus)) {
+        auto num_bytes = pipeline.process(*buses[bus], scheduler.quantum());
+        REQUIRE(num_bytes <= scheduler.quantum());
+        processed[bus] += num_bytes;
+        scheduler.served(num_bytes);
+        num_turns++;
+
+        // bus 1 is served completely before bus 0 has used more than a quantum
+        if (num_turns == 2) {
+            REQUIRE(processed[1] == bus_1.write_pos);
+            REQUIRE(processed[0] == scheduler.quantum());
+        }
+    }
+
+    REQUIRE(processed[0] == bus_0.write_pos);
+    REQUIRE(processed[1] == bus_1.write_pos);
+}
+
+TEST_CASE("queue a whole receive buffer without applying any packets", "[Connection]") {
+    // the receive buffers and the quantum of the firmware
+    const size_t NUM_SEGMENTS = 32;
+    const size_t SEGMENT_LEN = 256;
+    const size_t QUANTUM = 512;
+    Pipeline pipeline(1);
+    SoftwareDma dma(NUM_SEGMENTS, SEGMENT_LEN);
+    Connection connection(0, &dma.buf(), 1000000);
+
+    // a single pass of the packet task, during which the apply task does not run
+    auto process_pass = [&]() {
+        BusScheduler scheduler(1, QUANTUM);
+        auto write_count = dma.buf().write_count();
+        size_t bus;
+        size_t num_bytes = 0;
+        scheduler.begin();
+
+        while (scheduler.next(&bus)) {
+            auto num_turn_bytes = connection.process(
+                write_count, scheduler.quantum(), *pipeline.queue, *pipeline.log);
+            scheduler.served(num_turn_bytes);
+            num_bytes += num_turn_bytes;
+        }
+
+        return num_bytes;
+    };
+
+    auto num_received_packets = [&]() {
+        pipeline.log->request_stats();
+        pipeline.log->publish_stats();
+        std::unique_ptr<LogStats> stats(new LogStats());
+        REQUIRE(pipeline.log->read_stats(stats.get()));
+        return stats->buses[0].num_packets;
+    };
+
+    SECTION("shortest packets") {
+        auto raw_packet = encode(new_packet(4, Instruction::Ping, {}));
+        REQUIRE(raw_packet.size() == PacketQueue::MIN_PACKET_LEN);
+        auto num_packets = dma.buf().len() / raw_packet.size();
+
+        for (size_t i = 0; i < num_packets; i++) {
+            dma.write(raw_packet.data(), raw_packet.size());
+        }
+
+        REQUIRE(process_pass() == num_packets * raw_packet.size());
+        REQUIRE(pipeline.queue->size() == num_packets);
+
+        Log::Record record;
+        REQUIRE_FALSE(pipeline.log->pop(&record));
+        pipeline.apply();
+        REQUIRE(num_received_packets() == num_packets);
+    }
+
+    SECTION("longest payloads") {
+        std::vector<uint8_t> data(MAX_PACKET_DATA_LEN - 1, 0x42);
+        auto raw_packet = encode(new_packet(4, Instruction::Status, data));
+
+        // the payload of the first packet is carried over to the next pass
+        dma.write(raw_packet.data(), raw_packet.size() - 1);
+        REQUIRE(process_pass() == raw_packet.size() - 1);
+        REQUIRE(pipeline.queue->is_empty());
+
+        dma.write(&raw_packet.back(), 1);
+        auto num_packets = (dma.buf().len() - 1) / raw_packet.size();
+
+        for (size_t i = 0; i < num_packets; i++) {
+            dma.write(raw_packet.data(), raw_packet.size());
+        }
+
+        REQUIRE(process_pass() == 1 + num_packets * raw_packet.size());
+        REQUIRE(pipeline.queue->size() == num_packets + 1);
+
+        Log::Record record;
+        REQUIRE_FALSE(pipeline.log->pop(&record));
+        pipeline.apply();
+        REQUIRE(num_received_packets() == num_packets + 1);
+    }
+}
+
+TEST_CASE("drop packets if the apply stage falls behind", "[Connection]") {
+    Pipeline pipeline(1);
+    SimulatedBus bus(0);
+    bus.send(new_packet(4, Instruction::Ping, {}));
+    bus.send(new_packet(4, Instruction::Status, {0x37, 0x01, 0x06}));
+    pipeline.process(bus, SimulatedBus::LEN);
+
+    // the response to the read is lost together with the pings
+    bus.send(new_packet(4, Instruction::Read, {0x40, 0x00, 0x01, 0x00}));
+
+    // the pings are parsed in chunks, since they do not fit into the receive buffer at once
+    for (size_t i = 0; i < PacketQueue::NUM_ENTRIES + 2; i++) {
+        bus.send(new_packet(4, Instruction::Ping, {}));
+
+        if (i % 256 == 255) {
+            pipeline.parse(bus, SimulatedBus::LEN);
+        }
+    }
+
+    pipeline.parse(bus, SimulatedBus::LEN);
+    REQUIRE(pipeline.queue->size() == PacketQueue::NUM_ENTRIES);
+
+    // only the first dropped packet is logged
+    Log::Record record;
+    REQUIRE(pipeline.log->pop(&record));
+    REQUIRE(
+        to_string(record).find("] error: " + to_string(ReceiveResult::QueueOverflow))
+        != std::string::npos);
+    REQUIRE_FALSE(pipeline.log->pop(&record));
+
+    pipeline.apply();
+    REQUIRE(pipeline.queue->is_empty());
+
+    // the gap is queued before the next packet, so the status is not taken as the response
+    // to the read
+    bus.send(new_packet(4, Instruction::Status, {0x12}));
+    pipeline.parse(bus, SimulatedBus::LEN);
+    REQUIRE(pipeline.queue->size() == 2);
+    pipeline.apply();
+
+    auto& dev_4 = *pipeline.control_table_map.get(DeviceId(4)).value();
+    uint8_t value;
+    REQUIRE(dev_4.memory().read_uint8(0x40, &value));
+    REQUIRE(value == 0x00);
+}
@@ -1,8 +1,41 @@
 #include "control_table.h"
 #include "device/mx106.h"
 #include "device/mx64.h"
+#include "endian_convert.h"
 #include <catch2/catch.hpp>
 
+/// Builds the combined status packet sent in response to a `FastSyncRead` or `FastBulkRead`.
+/// Every entry consists of the error, id and data of a device. The crc that follows an entry
+/// covers all bytes sent before it, so the entries must not need any byte stuffing.
+static Packet fast_read_status(const std::vector<std::vector<uint8_t>>& entries) {
+    std::vector<uint8_t> data;
+
+    for (auto& entry : entries) {
+        data.insert(data.end(), entry.begin(), entry.end());
+        data.insert(data.end(), {0x00, 0x00});
+    }
+
+    uint8_t prefix[8] = {0xff, 0xff, 0xfd, 0x00, 0xfe, 0x00, 0x00, 0x55};
+    uint16_to_le(&prefix[5], (uint16_t) (data.size() + 1));
+    auto crc = update_crc(0, prefix, sizeof(prefix));
+    size_t offset = 0;
+
+    for (auto& entry : entries) {
+        crc = update_crc(crc, &data[offset], entry.size());
+        uint16_to_le(&data[offset + entry.size()], crc);
+        crc = update_crc(crc, &data[offset + entry.size()], 2);
+        offset += entry.size() + 2;
+    }
+
+    // the error of the first device is stored in the error field and the crc of the last one
+    // is the checksum of the packet
+    auto error = data[0];
+    data.erase(data.begin());
+    data.resize(data.size() - 2);
+
+    return Packet{DeviceId::broadcast(), Instruction::Status, Error(error), std::move(data)};
+}
+
 TEST_CASE("read and write to control table memory", "[ControlTableMemory]") {
     ControlTableMemory mem({
         Segment::new_data(0x0100, 32),
@@ -290,6 +323,136 @@ TEST_CASE("flow control for incoming packets", "[ControlTableMap]") {
         REQUIRE(buf[2] == 0xcc);
     }
 
+    SECTION("fast sync read packets") {
+        Packet fast_sync_read_packet{
+            DeviceId::broadcast(),
+            Instruction::FastSyncRead,
+            Error(),
+            std::vector<uint8_t>{0x0f, 0x00, 0x02, 0x00, 0x04, 0x05},
+        };
+
+        // ID1 DATA1 CRC1 ERR2 ID2 DATA2
+        auto fast_sync_read_resp = fast_read_status({
+            {0x00, 0x04, 0x0d, 0x0e},
+            {0x00, 0x05, 0x0b, 0x0f},
+        });
+
+        auto result = control_table_map.receive(fast_sync_read_packet);
+        REQUIRE(result == ProtocolResult::Ok);
+        result = control_table_map.receive(fast_sync_read_resp);
+        REQUIRE(result == ProtocolResult::Ok);
+
+        uint8_t buf[2];
+        REQUIRE(dev_4.memory().read(0x000f, buf, 2));
+        REQUIRE(buf[0] == 0x0d);
+        REQUIRE(buf[1] == 0x0e);
+
+        REQUIRE(dev_5.memory().read(0x000f, buf, 2));
+        REQUIRE(buf[0] == 0x0b);
+        REQUIRE(buf[1] == 0x0f);
+
+        SECTION("truncated response") {
+            auto truncated_resp = fast_sync_read_resp;
+            truncated_resp.data.pop_back();
+
+            result = control_table_map.receive(fast_sync_read_packet);
+            REQUIRE(result == ProtocolResult::Ok);
+            result = control_table_map.receive(truncated_resp);
+            REQUIRE(result == ProtocolResult::InvalidPacketLen);
+        }
+
+        SECTION("unexpected device order") {
+            auto reordered_resp = fast_read_status({
+                {0x00, 0x05, 0x0d, 0x0e},
+                {0x00, 0x04, 0x0b, 0x0f},
+            });
+
+            result = control_table_map.receive(fast_sync_read_packet);
+            REQUIRE(result == ProtocolResult::Ok);
+            result = control_table_map.receive(reordered_resp);
+            REQUIRE(result == ProtocolResult::InvalidDeviceId);
+        }
+
+        SECTION("corrupted entry") {
+            Packet fast_sync_read_3_packet{
+                DeviceId::broadcast(),
+                Instruction::FastSyncRead,
+                Error(),
+                std::vector<uint8_t>{0x0f, 0x00, 0x02, 0x00, 0x04, 0x05, 0x06},
+            };
+
+            // the data of the middle entry was corrupted, but the other entries are intact
+            auto corrupted_resp = fast_read_status({
+                {0x00, 0x04, 0x1d, 0x1e},
+                {0x00, 0x05, 0x1b, 0x1f},
+                {0x00, 0x06, 0x2b, 0x2f},
+            });
+            corrupted_resp.data[8] ^= 0x40;
+
+            result = control_table_map.receive(Packet{
+                DeviceId(6),
+                Instruction::Ping,
+                Error(),
+                std::vector<uint8_t>(),
+            });
+            REQUIRE(result == ProtocolResult::Ok);
+            result = control_table_map.receive(Packet{
+                DeviceId(6),
+                Instruction::Status,
+                Error(),
+                std::vector<uint8_t>{0x37, 0x01, 0x06},
+            });
+            REQUIRE(result == ProtocolResult::Ok);
+            auto& dev_6 = *control_table_map.get(DeviceId(6)).value();
+
+            result = control_table_map.receive(fast_sync_read_3_packet);
+            REQUIRE(result == ProtocolResult::Ok);
+            result = control_table_map.receive(corrupted_resp);
+            REQUIRE(result == ProtocolResult::InvalidChecksum);
+
+            REQUIRE(dev_4.memory().read(0x000f, buf, 2));
+            REQUIRE(buf[0] == 0x1d);
+            REQUIRE(buf[1] == 0x1e);
+
+            REQUIRE(dev_5.memory().read(0x000f, buf, 2));
+            REQUIRE(buf[0] == 0x0b);
+            REQUIRE(buf[1] == 0x0f);
+
+            REQUIRE(dev_6.memory().read(0x000f, buf, 2));
+            REQUIRE(buf[0] == 0x2b);
+            REQUIRE(buf[1] == 0x2f);
+        }
+    }
+
+    SECTION("fast bulk read packets") {
+        Packet fast_bulk_read_packet{
+            DeviceId::broadcast(),
+            Instruction::FastBulkRead,
+            Error(),
+            std::vector<uint8_t>{0x04, 0x11, 0x00, 0x03, 0x00, 0x05, 0x22, 0x00, 0x01, 0x00},
+        };
+
+        // the second device reports an error, but the data of the first one is still valid
+        auto fast_bulk_read_resp = fast_read_status({
+            {0x00, 0x04, 0x11, 0x22, 0x33},
+            {0x02, 0x05, 0xaa},
+        });
+
+        auto result = control_table_map.receive(fast_bulk_read_packet);
+        REQUIRE(result == ProtocolResult::Ok);
+        result = control_table_map.receive(fast_bulk_read_resp);
+        REQUIRE(result == ProtocolResult::StatusHasError);
+
+        uint8_t buf[3];
+        REQUIRE(dev_4.memory().read(0x0011, buf, 3));
+        REQUIRE(buf[0] == 0x11);
+        REQUIRE(buf[1] == 0x22);
+        REQUIRE(buf[2] == 0x33);
+
+        REQUIRE(dev_5.memory().read(0x0022, buf, 1));
+        REQUIRE(buf[0] != 0xaa);
+    }
+
     SECTION("bulk write packets") {
         Packet bulk_write_packet{
             DeviceId::broadcast(),
@@ -328,6 +491,242 @@ TEST_CASE("flow control for incoming packets", "[ControlTableMap]") {
         REQUIRE(buf[2] == 0xd0);
     }
 
+    SECTION("registered writes") {
+        Packet dev_4_reg_write{
+            DeviceId(4),
+            Instruction::RegWrite,
+            Error(),
+            std::vector<uint8_t>{0x74, 0x00, 0x01, 0x02},
+        };
+
+        Packet dev_5_reg_write{
+            DeviceId(5),
+            Instruction::RegWrite,
+            Error(),
+            std::vector<uint8_t>{0x74, 0x00, 0x03, 0x04},
+        };
+
+        Packet dev_5_action{
+            DeviceId(5),
+            Instruction::Action,
+            Error(),
+            std::vector<uint8_t>(),
+        };
+
+        Packet broadcast_action{
+            DeviceId::broadcast(),
+            Instruction::Action,
+            Error(),
+            std::vector<uint8_t>(),
+        };
+
+        Packet dev_4_reboot{
+            DeviceId(4),
+            Instruction::Reboot,
+            Error(),
+            std::vector<uint8_t>(),
+        };
+
+        auto result = control_table_map.receive(dev_4_reg_write);
+        REQUIRE(result == ProtocolResult::Ok);
+        result = control_table_map.receive(dev_5_reg_write);
+        REQUIRE(result == ProtocolResult::Ok);
+
+        uint8_t buf[2];
+        REQUIRE(dev_4.memory().read(0x0074, buf, 2));
+        REQUIRE(buf[0] == 0x00);
+        REQUIRE(buf[1] == 0x00);
+
+        result = control_table_map.receive(dev_5_action);
+        REQUIRE(result == ProtocolResult::Ok);
+
+        REQUIRE(dev_4.memory().read(0x0074, buf, 2));
+        REQUIRE(buf[0] == 0x00);
+        REQUIRE(buf[1] == 0x00);
+        REQUIRE(dev_5.memory().read(0x0074, buf, 2));
+        REQUIRE(buf[0] == 0x03);
+        REQUIRE(buf[1] == 0x04);
+
+        result = control_table_map.receive(broadcast_action);
+        REQUIRE(result == ProtocolResult::Ok);
+
+        REQUIRE(dev_4.memory().read(0x0074, buf, 2));
+        REQUIRE(buf[0] == 0x01);
+        REQUIRE(buf[1] == 0x02);
+
+        // the registered write is consumed by the action
+        REQUIRE(dev_4.memory().write_uint16(0x0074, 0));
+        result = control_table_map.receive(broadcast_action);
+        REQUIRE(result == ProtocolResult::Ok);
+
+        REQUIRE(dev_4.memory().read(0x0074, buf, 2));
+        REQUIRE(buf[0] == 0x00);
+        REQUIRE(buf[1] == 0x00);
+
+        // a reboot drops the registered write
+        result = control_table_map.receive(dev_4_reg_write);
+        REQUIRE(result == ProtocolResult::Ok);
+        result = control_table_map.receive(dev_4_reboot);
+        REQUIRE(result == ProtocolResult::Ok);
+        result = control_table_map.receive(broadcast_action);
+        REQUIRE(result == ProtocolResult::Ok);
+
+        REQUIRE(dev_4.memory().read(0x0074, buf, 2));
+        REQUIRE(buf[0] == 0x00);
+        REQUIRE(buf[1] == 0x00);
+    }
+
+    SECTION("factory reset") {
+        Packet dev_4_write{
+            DeviceId(4),
+            Instruction::Write,
+            Error(),
+            std::vector<uint8_t>{0x07, 0x00, 0x04, 0x03},
+        };
+
+        Packet dev_4_goal_write{
+            DeviceId(4),
+            Instruction::Write,
+            Error(),
+            std::vector<uint8_t>{0x74, 0x00, 0x01, 0x02, 0x00, 0x00},
+        };
+
+        Packet dev_4_factory_reset{
+            DeviceId(4),
+            Instruction::FactoryReset,
+            Error(),
+            std::vector<uint8_t>{0x01},
+        };
+
+        auto result = control_table_map.receive(dev_4_write);
+        REQUIRE(result == ProtocolResult::Ok);
+        result = control_table_map.receive(dev_4_goal_write);
+        REQUIRE(result == ProtocolResult::Ok);
+        result = control_table_map.receive(dev_4_factory_reset);
+        REQUIRE(result == ProtocolResult::Ok);
+
+        uint8_t value;
+        REQUIRE(dev_4.memory().read_uint8(6, &value));
+        REQUIRE(value == 0x06);
+        REQUIRE(dev_4.memory().read_uint8(7, &value));
+        REQUIRE(value == 0x04);
+        REQUIRE(dev_4.memory().read_uint8(8, &value));
+        REQUIRE(value == 1);
+
+        uint32_t goal_position;
+        REQUIRE(dev_4.memory().read_uint32(0x0074, &goal_position));
+        REQUIRE(goal_position == 0);
+        REQUIRE(dev_4.model_number() == Mx64ControlTable::MODEL_NUMBER);
+
+        // the table stays under its id, so the id is kept even if the device resets it
+        result = control_table_map.receive(dev_4_write);
+        REQUIRE(result == ProtocolResult::Ok);
+        dev_4_factory_reset.data[0] = 0xff;
+        result = control_table_map.receive(dev_4_factory_reset);
+        REQUIRE(result == ProtocolResult::Ok);
+
+        REQUIRE(dev_4.memory().read_uint8(7, &value));
+        REQUIRE(value == 0x04);
+        REQUIRE(dev_4.memory().read_uint8(8, &value));
+        REQUIRE(value == 1);
+
+        // a device that has not been seen yet does not get a table
+        Packet dev_9_factory_reset{
+            DeviceId(9),
+            Instruction::FactoryReset,
+            Error(),
+            std::vector<uint8_t>{0xff},
+        };
+
+        result = control_table_map.receive(dev_9_factory_reset);
+        REQUIRE(result == ProtocolResult::Ok);
+        REQUIRE_FALSE(control_table_map.get(DeviceId(9)).is_present());
+    }
+
+    SECTION("fragmented packets") {
+        Packet sync_write_first{
+            DeviceId::broadcast(),
+            Instruction::SyncWrite,
+            Error(),
+            std::vector<uint8_t>{0x10, 0x00, 0x02, 0x00, 0x04, 0x01},
+        };
+
+        Packet sync_write_last{
+            DeviceId::broadcast(),
+            Instruction::SyncWrite,
+            Error(),
+            std::vector<uint8_t>{0x02, 0x05, 0x03, 0x04},
+            6,
+        };
+
+        control_table_map.receive_fragment(sync_write_first);
+
+        // nothing must be written before the last fragment was received
+        uint8_t buf[2];
+        REQUIRE(dev_4.memory().read(0x0010, buf, 2));
+        REQUIRE(buf[0] == 0x00);
+        REQUIRE(buf[1] == 0x00);
+
+        auto result = control_table_map.receive(sync_write_last);
+        REQUIRE(result == ProtocolResult::Ok);
+
+        REQUIRE(dev_4.memory().read(0x0010, buf, 2));
+        REQUIRE(buf[0] == 0x01);
+        REQUIRE(buf[1] == 0x02);
+
+        REQUIRE(dev_5.memory().read(0x0010, buf, 2));
+        REQUIRE(buf[0] == 0x03);
+        REQUIRE(buf[1] == 0x04);
+
+        // discarded fragments are never applied, even if a later fragment arrives
+        sync_write_first.data[5] = 0xee;
+        sync_write_last.data[0] = 0xff;
+        control_table_map.receive_fragment(sync_write_first);
+        control_table_map.discard_fragments();
+
+        result = control_table_map.receive(sync_write_last);
+        REQUIRE(result == ProtocolResult::InvalidInstructionPacket);
+
+        REQUIRE(dev_4.memory().read(0x0010, buf, 2));
+        REQUIRE(buf[0] == 0x01);
+        REQUIRE(buf[1] == 0x02);
+
+        Packet dev_4_read{
+            DeviceId(4),
+            Instruction::Read,
+            Error(),
+            std::vector<uint8_t>{0x40, 0x00, 0x04, 0x00},
+        };
+
+        Packet dev_4_read_resp_first{
+            DeviceId(4),
+            Instruction::Status,
+            Error(),
+            std::vector<uint8_t>{0x01, 0x02},
+        };
+
+        Packet dev_4_read_resp_last{
+            DeviceId(4),
+            Instruction::Status,
+            Error(),
+            std::vector<uint8_t>{0x03, 0x04},
+            2,
+        };
+
+        result = control_table_map.receive(dev_4_read);
+        REQUIRE(result == ProtocolResult::Ok);
+        control_table_map.receive_fragment(dev_4_read_resp_first);
+        result = control_table_map.receive(dev_4_read_resp_last);
+        REQUIRE(result == ProtocolResult::Ok);
+
+        uint8_t read_buf[4];
+        REQUIRE(dev_4.memory().read(0x0040, read_buf, 4));
+        REQUIRE(read_buf[0] == 0x01);
+        REQUIRE(read_buf[1] == 0x02);
+        REQUIRE(read_buf[2] == 0x03);
+        REQUIRE(read_buf[3] == 0x04);
+    }
+
     SECTION("device disconnect") {
         Packet read_packet{
             DeviceId(4),
@@ -367,3 +766,243 @@ TEST_CASE("flow control for incoming packets", "[ControlTableMap]") {
         REQUIRE_FALSE(control_table_map.is_disconnected(DeviceId(5)));
     }
 }
+
+TEST_CASE("separate buses", "[ControlTableMap]") {
+    ControlTableMap control_table_map(2);
+    REQUIRE(control_table_map.num_buses() == 2);
+
+    Packet ping_dev_4{
+        DeviceId(4),
+        Instruction::Ping,
+        Error(),
+        std::vector<uint8_t>(),
+    };
+
+    Packet dev_4_ping_resp{
+        DeviceId(4),
+        Instruction::Status,
+        Error(),
+        std::vector<uint8_t>{0x37, 0x01, 0x06},
+    };
+
+    Packet ping_dev_5{
+        DeviceId(5),
+        Instruction::Ping,
+        Error(),
+        std::vector<uint8_t>(),
+    };
+
+    Packet dev_5_ping_resp{
+        DeviceId(5),
+        Instruction::Status,
+        Error(),
+        std::vector<uint8_t>{0x41, 0x01, 0x08},
+    };
+
+    // the packets of both buses are interleaved, but each response follows the instruction
+    // on its own bus
+    auto result = control_table_map.receive(ping_dev_4, 0);
+    REQUIRE(result == ProtocolResult::Ok);
+    result = control_table_map.receive(ping_dev_5, 1);
+    REQUIRE(result == ProtocolResult::Ok);
+    result = control_table_map.receive(dev_5_ping_resp, 1);
+    REQUIRE(result == ProtocolResult::Ok);
+    result = control_table_map.receive(dev_4_ping_resp, 0);
+    REQUIRE(result == ProtocolResult::Ok);
+
+    auto& dev_4 = *control_table_map.get(DeviceId(4)).value();
+    auto& dev_5 = *control_table_map.get(DeviceId(5)).value();
+    REQUIRE(dev_4.model_number() == Mx64ControlTable::MODEL_NUMBER);
+    REQUIRE(dev_5.model_number() == Mx106ControlTable::MODEL_NUMBER);
+
+    SECTION("broadcast write") {
+        Packet broadcast_write{
+            DeviceId::broadcast(),
+            Instruction::Write,
+            Error(),
+            std::vector<uint8_t>{0x0a, 0x00, 0x01, 0x02, 0x03},
+        };
+
+        result = control_table_map.receive(broadcast_write, 0);
+        REQUIRE(result == ProtocolResult::Ok);
+
+        uint8_t buf[3];
+        REQUIRE(dev_4.memory().read(0x000a, buf, 3));
+        REQUIRE(buf[0] == 0x01);
+        REQUIRE(dev_5.memory().read(0x000a, buf, 3));
+        REQUIRE(buf[0] == 0x00);
+    }
+
+    SECTION("registered writes") {
+        Packet dev_4_reg_write{
+            DeviceId(4),
+            Instruction::RegWrite,
+            Error(),
+            std::vector<uint8_t>{0x0a, 0x00, 0x01},
+        };
+
+        Packet dev_5_reg_write{
+            DeviceId(5),
+            Instruction::RegWrite,
+            Error(),
+            std::vector<uint8_t>{0x0a, 0x00, 0x02},
+        };
+
+        Packet broadcast_action{
+            DeviceId::broadcast(),
+            Instruction::Action,
+            Error(),
+            std::vector<uint8_t>(),
+        };
+
+        result = control_table_map.receive(dev_4_reg_write, 0);
+        REQUIRE(result == ProtocolResult::Ok);
+        result = control_table_map.receive(dev_5_reg_write, 1);
+        REQUIRE(result == ProtocolResult::Ok);
+
+        // the action on bus 1 only applies the write registered on bus 1
+        result = control_table_map.receive(broadcast_action, 1);
+        REQUIRE(result == ProtocolResult::Ok);
+
+        uint8_t value;
+        REQUIRE(dev_4.memory().read_uint8(0x000a, &value));
+        REQUIRE(value == 0x00);
+        REQUIRE(dev_5.memory().read_uint8(0x000a, &value));
+        REQUIRE(value == 0x02);
+
+        result = control_table_map.receive(broadcast_action, 0);
+        REQUIRE(result == ProtocolResult::Ok);
+        REQUIRE(dev_4.memory().read_uint8(0x000a, &value));
+        REQUIRE(value == 0x01);
+    }
+
+    SECTION("registered writes addressed on another bus") {
+        Packet dev_4_reg_write{
+            DeviceId(4),
+            Instruction::RegWrite,
+            Error(),
+            std::vector<uint8_t>{0x0a, 0x00, 0x01},
+        };
+
+        Packet dev_4_reboot{
+            DeviceId(4),
+            Instruction::Reboot,
+            Error(),
+            std::vector<uint8_t>(),
+        };
+
+        Packet broadcast_action{
+            DeviceId::broadcast(),
+            Instruction::Action,
+            Error(),
+            std::vector<uint8_t>(),
+        };
+
+        // the reboot on bus 1 cannot drop the write registered on bus 0
+        result = control_table_map.receive(dev_4_reg_write, 0);
+        REQUIRE(result == ProtocolResult::Ok);
+        result = control_table_map.receive(dev_4_reboot, 1);
+        REQUIRE(result == ProtocolResult::Ok);
+        result = control_table_map.receive(broadcast_action, 0);
+        REQUIRE(result == ProtocolResult::Ok);
+
+        uint8_t value;
+        REQUIRE(dev_4.memory().read_uint8(0x000a, &value));
+        REQUIRE(value == 0x01);
+
+        // a write registered again on another bus replaces the first one
+        dev_4_reg_write.data[2] = 0x02;
+        result = control_table_map.receive(dev_4_reg_write, 0);
+        REQUIRE(result == ProtocolResult::Ok);
+        dev_4_reg_write.data[2] = 0x03;
+        result = control_table_map.receive(dev_4_reg_write, 1);
+        REQUIRE(result == ProtocolResult::Ok);
+
+        result = control_table_map.receive(broadcast_action, 0);
+        REQUIRE(result == ProtocolResult::Ok);
+        REQUIRE(dev_4.memory().read_uint8(0x000a, &value));
+        REQUIRE(value == 0x01);
+
+        result = control_table_map.receive(broadcast_action, 1);
+        REQUIRE(result == ProtocolResult::Ok);
+        REQUIRE(dev_4.memory().read_uint8(0x000a, &value));
+        REQUIRE(value == 0x03);
+    }
+}
+
+TEST_CASE("save and restore the state", "[ControlTableMap]") {
+    ControlTableMap control_table_map(2);
+
+    Packet ping_dev_4{DeviceId(4), Instruction::Ping, Error(), std::vector<uint8_t>()};
+    Packet dev_4_ping_resp{
+        DeviceId(4),
+        Instruction::Status,
+        Error(),
+        std::vector<uint8_t>{0x37, 0x01, 0x06},
+    };
+    Packet dev_4_reg_write{
+        DeviceId(4),
+        Instruction::RegWrite,
+        Error(),
+        std::vector<uint8_t>{0x0a, 0x00, 0x01},
+    };
+    Packet sync_read{
+        DeviceId::broadcast(),
+        Instruction::SyncRead,
+        Error(),
+        std::vector<uint8_t>{0x40, 0x00, 0x02, 0x00, 0x04, 0x05},
+    };
+    Packet dev_4_sync_read_resp{
+        DeviceId(4),
+        Instruction::Status,
+        Error(),
+        std::vector<uint8_t>{0x12, 0x34},
+    };
+
+    REQUIRE(control_table_map.receive(ping_dev_4, 0) == ProtocolResult::Ok);
+    REQUIRE(control_table_map.receive(dev_4_ping_resp, 0) == ProtocolResult::Ok);
+    REQUIRE(control_table_map.receive(dev_4_reg_write, 1) == ProtocolResult::Ok);
+    REQUIRE(control_table_map.receive(sync_read, 0) == ProtocolResult::Ok);
+
+    std::vector<uint8_t> state;
+    control_table_map.save(&state);
+
+    ControlTableMap restored_map(2);
+    REQUIRE(restored_map.restore(state.data(), state.size()));
+
+    std::vector<uint8_t> restored_state;
+    restored_map.save(&restored_state);
+    REQUIRE(restored_state == state);
+
+    auto& dev_4 = *restored_map.get(DeviceId(4)).value();
+    REQUIRE(dev_4.model_number() == Mx64ControlTable::MODEL_NUMBER);
+
+    // the responses to the sync read are still expected
+    REQUIRE(restored_map.receive(dev_4_sync_read_resp, 0) == ProtocolResult::Ok);
+    uint16_t value;
+    REQUIRE(dev_4.memory().read_uint16(0x40, &value));
+    REQUIRE(value == 0x3412);
+
+    // device 5 did not respond
+    for (size_t i = 0; i <= ControlTableMap::MAX_ALLOWED_MISSED_PACKETS; i++) {
+        REQUIRE_FALSE(restored_map.is_disconnected(DeviceId(5)));
+        REQUIRE(restored_map.receive(sync_read, 0) == ProtocolResult::Ok);
+    }
+
+    REQUIRE(restored_map.is_disconnected(DeviceId(5)));
+
+    // the registered write is applied by an action on its bus
+    Packet broadcast_action{DeviceId::broadcast(), Instruction::Action, Error(), {}};
+    REQUIRE(restored_map.receive(broadcast_action, 1) == ProtocolResult::Ok);
+    uint8_t byte;
+    REQUIRE(dev_4.memory().read_uint8(0x0a, &byte));
+    REQUIRE(byte == 0x01);
+
+    SECTION("invalid states") {
+        ControlTableMap one_bus_map(1);
+        REQUIRE_FALSE(one_bus_map.restore(state.data(), state.size()));
+
+        REQUIRE_FALSE(restored_map.restore(state.data(), state.size() - 1));
+        REQUIRE(restored_map.size() == 0);
+    }
+}
@@ -0,0 +1,200 @@
+#include "device/imu.h"
+#include "device/mx64.h"
+#include "device_farm.h"
+#include "parser.h"
+#include <catch2/catch.hpp>
+
+#include <vector>
+
+/// Parses the status packet of a response.
+static Packet parse_response(const DeviceFarm& farm, const FarmResponse& response) {
+    Parser parser;
+    Packet packet{DeviceId(0), Instruction::Ping, Error(), {}};
+    Cursor cursor(farm.response_data() + response.offset, response.len);
+    REQUIRE(parser.parse(cursor, &packet) == ParseResult::PacketAvailable);
+    REQUIRE(cursor.remaining_bytes() == 0);
+    return packet;
+}
+
+TEST_CASE("emulate devices", "[DeviceFarm]") {
+    DeviceFarm farm;
+    REQUIRE(farm.add_device(DeviceId(1), Mx64ControlTable::MODEL_NUMBER));
+    REQUIRE(farm.add_device(DeviceId(2), Mx64ControlTable::MODEL_NUMBER));
+    REQUIRE(farm.add_device(DeviceId(3), ImuControlTable::MODEL_NUMBER));
+    REQUIRE(farm.num_devices() == 3);
+
+    SECTION("invalid devices") {
+        REQUIRE_FALSE(farm.add_device(DeviceId(1), Mx64ControlTable::MODEL_NUMBER));
+        REQUIRE_FALSE(farm.add_device(DeviceId::broadcast(), Mx64ControlTable::MODEL_NUMBER));
+        REQUIRE_FALSE(farm.add_device(DeviceId(4), 1234));
+        REQUIRE(farm.control_table(DeviceId(4)) == nullptr);
+    }
+
+    SECTION("ping") {
+        farm.receive(InstructionPacket(PingArgs{DeviceId(1)}));
+
+        REQUIRE(farm.responses().size() == 1);
+        auto packet = parse_response(farm, farm.responses()[0]);
+        REQUIRE(packet.device_id == DeviceId(1));
+        REQUIRE(packet.instruction == Instruction::Status);
+        REQUIRE(packet.error.is_ok());
+        REQUIRE(packet.data == std::vector<uint8_t>{0x37, 0x01, 0x00});
+
+        // the default Return Delay Time of 250 in units of 2 us
+        REQUIRE(farm.responses()[0].delay_us == 500);
+    }
+
+    SECTION("broadcast ping") {
+        farm.receive(InstructionPacket(PingArgs{DeviceId::broadcast()}));
+
+        REQUIRE(farm.responses().size() == 3);
+        REQUIRE(farm.responses()[0].device_id == DeviceId(1));
+        REQUIRE(farm.responses()[1].device_id == DeviceId(2));
+        REQUIRE(farm.responses()[2].device_id == DeviceId(3));
+        REQUIRE(parse_response(farm, farm.responses()[2]).data
+                == std::vector<uint8_t>{0xff, 0xba, 0x00});
+
+        // the IMU has no Return Delay Time
+        REQUIRE(farm.responses()[2].delay_us == 0);
+    }
+
+    SECTION("write and read") {
+        farm.receive(InstructionPacket(WriteArgs{DeviceId(1), 116, {0x00, 0x08, 0x00, 0x00}}));
+
+        REQUIRE(farm.responses().size() == 1);
+        REQUIRE(parse_response(farm, farm.responses()[0]).data.empty());
+
+        farm.receive(InstructionPacket(ReadArgs{DeviceId(1), 116, 4}));
+
+        REQUIRE(farm.responses().size() == 1);
+        REQUIRE(
+            parse_response(farm, farm.responses()[0]).data
+            == std::vector<uint8_t>{0x00, 0x08, 0x00, 0x00});
+    }
+
+    SECTION("sync write and sync read") {
+        farm.receive(InstructionPacket(SyncWriteArgs{
+            {DeviceId(2), DeviceId(1), DeviceId(5)},
+            116,
+            2,
+            {0x01, 0x02, 0x03, 0x04, 0x05, 0x06},
+        }));
+
+        REQUIRE(farm.responses().empty());
+
+        farm.receive(
+            InstructionPacket(SyncReadArgs{{DeviceId(2), DeviceId(5), DeviceId(1)}, 116, 2}));
+
+        // the devices answer in the order of the instruction, missing devices do not answer
+        REQUIRE(farm.responses().size() == 2);
+        REQUIRE(farm.responses()[0].device_id == DeviceId(2));
+        REQUIRE(farm.responses()[1].device_id == DeviceId(1));
+        REQUIRE(parse_response(farm, farm.responses()[0]).data == std::vector<uint8_t>{0x01, 0x02});
+        REQUIRE(parse_response(farm, farm.responses()[1]).data == std::vector<uint8_t>{0x03, 0x04});
+        REQUIRE(farm.responses()[1].offset == farm.responses()[0].len);
+
+        // a sync write without data changes nothing
+        farm.receive(InstructionPacket(SyncWriteArgs{{DeviceId(1), DeviceId(2)}, 116, 0, {}}));
+
+        REQUIRE(farm.responses().empty());
+    }
+
+    SECTION("bulk write and bulk read") {
+        farm.receive(InstructionPacket(BulkWriteArgs{{
+            WriteArgs{DeviceId(1), 65, {0x01}},
+            WriteArgs{DeviceId(3), 76, {0x02, 0x01}},
+        }}));
+
+        REQUIRE(farm.responses().empty());
+
+        farm.receive(InstructionPacket(BulkReadArgs{{
+            ReadArgs{DeviceId(3), 76, 2},
+            ReadArgs{DeviceId(1), 64, 2},
+        }}));
+
+        REQUIRE(farm.responses().size() == 2);
+        REQUIRE(farm.responses()[0].device_id == DeviceId(3));
+        REQUIRE(parse_response(farm, farm.responses()[0]).data == std::vector<uint8_t>{0x02, 0x01});
+        REQUIRE(parse_response(farm, farm.responses()[1]).data == std::vector<uint8_t>{0x00, 0x01});
+    }
+
+    SECTION("invalid addresses") {
+        farm.receive(InstructionPacket(ReadArgs{DeviceId(3), 70, 16}));
+
+        REQUIRE(farm.responses().size() == 1);
+        auto packet = parse_response(farm, farm.responses()[0]);
+        REQUIRE(packet.error == Error(DeviceFarm::ERROR_DATA_RANGE));
+        REQUIRE(packet.data.empty());
+
+        farm.receive(InstructionPacket(WriteArgs{DeviceId(3), 200, {0x01}}));
+
+        REQUIRE(parse_response(farm, farm.responses()[0]).error
+                == Error(DeviceFarm::ERROR_DATA_RANGE));
+    }
+
+    SECTION("registered writes") {
+        farm.receive(InstructionPacket(RegWriteArgs{DeviceId(2), 64, {0x01}}));
+
+        uint8_t value;
+        auto& memory = farm.control_table(DeviceId(2))->memory();
+        REQUIRE(memory.read_uint8(64, &value));
+        REQUIRE(value == 0);
+        REQUIRE(memory.read_uint8(69, &value));
+        REQUIRE(value == 1);
+
+        // the broadcast is not answered
+        farm.receive(InstructionPacket(ActionArgs{DeviceId::broadcast()}));
+
+        REQUIRE(farm.responses().empty());
+        REQUIRE(memory.read_uint8(64, &value));
+        REQUIRE(value == 1);
+        REQUIRE(memory.read_uint8(69, &value));
+        REQUIRE(value == 0);
+
+        farm.receive(InstructionPacket(ActionArgs{DeviceId(2)}));
+
+        REQUIRE(parse_response(farm, farm.responses()[0]).error
+                == Error(DeviceFarm::ERROR_INSTRUCTION));
+    }
+
+    SECTION("factory reset") {
+        farm.receive(InstructionPacket(WriteArgs{DeviceId(1), 9, {0x00}}));
+        farm.receive(InstructionPacket(FactoryResetArgs{DeviceId(1), FactoryReset::ResetAll}));
+
+        REQUIRE(farm.responses().size() == 1);
+        REQUIRE(farm.responses()[0].delay_us == 0);
+
+        farm.receive(InstructionPacket(PingArgs{DeviceId(1)}));
+
+        REQUIRE(farm.responses()[0].delay_us == 500);
+    }
+
+    SECTION("status return level") {
+        farm.receive(InstructionPacket(WriteArgs{DeviceId::broadcast(), 68, {0x01}}));
+
+        REQUIRE(farm.responses().empty());
+
+        farm.receive(InstructionPacket(WriteArgs{DeviceId(1), 65, {0x01}}));
+
+        REQUIRE(farm.responses().empty());
+
+        farm.receive(InstructionPacket(ReadArgs{DeviceId(1), 65, 1}));
+
+        REQUIRE(farm.responses().size() == 1);
+
+        farm.receive(InstructionPacket(WriteArgs{DeviceId(1), 68, {0x00}}));
+        farm.receive(InstructionPacket(ReadArgs{DeviceId(1), 65, 1}));
+
+        REQUIRE(farm.responses().empty());
+
+        farm.receive(InstructionPacket(PingArgs{DeviceId(1)}));
+
+        REQUIRE(farm.responses().size() == 1);
+    }
+
+    SECTION("fast reads") {
+        farm.receive(InstructionPacket(FastSyncReadArgs{{DeviceId(1), DeviceId(2)}, 132, 4}));
+
+        REQUIRE(farm.responses().empty());
+    }
+}
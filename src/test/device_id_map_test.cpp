@@ -89,10 +89,12 @@ TEST_CASE("DeviceIdMap entry API", "[DeviceIdMap]") {
         REQUIRE(map.get(DeviceId(0)).value() == 42);
         map.get(DeviceId(0)).clear_value();
         REQUIRE_FALSE(map.get(DeviceId(0)).is_present());
+        REQUIRE(map.size() == 3);
 
         REQUIRE_FALSE(map.get(DeviceId(1)).is_present());
         map.get(DeviceId(1)).clear_value();
         REQUIRE_FALSE(map.get(DeviceId(1)).is_present());
+        REQUIRE(map.size() == 3);
     }
 }
 
@@ -0,0 +1,58 @@
+#include "entropy_coder.h"
+#include <catch2/catch.hpp>
+
+#include <random>
+
+/// Codes `data` in blocks of `block_len` bytes and decodes the blocks again. Returns the total
+/// length of the coded blocks.
+static size_t round_trip(const std::vector<uint8_t>& data, size_t block_len) {
+    EntropyEncoder encoder;
+    EntropyDecoder decoder;
+    std::vector<uint8_t> decoded;
+    size_t coded_len = 0;
+
+    for (size_t offset = 0; offset < data.size(); offset += block_len) {
+        auto len = std::min(block_len, data.size() - offset);
+        std::vector<uint8_t> coded;
+        encoder.encode(data.data() + offset, len, &coded);
+        decoder.decode(coded.data(), coded.size(), len, &decoded);
+        coded_len += coded.size();
+    }
+
+    REQUIRE(decoded == data);
+    return coded_len;
+}
+
+TEST_CASE("code random data", "[EntropyCoder]") {
+    std::mt19937 random(1);
+    std::vector<uint8_t> data(100000);
+
+    for (auto& byte : data) {
+        byte = (uint8_t) random();
+    }
+
+    // random data cannot be compressed, but it only grows a little
+    auto coded_len = round_trip(data, 30000);
+    REQUIRE(coded_len < data.size() * 101 / 100);
+
+    // blocks of a single byte
+    REQUIRE(round_trip(std::vector<uint8_t>(data.begin(), data.begin() + 100), 1) <= 500);
+}
+
+TEST_CASE("code repeating data", "[EntropyCoder]") {
+    // records of a control cycle: a header and a few values that change slowly
+    std::vector<uint8_t> data;
+
+    for (uint32_t i = 0; i < 10000; i++) {
+        for (uint8_t id : {1, 2, 3}) {
+            data.insert(data.end(), {0x02, 0x84, 0x00, 0x04, 0x00, id});
+            data.insert(data.end(), {(uint8_t) (i * id / 16), (uint8_t) (i / 1000), 0x00, 0x00});
+        }
+    }
+
+    auto coded_len = round_trip(data, 65536);
+    REQUIRE(coded_len * 10 < data.size());
+
+    // the models keep learning across blocks, small blocks only cost their ends
+    REQUIRE(round_trip(data, 4096) < coded_len + 4 * data.size() / 4096);
+}
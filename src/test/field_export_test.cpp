@@ -0,0 +1,126 @@
+#include "capture.h"
+#include "field_export.h"
+#include "test_packets.h"
+#include <catch2/catch.hpp>
+
+#include <sstream>
+#include <string.h>
+
+/// Replays a capture and writes the field columns of all fields.
+static std::string export_columns(const std::string& capture, FieldTracker* tracker) {
+    CaptureReader reader((const uint8_t*) capture.data(), capture.size());
+    REQUIRE(reader.open() == CaptureResult::Ok);
+
+    std::stringstream out;
+    FieldColumnWriter writer(&out);
+    CaptureScanner scanner(&reader);
+    ScannedPacket packet;
+    std::vector<FieldChange> changes;
+
+    while (scanner.next(&packet) == CaptureResult::Ok) {
+        changes.clear();
+        tracker->add(packet, &changes);
+
+        for (auto& change : changes) {
+            writer.add(tracker->columns()[change.column], change);
+        }
+    }
+
+    writer.finish();
+    REQUIRE(writer.is_ok());
+    return out.str();
+}
+
+TEST_CASE("export field columns", "[FieldExport]") {
+    std::stringstream out;
+    CaptureWriter writer(&out, 1);
+    std::vector<uint8_t> data;
+
+    for (uint8_t id : {1, 2}) {
+        append_mx64_ping(&data, id);
+    }
+
+    writer.write(0, 0, data.data(), data.size());
+
+    // the position of device 1 changes every other cycle, enough for several blocks
+    for (uint32_t i = 1; i <= 3000; i++) {
+        auto position = i / 2;
+        data = encode(1, Instruction::Read, {0x84, 0x00, 0x04, 0x00});
+        auto status = encode(
+            1,
+            Instruction::Status,
+            {(uint8_t) position, (uint8_t) (position >> 8), 0x00, 0x00});
+        data.insert(data.end(), status.begin(), status.end());
+        writer.write(i * 1000, 0, data.data(), data.size());
+    }
+
+    // a sync write to both devices
+    data = encode(0xfe, Instruction::SyncWrite, {0x40, 0x00, 0x01, 0x00, 0x01, 0x01, 0x02, 0x01});
+    writer.write(4000000, 0, data.data(), data.size());
+
+    auto capture = out.str();
+    FieldTracker tracker(1);
+    auto columns_data = export_columns(capture, &tracker);
+
+    FieldColumnReader reader((const uint8_t*) columns_data.data(), columns_data.size());
+    REQUIRE(reader.open() == FieldColumnsResult::Ok);
+
+    // every field of both devices, since they all got their initial values
+    REQUIRE(reader.columns().size() == tracker.columns().size());
+    REQUIRE(reader.columns().size() == 2 * tracker.control_table_map().get(DeviceId(1))
+                                               .value()
+                                               ->fields()
+                                               .size());
+
+    auto find_column = [&](uint8_t id, const char* name) {
+        for (size_t i = 0; i < reader.columns().size(); i++) {
+            auto& column = reader.columns()[i].column;
+
+            if (column.device_id == DeviceId(id) && column.name == name) {
+                return i;
+            }
+        }
+
+        FAIL("no column " << name << " for device " << (int) id);
+        return (size_t) 0;
+    };
+
+    std::vector<FieldSample> samples;
+    auto position_column = find_column(1, "Present Position");
+    REQUIRE(reader.read(position_column, &samples) == FieldColumnsResult::Ok);
+    REQUIRE(reader.columns()[position_column].num_samples == 1501);
+    REQUIRE(samples.size() == 1501);
+    REQUIRE(samples[0].timestamp == 0);
+    REQUIRE(samples[0].value == 0);
+    REQUIRE(samples[1].timestamp == 2000);
+    REQUIRE(samples[1].value == 1);
+    REQUIRE(samples[1500].timestamp == 3000000);
+    REQUIRE(samples[1500].value == 1500);
+
+    for (uint8_t id : {1, 2}) {
+        samples.clear();
+        REQUIRE(reader.read(find_column(id, "Torque Enable"), &samples) == FieldColumnsResult::Ok);
+        REQUIRE(samples.size() == 2);
+        REQUIRE(samples[1].timestamp == 4000000);
+        REQUIRE(samples[1].value == 1);
+    }
+
+    SECTION("detect invalid columns") {
+        columns_data[columns_data.size() - 16] ^= 0xff;
+        FieldColumnReader corrupted((const uint8_t*) columns_data.data(), columns_data.size());
+        REQUIRE(corrupted.open() == FieldColumnsResult::Corrupted);
+
+        columns_data[0] = 'X';
+        FieldColumnReader invalid((const uint8_t*) columns_data.data(), columns_data.size());
+        REQUIRE(invalid.open() == FieldColumnsResult::InvalidMagic);
+    }
+}
+
+TEST_CASE("format field values", "[FieldExport]") {
+    REQUIRE(fmt_field_value(ControlTableField::FieldType::UInt32, 4000000000) == "4000000000");
+
+    float value = -1.5f;
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    REQUIRE(fmt_field_value(ControlTableField::FieldType::Float32, bits) == "-1.5");
+}
@@ -0,0 +1,90 @@
+#include "histogram.h"
+#include <catch2/catch.hpp>
+
+TEST_CASE("histogram buckets", "[Histogram]") {
+    // small values are stored exactly
+    for (uint32_t i = 0; i < Histogram::SUB_BUCKETS; i++) {
+        REQUIRE(Histogram::bucket_index(i) == i);
+        REQUIRE(Histogram::bucket_highest_value(i) == i);
+    }
+
+    // buckets are contiguous and cover the whole range
+    REQUIRE(Histogram::bucket_index(Histogram::SUB_BUCKETS) == Histogram::SUB_BUCKETS);
+    REQUIRE(Histogram::bucket_index(0xffffffff) == Histogram::NUM_BUCKETS - 1);
+    REQUIRE(Histogram::bucket_highest_value(Histogram::NUM_BUCKETS - 1) == 0xffffffff);
+
+    for (size_t i = 0; i < Histogram::NUM_BUCKETS - 1; i++) {
+        auto highest_value = Histogram::bucket_highest_value(i);
+        REQUIRE(Histogram::bucket_index(highest_value) == i);
+        REQUIRE(Histogram::bucket_index(highest_value + 1) == i + 1);
+    }
+
+    // the relative error is bounded by the number of sub buckets
+    uint32_t values[]{100, 1000, 12345, 216000, 4000000000};
+
+    for (auto value : values) {
+        auto highest_value = Histogram::bucket_highest_value(Histogram::bucket_index(value));
+        REQUIRE(highest_value >= value);
+        REQUIRE(highest_value - value <= value / Histogram::SUB_BUCKETS);
+    }
+}
+
+TEST_CASE("histogram percentiles", "[Histogram]") {
+    Histogram histogram;
+
+    REQUIRE(histogram.count() == 0);
+    REQUIRE(histogram.min() == 0);
+    REQUIRE(histogram.max() == 0);
+    REQUIRE(histogram.mean() == 0.0f);
+    REQUIRE(histogram.percentile(50.0f) == 0);
+
+    for (uint32_t i = 1; i <= 1000; i++) {
+        histogram.record(i);
+    }
+
+    REQUIRE(histogram.count() == 1000);
+    REQUIRE(histogram.min() == 1);
+    REQUIRE(histogram.max() == 1000);
+    REQUIRE(histogram.mean() == Approx(500.5f));
+
+    REQUIRE(histogram.percentile(0.0f) == 1);
+    REQUIRE(histogram.percentile(50.0f) >= 500);
+    REQUIRE(histogram.percentile(50.0f) <= 500 + 500 / Histogram::SUB_BUCKETS);
+    REQUIRE(histogram.percentile(99.0f) >= 990);
+    REQUIRE(histogram.percentile(99.0f) <= 1000);
+    REQUIRE(histogram.percentile(100.0f) == 1000);
+
+    SECTION("tail latency") {
+        // a single outlier only shows up in the highest percentiles
+        histogram.record(100000);
+
+        REQUIRE(histogram.percentile(99.0f) <= 1000);
+        REQUIRE(histogram.percentile(99.95f) >= 100000);
+        REQUIRE(histogram.percentile(99.95f) <= 100000 + 100000 / Histogram::SUB_BUCKETS);
+        REQUIRE(histogram.max() == 100000);
+    }
+
+    SECTION("large values do not overflow") {
+        Histogram large_values;
+
+        for (size_t i = 0; i < 4; i++) {
+            large_values.record(0xffffffff);
+        }
+
+        REQUIRE(large_values.mean() == Approx(4294967295.0f));
+        REQUIRE(large_values.percentile(99.9f) == 0xffffffff);
+    }
+
+    SECTION("reset") {
+        histogram.reset();
+
+        REQUIRE(histogram.count() == 0);
+        REQUIRE(histogram.max() == 0);
+        REQUIRE(histogram.percentile(99.0f) == 0);
+
+        histogram.record(7);
+
+        REQUIRE(histogram.min() == 7);
+        REQUIRE(histogram.percentile(50.0f) == 7);
+    }
+}
@@ -0,0 +1,126 @@
+#include "log.h"
+#include <catch2/catch.hpp>
+
+#include <memory>
+
+TEST_CASE("log records", "[Log]") {
+    std::unique_ptr<Log> log(new Log());
+    Log::Record record;
+
+    REQUIRE_FALSE(log->pop(&record));
+
+    log->log(Log::Record(ParseResult::MismatchedChecksum));
+    log->log(Log::Record(ProtocolResult::InvalidDeviceId));
+
+    REQUIRE(log->pop(&record));
+    REQUIRE(record.sequence() == 0);
+    auto text = to_string(record);
+    REQUIRE(text.find("[+") == 0);
+    REQUIRE(
+        text.find("] error: " + to_string(ParseResult::MismatchedChecksum)) != std::string::npos);
+
+    REQUIRE(log->pop(&record));
+    REQUIRE(record.sequence() == 1);
+    REQUIRE(
+        to_string(record).find("] error: " + to_string(ProtocolResult::InvalidDeviceId))
+        != std::string::npos);
+
+    REQUIRE_FALSE(log->pop(&record));
+
+    SECTION("dropped records") {
+        for (size_t i = 0; i < LOG_RING_LEN + 3; i++) {
+            log->log(Log::Record(ParseResult::MismatchedChecksum));
+        }
+
+        for (size_t i = 0; i < LOG_RING_LEN; i++) {
+            REQUIRE(log->pop(&record));
+        }
+
+        // the newest records were dropped, which shows up as a gap in the sequence numbers
+        log->log(Log::Record(ParseResult::MismatchedChecksum));
+
+        REQUIRE(record.sequence() == LOG_RING_LEN + 1);
+        REQUIRE(log->pop(&record));
+        REQUIRE(record.sequence() == LOG_RING_LEN + 5);
+    }
+}
+
+TEST_CASE("log profiling information", "[Log]") {
+    std::unique_ptr<Log> log(new Log(2));
+    std::unique_ptr<LogStats> stats(new LogStats());
+
+    log->buf_processing_time(100);
+    log->buf_processing_time(300);
+    log->time_between_buf_processing(1000);
+    log->packet_processing_time(10);
+    log->lock_wait_time(0);
+    log->lock_wait_time(5);
+    log->receive_check(0, ReceiveCheck{ReceiveResult::Ok, 0, 500});
+    log->receive_check(1, ReceiveCheck{ReceiveResult::SkippedSegments, 2, -20});
+    log->receive_check(1, ReceiveCheck{ReceiveResult::OverwrittenSegment, 0, -100});
+    log->bus_processed(0, 100, 4);
+    log->bus_processed(1, 10, 1);
+    log->log(Log::Record(ParseResult::MismatchedChecksum, 0));
+
+    // the stats are only copied when requested
+    log->publish_stats();
+    REQUIRE_FALSE(log->read_stats(stats.get()));
+
+    log->request_stats();
+    REQUIRE_FALSE(log->read_stats(stats.get()));
+    log->publish_stats();
+    REQUIRE(log->read_stats(stats.get()));
+    REQUIRE_FALSE(log->read_stats(stats.get()));
+
+    REQUIRE(stats->buf_processing_times.count() == 2);
+    REQUIRE(stats->buf_processing_times.max() == 300);
+    REQUIRE(stats->times_between_buf_processing.count() == 1);
+    REQUIRE(stats->packet_processing_times.count() == 1);
+    REQUIRE(stats->lock_wait_times.count() == 2);
+    REQUIRE(stats->lock_wait_times.percentile(100.0f) == 5);
+    REQUIRE(stats->receive_headroom.count() == 3);
+    REQUIRE(stats->receive_headroom.min() == 0);
+    REQUIRE(stats->receive_headroom.max() == 500);
+    REQUIRE(stats->buses[0].num_bytes == 100);
+    REQUIRE(stats->buses[0].num_packets == 4);
+    REQUIRE(stats->buses[0].num_errors == 1);
+    REQUIRE(stats->buses[0].num_skipped_segments == 0);
+    REQUIRE(stats->buses[0].num_overwritten_segments == 0);
+    REQUIRE(stats->buses[1].num_bytes == 10);
+    REQUIRE(stats->buses[1].num_packets == 1);
+    REQUIRE(stats->buses[1].num_errors == 0);
+    REQUIRE(stats->buses[1].num_skipped_segments == 2);
+    REQUIRE(stats->buses[1].num_overwritten_segments == 1);
+
+    // failed receive checks are logged as records of their bus
+    Log::Record record;
+    REQUIRE(log->pop(&record));
+    REQUIRE(
+        to_string(record).find(
+            "] error: " + to_string(ReceiveResult::SkippedSegments) + " (bus 1)")
+        != std::string::npos);
+    REQUIRE(log->pop(&record));
+    REQUIRE(
+        to_string(record).find("] error: " + to_string(ReceiveResult::OverwrittenSegment))
+        != std::string::npos);
+    REQUIRE(log->pop(&record));
+    REQUIRE(to_string(record).find(" (bus 0)") != std::string::npos);
+    REQUIRE_FALSE(log->pop(&record));
+
+    SECTION("reset") {
+        log->reset_stats();
+        log->request_stats();
+        log->publish_stats();
+        REQUIRE(log->read_stats(stats.get()));
+
+        REQUIRE(stats->buf_processing_times.count() == 0);
+        REQUIRE(stats->times_between_buf_processing.count() == 0);
+        REQUIRE(stats->packet_processing_times.count() == 0);
+        REQUIRE(stats->lock_wait_times.count() == 0);
+        REQUIRE(stats->receive_headroom.count() == 0);
+        REQUIRE(stats->buses[0].num_packets == 0);
+        REQUIRE(stats->buses[0].num_errors == 0);
+        REQUIRE(stats->buses[1].num_skipped_segments == 0);
+        REQUIRE(stats->buses[1].num_overwritten_segments == 0);
+    }
+}
@@ -0,0 +1,111 @@
+#include "master_script.h"
+#include "parser.h"
+#include <catch2/catch.hpp>
+
+#include <string>
+#include <vector>
+
+/// Parses the packet of a step into `instruction_packet`.
+static void parse_step(
+    const MasterScript& script,
+    const MasterStep& step,
+    InstructionPacket* instruction_packet) {
+    Parser parser;
+    Packet packet{DeviceId(0), Instruction::Ping, Error(), {}};
+    Cursor cursor(script.data() + step.offset, step.len);
+    REQUIRE(parser.parse(cursor, &packet) == ParseResult::PacketAvailable);
+    REQUIRE(cursor.remaining_bytes() == 0);
+    REQUIRE(parse_instruction_packet(packet, instruction_packet) == InstructionParseResult::Ok);
+}
+
+TEST_CASE("parse master scripts", "[MasterScript]") {
+    MasterScript script;
+    std::string error;
+
+    SECTION("instructions") {
+        REQUIRE(script.parse(
+            "# enables the torque of all servos\n"
+            "Write 254 64 1 1\n"
+            "\n"
+            "SyncWrite 116 4 1=2048 2=0x400  # goal positions\n"
+            "SyncRead 132 4 1 2\n"
+            "BulkRead 1:132:4 3:36:12\n"
+            "BulkWrite 1:65:1=1 2:102:2=200\n"
+            "Ping 254\n"
+            "RegWrite 1 65 1 0\n"
+            "Action 1\n"
+            "FactoryReset 2 0x01\n"
+            "FastSyncRead 132 4 1 2\n",
+            &error));
+
+        auto& steps = script.steps();
+        REQUIRE(steps.size() == 10);
+        REQUIRE(steps[0].line == 2);
+        REQUIRE(steps[1].line == 4);
+        REQUIRE(steps[9].offset + steps[9].len == script.len());
+
+        InstructionPacket write;
+        parse_step(script, steps[0], &write);
+        REQUIRE(write.instruction == Instruction::Write);
+        REQUIRE(write.write.device_id.is_broadcast());
+        REQUIRE(write.write.start_addr == 64);
+        REQUIRE(write.write.data == std::vector<uint8_t>{0x01});
+        REQUIRE(steps[0].num_responses == 0);
+
+        InstructionPacket sync_write;
+        parse_step(script, steps[1], &sync_write);
+        REQUIRE(sync_write.instruction == Instruction::SyncWrite);
+        REQUIRE(sync_write.sync_write.len == 4);
+        REQUIRE(sync_write.sync_write.devices == std::vector<DeviceId>{DeviceId(1), DeviceId(2)});
+        REQUIRE(
+            sync_write.sync_write.data
+            == std::vector<uint8_t>{0x00, 0x08, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00});
+        REQUIRE(steps[1].num_responses == 0);
+
+        InstructionPacket packet;
+        parse_step(script, steps[2], &packet);
+        REQUIRE(packet.instruction == Instruction::SyncRead);
+        REQUIRE(steps[2].num_responses == 2);
+
+        InstructionPacket bulk_read;
+        parse_step(script, steps[3], &bulk_read);
+        REQUIRE(bulk_read.bulk_read.reads.size() == 2);
+        REQUIRE(bulk_read.bulk_read.reads[1].device_id == DeviceId(3));
+        REQUIRE(bulk_read.bulk_read.reads[1].start_addr == 36);
+        REQUIRE(bulk_read.bulk_read.reads[1].len == 12);
+        REQUIRE(steps[3].num_responses == 2);
+
+        InstructionPacket bulk_write;
+        parse_step(script, steps[4], &bulk_write);
+        REQUIRE(bulk_write.bulk_write.writes.size() == 2);
+        REQUIRE(bulk_write.bulk_write.writes[1].data == std::vector<uint8_t>{0xc8, 0x00});
+        REQUIRE(steps[4].num_responses == 0);
+
+        REQUIRE(steps[5].num_responses == MasterScript::UNKNOWN_NUM_RESPONSES);
+        parse_step(script, steps[6], &packet);
+        REQUIRE(packet.instruction == Instruction::RegWrite);
+        REQUIRE(steps[7].num_responses == 1);
+
+        InstructionPacket factory_reset;
+        parse_step(script, steps[8], &factory_reset);
+        REQUIRE(factory_reset.factory_reset.reset == FactoryReset::ResetAllExceptId);
+
+        REQUIRE(steps[9].instruction == Instruction::FastSyncRead);
+        REQUIRE(steps[9].num_responses == 1);
+    }
+
+    SECTION("invalid lines") {
+        REQUIRE_FALSE(script.parse("Ping 1\nJump 1\n", &error));
+        REQUIRE(error == "line 2: unknown instruction `Jump`");
+
+        REQUIRE_FALSE(script.parse("Read 1 132\n", &error));
+        REQUIRE(error == "line 1: expected `Read <id> <addr> <len>`");
+
+        // values must fit into their length
+        REQUIRE_FALSE(script.parse("Write 1 65 1 256\n", &error));
+        REQUIRE_FALSE(script.parse("SyncWrite 116 3 1=0\n", &error));
+        REQUIRE_FALSE(script.parse("Ping 255\n", &error));
+        REQUIRE_FALSE(script.parse("FactoryReset 1 3\n", &error));
+        REQUIRE_FALSE(script.parse("Status 1\n", &error));
+    }
+}
@@ -0,0 +1,133 @@
+#include "packet_encoder.h"
+#include "parser.h"
+#include <catch2/catch.hpp>
+
+#include <vector>
+
+/// Parses all packets in `data`.
+static std::vector<Packet> parse_all(const uint8_t* data, size_t len) {
+    Parser parser;
+    Packet packet{DeviceId(0), Instruction::Ping, Error(), {}};
+    Cursor cursor(data, len);
+    std::vector<Packet> packets;
+    ParseResult result;
+
+    while ((result = parser.parse(cursor, &packet)) != ParseResult::NeedMoreData) {
+        REQUIRE(result == ParseResult::PacketAvailable);
+        packets.push_back(packet);
+    }
+
+    return packets;
+}
+
+TEST_CASE("encode packets", "[PacketEncoder]") {
+    uint8_t buf[256];
+    PacketEncoder encoder(buf, sizeof(buf));
+
+    SECTION("ping and read packets") {
+        REQUIRE(encode_instruction_packet(InstructionPacket(PingArgs{DeviceId(1)}), &encoder));
+        REQUIRE(
+            encode_instruction_packet(InstructionPacket(ReadArgs{DeviceId(1), 132, 4}), &encoder));
+
+        REQUIRE(
+            std::vector<uint8_t>(encoder.data(), encoder.data() + encoder.len())
+            == std::vector<uint8_t>{0xff, 0xff, 0xfd, 0x00, 0x01, 0x03, 0x00, 0x01, 0x19, 0x4e,
+                                    0xff, 0xff, 0xfd, 0x00, 0x01, 0x07, 0x00, 0x02, 0x84, 0x00,
+                                    0x04, 0x00, 0x1d, 0x15});
+    }
+
+    SECTION("status packets") {
+        uint8_t data[] = {0x37, 0x01, 0x06};
+        REQUIRE(encode_status_packet(DeviceId(1), Error(0x80), data, sizeof(data), &encoder));
+
+        auto packets = parse_all(encoder.data(), encoder.len());
+        REQUIRE(packets.size() == 1);
+        REQUIRE(packets[0].device_id == DeviceId(1));
+        REQUIRE(packets[0].instruction == Instruction::Status);
+        REQUIRE(packets[0].error == Error(0x80));
+        REQUIRE(packets[0].data == std::vector<uint8_t>{0x37, 0x01, 0x06});
+    }
+
+    SECTION("byte stuffing") {
+        Packet packet{
+            DeviceId(1),
+            Instruction::Write,
+            Error(),
+            {0x00, 0x00, 0xff, 0xff, 0xfd, 0xff, 0xff, 0xff, 0xfd},
+        };
+        REQUIRE(encode_packet(packet, &encoder));
+
+        // both headers in the payload are stuffed
+        REQUIRE(encoder.len() == 10 + 9 + 2);
+        REQUIRE(buf[5] == 9 + 2 + 1 + 2);
+        REQUIRE(buf[12] == 0xfd);
+        REQUIRE(buf[13] == 0xfd);
+
+        auto packets = parse_all(encoder.data(), encoder.len());
+        REQUIRE(packets.size() == 1);
+        REQUIRE(packets[0].data == packet.data);
+    }
+
+    SECTION("all instructions") {
+        InstructionPacket cycle[11];
+        cycle[0] = InstructionPacket(WriteArgs{DeviceId(2), 116, {0x01, 0x02, 0x03, 0x04}});
+        cycle[1] = InstructionPacket(RegWriteArgs{DeviceId(2), 64, {0x01}});
+        cycle[2] = InstructionPacket(ActionArgs{DeviceId::broadcast()});
+        cycle[3] = InstructionPacket(FactoryResetArgs{DeviceId(3), FactoryReset::ResetAllExceptId});
+        cycle[4] = InstructionPacket(RebootArgs{DeviceId(3)});
+        cycle[5] = InstructionPacket(ClearArgs{DeviceId(3)});
+        cycle[6] = InstructionPacket(SyncReadArgs{{DeviceId(1), DeviceId(2)}, 132, 4});
+        cycle[7] = InstructionPacket(SyncWriteArgs{
+            {DeviceId(1), DeviceId(2)}, 116, 2, {0xff, 0xff, 0xfd, 0x00}});
+        cycle[8] = InstructionPacket(BulkReadArgs{{{DeviceId(1), 132, 4}, {DeviceId(2), 0, 2}}});
+        cycle[9] = InstructionPacket(BulkWriteArgs{
+            {{DeviceId(1), 116, {0x01, 0x02}}, {DeviceId(2), 64, {0x01}}}});
+        cycle[10] = InstructionPacket(FastSyncReadArgs{{DeviceId(1), DeviceId(2)}, 132, 4});
+
+        REQUIRE(encode_instruction_packets(cycle, 11, &encoder) == 11);
+        auto packets = parse_all(encoder.data(), encoder.len());
+        REQUIRE(packets.size() == 11);
+
+        // decoding and encoding again results in the same bytes
+        uint8_t other_buf[256];
+        PacketEncoder other_encoder(other_buf, sizeof(other_buf));
+
+        for (size_t i = 0; i < packets.size(); i++) {
+            InstructionPacket instruction_packet;
+            REQUIRE(
+                parse_instruction_packet(packets[i], &instruction_packet)
+                == InstructionParseResult::Ok);
+            REQUIRE(instruction_packet.instruction == cycle[i].instruction);
+            REQUIRE(encode_instruction_packet(instruction_packet, &other_encoder));
+        }
+
+        REQUIRE(
+            std::vector<uint8_t>(other_encoder.data(), other_encoder.data() + other_encoder.len())
+            == std::vector<uint8_t>(encoder.data(), encoder.data() + encoder.len()));
+    }
+
+    SECTION("sync write without data") {
+        InstructionPacket packet(SyncWriteArgs{{DeviceId(1), DeviceId(2)}, 116, 0, {}});
+
+        REQUIRE(encode_instruction_packet(packet, &encoder));
+        REQUIRE(encoder.len() == 10 + 4 + 2);
+        REQUIRE(buf[12] == 1);
+        REQUIRE(buf[13] == 2);
+    }
+
+    SECTION("full buffer") {
+        PacketEncoder small_encoder(buf, 16);
+        InstructionPacket cycle[2];
+        cycle[0] = InstructionPacket(PingArgs{DeviceId(1)});
+        cycle[1] = InstructionPacket(PingArgs{DeviceId(2)});
+
+        // the packet that does not fit is discarded
+        REQUIRE(encode_instruction_packets(cycle, 2, &small_encoder) == 1);
+        REQUIRE(small_encoder.len() == 10);
+
+        small_encoder.clear();
+        REQUIRE(encode_instruction_packet(cycle[1], &small_encoder));
+        REQUIRE(small_encoder.len() == 10);
+        REQUIRE(buf[4] == 2);
+    }
+}
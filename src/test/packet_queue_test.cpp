@@ -0,0 +1,126 @@
+#include "packet_queue.h"
+#include <catch2/catch.hpp>
+
+#include <memory>
+#include <thread>
+
+static Packet new_packet(uint8_t id, size_t data_len) {
+    std::vector<uint8_t> data;
+
+    for (size_t i = 0; i < data_len; i++) {
+        data.push_back((uint8_t) (id + i));
+    }
+
+    return Packet{DeviceId(id), Instruction::Write, Error(id), data};
+}
+
+TEST_CASE("push and pop packets", "[PacketQueue]") {
+    std::unique_ptr<PacketQueue> queue(new PacketQueue());
+    Packet packet = new_packet(0, 0);
+    size_t bus;
+    PacketKind kind;
+
+    REQUIRE_FALSE(queue->pop(&bus, &kind, &packet));
+
+    auto fragment = new_packet(3, MAX_PACKET_DATA_LEN);
+    fragment.data_offset = MAX_PACKET_DATA_LEN;
+    REQUIRE(queue->push(1, PacketKind::Fragment, fragment));
+    REQUIRE(queue->push(2, PacketKind::Gap));
+    REQUIRE(queue->size() == 2);
+
+    REQUIRE(queue->pop(&bus, &kind, &packet));
+    REQUIRE(bus == 1);
+    REQUIRE(kind == PacketKind::Fragment);
+    REQUIRE(packet.device_id == DeviceId(3));
+    REQUIRE(packet.instruction == Instruction::Write);
+    REQUIRE(packet.error == Error(3));
+    REQUIRE(packet.data == fragment.data);
+    REQUIRE(packet.data_offset == MAX_PACKET_DATA_LEN);
+
+    REQUIRE(queue->pop(&bus, &kind, &packet));
+    REQUIRE(bus == 2);
+    REQUIRE(kind == PacketKind::Gap);
+    REQUIRE(packet.data.empty());
+    REQUIRE(queue->is_empty());
+
+    SECTION("full ring") {
+        for (size_t i = 0; i < PacketQueue::NUM_ENTRIES; i++) {
+            REQUIRE(queue->push(0, PacketKind::Packet, new_packet(1, 0)));
+        }
+
+        REQUIRE_FALSE(queue->push(0, PacketKind::Gap));
+        REQUIRE(queue->pop(&bus, &kind, &packet));
+        REQUIRE(queue->push(0, PacketKind::Gap));
+    }
+
+    SECTION("full arena") {
+        auto num_packets = PacketQueue::ARENA_LEN / MAX_PACKET_DATA_LEN;
+
+        for (size_t i = 0; i < num_packets; i++) {
+            REQUIRE(queue->push(0, PacketKind::Packet, new_packet(1, MAX_PACKET_DATA_LEN)));
+        }
+
+        // packets without payload still fit
+        REQUIRE_FALSE(queue->push(0, PacketKind::Packet, new_packet(1, 1)));
+        REQUIRE(queue->push(0, PacketKind::Gap));
+
+        REQUIRE(queue->pop(&bus, &kind, &packet));
+        REQUIRE(queue->push(0, PacketKind::Packet, new_packet(1, MAX_PACKET_DATA_LEN)));
+    }
+
+    SECTION("payloads wrap around the end of the arena") {
+        // fill the arena so the next payload does not fit before its end
+        auto first_len = PacketQueue::ARENA_LEN * 5 / 16;
+        auto second_len = PacketQueue::ARENA_LEN * 6 / 16;
+
+        for (size_t i = 0; i < 3; i++) {
+            REQUIRE(queue->push(0, PacketKind::Packet, new_packet(5, first_len)));
+        }
+
+        REQUIRE(queue->pop(&bus, &kind, &packet));
+
+        // the bytes skipped at the end count as used, so the payload needs more space than
+        // has been freed at the start
+        REQUIRE_FALSE(queue->push(0, PacketKind::Packet, new_packet(6, second_len)));
+
+        REQUIRE(queue->pop(&bus, &kind, &packet));
+        REQUIRE(queue->push(0, PacketKind::Packet, new_packet(6, second_len)));
+        REQUIRE(queue->pop(&bus, &kind, &packet));
+        REQUIRE(packet.data == new_packet(5, first_len).data);
+        REQUIRE(queue->pop(&bus, &kind, &packet));
+        REQUIRE(packet.data == new_packet(6, second_len).data);
+        REQUIRE(queue->is_empty());
+    }
+}
+
+TEST_CASE("pass packets between threads", "[PacketQueue]") {
+    std::unique_ptr<PacketQueue> queue(new PacketQueue());
+    const size_t num_packets = 20000;
+
+    std::thread producer([&]() {
+        for (size_t i = 0; i < num_packets; i++) {
+            auto packet = new_packet((uint8_t) i, i % MAX_PACKET_DATA_LEN);
+
+            while (!queue->push(i % 4, PacketKind::Packet, packet)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    Packet packet = new_packet(0, 0);
+    size_t bus;
+    PacketKind kind;
+    bool is_ok = true;
+
+    for (size_t i = 0; i < num_packets; i++) {
+        while (!queue->pop(&bus, &kind, &packet)) {
+            std::this_thread::yield();
+        }
+
+        is_ok = is_ok && bus == i % 4 && packet.device_id == DeviceId((uint8_t) i)
+            && packet.data == new_packet((uint8_t) i, i % MAX_PACKET_DATA_LEN).data;
+    }
+
+    producer.join();
+    REQUIRE(is_ok);
+}
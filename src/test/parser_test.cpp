@@ -108,6 +108,7 @@ TEST_CASE("parse packets", "[Parser]") {
 
         REQUIRE(cursor.remaining_bytes() == 5);
         REQUIRE(result == ParseResult::PacketAvailable);
+        REQUIRE(parser.raw_packet_len() == sizeof(raw_packet) - 5);
         REQUIRE(packet.device_id == DeviceId(1));
         REQUIRE(packet.instruction == Instruction::Read);
         REQUIRE(packet.error == Error());
@@ -130,6 +131,9 @@ TEST_CASE("parse packets", "[Parser]") {
         REQUIRE(packet.instruction == Instruction::Read);
         REQUIRE(packet.error == Error());
         REQUIRE(packet.data == std::vector<uint8_t>{0xff, 0xff, 0xfd});
+
+        // the stuffing byte is part of the packet on the bus
+        REQUIRE(parser.raw_packet_len() == sizeof(raw_packet));
     }
 
     SECTION("packet split over two buffers") {
@@ -204,6 +208,82 @@ TEST_CASE("parse packets", "[Parser]") {
     }
 };
 
+/// Appends the checksum to a raw packet.
+static void append_checksum(std::vector<uint8_t>& raw_packet) {
+    Receiver receiver;
+    Cursor cursor(raw_packet.data(), raw_packet.size());
+    receiver.wait_for_header(cursor);
+
+    while (cursor.remaining_bytes() > 0) {
+        receiver.read_byte(cursor, Receiver::Crc::Enable);
+    }
+
+    auto crc = receiver.current_crc();
+    raw_packet.push_back(crc & 0xff);
+    raw_packet.push_back(crc >> 8);
+}
+
+TEST_CASE("parse fragmented packets", "[Parser]") {
+    Parser parser;
+    Packet packet{
+        DeviceId(0),
+        Instruction::Ping,
+        Error(),
+        std::vector<uint8_t>(),
+    };
+
+    // write packet with 2 bytes for the address and 300 bytes of data
+    std::vector<uint8_t> raw_packet{0xff, 0xff, 0xfd, 0x00, 0x01, 0x31, 0x01, 0x03, 0x40, 0x00};
+
+    for (size_t i = 0; i < 300; i++) {
+        raw_packet.push_back(i % 0x80);
+    }
+
+    append_checksum(raw_packet);
+
+    SECTION("complete packet") {
+        Cursor cursor(raw_packet.data(), raw_packet.size());
+        auto result = parser.parse(cursor, &packet);
+
+        REQUIRE(result == ParseResult::PacketFragment);
+        REQUIRE(packet.device_id == DeviceId(1));
+        REQUIRE(packet.instruction == Instruction::Write);
+        REQUIRE(packet.data_offset == 0);
+        REQUIRE(packet.data.size() == MAX_PACKET_DATA_LEN);
+        REQUIRE(packet.data[0] == 0x40);
+        REQUIRE(packet.data[2] == 0x00);
+
+        result = parser.parse(cursor, &packet);
+
+        REQUIRE(cursor.remaining_bytes() == 0);
+        REQUIRE(result == ParseResult::PacketAvailable);
+        REQUIRE(packet.data_offset == MAX_PACKET_DATA_LEN);
+        REQUIRE(packet.data.size() == 302 - MAX_PACKET_DATA_LEN);
+        REQUIRE(packet.data.back() == 299 % 0x80);
+    }
+
+    SECTION("packet split over two buffers") {
+        Cursor cursor(raw_packet.data(), 100);
+        auto result = parser.parse(cursor, &packet);
+
+        REQUIRE(result == ParseResult::NeedMoreData);
+
+        cursor = Cursor(raw_packet.data() + 100, raw_packet.size() - 100);
+        result = parser.parse(cursor, &packet);
+
+        REQUIRE(result == ParseResult::PacketFragment);
+        REQUIRE(packet.data_offset == 0);
+        REQUIRE(packet.data.size() == MAX_PACKET_DATA_LEN);
+
+        result = parser.parse(cursor, &packet);
+
+        REQUIRE(cursor.remaining_bytes() == 0);
+        REQUIRE(result == ParseResult::PacketAvailable);
+        REQUIRE(packet.data_offset == MAX_PACKET_DATA_LEN);
+        REQUIRE(packet.data.size() == 302 - MAX_PACKET_DATA_LEN);
+    }
+}
+
 TEST_CASE("parse invalid packets", "[Parser]") {
     Parser parser;
     Packet packet{
@@ -213,15 +293,23 @@ TEST_CASE("parse invalid packets", "[Parser]") {
         std::vector<uint8_t>(),
     };
 
-    SECTION("buffer overflow") {
-        std::vector<uint8_t> raw_packet{0xff, 0xff, 0xfd, 0x00, 0x01, 0xff, 0xff, 0x02};
-        raw_packet.resize(raw_packet.size() + MAX_PACKET_DATA_LEN + 10, 0x00);
+    SECTION("fragmented packet with invalid checksum") {
+        std::vector<uint8_t> raw_packet{0xff, 0xff, 0xfd, 0x00, 0x01, 0x2e, 0x01, 0x03};
+        raw_packet.resize(raw_packet.size() + MAX_PACKET_DATA_LEN + 43, 0x00);
+        raw_packet.push_back(0x12);
+        raw_packet.push_back(0x34);
 
         Cursor cursor(raw_packet.data(), raw_packet.size());
         auto result = parser.parse(cursor, &packet);
 
-        REQUIRE(cursor.remaining_bytes() == 9);
-        REQUIRE(result == ParseResult::BufferOverflow);
+        REQUIRE(result == ParseResult::PacketFragment);
+        REQUIRE(packet.data.size() == MAX_PACKET_DATA_LEN);
+        REQUIRE(packet.data_offset == 0);
+
+        result = parser.parse(cursor, &packet);
+
+        REQUIRE(cursor.remaining_bytes() == 0);
+        REQUIRE(result == ParseResult::MismatchedChecksum);
     }
 
     SECTION("invalid checksum") {
@@ -604,6 +692,48 @@ TEST_CASE("parse instruction packet from generic packet", "[parse_instruction_pa
         REQUIRE(result == InstructionParseResult::InvalidPacketLen);
     }
 
+    SECTION("fast sync read") {
+        packet = Packet{
+            DeviceId::broadcast(),
+            Instruction::FastSyncRead,
+            Error(),
+            std::vector<uint8_t>{0x84, 0x00, 0x04, 0x00, 0x01, 0x02},
+        };
+
+        auto result = parse_instruction_packet(packet, &instruction_packet);
+
+        REQUIRE(result == InstructionParseResult::Ok);
+        REQUIRE(instruction_packet.instruction == Instruction::FastSyncRead);
+        REQUIRE(
+            instruction_packet.fast_sync_read.devices
+            == std::vector<DeviceId>{DeviceId(1), DeviceId(2)});
+        REQUIRE(instruction_packet.fast_sync_read.start_addr == 0x0084);
+        REQUIRE(instruction_packet.fast_sync_read.len == 4);
+    }
+
+    SECTION("fast bulk read") {
+        packet = Packet{
+            DeviceId::broadcast(),
+            Instruction::FastBulkRead,
+            Error(),
+            std::vector<uint8_t>{0x01, 0x90, 0x00, 0x02, 0x00, 0x02, 0x92, 0x00, 0x01, 0x00},
+        };
+
+        auto result = parse_instruction_packet(packet, &instruction_packet);
+
+        REQUIRE(result == InstructionParseResult::Ok);
+        REQUIRE(instruction_packet.instruction == Instruction::FastBulkRead);
+        REQUIRE(instruction_packet.fast_bulk_read.reads.size() == 2);
+
+        REQUIRE(instruction_packet.fast_bulk_read.reads[0].device_id == DeviceId(1));
+        REQUIRE(instruction_packet.fast_bulk_read.reads[0].start_addr == 0x0090);
+        REQUIRE(instruction_packet.fast_bulk_read.reads[0].len == 2);
+
+        REQUIRE(instruction_packet.fast_bulk_read.reads[1].device_id == DeviceId(2));
+        REQUIRE(instruction_packet.fast_bulk_read.reads[1].start_addr == 0x0092);
+        REQUIRE(instruction_packet.fast_bulk_read.reads[1].len == 1);
+    }
+
     SECTION("bulk write") {
         uint8_t raw_packet[]{0xff, 0xff, 0xfd, 0x00, 0xfe, 0x10, 0x00, 0x93, 0x01, 0x20, 0x00, 0x02,
                              0x00, 0xa0, 0x00, 0x02, 0x1f, 0x00, 0x01, 0x00, 0x50, 0xb7, 0x68};
@@ -659,3 +789,132 @@ TEST_CASE("parse instruction packet from generic packet", "[parse_instruction_pa
         REQUIRE(result == InstructionParseResult::InvalidPacketLen);
     }
 }
+
+TEST_CASE("decode fragmented instruction packets", "[InstructionDecoder]") {
+    InstructionDecoder decoder;
+    InstructionPacket instruction_packet;
+
+    SECTION("sync write") {
+        // entries are split across the fragments
+        Packet first{
+            DeviceId::broadcast(),
+            Instruction::SyncWrite,
+            Error(),
+            std::vector<uint8_t>{0x74, 0x00, 0x02, 0x00, 0x01, 0xaa},
+        };
+
+        Packet last{
+            DeviceId::broadcast(),
+            Instruction::SyncWrite,
+            Error(),
+            std::vector<uint8_t>{0xbb, 0x02, 0xcc, 0xdd},
+            6,
+        };
+
+        decoder.decode(first);
+        decoder.decode(last);
+        auto result = decoder.finish(&instruction_packet);
+
+        REQUIRE(result == InstructionParseResult::Ok);
+        REQUIRE(instruction_packet.instruction == Instruction::SyncWrite);
+        REQUIRE(instruction_packet.sync_write.start_addr == 0x74);
+        REQUIRE(instruction_packet.sync_write.len == 2);
+        REQUIRE(
+            instruction_packet.sync_write.devices
+            == std::vector<DeviceId>{DeviceId(1), DeviceId(2)});
+        REQUIRE(instruction_packet.sync_write.data == std::vector<uint8_t>{0xaa, 0xbb, 0xcc, 0xdd});
+    }
+
+    SECTION("bulk write") {
+        Packet first{
+            DeviceId::broadcast(),
+            Instruction::BulkWrite,
+            Error(),
+            std::vector<uint8_t>{0x01, 0x10, 0x00, 0x02, 0x00, 0xaa, 0xbb, 0x02, 0x20},
+        };
+
+        Packet last{
+            DeviceId::broadcast(),
+            Instruction::BulkWrite,
+            Error(),
+            std::vector<uint8_t>{0x00, 0x01, 0x00, 0xcc},
+            9,
+        };
+
+        decoder.decode(first);
+        decoder.decode(last);
+        auto result = decoder.finish(&instruction_packet);
+
+        REQUIRE(result == InstructionParseResult::Ok);
+        REQUIRE(instruction_packet.instruction == Instruction::BulkWrite);
+        REQUIRE(instruction_packet.bulk_write.writes.size() == 2);
+        REQUIRE(instruction_packet.bulk_write.writes[0].device_id == DeviceId(1));
+        REQUIRE(instruction_packet.bulk_write.writes[0].start_addr == 0x10);
+        REQUIRE(instruction_packet.bulk_write.writes[0].data == std::vector<uint8_t>{0xaa, 0xbb});
+        REQUIRE(instruction_packet.bulk_write.writes[1].device_id == DeviceId(2));
+        REQUIRE(instruction_packet.bulk_write.writes[1].start_addr == 0x20);
+        REQUIRE(instruction_packet.bulk_write.writes[1].data == std::vector<uint8_t>{0xcc});
+    }
+
+    SECTION("bulk write with missing data") {
+        Packet first{
+            DeviceId::broadcast(),
+            Instruction::BulkWrite,
+            Error(),
+            std::vector<uint8_t>{0x01, 0x10, 0x00, 0x02, 0x00},
+        };
+
+        Packet last{
+            DeviceId::broadcast(),
+            Instruction::BulkWrite,
+            Error(),
+            std::vector<uint8_t>{0xaa},
+            5,
+        };
+
+        decoder.decode(first);
+        decoder.decode(last);
+        REQUIRE(decoder.finish(&instruction_packet) == InstructionParseResult::InvalidPacketLen);
+    }
+
+    SECTION("missing fragment") {
+        Packet first{
+            DeviceId::broadcast(),
+            Instruction::SyncRead,
+            Error(),
+            std::vector<uint8_t>{0x74, 0x00, 0x02, 0x00, 0x01},
+        };
+
+        Packet last{
+            DeviceId::broadcast(),
+            Instruction::SyncRead,
+            Error(),
+            std::vector<uint8_t>{0x03},
+            6,
+        };
+
+        decoder.decode(first);
+        decoder.decode(last);
+        REQUIRE(decoder.finish(&instruction_packet) == InstructionParseResult::InvalidPacketLen);
+    }
+
+    SECTION("fixed size instruction") {
+        Packet first{
+            DeviceId(1),
+            Instruction::Read,
+            Error(),
+            std::vector<uint8_t>{0x74, 0x00, 0x02, 0x00},
+        };
+
+        decoder.decode(first);
+        REQUIRE(decoder.finish(&instruction_packet) == InstructionParseResult::InvalidPacketLen);
+    }
+}
+
+TEST_CASE("convert instruction names", "[Instruction]") {
+    Instruction instruction;
+    REQUIRE(to_string(Instruction::SyncWrite) == "SyncWrite");
+    REQUIRE(instruction_from_string("FastBulkRead", &instruction));
+    REQUIRE(instruction == Instruction::FastBulkRead);
+    REQUIRE_FALSE(instruction_from_string("syncwrite", &instruction));
+}
@@ -0,0 +1,121 @@
+#include "endian_convert.h"
+#include "pcap_export.h"
+#include "test_packets.h"
+#include <catch2/catch.hpp>
+
+#include <sstream>
+
+struct Record {
+    uint64_t timestamp;
+    std::vector<uint8_t> data;
+};
+
+/// Reads the records of a pcap file with nanosecond timestamps.
+static std::vector<Record> read_records(const std::string& pcap) {
+    auto data = (const uint8_t*) pcap.data();
+    REQUIRE(pcap.size() >= 24);
+    REQUIRE(uint32_from_le(&data[0]) == 0xa1b23c4d);
+    REQUIRE(uint32_from_le(&data[20]) == PCAP_LINK_TYPE);
+
+    std::vector<Record> records;
+    size_t offset = 24;
+
+    while (offset < pcap.size()) {
+        REQUIRE(pcap.size() - offset >= 16);
+        auto header = &data[offset];
+        auto len = uint32_from_le(&header[8]);
+        REQUIRE(uint32_from_le(&header[12]) == len);
+        REQUIRE(pcap.size() - offset - 16 >= len);
+
+        uint64_t timestamp = uint32_from_le(&header[0]) * 1000000000ull
+            + uint32_from_le(&header[4]);
+        records.push_back(Record{timestamp, std::vector<uint8_t>(&header[16], &header[16] + len)});
+        offset += 16 + len;
+    }
+
+    return records;
+}
+
+/// Returns `packet` with the link-layer header of a frame.
+static std::vector<uint8_t> frame(uint8_t bus, uint8_t flags, std::vector<uint8_t> packet) {
+    packet.insert(packet.begin(), {bus, flags, 0x00, 0x00});
+    return packet;
+}
+
+TEST_CASE("export packets to pcap", "[PcapExporter]") {
+    std::stringstream out;
+    auto ping = encode(1, Instruction::Ping, {});
+    auto status = encode(1, Instruction::Status, {0x37, 0x01, 0x06});
+    auto read = encode(2, Instruction::Read, {0x84, 0x00, 0x04, 0x00});
+    auto broken_read = read;
+    broken_read.back() ^= 0xff;
+
+    // the status packet is split between the chunks of bus 0
+    std::vector<uint8_t> chunk1 = ping;
+    chunk1.insert(chunk1.end(), status.begin(), status.begin() + 5);
+    std::vector<uint8_t> chunk2(status.begin() + 5, status.end());
+    chunk2.insert(chunk2.end(), {0x12, 0x34});
+    chunk2.insert(chunk2.end(), broken_read.begin(), broken_read.end());
+    chunk2.insert(chunk2.end(), read.begin(), read.end());
+
+    SECTION("with timestamps of the chunks") {
+        {
+            PcapWriter writer(&out, PCAP_LINK_TYPE, 64);
+            PcapExporter exporter(&writer, 2, 0);
+            exporter.add(100, 0, chunk1.data(), chunk1.size());
+            exporter.add(150, 1, read.data(), read.size());
+            exporter.add(200, 0, chunk2.data(), chunk2.size());
+            REQUIRE(exporter.num_frames() == 5);
+        }
+
+        auto records = read_records(out.str());
+        REQUIRE(records.size() == 5);
+        REQUIRE(records[0].timestamp == 100000);
+        REQUIRE(records[0].data == frame(0, 0, ping));
+        REQUIRE(records[1].timestamp == 150000);
+        REQUIRE(records[1].data == frame(1, 0, read));
+        REQUIRE(records[2].timestamp == 200000);
+        REQUIRE(records[2].data == frame(0, 0, status));
+        REQUIRE(
+            records[3].data
+            == frame(0, PCAP_FLAG_MISMATCHED_CHECKSUM | PCAP_FLAG_RESYNC, broken_read));
+        REQUIRE(records[4].data == frame(0, 0, read));
+    }
+
+    SECTION("with timestamps of the packets") {
+        {
+            PcapWriter writer(&out, PCAP_LINK_TYPE);
+            PcapExporter exporter(&writer, 1, 1000000);
+            exporter.add(1000, 0, chunk1.data(), chunk1.size());
+            exporter.add(2000, 0, chunk2.data(), chunk2.size());
+        }
+
+        // a byte takes 10 us at 1 Mbaud
+        auto records = read_records(out.str());
+        REQUIRE(records.size() == 4);
+        REQUIRE(records[0].timestamp == 1000000 - 5 * 10000);
+        REQUIRE(records[1].timestamp == 2000000 - (chunk2.size() - 9) * 10000);
+        REQUIRE(records[3].timestamp == 2000000);
+    }
+
+    SECTION("large chunks") {
+        std::vector<uint8_t> chunk;
+
+        while (chunk.size() < 200000) {
+            chunk.insert(chunk.end(), read.begin(), read.end());
+        }
+
+        {
+            PcapWriter writer(&out, PCAP_LINK_TYPE);
+            PcapExporter exporter(&writer, 1, 0);
+            exporter.add(0, 0, chunk.data(), chunk.size());
+            exporter.add(0, 0, chunk.data(), chunk.size());
+        }
+
+        auto records = read_records(out.str());
+        REQUIRE(records.size() == chunk.size() / read.size() * 2);
+
+        REQUIRE(records.front().data == frame(0, 0, read));
+        REQUIRE(records.back().data == frame(0, 0, read));
+    }
+}
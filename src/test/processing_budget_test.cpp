@@ -0,0 +1,91 @@
+#include "processing_budget.h"
+#include <catch2/catch.hpp>
+
+/// A simulated packet task that processes slices of `slice_len` ticks whenever it is
+/// allowed to.
+struct SimulatedTask {
+    SimulatedTask(ProcessingBudget* budget, uint32_t slice_len) :
+        budget(budget),
+        slice_len(slice_len),
+        now(0),
+        processing_time(0) {}
+
+    /// Processes slices until the budget is used up or `until` is reached. Returns the
+    /// resume delay if the task yielded or 0 otherwise.
+    uint32_t run(uint32_t until, int32_t headroom) {
+        while (this->now < until) {
+            if (!this->budget->may_continue(this->now, headroom)) {
+                return this->budget->resume_delay(this->now, headroom);
+            }
+
+            this->budget->consumed(this->now, this->now + this->slice_len);
+            this->now += this->slice_len;
+            this->processing_time += this->slice_len;
+        }
+
+        return 0;
+    }
+
+    ProcessingBudget* budget;
+    uint32_t slice_len;
+    uint32_t now;
+    uint32_t processing_time;
+};
+
+TEST_CASE("share the cpu with the ui", "[ProcessingBudget]") {
+    ProcessingBudget budget(1000, 700, 200);
+    SimulatedTask task(&budget, 100);
+
+    SECTION("yield once the budget is used up") {
+        auto delay = task.run(5000, 10000);
+        REQUIRE(task.now == 700);
+        REQUIRE(budget.used() == 700);
+        REQUIRE(delay == 300);
+
+        // the next period starts with a new budget
+        task.now += delay;
+        delay = task.run(5000, 10000);
+        REQUIRE(task.now == 1700);
+        REQUIRE(delay == 300);
+    }
+
+    SECTION("the ui gets the slack") {
+        // the task processes continuously for 10 periods, but only gets its budget
+        while (task.now < 10000) {
+            task.now += task.run(10000, 10000);
+        }
+
+        REQUIRE(task.processing_time == 7000);
+    }
+
+    SECTION("the bus takes precedence") {
+        // the headroom is too low to yield
+        auto delay = task.run(1500, 150);
+        REQUIRE(delay == 0);
+        REQUIRE(task.now == 1500);
+        REQUIRE(task.processing_time == 1500);
+    }
+
+    SECTION("yields are limited by the headroom") {
+        task.run(5000, 10000);
+        REQUIRE(task.now == 700);
+        REQUIRE(budget.resume_delay(task.now, 350) == 150);
+        REQUIRE(budget.resume_delay(task.now, 10000) == 300);
+    }
+
+    SECTION("long sleeps start a new period") {
+        task.run(500, 10000);
+        task.now = 5250;
+        REQUIRE(task.run(5000 + 6000, 10000) == 300);
+        REQUIRE(task.now == 5950);
+    }
+
+    SECTION("timer overflow") {
+        ProcessingBudget budget(1000, 700, 200);
+        task.budget = &budget;
+        task.now = 0xfffffe00;
+        budget.may_continue(task.now, 10000);
+        REQUIRE(task.run(0xffffffff, 10000) == 1000 - 700);
+        REQUIRE(budget.used() == 700);
+    }
+}
@@ -0,0 +1,311 @@
+#include "clock.h"
+#include "parser.h"
+#include "receive_buf.h"
+#include <catch2/catch.hpp>
+
+#include <memory>
+
+const size_t NUM_SEGMENTS = 8;
+const size_t SEGMENT_LEN = 64;
+const size_t LEN = NUM_SEGMENTS * SEGMENT_LEN;
+const size_t HALF_LEN = LEN / 2;
+
+/// Simulates the DMA controller writing to a `ReceiveBuf` in circular mode.
+class Producer {
+  public:
+    Producer() :
+        dma_counter(LEN),
+        buf(bytes, NUM_SEGMENTS, SEGMENT_LEN, &dma_counter),
+        write_pos(0) {}
+
+    /// Writes `len` bytes and calls the DMA callbacks whenever a half has been filled.
+    void write(const uint8_t* bytes, size_t len) {
+        for (size_t i = 0; i < len; i++) {
+            this->write_without_callbacks(bytes[i]);
+
+            if (this->write_pos == HALF_LEN) {
+                this->buf.complete_half(ReceiveBuf::Half::Front);
+            } else if (this->write_pos == 0) {
+                this->buf.complete_half(ReceiveBuf::Half::Back);
+            }
+        }
+    }
+
+    void write_without_callbacks(uint8_t byte) {
+        this->bytes[this->write_pos] = byte;
+        this->write_pos = (this->write_pos + 1) % LEN;
+
+        // the counter is reloaded at the end of the ring
+        this->dma_counter = LEN - this->write_pos;
+    }
+
+    volatile uint8_t bytes[LEN];
+    volatile uint32_t dma_counter;
+    ReceiveBuf buf;
+    size_t write_pos;
+};
+
+static std::vector<uint8_t> read_bytes(Cursor& cursor) {
+    std::vector<uint8_t> bytes(cursor.remaining_bytes());
+    cursor.read(bytes.data(), bytes.size());
+    return bytes;
+}
+
+static std::vector<uint8_t> test_bytes(size_t len) {
+    std::vector<uint8_t> bytes(len);
+
+    for (size_t i = 0; i < len; i++) {
+        bytes[i] = (uint8_t) (i % 251);
+    }
+
+    return bytes;
+}
+
+TEST_CASE("byte duration for baudrate", "[ReceiveMonitor]") {
+    // a byte with 10 bits takes 10 us at 1 Mbit/s
+    REQUIRE(
+        ReceiveMonitor::byte_duration_for_baudrate(1000000)
+        == (uint32_t) (10 * Clock::TICKS_PER_US));
+}
+
+TEST_CASE("count written bytes", "[ReceiveBuf]") {
+    Producer producer;
+    auto bytes = test_bytes(3 * LEN);
+    REQUIRE(producer.buf.len() == LEN);
+    REQUIRE(producer.buf.num_segments() == NUM_SEGMENTS);
+    REQUIRE(producer.buf.write_count() == 0);
+
+    producer.write(bytes.data(), HALF_LEN + 10);
+    REQUIRE(producer.buf.write_count() == HALF_LEN + 10);
+
+    producer.write(bytes.data(), LEN);
+    REQUIRE(producer.buf.write_count() == LEN + HALF_LEN + 10);
+
+    SECTION("callback has not run yet") {
+        for (size_t i = 0; i < HALF_LEN; i++) {
+            producer.write_without_callbacks(bytes[i]);
+        }
+
+        REQUIRE(producer.buf.write_count() == 2 * LEN + 10);
+    }
+
+    SECTION("missed callback") {
+        producer.buf.complete_half(ReceiveBuf::Half::Back);
+        REQUIRE(producer.buf.num_completed_halves == 4);
+        producer.buf.complete_half(ReceiveBuf::Half::Back);
+        REQUIRE(producer.buf.num_completed_halves == 6);
+    }
+}
+
+TEST_CASE("detect overruns", "[ReceiveMonitor]") {
+    Producer producer;
+    ReceiveMonitor monitor(10);
+
+    SECTION("keeping up") {
+        auto check = monitor.check(producer.buf, 0, 100, 0);
+        REQUIRE(check.result == ReceiveResult::Ok);
+        REQUIRE(check.num_skipped_segments == 0);
+        REQUIRE(check.headroom == (int32_t) (LEN - 100) * 10);
+    }
+
+    SECTION("skipped segments") {
+        auto check = monitor.check(producer.buf, LEN, LEN + 100, 3);
+        REQUIRE(check.result == ReceiveResult::SkippedSegments);
+        REQUIRE(check.num_skipped_segments == 3);
+    }
+
+    SECTION("overwritten segment") {
+        // the producer has started to refill the segment
+        auto check = monitor.check(producer.buf, SEGMENT_LEN, 2 * SEGMENT_LEN + LEN, 0);
+        REQUIRE(check.result == ReceiveResult::OverwrittenSegment);
+        REQUIRE(check.headroom == -(int32_t) SEGMENT_LEN * 10);
+    }
+
+    SECTION("counter overflow") {
+        auto check = monitor.check(producer.buf, 0xffffff00, 0x10, 0);
+        REQUIRE(check.result == ReceiveResult::Ok);
+        REQUIRE(check.headroom == (int32_t) (LEN - 0x110) * 10);
+    }
+}
+
+TEST_CASE("read while receiving", "[ReceiveReader]") {
+    Producer producer;
+    auto& buf = producer.buf;
+    ReceiveReader reader(10);
+    ReceiveCheck check;
+    auto bytes = test_bytes(3 * LEN);
+
+    // nothing has been received yet
+    auto cursor = reader.next(buf, buf.write_count());
+    REQUIRE(cursor.remaining_bytes() == 0);
+    REQUIRE_FALSE(reader.finish(buf, &check));
+
+    SECTION("partially filled segments") {
+        producer.write(bytes.data(), 10);
+        cursor = reader.next(buf, buf.write_count());
+        REQUIRE(read_bytes(cursor) == std::vector<uint8_t>(bytes.begin(), bytes.begin() + 10));
+        REQUIRE_FALSE(reader.finish(buf, &check));
+
+        cursor = reader.next(buf, buf.write_count());
+        REQUIRE(cursor.remaining_bytes() == 0);
+        REQUIRE_FALSE(reader.finish(buf, &check));
+
+        // the cursor ends at the end of the first segment
+        producer.write(bytes.data() + 10, SEGMENT_LEN);
+        cursor = reader.next(buf, buf.write_count());
+        REQUIRE(
+            read_bytes(cursor)
+            == std::vector<uint8_t>(bytes.begin() + 10, bytes.begin() + SEGMENT_LEN));
+        REQUIRE(reader.finish(buf, &check));
+        REQUIRE(check.result == ReceiveResult::Ok);
+        REQUIRE(check.headroom == (int32_t) (LEN - SEGMENT_LEN - 10) * 10);
+
+        cursor = reader.next(buf, buf.write_count());
+        REQUIRE(
+            read_bytes(cursor)
+            == std::vector<uint8_t>(
+                bytes.begin() + SEGMENT_LEN,
+                bytes.begin() + SEGMENT_LEN + 10));
+        REQUIRE_FALSE(reader.finish(buf, &check));
+    }
+
+    SECTION("limited length") {
+        producer.write(bytes.data(), 3 * SEGMENT_LEN);
+        auto write_count = buf.write_count();
+        REQUIRE(reader.next(buf, write_count, 40).remaining_bytes() == 40);
+        REQUIRE_FALSE(reader.finish(buf, &check));
+        REQUIRE(reader.next(buf, write_count, 40).remaining_bytes() == SEGMENT_LEN - 40);
+        REQUIRE(reader.finish(buf, &check));
+        REQUIRE(reader.next(buf, write_count).remaining_bytes() == SEGMENT_LEN);
+        REQUIRE(reader.finish(buf, &check));
+
+        // data received after the snapshot is not read
+        producer.write(bytes.data(), 10);
+        REQUIRE(reader.next(buf, write_count).remaining_bytes() == SEGMENT_LEN);
+        REQUIRE(reader.finish(buf, &check));
+        REQUIRE(reader.next(buf, write_count).remaining_bytes() == 0);
+    }
+
+    SECTION("wrap around") {
+        producer.write(bytes.data(), LEN - 10);
+
+        for (size_t i = 0; i < NUM_SEGMENTS - 1; i++) {
+            REQUIRE(reader.next(buf, buf.write_count()).remaining_bytes() == SEGMENT_LEN);
+            REQUIRE(reader.finish(buf, &check));
+        }
+
+        REQUIRE(reader.next(buf, buf.write_count()).remaining_bytes() == SEGMENT_LEN - 10);
+        REQUIRE_FALSE(reader.finish(buf, &check));
+
+        producer.write(bytes.data() + LEN - 10, 20);
+        cursor = reader.next(buf, buf.write_count());
+        REQUIRE(
+            read_bytes(cursor)
+            == std::vector<uint8_t>(bytes.begin() + LEN - 10, bytes.begin() + LEN));
+        REQUIRE(reader.finish(buf, &check));
+        REQUIRE(check.result == ReceiveResult::Ok);
+
+        cursor = reader.next(buf, buf.write_count());
+        REQUIRE(
+            read_bytes(cursor)
+            == std::vector<uint8_t>(bytes.begin() + LEN, bytes.begin() + LEN + 10));
+    }
+
+    SECTION("lapped by the producer") {
+        producer.write(bytes.data(), LEN + 2 * SEGMENT_LEN + 10);
+
+        // the first three segments are being refilled, so continue with the oldest intact
+        // segment
+        cursor = reader.next(buf, buf.write_count());
+        REQUIRE(
+            read_bytes(cursor)
+            == std::vector<uint8_t>(
+                bytes.begin() + 3 * SEGMENT_LEN,
+                bytes.begin() + 4 * SEGMENT_LEN));
+        REQUIRE(reader.finish(buf, &check));
+        REQUIRE(check.result == ReceiveResult::SkippedSegments);
+        REQUIRE(check.num_skipped_segments == 3);
+
+        cursor = reader.next(buf, buf.write_count());
+        REQUIRE(reader.finish(buf, &check));
+        REQUIRE(check.result == ReceiveResult::Ok);
+        REQUIRE(check.num_skipped_segments == 0);
+    }
+
+    SECTION("headroom of unread data") {
+        REQUIRE(reader.headroom(buf, buf.write_count()) == (int32_t) LEN * 10);
+        producer.write(bytes.data(), 100);
+        REQUIRE(reader.headroom(buf, buf.write_count()) == (int32_t) (LEN - 100) * 10);
+
+        reader.next(buf, buf.write_count(), 30);
+        REQUIRE(reader.headroom(buf, buf.write_count()) == (int32_t) (LEN - 70) * 10);
+    }
+
+    SECTION("overwritten while reading") {
+        producer.write(bytes.data(), LEN - 10);
+        cursor = reader.next(buf, buf.write_count());
+        REQUIRE(cursor.remaining_bytes() == SEGMENT_LEN);
+
+        // the producer reaches the segment before it has been processed
+        producer.write(bytes.data(), 20);
+        REQUIRE(reader.finish(buf, &check));
+        REQUIRE(check.result == ReceiveResult::OverwrittenSegment);
+        REQUIRE(check.headroom == -10 * 10);
+    }
+}
+
+TEST_CASE("parse while receiving", "[ReceiveReader]") {
+    Producer producer;
+    ReceiveReader reader(10);
+    Parser parser;
+    Packet packet{
+        DeviceId(0),
+        Instruction::Ping,
+        Error(),
+        std::vector<uint8_t>(),
+    };
+
+    uint8_t ping_packet[]{0xff, 0xff, 0xfd, 0x00, 0x01, 0x03, 0x00, 0x01, 0x19, 0x4e};
+    const size_t NUM_PACKETS = 2000;
+    size_t num_packets = 0;
+
+    // deliver the packets in chunks that do not line up with the packet or segment
+    // boundaries
+    for (size_t i = 0; i < NUM_PACKETS; i++) {
+        producer.write(ping_packet, sizeof(ping_packet));
+
+        if (i % 7 != 0) {
+            continue;
+        }
+
+        while (true) {
+            auto cursor = reader.next(producer.buf, producer.buf.write_count());
+            auto cursor_len = cursor.remaining_bytes();
+
+            while (cursor.remaining_bytes() > 0) {
+                auto result = parser.parse(cursor, &packet);
+
+                if (result == ParseResult::NeedMoreData) {
+                    break;
+                }
+
+                REQUIRE(result == ParseResult::PacketAvailable);
+                REQUIRE(packet.device_id == DeviceId(1));
+                num_packets++;
+            }
+
+            ReceiveCheck check;
+
+            if (reader.finish(producer.buf, &check)) {
+                REQUIRE(check.result == ReceiveResult::Ok);
+            }
+
+            if (cursor_len == 0) {
+                break;
+            }
+        }
+    }
+
+    // the packets after the last read are still in the buffer
+    REQUIRE(num_packets == NUM_PACKETS - NUM_PACKETS % 7 + 1);
+}
@@ -0,0 +1,31 @@
+#include "software_dma.h"
+#include <catch2/catch.hpp>
+
+#include <vector>
+
+TEST_CASE("fill a receive buffer in software", "[SoftwareDma]") {
+    SoftwareDma dma(4, 8);
+    auto& buf = dma.buf();
+    std::vector<uint8_t> data;
+
+    for (size_t i = 0; i < 100; i++) {
+        data.push_back((uint8_t) i);
+    }
+
+    dma.write(data.data(), 5);
+    REQUIRE(buf.write_count() == 5);
+    REQUIRE(buf.num_completed_halves == 0);
+
+    // ends exactly at the end of the front half
+    dma.write(&data[5], 11);
+    REQUIRE(buf.write_count() == 16);
+    REQUIRE(buf.num_completed_halves == 1);
+
+    // a write may complete several halves and wrap around the ring
+    dma.write(&data[16], 50);
+    REQUIRE(buf.write_count() == 66);
+    REQUIRE(buf.num_completed_halves == 4);
+    REQUIRE(buf.bytes()[0] == 64);
+    REQUIRE(buf.bytes()[1] == 65);
+    REQUIRE(buf.bytes()[2] == 34);
+}
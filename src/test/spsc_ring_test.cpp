@@ -0,0 +1,64 @@
+#include "spsc_ring.h"
+#include <catch2/catch.hpp>
+
+#include <thread>
+
+TEST_CASE("push and pop items", "[SpscRing]") {
+    SpscRing<uint32_t, 4> ring;
+    uint32_t item;
+
+    REQUIRE(ring.is_empty());
+    REQUIRE_FALSE(ring.pop(&item));
+
+    for (uint32_t i = 0; i < 4; i++) {
+        REQUIRE(ring.push(i));
+    }
+
+    REQUIRE(ring.size() == 4);
+    REQUIRE_FALSE(ring.push(4));
+
+    REQUIRE(ring.pop(&item));
+    REQUIRE(item == 0);
+    REQUIRE(ring.push(4));
+
+    for (uint32_t i = 1; i <= 4; i++) {
+        REQUIRE(ring.pop(&item));
+        REQUIRE(item == i);
+    }
+
+    REQUIRE(ring.is_empty());
+    REQUIRE_FALSE(ring.pop(&item));
+}
+
+TEST_CASE("pass items between threads", "[SpscRing]") {
+    SpscRing<uint32_t, 16> ring;
+    const uint32_t num_items = 100000;
+
+    std::thread producer([&]() {
+        for (uint32_t i = 0; i < num_items; i++) {
+            while (!ring.push(i)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    // every item must arrive exactly once and in order
+    uint32_t next_item = 0;
+    bool is_in_order = true;
+
+    while (next_item < num_items) {
+        uint32_t item;
+
+        if (ring.pop(&item)) {
+            is_in_order &= item == next_item;
+            next_item++;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+
+    producer.join();
+
+    REQUIRE(is_in_order);
+    REQUIRE(ring.is_empty());
+}
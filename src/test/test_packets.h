@@ -0,0 +1,42 @@
+#ifndef TEST_PACKETS_H
+#define TEST_PACKETS_H
+
+#include "packet_encoder.h"
+#include "parser.h"
+#include <catch2/catch.hpp>
+
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+/// Encodes a packet like a device or controller would (see `encode_packet`), including byte
+/// stuffing.
+inline std::vector<uint8_t> encode(const Packet& packet) {
+    // stuffing adds at most a byte for every three bytes of the payload
+    std::vector<uint8_t> buf(16 + packet.data.size() * 2);
+    PacketEncoder encoder(buf.data(), buf.size());
+    REQUIRE(encode_packet(packet, &encoder));
+
+    buf.resize(encoder.len());
+    return buf;
+}
+
+/// Encodes a packet of the device `id`. `error` is only used by status packets.
+inline std::vector<uint8_t>
+    encode(uint8_t id, Instruction instruction, std::vector<uint8_t> data, uint8_t error = 0) {
+    return encode(Packet{DeviceId(id), instruction, Error(error), std::move(data)});
+}
+
+/// Appends the bytes of an encoded packet to `data`.
+inline void append(std::vector<uint8_t>* data, const std::vector<uint8_t>& packet) {
+    data->insert(data->end(), packet.begin(), packet.end());
+}
+
+/// Appends a ping of the device `id` and the response of an MX-64, so its control table is
+/// known from then on.
+inline void append_mx64_ping(std::vector<uint8_t>* data, uint8_t id) {
+    append(data, encode(id, Instruction::Ping, {}));
+    append(data, encode(id, Instruction::Status, {0x37, 0x01, 0x06}));
+}
+
+#endif
@@ -0,0 +1,98 @@
+#include "trace.h"
+#include <catch2/catch.hpp>
+
+#include <string.h>
+
+template <size_t LEN>
+static std::vector<uint8_t> dump(const TraceRing<LEN>& ring) {
+    std::vector<uint8_t> bytes(sizeof(ring));
+    memcpy(bytes.data(), &ring, sizeof(ring));
+    return bytes;
+}
+
+TEST_CASE("decode trace ring dumps", "[TraceRing]") {
+    TraceRing<4> ring;
+    std::vector<TraceRecord> records;
+
+    SECTION("empty ring") {
+        auto bytes = dump(ring);
+        REQUIRE(bytes.size() == 4 + 4 * sizeof(TraceRecord));
+        REQUIRE(decode_trace_dump(bytes.data(), bytes.size(), &records) == TraceDecodeResult::Ok);
+        REQUIRE(records.empty());
+    }
+
+    SECTION("partially filled ring") {
+        ring.push(TraceRecord{10, 1, 2, TraceEvent::ParseStart, TraceTrack::Packets, 0});
+        ring.push(TraceRecord{20, 3, 4, TraceEvent::ParseEnd, TraceTrack::Packets, 0});
+
+        auto bytes = dump(ring);
+        REQUIRE(decode_trace_dump(bytes.data(), bytes.size(), &records) == TraceDecodeResult::Ok);
+        REQUIRE(records.size() == 2);
+
+        REQUIRE(records[0].timestamp == 10);
+        REQUIRE(records[0].arg0 == 1);
+        REQUIRE(records[0].arg1 == 2);
+        REQUIRE(records[0].event == TraceEvent::ParseStart);
+        REQUIRE(records[0].track == TraceTrack::Packets);
+
+        REQUIRE(records[1].timestamp == 20);
+        REQUIRE(records[1].event == TraceEvent::ParseEnd);
+    }
+
+    SECTION("overwritten records") {
+        for (uint32_t i = 0; i < 6; i++) {
+            ring.push(TraceRecord{i, i, 0, TraceEvent::PacketDecoded, TraceTrack::Packets, 0});
+        }
+
+        auto bytes = dump(ring);
+        REQUIRE(decode_trace_dump(bytes.data(), bytes.size(), &records) == TraceDecodeResult::Ok);
+        REQUIRE(records.size() == 4);
+
+        for (uint32_t i = 0; i < 4; i++) {
+            REQUIRE(records[i].timestamp == i + 2);
+        }
+    }
+
+    SECTION("invalid length") {
+        auto bytes = dump(ring);
+        REQUIRE(
+            decode_trace_dump(bytes.data(), bytes.size() - 1, &records)
+            == TraceDecodeResult::InvalidLen);
+        // three records are not a power of two
+        REQUIRE(
+            decode_trace_dump(bytes.data(), bytes.size() - sizeof(TraceRecord), &records)
+            == TraceDecodeResult::InvalidLen);
+    }
+}
+
+TEST_CASE("convert trace records to chrome trace json", "[TraceRing]") {
+    std::vector<TraceRecord> records{
+        TraceRecord{0xfffffc18, 64, 0, TraceEvent::ParseStart, TraceTrack::Packets, 0},
+        TraceRecord{0x000001f4, 3, 0x82, TraceEvent::PacketDecoded, TraceTrack::Packets, 0},
+        TraceRecord{0x000003e8, 1, 0, TraceEvent::ParseEnd, TraceTrack::Packets, 0},
+        TraceRecord{0x000007d0, 1, 0, TraceEvent::BufferHandover, TraceTrack::Interrupt, 0},
+    };
+
+    auto json = to_chrome_trace_json(records, 1000);
+
+    REQUIRE(
+        json
+        == "{\"traceEvents\":[\n"
+           "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,"
+           "\"args\":{\"name\":\"packets\"}},\n"
+           "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":1,"
+           "\"args\":{\"name\":\"ui\"}},\n"
+           "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":2,"
+           "\"args\":{\"name\":\"interrupt\"}},\n"
+           "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":3,"
+           "\"args\":{\"name\":\"apply\"}},\n"
+           "{\"name\":\"parse\",\"ph\":\"B\",\"ts\":4294966.296,\"pid\":0,\"tid\":0,"
+           "\"args\":{\"arg0\":64,\"arg1\":0}},\n"
+           "{\"name\":\"packet decoded\",\"ph\":\"i\",\"s\":\"t\",\"ts\":4294967.796,"
+           "\"pid\":0,\"tid\":0,\"args\":{\"arg0\":3,\"arg1\":130}},\n"
+           "{\"name\":\"parse\",\"ph\":\"E\",\"ts\":4294968.296,\"pid\":0,\"tid\":0,"
+           "\"args\":{\"arg0\":1,\"arg1\":0}},\n"
+           "{\"name\":\"buffer handover\",\"ph\":\"i\",\"s\":\"t\",\"ts\":4294969.296,"
+           "\"pid\":0,\"tid\":2,\"args\":{\"arg0\":1,\"arg1\":0}}\n"
+           "]}\n");
+}
@@ -0,0 +1,96 @@
+#include "wake_policy.h"
+#include <catch2/catch.hpp>
+
+TEST_CASE("decide when to process received data", "[WakePolicy]") {
+    WakePolicy policy(100, 1000, 5000, 64, 512);
+
+    // the wait timed out
+    REQUIRE(policy.wake(0, 0));
+    policy.processed(10, 0);
+    REQUIRE(policy.timeout(10) == 5000);
+    REQUIRE(policy.handover_len() == 64);
+
+    SECTION("filled halves are processed immediately") {
+        REQUIRE(policy.wake(WAKE_HALF_COMPLETE, 20));
+        REQUIRE(policy.wake(WAKE_HALF_COMPLETE | WAKE_IDLE_LINE, 20));
+    }
+
+    SECTION("idle lines are rate limited") {
+        REQUIRE_FALSE(policy.wake(WAKE_IDLE_LINE, 50));
+
+        // sleep until the minimum interval has passed
+        REQUIRE(policy.timeout(50) == 60);
+        REQUIRE_FALSE(policy.wake(WAKE_IDLE_LINE, 80));
+        REQUIRE(policy.timeout(80) == 30);
+        REQUIRE(policy.wake(0, 110));
+        policy.processed(115, 0);
+        REQUIRE(policy.timeout(115) == 5000);
+
+        REQUIRE(policy.wake(WAKE_IDLE_LINE, 300));
+        policy.processed(310, 0);
+    }
+
+    SECTION("pending data is processed by the next event") {
+        REQUIRE_FALSE(policy.wake(WAKE_IDLE_LINE, 50));
+        REQUIRE(policy.timeout(200) == 0);
+        REQUIRE(policy.wake(WAKE_IDLE_LINE, 200));
+    }
+
+    SECTION("timer overflow") {
+        policy.processed(0xffffffc0, 0);
+        REQUIRE_FALSE(policy.wake(WAKE_IDLE_LINE, 0x10));
+        REQUIRE(policy.timeout(0x10) == 100 - 0x50);
+        REQUIRE(policy.wake(WAKE_IDLE_LINE, 0x30));
+    }
+}
+
+TEST_CASE("adapt the handover to the fill rate", "[WakePolicy]") {
+    WakePolicy policy(100, 1000, 5000, 64, 512);
+    uint32_t now = 0;
+
+    /// Processes data received at `rate` bytes per tick every `interval` ticks.
+    auto receive = [&](float rate, uint32_t interval, size_t num_times) {
+        for (size_t i = 0; i < num_times; i++) {
+            now += interval;
+            policy.processed(now, (size_t) (rate * interval));
+        }
+    };
+
+    SECTION("light load") {
+        // 10 bytes per handover interval
+        receive(0.01f, 1000, 50);
+        REQUIRE(policy.handover_len() == 64);
+
+        // a segment takes longer than the maximum wait, but idle lines are processed quickly
+        REQUIRE(policy.timeout(now) == 5000);
+        REQUIRE(policy.wake(WAKE_IDLE_LINE, now + 100));
+    }
+
+    SECTION("heavy load") {
+        // 200 bytes per handover interval
+        receive(0.2f, 1000, 50);
+        REQUIRE(policy.handover_len() == 256);
+
+        // idle lines are collected for a whole handover interval
+        REQUIRE_FALSE(policy.wake(WAKE_IDLE_LINE, now + 100));
+        REQUIRE(policy.timeout(now + 100) == 900);
+
+        // the task wakes up on its own once a handover has been received
+        policy.processed(now + 100, 20);
+        now += 100;
+        auto timeout = policy.timeout(now);
+        REQUIRE(timeout > 1000);
+        REQUIRE(timeout < 1400);
+    }
+
+    SECTION("the handover is limited") {
+        receive(2.0f, 1000, 50);
+        REQUIRE(policy.handover_len() == 512);
+    }
+
+    SECTION("the load drops") {
+        receive(0.2f, 1000, 50);
+        receive(0.0f, 1000, 50);
+        REQUIRE(policy.handover_len() == 64);
+    }
+}
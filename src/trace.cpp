@@ -0,0 +1,180 @@
+#include "trace.h"
+#include "endian_convert.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+#ifdef ENABLE_TRACING
+TraceRing<TRACE_RING_LEN> trace_ring;
+#endif
+
+static const char* event_name(TraceEvent event);
+static char event_phase(TraceEvent event);
+static const char* track_name(TraceTrack track);
+
+std::string to_string(TraceDecodeResult result) {
+    switch (result) {
+        case TraceDecodeResult::Ok: {
+            return "ok";
+        }
+        case TraceDecodeResult::InvalidLen: {
+            return "invalid length";
+        }
+        default: { return "unknown"; }
+    }
+}
+
+TraceDecodeResult decode_trace_dump(
+    const uint8_t* dump,
+    size_t len,
+    std::vector<TraceRecord>* records) {
+    const size_t index_len = 4;
+    const size_t record_len = sizeof(TraceRecord);
+
+    if (len < index_len + record_len || (len - index_len) % record_len != 0) {
+        return TraceDecodeResult::InvalidLen;
+    }
+
+    size_t ring_len = (len - index_len) / record_len;
+
+    if ((ring_len & (ring_len - 1)) != 0) {
+        return TraceDecodeResult::InvalidLen;
+    }
+
+    uint32_t next_index = uint32_from_le(dump);
+
+    // the ring is only completely filled once the index has passed its length
+    size_t num_records = std::min((size_t) next_index, ring_len);
+    size_t first_index = next_index - num_records;
+
+    records->clear();
+    records->reserve(num_records);
+
+    for (size_t i = 0; i < num_records; i++) {
+        auto raw = dump + index_len + ((first_index + i) & (ring_len - 1)) * record_len;
+
+        records->push_back(TraceRecord{
+            uint32_from_le(raw),
+            uint32_from_le(raw + 4),
+            uint32_from_le(raw + 8),
+            (TraceEvent) raw[12],
+            (TraceTrack) raw[13],
+            0,
+        });
+    }
+
+    return TraceDecodeResult::Ok;
+}
+
+std::string to_chrome_trace_json(const std::vector<TraceRecord>& records, uint32_t ticks_per_us) {
+    std::stringstream json;
+    json << "{\"traceEvents\":[";
+
+    // name the tracks so the viewer shows them as threads
+    const TraceTrack tracks[] = {
+        TraceTrack::Packets,
+        TraceTrack::Ui,
+        TraceTrack::Interrupt,
+        TraceTrack::Apply,
+    };
+
+    for (size_t i = 0; i < sizeof(tracks) / sizeof(tracks[0]); i++) {
+        json << (i > 0 ? "," : "") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,"
+             << "\"tid\":" << (unsigned) tracks[i] << ",\"args\":{\"name\":\""
+             << track_name(tracks[i]) << "\"}}";
+    }
+
+    uint64_t timestamp = 0;
+
+    for (size_t i = 0; i < records.size(); i++) {
+        auto& record = records[i];
+
+        if (i == 0) {
+            timestamp = record.timestamp;
+        } else {
+            // the difference is interpreted as signed to survive wrapping of the counter
+            timestamp += (int32_t) (record.timestamp - records[i - 1].timestamp);
+        }
+
+        auto phase = event_phase(record.event);
+
+        json << ",\n{\"name\":\"" << event_name(record.event) << "\",\"ph\":\"" << phase << "\"";
+
+        if (phase == 'i') {
+            json << ",\"s\":\"t\"";
+        }
+
+        json << ",\"ts\":" << timestamp / ticks_per_us << "." << std::setfill('0')
+             << std::setw(3) << (timestamp % ticks_per_us) * 1000 / ticks_per_us
+             << ",\"pid\":0,\"tid\":" << (unsigned) record.track << ",\"args\":{\"arg0\":"
+             << record.arg0 << ",\"arg1\":" << record.arg1 << "}}";
+    }
+
+    json << "\n]}\n";
+    return json.str();
+}
+
+static const char* event_name(TraceEvent event) {
+    switch (event) {
+        case TraceEvent::ParseStart:
+        case TraceEvent::ParseEnd: {
+            return "parse";
+        }
+        case TraceEvent::PacketDecoded: {
+            return "packet decoded";
+        }
+        case TraceEvent::LockAcquired:
+        case TraceEvent::LockReleased: {
+            return "lock held";
+        }
+        case TraceEvent::UiUpdateStart:
+        case TraceEvent::UiUpdateEnd: {
+            return "ui update";
+        }
+        case TraceEvent::BufferHandover: {
+            return "buffer handover";
+        }
+        case TraceEvent::Yield: {
+            return "yield";
+        }
+        case TraceEvent::IdleLine: {
+            return "idle line";
+        }
+        default: { return "unknown"; }
+    }
+}
+
+static char event_phase(TraceEvent event) {
+    switch (event) {
+        case TraceEvent::ParseStart:
+        case TraceEvent::LockAcquired:
+        case TraceEvent::UiUpdateStart: {
+            return 'B';
+        }
+        case TraceEvent::ParseEnd:
+        case TraceEvent::LockReleased:
+        case TraceEvent::UiUpdateEnd: {
+            return 'E';
+        }
+        default: { return 'i'; }
+    }
+}
+
+static const char* track_name(TraceTrack track) {
+    switch (track) {
+        case TraceTrack::Packets: {
+            return "packets";
+        }
+        case TraceTrack::Ui: {
+            return "ui";
+        }
+        case TraceTrack::Interrupt: {
+            return "interrupt";
+        }
+        case TraceTrack::Apply: {
+            return "apply";
+        }
+        default: { return "unknown"; }
+    }
+}
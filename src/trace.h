@@ -0,0 +1,164 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "clock.h"
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/// Records a trace event if the firmware is built with `ENABLE_TRACING` (`make TRACE=1`).
+/// `track` and `event` are the names of a `TraceTrack` and a `TraceEvent` variant, the
+/// arguments are stored as is. The arguments are not evaluated if tracing is disabled, so
+/// the macro does not generate any code in this case.
+///
+/// `TRACE_TIMESTAMP` declares a variable holding the current timestamp that can be used as
+/// argument (e.g. to report how long it took to acquire a lock). The variable only exists if
+/// tracing is enabled, so it must only be referenced in `TRACE` invocations.
+#ifdef ENABLE_TRACING
+#define TRACE(track, event, arg0, arg1) \
+    trace_ring.record(TraceTrack::track, TraceEvent::event, (uint32_t)(arg0), (uint32_t)(arg1))
+#define TRACE_TIMESTAMP(name) const uint32_t name = trace_timestamp()
+#else
+#define TRACE(track, event, arg0, arg1) ((void) 0)
+#define TRACE_TIMESTAMP(name) ((void) 0)
+#endif
+
+/// The number of records stored in the global trace ring. Must be a power of two.
+const size_t TRACE_RING_LEN = 1024;
+
+/// The events that can be traced. Events ending in `Start`/`Acquired` begin a span on
+/// their track which is closed by the matching `End`/`Released` event.
+enum class TraceEvent : uint8_t {
+    /// Processing of the data received on a bus started. `arg0` is the bus and `arg1` the
+    /// number of bytes written to its receive buffer (`ReceiveBuf::write_count`).
+    ParseStart,
+
+    /// Processing of the data received on a bus ended. `arg0` is the number of bytes
+    /// processed.
+    ParseEnd,
+
+    /// A packet was decoded. `arg0` is the device id and `arg1` the instruction.
+    PacketDecoded,
+
+    /// A lock was acquired. `arg0` is the `TraceLock` and `arg1` the number of ticks spent
+    /// waiting for it.
+    LockAcquired,
+
+    /// A lock was released. `arg0` is the `TraceLock`.
+    LockReleased,
+
+    /// emWin started to update the UI.
+    UiUpdateStart,
+
+    /// emWin finished updating the UI.
+    UiUpdateEnd,
+
+    /// The DMA controller filled a buffer half. `arg0` is twice the bus plus the index of the
+    /// half (0 = front, 1 = back), `arg1` its sequence number.
+    BufferHandover,
+
+    /// A UART detected an idle line. `arg0` is the position of the DMA controller in the
+    /// receive buffer and `arg1` the bus.
+    IdleLine,
+
+    /// The packet task yielded to the UI because its processing budget was used up. `arg0`
+    /// is the smallest headroom of the receive buffers and `arg1` the time until it resumes
+    /// (both in `Clock` ticks).
+    Yield,
+};
+
+/// The timeline an event is shown on (the task or interrupt it was recorded in).
+enum class TraceTrack : uint8_t {
+    Packets,
+    Ui,
+    Interrupt,
+
+    /// The task that applies queued packets to the control tables (see `ApplyStage`).
+    Apply,
+};
+
+/// The locks that are reported by `TraceEvent::LockAcquired` and `TraceEvent::LockReleased`.
+enum class TraceLock : uint32_t {
+    ControlTableMap,
+};
+
+/// A single trace event. The layout is fixed since the records are decoded from a memory
+/// dump (all fields are little-endian).
+struct TraceRecord {
+    uint32_t timestamp;
+    uint32_t arg0;
+    uint32_t arg1;
+    TraceEvent event;
+    TraceTrack track;
+    uint16_t reserved;
+};
+
+static_assert(sizeof(TraceRecord) == 16, "trace records must be 16 bytes");
+
+/// Returns the current timestamp used for trace records (the raw counter of `Clock`).
+inline uint32_t trace_timestamp() {
+    return Clock::counter();
+}
+
+/// A ring of trace records. Writers only increment the write index, so records can be
+/// written from any task or interrupt without locking. Once the ring is full the oldest
+/// records are overwritten.
+///
+/// The ring is meant to be dumped from memory as is (e.g. `dump binary value trace.bin
+/// trace_ring` in GDB). The dump consists of the write index followed by the records.
+template <size_t LEN>
+class TraceRing {
+  public:
+    static_assert(LEN > 0 && (LEN & (LEN - 1)) == 0, "length must be a power of two");
+
+    TraceRing() : next_index(0), records() {}
+
+    TraceRing(const TraceRing&) = delete;
+
+    TraceRing& operator=(const TraceRing&) = delete;
+
+    /// Records `event` with the current timestamp.
+    void record(TraceTrack track, TraceEvent event, uint32_t arg0, uint32_t arg1) {
+        this->push(TraceRecord{trace_timestamp(), arg0, arg1, event, track, 0});
+    }
+
+    /// Stores `record` in the ring.
+    void push(const TraceRecord& record) {
+        auto index = this->next_index.fetch_add(1, std::memory_order_relaxed);
+        this->records[index & (LEN - 1)] = record;
+    }
+
+  private:
+    std::atomic<uint32_t> next_index;
+    TraceRecord records[LEN];
+};
+
+#ifdef ENABLE_TRACING
+extern TraceRing<TRACE_RING_LEN> trace_ring;
+#endif
+
+/// The result of decoding a dump of a `TraceRing`.
+enum class TraceDecodeResult {
+    Ok,
+
+    /// The dump is too short or the number of records is not a power of two.
+    InvalidLen,
+};
+
+std::string to_string(TraceDecodeResult result);
+
+/// Decodes the memory dump of a `TraceRing` into `records`, sorted from oldest to newest.
+TraceDecodeResult decode_trace_dump(
+    const uint8_t* dump,
+    size_t len,
+    std::vector<TraceRecord>* records);
+
+/// Converts `records` into the JSON format understood by Chrome's trace viewer
+/// (`chrome://tracing`) and Perfetto. Timestamps are unwrapped, so the counter may overflow
+/// between records as long as consecutive records are less than 2^31 ticks apart.
+std::string to_chrome_trace_json(const std::vector<TraceRecord>& records, uint32_t ticks_per_us);
+
+#endif
@@ -1,5 +1,6 @@
 #include "ui/device_info_window.h"
 #include "main.h"
+#include "trace.h"
 #include "ui/run_ui.h"
 #include <sstream>
 
@@ -135,7 +136,9 @@ void DeviceInfoWindow::update() {
     std::vector<DeviceInfo> device_infos;
     device_infos.reserve(DeviceId::num_values());
 
+    TRACE_TIMESTAMP(lock_start);
     auto& control_table_map = this->control_table_map->lock();
+    TRACE(Ui, LockAcquired, TraceLock::ControlTableMap, trace_timestamp() - lock_start);
 
     for (auto id_and_table : control_table_map) {
         auto device_id = id_and_table.first;
@@ -154,6 +157,7 @@ void DeviceInfoWindow::update() {
     }
 
     this->control_table_map->unlock();
+    TRACE(Ui, LockReleased, TraceLock::ControlTableMap, 0);
 
     for (auto& device_info : device_infos) {
         this->device_list.insert_or_modify(device_info.id, [&](auto& item) {
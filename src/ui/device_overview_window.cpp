@@ -1,5 +1,6 @@
 #include "ui/device_overview_window.h"
 #include "main.h"
+#include "trace.h"
 #include "ui/device_info_window.h"
 #include "ui/log_window.h"
 #include "ui/model_overview_window.h"
@@ -159,7 +160,9 @@ void DeviceOverviewWindow::update() {
     size_t num_connected = 0;
     size_t num_disconnected = 0;
 
+    TRACE_TIMESTAMP(lock_start);
     auto& control_table_map = this->control_table_map->lock();
+    TRACE(Ui, LockAcquired, TraceLock::ControlTableMap, trace_timestamp() - lock_start);
 
     for (auto id_and_table : control_table_map) {
         auto device_id = id_and_table.first;
@@ -180,6 +183,7 @@ void DeviceOverviewWindow::update() {
     }
 
     this->control_table_map->unlock();
+    TRACE(Ui, LockReleased, TraceLock::ControlTableMap, 0);
 
     // update model overview
     this->registry->get_window<ModelOverviewWindow>()->update(device_statuses);
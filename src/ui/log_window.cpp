@@ -2,12 +2,24 @@
 #include "main.h"
 #include "ui/run_ui.h"
 #include <FreeRTOS.h>
+#include <iomanip>
 #include <sstream>
+#include <task.h>
 
-LogWindow::LogWindow(WindowRegistry* registry, const Mutex<Log>* log) :
+/// The maximum time to wait for the packet task to publish its stats.
+const size_t STATS_TIMEOUT_MS = 50;
+
+/// The height of a line in the bus stats label (matches `GUI_FONT_13_1`).
+const int BUS_STATS_LINE_HEIGHT = 14;
+
+static void format_histogram(std::stringstream& fmt, const char* name, const Histogram& histogram);
+
+LogWindow::LogWindow(WindowRegistry* registry, Log* log) :
     registry(registry),
     log(log),
     last_refresh(0),
+    next_sequence(0),
+    num_dropped_records(0),
     handle(WINDOW_CreateUser(
         0,
         0,
@@ -45,7 +57,7 @@ LogWindow::LogWindow(WindowRegistry* registry, const Mutex<Log>* log) :
     this->last_update_label = TEXT_CreateEx(
         140,
         0,
-        200,
+        DISPLAY_WIDTH - 2 * (BUTTON_WIDTH + MARGIN) - 140,
         TITLE_BAR_HEIGHT,
         this->handle,
         WM_CF_SHOW,
@@ -65,6 +77,18 @@ LogWindow::LogWindow(WindowRegistry* registry, const Mutex<Log>* log) :
 
     BUTTON_SetText(this->refresh_button, "Refresh");
 
+    this->reset_button = BUTTON_CreateEx(
+        DISPLAY_WIDTH - 2 * (BUTTON_WIDTH + MARGIN),
+        MARGIN,
+        BUTTON_WIDTH,
+        BUTTON_HEIGHT,
+        this->handle,
+        WM_CF_SHOW,
+        0,
+        NO_ID);
+
+    BUTTON_SetText(this->reset_button, "Reset");
+
     auto stats_window = WINDOW_CreateEx(
         0,
         TITLE_BAR_HEIGHT,
@@ -89,11 +113,30 @@ LogWindow::LogWindow(WindowRegistry* registry, const Mutex<Log>* log) :
         NO_ID,
         "<no data>");
 
-    this->log_list = LISTVIEW_CreateEx(
+    // the percentiles don't fit with the default font
+    TEXT_SetFont(this->stats_label, GUI_FONT_13_1);
+
+    // one line per bus
+    auto bus_stats_height = (int) this->log->num_buses() * BUS_STATS_LINE_HEIGHT;
+
+    this->bus_stats_label = TEXT_CreateEx(
         150 + MARGIN,
         TITLE_BAR_HEIGHT,
         DISPLAY_WIDTH - (150 + MARGIN),
-        DISPLAY_HEIGHT - TITLE_BAR_HEIGHT,
+        bus_stats_height,
+        this->handle,
+        WM_CF_SHOW,
+        TEXT_CF_LEFT | TEXT_CF_TOP,
+        NO_ID,
+        "");
+
+    TEXT_SetFont(this->bus_stats_label, GUI_FONT_13_1);
+
+    this->log_list = LISTVIEW_CreateEx(
+        150 + MARGIN,
+        TITLE_BAR_HEIGHT + bus_stats_height,
+        DISPLAY_WIDTH - (150 + MARGIN),
+        DISPLAY_HEIGHT - TITLE_BAR_HEIGHT - bus_stats_height,
         this->handle,
         WM_CF_SHOW,
         0,
@@ -126,6 +169,8 @@ void LogWindow::on_message(WM_MESSAGE* msg) {
             break;
         }
         case WM_TIMER: {
+            // drain the log regularly, so records are only dropped on bursts
+            this->read_records();
             this->update_last_refresh();
             WM_RestartTimer(msg->Data.v, 1000);
             break;
@@ -136,6 +181,8 @@ void LogWindow::on_message(WM_MESSAGE* msg) {
                     this->on_back_button_click();
                 } else if (msg->hWinSrc == this->refresh_button) {
                     this->on_refresh_button_click();
+                } else if (msg->hWinSrc == this->reset_button) {
+                    this->on_reset_button_click();
                 }
             }
 
@@ -166,6 +213,26 @@ void LogWindow::update_last_refresh() {
     TEXT_SetText(this->last_update_label, fmt.str().c_str());
 }
 
+void LogWindow::read_records() {
+    Log::Record record;
+
+    while (this->log->pop(&record)) {
+        this->num_dropped_records += record.sequence() - this->next_sequence;
+        this->next_sequence = record.sequence() + 1;
+
+        if (this->records.size() >= MAX_NUM_LOG_ENTRIES) {
+            this->records.pop_back();
+        }
+
+        this->records.push_front(record);
+    }
+}
+
+void LogWindow::on_reset_button_click() {
+    this->log->reset_stats();
+    this->on_refresh_button_click();
+}
+
 void LogWindow::on_back_button_click() {
     this->registry->navigate_back();
 }
@@ -174,37 +241,55 @@ void LogWindow::on_refresh_button_click() {
     this->last_refresh = HAL_GetTick();
     this->update_last_refresh();
 
-    // make a copy to avoid holding the lock for a long time
-    Log log_copy(this->log->lock());
-    this->log->unlock();
+    this->log->request_stats();
+    this->read_records();
+
+    // the packet task publishes the stats once it has processed its next buffer (keep the
+    // previous stats if that takes too long)
+    for (size_t i = 0; i < STATS_TIMEOUT_MS; i++) {
+        if (this->log->read_stats(&this->stats)) {
+            break;
+        }
+
+        vTaskDelay(1 / portTICK_PERIOD_MS);
+    }
 
     std::stringstream fmt;
-    fmt << "Max. time btw. buffers\n"
-        << log_copy.max_time_between_buf_processing() << " ms\n"
-        << "Avg. time btw. buffers\n"
-        << log_copy.avg_time_between_buf_processing() << " ms \n"
-        << "Max. time per buffer\n"
-        << log_copy.max_buf_processing_time() << " ms\n"
-        << "Avg. time per buffer\n"
-        << log_copy.avg_buf_processing_time() << " ms\n\n"
-        << "Free heap memory\n"
-        << xPortGetFreeHeapSize() << " B\n"
-        << "Free UI memory\n"
-        << GUI_ALLOC_GetNumFreeBytes() << " B";
+    format_histogram(fmt, "Time btw. buffers", this->stats.times_between_buf_processing);
+    format_histogram(fmt, "Time per buffer", this->stats.buf_processing_times);
+    format_histogram(fmt, "Time per packet", this->stats.packet_processing_times);
+    format_histogram(fmt, "Lock wait time", this->stats.lock_wait_times);
+    fmt << "Min. headroom " << Clock::to_us(this->stats.receive_headroom.min()) << " us\n"
+        << "Yields to UI: " << this->stats.num_yields << "\n"
+        << "Dropped records: " << this->num_dropped_records << "\n"
+        << "Free heap: " << xPortGetFreeHeapSize() << " B\n"
+        << "Free UI mem: " << GUI_ALLOC_GetNumFreeBytes() << " B";
     TEXT_SetText(this->stats_label, fmt.str().c_str());
 
+    std::stringstream bus_fmt;
+
+    for (size_t bus = 0; bus < this->log->num_buses(); bus++) {
+        auto& bus_stats = this->stats.buses[bus];
+        bus_fmt << (bus > 0 ? "\n" : "") << "Bus " << bus << ": " << bus_stats.num_packets
+                << " packets, " << bus_stats.num_errors << " errors, "
+                << bus_stats.num_skipped_segments << "/" << bus_stats.num_overwritten_segments
+                << " skipped/overwr.";
+    }
+
+    TEXT_SetText(this->bus_stats_label, bus_fmt.str().c_str());
+
     auto num_items = LISTVIEW_GetNumRows(this->log_list);
 
     // delete or add items as necessary
-    if (num_items < log_copy.size()) {
-        auto num_missing_items = log_copy.size() - num_items;
+    if (num_items < this->records.size()) {
+        auto num_missing_items = this->records.size() - num_items;
 
         for (size_t i = 0; i < num_missing_items; i++) {
             const char* cells[]{""};
             LISTVIEW_AddRow(this->log_list, cells);
         }
-    } else if (num_items > log_copy.size()) {
-        auto num_extra_items = num_items - log_copy.size();
+    } else if (num_items > this->records.size()) {
+        auto num_extra_items = num_items - this->records.size();
 
         for (size_t i = 0; i < num_extra_items; i++) {
             LISTVIEW_DeleteRow(this->log_list, num_items - 1 - i);
@@ -213,8 +298,17 @@ void LogWindow::on_refresh_button_click() {
 
     size_t item_idx = 0;
 
-    for (auto& record : log_copy) {
+    for (auto& record : this->records) {
         LISTVIEW_SetItemText(this->log_list, 0, item_idx, to_string(record).c_str());
         item_idx++;
     }
 }
+
+static void format_histogram(std::stringstream& fmt, const char* name, const Histogram& histogram) {
+    // all times are converted from clock ticks to microseconds
+    fmt << std::fixed << std::setprecision(1) << name << " (us)\n"
+        << "p50 " << Clock::to_us(histogram.percentile(50.0f)) << " p99 "
+        << Clock::to_us(histogram.percentile(99.0f)) << "\n"
+        << "p999 " << Clock::to_us(histogram.percentile(99.9f)) << " max "
+        << Clock::to_us(histogram.max()) << "\n";
+}
@@ -9,10 +9,11 @@
 #include <GUI.h>
 #include <LISTVIEW.h>
 #include <TEXT.h>
+#include <deque>
 
 class LogWindow {
   public:
-    LogWindow(WindowRegistry* registry, const Mutex<Log>* log);
+    LogWindow(WindowRegistry* registry, Log* log);
 
     LogWindow(const LogWindow&) = delete;
 
@@ -39,19 +40,30 @@ class LogWindow {
 
     void update_last_refresh();
 
+    /// Moves the records from the log into `records`.
+    void read_records();
+
     void on_back_button_click();
 
     void on_refresh_button_click();
 
+    void on_reset_button_click();
+
     WindowRegistry* registry;
-    const Mutex<Log>* log;
+    Log* log;
     uint32_t last_refresh;
+    std::deque<Log::Record> records;
+    LogStats stats;
+    uint32_t next_sequence;
+    uint32_t num_dropped_records;
     WM_HWIN handle;
     TEXT_Handle last_update_label;
     TEXT_Handle stats_label;
+    TEXT_Handle bus_stats_label;
     LISTVIEW_Handle log_list;
     BUTTON_Handle back_button;
     BUTTON_Handle refresh_button;
+    BUTTON_Handle reset_button;
 };
 
 #endif
@@ -1,5 +1,6 @@
 #include "ui/run_ui.h"
 #include "main.h"
+#include "trace.h"
 #include "ui/device_info_window.h"
 #include "ui/device_overview_window.h"
 #include "ui/log_window.h"
@@ -8,21 +9,23 @@
 #include <LISTVIEW.h>
 #include <cmath>
 
-static void create_ui(const Mutex<Log>&, const Mutex<ControlTableMap>&);
+static void create_ui(Log&, const Mutex<ControlTableMap>&);
 static void set_ui_theme();
 static void set_header_skin();
 static void set_scrollbar_skin();
 static void set_button_skin();
 
-void run_ui(Mutex<Log>& log, const Mutex<ControlTableMap>& control_table_map) {
+void run_ui(Log& log, const Mutex<ControlTableMap>& control_table_map) {
     create_ui(log, control_table_map);
 
     while (true) {
+        TRACE(Ui, UiUpdateStart, 0, 0);
         GUI_Exec();
+        TRACE(Ui, UiUpdateEnd, 0, 0);
     }
 }
 
-static void create_ui(const Mutex<Log>& log, const Mutex<ControlTableMap>& control_table_map) {
+static void create_ui(Log& log, const Mutex<ControlTableMap>& control_table_map) {
     set_ui_theme();
 
     // we're leaking all allocation since the UI task will never exit anyway
@@ -0,0 +1,44 @@
+#ifndef VARINT_H
+#define VARINT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/// Appends `value` as a varint: 7 bits per byte, least significant first, with the highest
+/// bit set in every byte but the last.
+inline void append_varint(uint64_t value, std::vector<uint8_t>* out) {
+    while (value >= 0x80) {
+        out->push_back((uint8_t) (value | 0x80));
+        value >>= 7;
+    }
+
+    out->push_back((uint8_t) value);
+}
+
+/// Reads a varint from the `len` bytes at `data` into `value`. Returns the number of bytes
+/// read or 0 if the varint is truncated or too large.
+inline size_t read_varint(const uint8_t* data, size_t len, uint64_t* value) {
+    *value = 0;
+
+    for (size_t i = 0; i < len && i < 10; i++) {
+        *value |= (uint64_t) (data[i] & 0x7f) << (7 * i);
+
+        if ((data[i] & 0x80) == 0) {
+            return i + 1;
+        }
+    }
+
+    return 0;
+}
+
+/// Maps signed values to unsigned ones so that values close to 0 have short varints.
+inline uint64_t zigzag_encode(int64_t value) {
+    return ((uint64_t) value << 1) ^ (uint64_t) (value >> 63);
+}
+
+inline int64_t zigzag_decode(uint64_t value) {
+    return (int64_t) (value >> 1) ^ -(int64_t) (value & 1);
+}
+
+#endif
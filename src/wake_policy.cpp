@@ -0,0 +1,86 @@
+#include "wake_policy.h"
+
+#include <algorithm>
+
+/// The weight of a new sample of the fill rate.
+const float FILL_RATE_WEIGHT = 0.125f;
+
+WakePolicy::WakePolicy(
+    uint32_t min_interval,
+    uint32_t handover_interval,
+    uint32_t max_wait,
+    size_t segment_len,
+    size_t max_handover_len) :
+    min_interval(min_interval),
+    handover_interval(handover_interval),
+    max_wait(max_wait),
+    segment_len(segment_len),
+    max_handover_len(max_handover_len),
+    handover_len_(segment_len),
+    last_processing(0),
+    fill_rate(0.0f),
+    is_pending(false) {}
+
+bool WakePolicy::wake(uint32_t events, uint32_t now) {
+    // a filled half has to be processed before the DMA controller returns to it
+    if ((events & WAKE_HALF_COMPLETE) != 0) {
+        return true;
+    }
+
+    // either the maximum wait time or the delay requested by `timeout` has expired
+    if (events == 0) {
+        return true;
+    }
+
+    if ((events & WAKE_IDLE_LINE) != 0) {
+        this->is_pending = true;
+    }
+
+    return this->is_pending && now - this->last_processing >= this->idle_interval();
+}
+
+void WakePolicy::processed(uint32_t now, size_t num_bytes) {
+    auto elapsed = now - this->last_processing;
+    this->last_processing = now;
+    this->is_pending = false;
+
+    if (elapsed == 0) {
+        return;
+    }
+
+    auto rate = (float) num_bytes / (float) elapsed;
+    this->fill_rate += FILL_RATE_WEIGHT * (rate - this->fill_rate);
+
+    // round up to whole segments
+    auto num_bytes_per_interval = (size_t) (this->fill_rate * (float) this->handover_interval);
+    auto num_segments = (num_bytes_per_interval + this->segment_len - 1) / this->segment_len;
+    this->handover_len_ = std::min(
+        std::max(num_segments, (size_t) 1) * this->segment_len,
+        this->max_handover_len);
+}
+
+uint32_t WakePolicy::timeout(uint32_t now) const {
+    auto elapsed = now - this->last_processing;
+    auto timeout = this->max_wait;
+
+    // wake up once the handover is expected to be complete
+    if (this->fill_rate > 0.0f) {
+        auto handover_duration = (float) this->handover_len_ / this->fill_rate;
+
+        if (handover_duration < (float) elapsed + (float) timeout) {
+            timeout = handover_duration > elapsed ? (uint32_t) handover_duration - elapsed : 0;
+        }
+    }
+
+    if (this->is_pending) {
+        auto idle_interval = this->idle_interval();
+        timeout = std::min(timeout, elapsed < idle_interval ? idle_interval - elapsed : 0);
+    }
+
+    return timeout;
+}
+
+uint32_t WakePolicy::idle_interval() const {
+    return this->handover_len_ > this->segment_len ? this->handover_interval
+                                                   : this->min_interval;
+}
@@ -0,0 +1,77 @@
+#ifndef WAKE_POLICY_H
+#define WAKE_POLICY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// Sent to the packet task (as a task notification bit) by the DMA callbacks once a half of
+/// the receive buffer has been filled.
+const uint32_t WAKE_HALF_COMPLETE = 1 << 0;
+
+/// Sent to the packet task (as a task notification bit) by the UART interrupt once the bus
+/// has been idle for the duration of a byte, which usually marks the end of a packet.
+const uint32_t WAKE_IDLE_LINE = 1 << 1;
+
+/// Decides when the packet task processes received data. The task sleeps until it is
+/// notified or the timeout returned by `timeout` expires. A filled half is always processed
+/// right away. Otherwise, data is handed over to the task in chunks of `handover_len`
+/// bytes, which is chosen from the measured fill rate of the receive buffers:
+///
+/// - At light load (less than a segment per `handover_interval`) the handover is a single
+///   segment. An idle line triggers processing of the partially filled segment as soon as
+///   `min_interval` has passed since the last processing, for low latency.
+/// - Under heavy load the handover grows to the number of segments received per
+///   `handover_interval` (at most `max_handover_len`), so the task wakes up less often and
+///   processes larger chunks. Idle lines are only processed every `handover_interval`.
+///
+/// In both cases the task wakes up on its own when a handover is expected to be complete,
+/// so data is processed in time even if the line never becomes idle.
+///
+/// All times are measured in `Clock` ticks.
+class WakePolicy {
+  public:
+    /// `max_wait` is the maximum time the task sleeps without processing, which ensures that
+    /// the task regularly handles requests of other tasks (e.g. `Log::publish_stats`).
+    WakePolicy(
+        uint32_t min_interval,
+        uint32_t handover_interval,
+        uint32_t max_wait,
+        size_t segment_len,
+        size_t max_handover_len);
+
+    /// Called whenever the task wakes up. `events` are the notification bits the task has
+    /// received (0 if the wait timed out). Returns `true` if received data should be
+    /// processed now.
+    bool wake(uint32_t events, uint32_t now);
+
+    /// Called after `num_bytes` of received data have been processed.
+    void processed(uint32_t now, size_t num_bytes);
+
+    /// Returns the time the task may sleep until it has to wake up on its own.
+    uint32_t timeout(uint32_t now) const;
+
+    /// The number of bytes the task currently processes at once.
+    size_t handover_len() const {
+        return this->handover_len_;
+    }
+
+  private:
+    /// The minimum time between processing data after an idle line.
+    uint32_t idle_interval() const;
+
+    uint32_t min_interval;
+    uint32_t handover_interval;
+    uint32_t max_wait;
+    size_t segment_len;
+    size_t max_handover_len;
+    size_t handover_len_;
+    uint32_t last_processing;
+
+    /// The average number of bytes received per tick (exponentially weighted).
+    float fill_rate;
+
+    /// Whether data has been received that has not been processed yet.
+    bool is_pending;
+};
+
+#endif
@@ -0,0 +1,188 @@
+#include "capture.h"
+#include "checkpoint.h"
+#include "host/mapped_file.h"
+#include "host/pipeline.h"
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Writes checkpoints for captures recorded by `monitor -w` (see `src/checkpoint.h`) and
+// restores the state of all devices at any time of a capture with them. `build` replays the
+// whole capture once and writes a checkpoint every `-i` seconds (10 by default) next to it
+// (`<capture>.ckp`). `seek` restores the state at `-t` seconds since the capture started from
+// the checkpoint before it and prints the devices like `monitor` (`-v` prints every field).
+// Without checkpoints, `seek` replays the capture from the start.
+//
+// usage: checkpoint build [-i interval in s] <capture>
+//        checkpoint seek [-v] -t time <capture>
+
+/// Maps the capture at `path` and opens it. Exits on errors.
+static void open_capture(const char* path, MappedFile* file, CaptureReader* reader) {
+    std::string error;
+
+    if (!file->open(path, &error)) {
+        std::cerr << "error: cannot open `" << path << "`: " << error << std::endl;
+        exit(1);
+    }
+
+    *reader = CaptureReader(file->data(), file->len());
+    auto result = reader->open();
+
+    if (result == CaptureResult::Ok
+        && (reader->num_buses() == 0 || reader->num_buses() > MAX_NUM_BUSES)) {
+        result = CaptureResult::InvalidBus;
+    }
+
+    if (result != CaptureResult::Ok) {
+        std::cerr << "error: cannot read `" << path << "`: " << to_string(result) << std::endl;
+        exit(1);
+    }
+}
+
+static void build(int argc, char** argv) {
+    double interval_s = 10.0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "i:")) != -1) {
+        switch (opt) {
+            case 'i': {
+                interval_s = strtod(optarg, nullptr);
+                break;
+            }
+            default: { exit(1); }
+        }
+    }
+
+    if (optind >= argc) {
+        std::cerr << "error: missing capture path" << std::endl;
+        exit(1);
+    }
+
+    if (interval_s <= 0.0) {
+        std::cerr << "error: the interval must be positive" << std::endl;
+        exit(1);
+    }
+
+    auto path = argv[optind];
+    MappedFile file;
+    CaptureReader reader(nullptr, 0);
+    open_capture(path, &file, &reader);
+
+    auto checkpoints_path = std::string(path) + ".ckp";
+    std::ofstream checkpoints_file(checkpoints_path, std::ios::binary);
+    CheckpointWriter writer(
+        &checkpoints_file, reader.num_buses(), file.len(), (uint64_t) (interval_s * 1e6));
+    CaptureScanner scanner(&reader);
+    ScannedPacket packet;
+    CaptureResult result;
+
+    while ((result = scanner.next(&packet)) == CaptureResult::Ok) {
+        writer.add(packet);
+    }
+
+    if (result != CaptureResult::End) {
+        std::cerr << "warning: checkpoints end early: " << to_string(result) << std::endl;
+    }
+
+    writer.finish();
+    checkpoints_file.flush();
+
+    if (!writer.is_ok()) {
+        std::cerr << "error: cannot write `" << checkpoints_path << "`" << std::endl;
+        exit(1);
+    }
+
+    std::cout << "wrote " << writer.num_checkpoints() << " checkpoints" << std::endl;
+}
+
+static void seek(int argc, char** argv) {
+    bool has_time = false;
+    uint64_t timestamp = 0;
+    bool is_verbose = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:v")) != -1) {
+        switch (opt) {
+            case 't': {
+                has_time = true;
+                timestamp = (uint64_t) (strtod(optarg, nullptr) * 1e6);
+                break;
+            }
+            case 'v': {
+                is_verbose = true;
+                break;
+            }
+            default: { exit(1); }
+        }
+    }
+
+    if (optind >= argc) {
+        std::cerr << "error: missing capture path" << std::endl;
+        exit(1);
+    }
+
+    if (!has_time) {
+        std::cerr << "error: expected a time" << std::endl;
+        exit(1);
+    }
+
+    auto path = argv[optind];
+    MappedFile file;
+    CaptureReader reader(nullptr, 0);
+    open_capture(path, &file, &reader);
+
+    // replaying from the start always works, so missing checkpoints are not an error
+    auto checkpoints_path = std::string(path) + ".ckp";
+    MappedFile checkpoints_file;
+    CheckpointReader checkpoints(nullptr, 0);
+    auto has_checkpoints = false;
+    std::string error;
+
+    if (checkpoints_file.open(checkpoints_path.c_str(), &error)) {
+        checkpoints = CheckpointReader(checkpoints_file.data(), checkpoints_file.len());
+        auto result = checkpoints.open(file.len(), reader.num_buses());
+
+        if (result != CheckpointResult::Ok) {
+            std::cerr << "error: cannot read `" << checkpoints_path << "`: " << to_string(result)
+                      << " (see `checkpoint build`)" << std::endl;
+            exit(1);
+        }
+
+        has_checkpoints = true;
+    }
+
+    ControlTableMap map(reader.num_buses());
+    auto result = restore_state(&reader, has_checkpoints ? &checkpoints : nullptr, timestamp, &map);
+
+    if (result != CheckpointResult::Ok) {
+        std::cerr << "error: cannot restore the state: " << to_string(result) << std::endl;
+        exit(1);
+    }
+
+    std::cout << std::fixed << std::setprecision(6) << "state at " << timestamp / 1e6 << "\n";
+    print_devices(std::cout, map, is_verbose);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "error: expected `build` or `seek`" << std::endl;
+        exit(1);
+    }
+
+    // the options follow the command
+    if (strcmp(argv[1], "build") == 0) {
+        build(argc - 1, argv + 1);
+    } else if (strcmp(argv[1], "seek") == 0) {
+        seek(argc - 1, argv + 1);
+    } else {
+        std::cerr << "error: expected `build [options] <capture>` or `seek [options] <capture>`"
+                  << std::endl;
+        exit(1);
+    }
+
+    exit(0);
+}
@@ -0,0 +1,126 @@
+#include "capture.h"
+#include "capture_codec.h"
+#include "host/mapped_file.h"
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdlib.h>
+#include <string.h>
+
+// Compresses captures recorded by `monitor -w` (see `src/capture_codec.h`) and restores them
+// bit-exactly. `compress` writes `<capture>.dxz`, `decompress` writes the capture to the given
+// path. Both print the sizes and the throughput (relative to the uncompressed capture).
+//
+// usage: codec compress <capture>
+//        codec decompress <compressed capture> <capture>
+
+/// Maps the file at `path`. Exits on errors.
+static void open_file(const char* path, MappedFile* file) {
+    std::string error;
+
+    if (!file->open(path, &error)) {
+        std::cerr << "error: cannot open `" << path << "`: " << error << std::endl;
+        exit(1);
+    }
+}
+
+static void print_stats(
+    uint64_t capture_len,
+    uint64_t compressed_len,
+    std::chrono::steady_clock::time_point start) {
+    auto elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+                         .count();
+
+    std::cout << std::fixed << std::setprecision(1) << capture_len << " bytes <-> "
+              << compressed_len << " bytes (" << (double) capture_len / compressed_len
+              << "x), " << capture_len / elapsed_s / 1e6 << " MB/s" << std::endl;
+}
+
+static void compress(const char* path) {
+    MappedFile file;
+    open_file(path, &file);
+
+    auto compressed_path = std::string(path) + ".dxz";
+    std::ofstream compressed_file(compressed_path, std::ios::binary);
+    auto start = std::chrono::steady_clock::now();
+    auto result = compress_capture(file.data(), file.len(), &compressed_file);
+
+    if (result != CaptureResult::Ok) {
+        std::cerr << "error: cannot read `" << path << "`: " << to_string(result) << std::endl;
+        exit(1);
+    }
+
+    compressed_file.flush();
+
+    if (!compressed_file.good()) {
+        std::cerr << "error: cannot write `" << compressed_path << "`" << std::endl;
+        exit(1);
+    }
+
+    print_stats(file.len(), (uint64_t) compressed_file.tellp(), start);
+}
+
+static void decompress(const char* path, const char* capture_path) {
+    MappedFile file;
+    open_file(path, &file);
+
+    CaptureDecoder decoder(file.data(), file.len());
+    auto result = decoder.open();
+
+    if (result != CodecResult::Ok) {
+        std::cerr << "error: cannot read `" << path << "`: " << to_string(result) << std::endl;
+        exit(1);
+    }
+
+    std::ofstream capture_file(capture_path, std::ios::binary);
+    auto start = std::chrono::steady_clock::now();
+    auto header = decoder.capture_header();
+    std::vector<uint8_t> buf(header, header + CAPTURE_HEADER_LEN);
+    uint64_t capture_len = 0;
+
+    // the chunks are written in blocks, like they would be passed on to a consumer
+    while ((result = decoder.next(&buf)) == CodecResult::Ok) {
+        if (buf.size() >= 64 * 1024) {
+            capture_file.write((const char*) buf.data(), buf.size());
+            capture_len += buf.size();
+            buf.clear();
+        }
+    }
+
+    capture_file.write((const char*) buf.data(), buf.size());
+    capture_len += buf.size();
+    capture_file.flush();
+
+    if (result != CodecResult::End) {
+        std::cerr << "error: cannot read `" << path << "`: " << to_string(result) << std::endl;
+        exit(1);
+    }
+
+    if (!capture_file.good()) {
+        std::cerr << "error: cannot write `" << capture_path << "`" << std::endl;
+        exit(1);
+    }
+
+    if (capture_len != decoder.capture_len()) {
+        std::cerr << "warning: expected " << decoder.capture_len() << " bytes" << std::endl;
+    }
+
+    print_stats(capture_len, file.len(), start);
+}
+
+int main(int argc, char** argv) {
+    if (argc == 3 && strcmp(argv[1], "compress") == 0) {
+        compress(argv[2]);
+    } else if (argc == 4 && strcmp(argv[1], "decompress") == 0) {
+        decompress(argv[2], argv[3]);
+    } else {
+        std::cerr << "error: expected `compress <capture>` or `decompress <compressed capture> "
+                     "<capture>`"
+                  << std::endl;
+        exit(1);
+    }
+
+    exit(0);
+}
@@ -0,0 +1,131 @@
+#include "capture.h"
+#include "capture_diff.h"
+#include "field_export.h"
+#include "host/mapped_file.h"
+
+#include <iomanip>
+#include <iostream>
+#include <stdlib.h>
+#include <unistd.h>
+
+// Compares the devices of two captures recorded by `monitor -w`, e.g. of a good and a bad run
+// of a robot. Both captures are replayed in lockstep, aligned by control cycle instead of
+// time: a cycle starts with every packet with the cycle instruction (`SyncWrite` unless `-n`
+// is given). After every cycle, the fields of all devices are compared. The tool prints the
+// devices that are only part of one capture (or have different models), the first cycle in
+// which every field differed and statistics of the differences. Times are in seconds since
+// the capture started.
+//
+// usage: compare [-n instruction] <capture> <capture>
+
+/// Maps the capture at `path` and opens it. Exits on errors.
+static void open_capture(const char* path, MappedFile* file, CaptureReader* reader) {
+    std::string error;
+
+    if (!file->open(path, &error)) {
+        std::cerr << "error: cannot open `" << path << "`: " << error << std::endl;
+        exit(1);
+    }
+
+    *reader = CaptureReader(file->data(), file->len());
+    auto result = reader->open();
+
+    if (result != CaptureResult::Ok) {
+        std::cerr << "error: cannot read `" << path << "`: " << to_string(result) << std::endl;
+        exit(1);
+    }
+}
+
+int main(int argc, char** argv) {
+    auto cycle_instruction = Instruction::SyncWrite;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        switch (opt) {
+            case 'n': {
+                if (!instruction_from_string(optarg, &cycle_instruction)) {
+                    std::cerr << "error: unknown instruction `" << optarg << "`" << std::endl;
+                    exit(1);
+                }
+
+                break;
+            }
+            default: { exit(1); }
+        }
+    }
+
+    if (argc - optind != 2) {
+        std::cerr << "error: expected two capture paths" << std::endl;
+        exit(1);
+    }
+
+    const char* paths[2] = {argv[optind], argv[optind + 1]};
+    MappedFile files[2];
+    CaptureReader readers[2] = {CaptureReader(nullptr, 0), CaptureReader(nullptr, 0)};
+
+    for (size_t i = 0; i < 2; i++) {
+        open_capture(paths[i], &files[i], &readers[i]);
+    }
+
+    CaptureDiff diff(&readers[0], &readers[1], cycle_instruction);
+
+    while (diff.next()) {
+    }
+
+    for (size_t i = 0; i < 2; i++) {
+        auto result = diff.result(i);
+
+        if (result == CaptureResult::Ok) {
+            std::cout << "`" << paths[i] << "` has more cycles" << std::endl;
+        } else if (result != CaptureResult::End) {
+            std::cerr << "warning: `" << paths[i] << "` ends early: " << to_string(result)
+                      << std::endl;
+        }
+    }
+
+    std::cout << "compared " << diff.num_cycles() << " cycles, " << diff.num_differing_cycles()
+              << " differ\n"
+              << std::fixed << std::setprecision(6);
+
+    for (auto& device : diff.devices()) {
+        std::cout << "cycle " << device.cycle << ": device " << device.device_id;
+
+        for (size_t i = 0; i < 2; i++) {
+            std::cout << (i == 0 ? " is " : ", ");
+
+            if (device.is_present[i]) {
+                std::cout << "model " << device.model_numbers[i];
+            } else {
+                std::cout << "missing";
+            }
+
+            std::cout << " in `" << paths[i] << "`";
+        }
+
+        std::cout << "\n";
+    }
+
+    if (!diff.fields().empty()) {
+        std::cout << "first divergence of every field:\n";
+    }
+
+    for (auto& field : diff.fields()) {
+        std::cout << "cycle " << field.first_cycle << " (" << field.first_timestamps[0] / 1e6
+                  << " / " << field.first_timestamps[1] / 1e6 << "): device " << field.device_id
+                  << " " << field.name << ": " << fmt_field_value(field.type, field.first_values[0])
+                  << " != " << fmt_field_value(field.type, field.first_values[1]) << "\n";
+    }
+
+    if (!diff.fields().empty()) {
+        std::cout << "differences:\n" << std::setprecision(3);
+    }
+
+    for (auto& field : diff.fields()) {
+        std::cout << "device " << field.device_id << " " << field.name << ": " << field.num_cycles
+                  << " cycles, max " << field.max_diff << ", mean "
+                  << field.sum_diff / field.num_cycles << "\n";
+    }
+
+    std::cout.flush();
+    exit(0);
+}
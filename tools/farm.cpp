@@ -0,0 +1,256 @@
+#include "clock.h"
+#include "control_table.h"
+#include "device_farm.h"
+#include "host/bus_input.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <iostream>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+// Emulates devices of the supported models on a pty, so the monitor can be load-tested without
+// hardware (see `src/device_farm.h`). A master (e.g. `master`) sends instructions to the devices
+// through the bus pty and receives their responses. Everything sent on the bus (instructions and
+// responses) is copied to the tap pty, which `monitor` reads like a bus. Every response is sent
+// after the Return Delay Time of its device and takes as long as at the baudrate. Devices are
+// given as an id or a range of ids and a model number or name (e.g. `1-20:MX-64`, `21:0xbaff`).
+// `-l` and `-t` create symlinks to the bus and tap ptys.
+//
+// usage: farm [-b baudrate] [-l bus link] [-t tap link] <id>[-<id>]:<model>...
+
+static volatile sig_atomic_t is_interrupted = 0;
+
+/// Parses a model number or the name of a model (e.g. `MX-64`). Returns `false` if the model is
+/// not supported.
+static bool parse_model(const std::string& str, uint16_t* model_number) {
+    char* end;
+    auto number = strtoul(str.c_str(), &end, 0);
+
+    for (auto supported : ControlTableMap::supported_model_numbers()) {
+        auto name = ControlTableMap::create_control_table(supported)->device_name();
+
+        if ((*end == '\0' && number == supported) || strcasecmp(str.c_str(), name) == 0) {
+            *model_number = supported;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/// Adds the devices of an argument like `1-20:MX-64` to `farm`. Exits on errors.
+static void add_devices(const std::string& arg, DeviceFarm* farm) {
+    auto model_pos = arg.rfind(':');
+    uint16_t model_number;
+
+    if (model_pos == std::string::npos || !parse_model(arg.substr(model_pos + 1), &model_number)) {
+        std::cerr << "error: expected devices like `1-20:MX-64`, got `" << arg << "`" << std::endl;
+        exit(1);
+    }
+
+    char* end;
+    auto first = strtoul(arg.c_str(), &end, 0);
+    auto last = first;
+
+    if (*end == '-') {
+        last = strtoul(end + 1, &end, 0);
+    }
+
+    if (end != arg.c_str() + model_pos || first > last || last >= DeviceId::broadcast().to_byte()) {
+        std::cerr << "error: invalid ids in `" << arg << "`" << std::endl;
+        exit(1);
+    }
+
+    for (auto id = first; id <= last; id++) {
+        if (!farm->add_device(DeviceId((uint8_t) id), model_number)) {
+            std::cerr << "error: device " << id << " was given twice" << std::endl;
+            exit(1);
+        }
+    }
+}
+
+/// Creates a pty and a symlink to it at `link` (if not `nullptr`). Exits on errors.
+static int create_pty(const char* name, const char* link) {
+    std::string path;
+    std::string error;
+    auto fd = create_bus_pty(&path, &error);
+
+    if (fd < 0) {
+        std::cerr << "error: cannot create the " << name << " pty: " << error << std::endl;
+        exit(1);
+    }
+
+    if (link) {
+        unlink(link);
+
+        if (symlink(path.c_str(), link) != 0) {
+            std::cerr << "error: cannot create `" << link << "`: " << strerror(errno) << std::endl;
+            exit(1);
+        }
+    }
+
+    std::cout << name << ": " << path << std::endl;
+    return fd;
+}
+
+/// Copies the traffic of the bus to the tap. Without a monitor the tap's buffer fills up, the
+/// bytes that do not fit are dropped and counted in `num_dropped`.
+static void copy_to_tap(int tap, const uint8_t* data, size_t len, uint64_t* num_dropped) {
+    auto written = write(tap, data, len);
+    *num_dropped += written < 0 ? len : len - written;
+}
+
+/// Waits until `Clock::now()` reaches `timestamp`.
+static void sleep_until(Clock::Timestamp timestamp) {
+    auto now = Clock::now();
+
+    if (timestamp <= now) {
+        return;
+    }
+
+    auto ns = (timestamp - now) * (1000 / Clock::TICKS_PER_US);
+    timespec duration{(time_t) (ns / 1000000000), (long) (ns % 1000000000)};
+    nanosleep(&duration, nullptr);
+}
+
+int main(int argc, char** argv) {
+    uint32_t baudrate = 1000000;
+    const char* bus_link = nullptr;
+    const char* tap_link = nullptr;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "b:l:t:")) != -1) {
+        switch (opt) {
+            case 'b': {
+                baudrate = strtoul(optarg, nullptr, 10);
+                break;
+            }
+            case 'l': {
+                bus_link = optarg;
+                break;
+            }
+            case 't': {
+                tap_link = optarg;
+                break;
+            }
+            default: { exit(1); }
+        }
+    }
+
+    if (optind == argc) {
+        std::cerr << "error: expected devices like `1-20:MX-64`" << std::endl;
+        exit(1);
+    }
+
+    if (baudrate == 0) {
+        std::cerr << "error: invalid baudrate" << std::endl;
+        exit(1);
+    }
+
+    DeviceFarm farm;
+
+    for (auto i = optind; i < argc; i++) {
+        add_devices(argv[i], &farm);
+    }
+
+    auto bus = create_pty("bus", bus_link);
+    auto tap = create_pty("tap", tap_link);
+    fcntl(tap, F_SETFL, fcntl(tap, F_GETFL) | O_NONBLOCK);
+
+    signal(SIGINT, [](int) { is_interrupted = 1; });
+
+    // the ticks it takes to send a byte (with start and stop bit)
+    auto byte_ticks = 10ull * 1000000 * Clock::TICKS_PER_US / baudrate;
+
+    Parser parser;
+    InstructionDecoder decoder;
+    Packet packet{DeviceId(0), Instruction::Ping, Error(), {}};
+    InstructionPacket instruction_packet;
+    std::vector<uint8_t> chunk(4096);
+    uint64_t num_instructions = 0;
+    uint64_t num_responses = 0;
+    uint64_t num_errors = 0;
+    uint64_t num_dropped = 0;
+
+    while (!is_interrupted) {
+        pollfd fd{bus, POLLIN, 0};
+
+        if (poll(&fd, 1, 100) <= 0) {
+            continue;
+        }
+
+        auto len = read(bus, chunk.data(), chunk.size());
+
+        if (len <= 0) {
+            continue;
+        }
+
+        // the pty transfers the data at once, so this is when the instructions ended
+        auto end = Clock::now();
+        copy_to_tap(tap, chunk.data(), len, &num_dropped);
+
+        Cursor cursor(chunk.data(), len);
+        ParseResult result;
+
+        while ((result = parser.parse(cursor, &packet)) != ParseResult::NeedMoreData) {
+            if (result == ParseResult::PacketFragment) {
+                decoder.decode(packet);
+                continue;
+            }
+
+            if (result != ParseResult::PacketAvailable) {
+                decoder.reset();
+                num_errors++;
+                continue;
+            }
+
+            // status packets of other devices on the bus
+            if (packet.instruction == Instruction::Status) {
+                continue;
+            }
+
+            InstructionParseResult parse_result;
+
+            if (packet.data_offset > 0) {
+                decoder.decode(packet);
+                parse_result = decoder.finish(&instruction_packet);
+            } else {
+                decoder.reset();
+                parse_result = parse_instruction_packet(packet, &instruction_packet);
+            }
+
+            if (parse_result != InstructionParseResult::Ok) {
+                num_errors++;
+                continue;
+            }
+
+            num_instructions++;
+            farm.receive(instruction_packet);
+
+            for (auto& response : farm.responses()) {
+                sleep_until(end + (Clock::Timestamp) response.delay_us * Clock::TICKS_PER_US);
+
+                auto data = farm.response_data() + response.offset;
+                write_bus(bus, data, response.len);
+                copy_to_tap(tap, data, response.len, &num_dropped);
+
+                end = Clock::now() + response.len * byte_ticks;
+                num_responses++;
+            }
+
+            sleep_until(end);
+        }
+    }
+
+    std::cerr << num_instructions << " instructions, " << num_responses << " responses, "
+              << num_errors << " errors, " << num_dropped << " bytes not copied to the tap"
+              << std::endl;
+    exit(0);
+}
@@ -0,0 +1,216 @@
+#include "capture.h"
+#include "field_export.h"
+#include "host/mapped_file.h"
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Exports the values of the fields of all devices over the time of a capture recorded by
+// `monitor -w`. The capture is replayed and every change of a field's value is a sample, so
+// a field keeps its value until the next sample. `csv` prints the samples in order as CSV
+// (`time,device,field,value`, times in seconds since the capture started). `columns` writes
+// field columns (see `src/field_export.h`) next to the capture (`<capture>.fields`) and
+// `read` prints them as CSV, column by column. `-d` and `-n` only export the fields of a
+// device or the fields with a name.
+//
+// usage: fields csv [-d device] [-n field] <capture>
+//        fields columns [-d device] [-n field] <capture>
+//        fields read [-d device] [-n field] <field columns>
+
+/// The fields to export.
+struct Filter {
+    bool has_device_id;
+    DeviceId device_id;
+    std::string name;
+
+    bool matches(const FieldColumn& column) const {
+        return (!this->has_device_id || column.device_id == this->device_id)
+            && (this->name.empty() || column.name == this->name);
+    }
+};
+
+/// Parses the options of a command and returns the path that follows them. Exits on errors.
+static const char* parse_options(int argc, char** argv, Filter* filter) {
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:n:")) != -1) {
+        switch (opt) {
+            case 'd': {
+                filter->has_device_id = true;
+                filter->device_id = DeviceId((uint8_t) strtoul(optarg, nullptr, 10));
+                break;
+            }
+            case 'n': {
+                filter->name = optarg;
+                break;
+            }
+            default: { exit(1); }
+        }
+    }
+
+    if (optind >= argc) {
+        std::cerr << "error: missing path" << std::endl;
+        exit(1);
+    }
+
+    return argv[optind];
+}
+
+/// Maps the file at `path`. Exits on errors.
+static void open_file(const char* path, MappedFile* file) {
+    std::string error;
+
+    if (!file->open(path, &error)) {
+        std::cerr << "error: cannot open `" << path << "`: " << error << std::endl;
+        exit(1);
+    }
+}
+
+static void print_csv_header() {
+    std::cout << "time,device,field,value\n" << std::fixed << std::setprecision(6);
+}
+
+static void print_csv_row(const FieldColumn& column, uint64_t timestamp, uint32_t value) {
+    std::cout << timestamp / 1e6 << "," << column.device_id.to_string() << ",\"" << column.name
+              << "\"," << fmt_field_value(column.type, value) << "\n";
+}
+
+/// Replays the capture at `path` and passes every change of the fields that match `filter`
+/// to `add`.
+template<typename F> static void export_fields(const char* path, const Filter& filter, F add) {
+    MappedFile file;
+    open_file(path, &file);
+
+    CaptureReader reader(file.data(), file.len());
+    auto result = reader.open();
+
+    if (result != CaptureResult::Ok) {
+        std::cerr << "error: cannot read `" << path << "`: " << to_string(result) << std::endl;
+        exit(1);
+    }
+
+    FieldTracker tracker(reader.num_buses());
+    CaptureScanner scanner(&reader);
+    ScannedPacket packet;
+    std::vector<FieldChange> changes;
+
+    while ((result = scanner.next(&packet)) == CaptureResult::Ok) {
+        changes.clear();
+        tracker.add(packet, &changes);
+
+        for (auto& change : changes) {
+            auto& column = tracker.columns()[change.column];
+
+            if (filter.matches(column)) {
+                add(column, change);
+            }
+        }
+    }
+
+    if (result != CaptureResult::End) {
+        std::cerr << "warning: export ends early: " << to_string(result) << std::endl;
+    }
+}
+
+static void export_csv(int argc, char** argv) {
+    Filter filter{false, DeviceId(0), ""};
+    auto path = parse_options(argc, argv, &filter);
+    print_csv_header();
+
+    export_fields(path, filter, [](const FieldColumn& column, const FieldChange& change) {
+        print_csv_row(column, change.timestamp, change.value);
+    });
+
+    std::cout.flush();
+}
+
+static void export_columns(int argc, char** argv) {
+    Filter filter{false, DeviceId(0), ""};
+    auto path = parse_options(argc, argv, &filter);
+    auto columns_path = std::string(path) + ".fields";
+    std::ofstream columns_file(columns_path, std::ios::binary);
+    FieldColumnWriter writer(&columns_file);
+    uint64_t num_samples = 0;
+
+    export_fields(path, filter, [&](const FieldColumn& column, const FieldChange& change) {
+        writer.add(column, change);
+        num_samples++;
+    });
+
+    writer.finish();
+    columns_file.flush();
+
+    if (!writer.is_ok()) {
+        std::cerr << "error: cannot write `" << columns_path << "`" << std::endl;
+        exit(1);
+    }
+
+    std::cout << "wrote " << num_samples << " samples" << std::endl;
+}
+
+static void read_columns(int argc, char** argv) {
+    Filter filter{false, DeviceId(0), ""};
+    auto path = parse_options(argc, argv, &filter);
+    MappedFile file;
+    open_file(path, &file);
+
+    FieldColumnReader reader(file.data(), file.len());
+    auto result = reader.open();
+
+    if (result != FieldColumnsResult::Ok) {
+        std::cerr << "error: cannot read `" << path << "`: " << to_string(result) << std::endl;
+        exit(1);
+    }
+
+    print_csv_header();
+    std::vector<FieldSample> samples;
+
+    for (size_t i = 0; i < reader.columns().size(); i++) {
+        auto& column = reader.columns()[i].column;
+
+        if (!filter.matches(column)) {
+            continue;
+        }
+
+        samples.clear();
+        result = reader.read(i, &samples);
+
+        if (result != FieldColumnsResult::Ok) {
+            std::cerr << "error: cannot read `" << path << "`: " << to_string(result) << std::endl;
+            exit(1);
+        }
+
+        for (auto& sample : samples) {
+            print_csv_row(column, sample.timestamp, sample.value);
+        }
+    }
+
+    std::cout.flush();
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "error: expected `csv`, `columns` or `read`" << std::endl;
+        exit(1);
+    }
+
+    // the options follow the command
+    if (strcmp(argv[1], "csv") == 0) {
+        export_csv(argc - 1, argv + 1);
+    } else if (strcmp(argv[1], "columns") == 0) {
+        export_columns(argc - 1, argv + 1);
+    } else if (strcmp(argv[1], "read") == 0) {
+        read_columns(argc - 1, argv + 1);
+    } else {
+        std::cerr << "error: expected `csv`, `columns` or `read` followed by the options and a "
+                     "path"
+                  << std::endl;
+        exit(1);
+    }
+
+    exit(0);
+}
@@ -0,0 +1,170 @@
+#include "host/bus_input.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+/// Returns the `termios` speed for `baudrate` or `B0` if it is not supported.
+static speed_t termios_speed(uint32_t baudrate) {
+    switch (baudrate) {
+        case 9600: {
+            return B9600;
+        }
+        case 57600: {
+            return B57600;
+        }
+        case 115200: {
+            return B115200;
+        }
+        case 1000000: {
+            return B1000000;
+        }
+        case 2000000: {
+            return B2000000;
+        }
+        case 3000000: {
+            return B3000000;
+        }
+        case 4000000: {
+            return B4000000;
+        }
+        default: { return B0; }
+    }
+}
+
+/// Switches the serial port or pty `fd` to raw mode at `baudrate`. Closes it and returns -1 on
+/// errors.
+static int configure_tty(int fd, uint32_t baudrate, std::string* error) {
+    auto speed = termios_speed(baudrate);
+
+    if (speed == B0) {
+        *error = "unsupported baudrate " + std::to_string(baudrate);
+        close(fd);
+        return -1;
+    }
+
+    termios config;
+
+    if (tcgetattr(fd, &config) != 0) {
+        *error = strerror(errno);
+        close(fd);
+        return -1;
+    }
+
+    // a read returns as soon as a byte is available, so it never blocks after a `poll`
+    cfmakeraw(&config);
+    config.c_cflag |= CLOCAL | CREAD;
+    config.c_cc[VMIN] = 1;
+    config.c_cc[VTIME] = 0;
+    cfsetispeed(&config, speed);
+    cfsetospeed(&config, speed);
+
+    if (tcsetattr(fd, TCSANOW, &config) != 0) {
+        *error = strerror(errno);
+        close(fd);
+        return -1;
+    }
+
+    tcflush(fd, TCIFLUSH);
+    return fd;
+}
+
+int open_bus_input(const char* path, uint32_t baudrate, std::string* error) {
+    auto fd = open(path, O_RDONLY | O_NOCTTY);
+
+    if (fd < 0) {
+        *error = strerror(errno);
+        return -1;
+    }
+
+    if (!isatty(fd)) {
+        return fd;
+    }
+
+    return configure_tty(fd, baudrate, error);
+}
+
+int open_bus(const char* path, uint32_t baudrate, std::string* error) {
+    auto fd = open(path, O_RDWR | O_NOCTTY);
+
+    if (fd < 0) {
+        *error = strerror(errno);
+        return -1;
+    }
+
+    if (!isatty(fd)) {
+        *error = "not a serial port or pty";
+        close(fd);
+        return -1;
+    }
+
+    return configure_tty(fd, baudrate, error);
+}
+
+int create_bus_pty(std::string* path, std::string* error) {
+    auto fd = posix_openpt(O_RDWR | O_NOCTTY);
+
+    if (fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0) {
+        *error = strerror(errno);
+
+        if (fd >= 0) {
+            close(fd);
+        }
+
+        return -1;
+    }
+
+    *path = ptsname(fd);
+
+    // without a process on the other side, reads return errors; this side never closes it
+    auto other_fd = open(path->c_str(), O_RDWR | O_NOCTTY);
+
+    if (other_fd < 0) {
+        *error = strerror(errno);
+        close(fd);
+        return -1;
+    }
+
+    // the raw mode (no echo) is a setting of the other side
+    termios config;
+
+    if (tcgetattr(other_fd, &config) != 0) {
+        *error = strerror(errno);
+        close(other_fd);
+        close(fd);
+        return -1;
+    }
+
+    cfmakeraw(&config);
+
+    if (tcsetattr(other_fd, TCSANOW, &config) != 0) {
+        *error = strerror(errno);
+        close(other_fd);
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+bool write_bus(int fd, const uint8_t* data, size_t len) {
+    while (len > 0) {
+        auto written = write(fd, data, len);
+
+        if (written < 0) {
+            if (errno == EINTR || errno == EAGAIN) {
+                continue;
+            }
+
+            return false;
+        }
+
+        data += written;
+        len -= written;
+    }
+
+    return true;
+}
@@ -0,0 +1,28 @@
+#ifndef BUS_INPUT_H
+#define BUS_INPUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+/// Opens `path` to read the data received on a bus. Serial ports (e.g. a USB-RS485 adapter)
+/// and ptys are switched to raw mode at `baudrate`, anything else (e.g. a capture file) is
+/// read as is. Returns the file descriptor or -1, in which case `error` is set.
+int open_bus_input(const char* path, uint32_t baudrate, std::string* error);
+
+/// Opens the serial port or pty at `path` to send and receive data on a bus (e.g. as its
+/// master), in raw mode at `baudrate`. Returns the file descriptor or -1, in which case
+/// `error` is set.
+int open_bus(const char* path, uint32_t baudrate, std::string* error);
+
+/// Creates a pty in raw mode that another process opens as a bus (see `open_bus_input` and
+/// `open_bus`). The other side is kept open, so the pty can be opened and closed any number
+/// of times. Sets `path` to the path of the other side. Returns the file descriptor of this
+/// side or -1, in which case `error` is set.
+int create_bus_pty(std::string* path, std::string* error);
+
+/// Writes all `len` bytes of `data` to a bus opened with `open_bus` or `create_bus_pty`.
+/// Returns `false` on errors.
+bool write_bus(int fd, const uint8_t* data, size_t len);
+
+#endif
@@ -0,0 +1,52 @@
+#include "host/mapped_file.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile() : data_(nullptr), len_(0) {}
+
+MappedFile::~MappedFile() {
+    if (this->len_ > 0) {
+        munmap((void*) this->data_, this->len_);
+    }
+}
+
+bool MappedFile::open(const char* path, std::string* error) {
+    auto fd = ::open(path, O_RDONLY);
+
+    if (fd < 0) {
+        *error = strerror(errno);
+        return false;
+    }
+
+    struct stat file_stat;
+
+    if (fstat(fd, &file_stat) != 0) {
+        *error = strerror(errno);
+        close(fd);
+        return false;
+    }
+
+    // an empty file cannot be mapped, but it is still a valid (empty) file
+    if (file_stat.st_size > 0) {
+        auto data = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (data == MAP_FAILED) {
+            *error = strerror(errno);
+            close(fd);
+            return false;
+        }
+
+        madvise(data, file_stat.st_size, MADV_SEQUENTIAL);
+        this->data_ = (const uint8_t*) data;
+        this->len_ = file_stat.st_size;
+    }
+
+    // the mapping stays valid after the file has been closed
+    close(fd);
+    return true;
+}
@@ -0,0 +1,37 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+/// A file that is mapped into memory read-only, so large captures can be read without
+/// copying them. The mapping is hinted for sequential access.
+class MappedFile {
+  public:
+    MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile();
+
+    /// Maps the file at `path`. Must only be called once. Returns `false` and sets `error` if
+    /// this fails.
+    bool open(const char* path, std::string* error);
+
+    const uint8_t* data() const {
+        return this->data_;
+    }
+
+    size_t len() const {
+        return this->len_;
+    }
+
+  private:
+    const uint8_t* data_;
+    size_t len_;
+};
+
+#endif
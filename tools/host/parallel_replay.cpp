@@ -0,0 +1,126 @@
+#include "host/parallel_replay.h"
+#include "capture_segments.h"
+#include "checkpoint.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+/// The segments are small enough that every thread scans several of them, so a slow segment
+/// does not stall the others, and large enough that completing the packets after a segment
+/// is negligible.
+static const size_t MIN_SEGMENT_LEN = 64 * 1024;
+static const size_t MAX_SEGMENT_LEN = 1024 * 1024;
+static const size_t SEGMENTS_PER_THREAD = 4;
+
+CaptureResult replay_parallel(
+    const uint8_t* capture,
+    size_t len,
+    size_t num_threads,
+    ControlTableMap* map,
+    ParallelReplayStats* stats) {
+    stats->num_segments = 0;
+    stats->num_resyncs = 0;
+    CaptureReader reader(capture, len);
+    auto result = reader.open();
+
+    if (result != CaptureResult::Ok) {
+        return result;
+    }
+
+    num_threads = std::max<size_t>(num_threads, 1);
+    auto num_buses = reader.num_buses();
+    stats->num_packets.assign(num_buses, 0);
+    stats->num_errors.assign(num_buses, 0);
+    auto segment_len = len / (num_threads * SEGMENTS_PER_THREAD);
+    segment_len = std::min(std::max(segment_len, MIN_SEGMENT_LEN), MAX_SEGMENT_LEN);
+
+    std::vector<size_t> boundaries;
+    result = split_capture(&reader, segment_len, &boundaries);
+    auto num_segments = boundaries.size() - 1;
+
+    // a segment is scanned into slot `index % slots.size()` once the one before it in the
+    // slot has been merged
+    std::vector<CaptureSegment> slots(2 * num_threads);
+    std::vector<bool> is_scanned(slots.size(), false);
+    std::mutex mutex;
+    std::condition_variable scanned;
+    std::condition_variable merged;
+    size_t next_segment = 0;
+    size_t num_merged = 0;
+
+    std::vector<std::thread> threads;
+
+    for (size_t i = 0; i < num_threads; i++) {
+        threads.emplace_back([&]() {
+            std::unique_lock<std::mutex> lock(mutex);
+
+            while (true) {
+                merged.wait(lock, [&]() {
+                    return next_segment == num_segments
+                        || next_segment < num_merged + slots.size();
+                });
+
+                if (next_segment == num_segments) {
+                    return;
+                }
+
+                auto index = next_segment++;
+                auto slot = index % slots.size();
+                lock.unlock();
+                scan_segment(capture, boundaries, index, &slots[slot]);
+                lock.lock();
+                is_scanned[slot] = true;
+                scanned.notify_all();
+            }
+        });
+    }
+
+    SegmentMerger merger(num_buses);
+    ScannedPacket packet;
+
+    auto apply = [&]() {
+        while (merger.next(&packet)) {
+            auto protocol_result = apply_scanned_packet(*map, packet);
+
+            if (packet.result == ParseResult::PacketAvailable) {
+                stats->num_packets[packet.bus]++;
+            }
+
+            if ((packet.result != ParseResult::PacketAvailable
+                 && packet.result != ParseResult::PacketFragment)
+                || protocol_result != ProtocolResult::Ok) {
+                stats->num_errors[packet.bus]++;
+            }
+        }
+    };
+
+    for (size_t index = 0; index < num_segments; index++) {
+        auto slot = index % slots.size();
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            scanned.wait(lock, [&]() { return is_scanned[slot]; });
+        }
+
+        merger.add(&slots[slot]);
+        apply();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        is_scanned[slot] = false;
+        num_merged++;
+        merged.notify_all();
+    }
+
+    merger.finish();
+    apply();
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    stats->num_segments = num_segments;
+    stats->num_resyncs = merger.num_resyncs();
+    return result;
+}
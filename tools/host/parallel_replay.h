@@ -0,0 +1,38 @@
+#ifndef PARALLEL_REPLAY_H
+#define PARALLEL_REPLAY_H
+
+#include "capture.h"
+#include "control_table.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/// What a `replay_parallel` found in a capture.
+struct ParallelReplayStats {
+    /// The number of packets and errors (invalid packets and packets that could not be
+    /// applied) per bus.
+    std::vector<uint64_t> num_packets;
+    std::vector<uint64_t> num_errors;
+
+    size_t num_segments;
+
+    /// See `SegmentMerger::num_resyncs`.
+    size_t num_resyncs;
+};
+
+/// Replays the capture of `len` bytes at `capture` to `map` (which must have as many buses as
+/// the capture) on `num_threads` threads. The segments of the capture (see `split_capture`)
+/// are scanned in parallel, while the calling thread merges them and applies the packets in
+/// order, since every response depends on the instruction before it. At most two segments
+/// per thread are held in memory. Returns `CaptureResult::End` if all chunks were replayed,
+/// otherwise the error of the reader (the packets before an invalid chunk are still
+/// replayed).
+CaptureResult replay_parallel(
+    const uint8_t* capture,
+    size_t len,
+    size_t num_threads,
+    ControlTableMap* map,
+    ParallelReplayStats* stats);
+
+#endif
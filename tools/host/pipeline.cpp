@@ -0,0 +1,91 @@
+#include "host/pipeline.h"
+
+const size_t HostPipeline::QUANTUM;
+
+HostPipeline::Bus::Bus(size_t bus, uint32_t baudrate) :
+    dma(NUM_SEGMENTS, SEGMENT_LEN),
+    connection(bus, &dma.buf(), baudrate) {}
+
+HostPipeline::HostPipeline(size_t num_buses, uint32_t baudrate, std::ostream* errors) :
+    errors(errors),
+    log(num_buses),
+    apply_stage(&queue),
+    control_table_map_(num_buses) {
+    for (size_t bus = 0; bus < num_buses; bus++) {
+        this->buses.push_back(std::unique_ptr<Bus>(new Bus(bus, baudrate)));
+    }
+}
+
+void HostPipeline::process_received(size_t bus) {
+    auto& connection = this->buses[bus]->connection;
+    auto write_count = this->buses[bus]->dma.buf().write_count();
+    size_t num_bytes;
+
+    do {
+        num_bytes = connection.process(write_count, QUANTUM, this->queue, this->log);
+        this->apply();
+    } while (num_bytes == QUANTUM);
+}
+
+void HostPipeline::process(size_t bus, const uint8_t* data, size_t len) {
+    auto& connection = this->buses[bus]->connection;
+
+    for (size_t pos = 0; pos < len; pos += QUANTUM) {
+        Cursor cursor(data + pos, std::min(QUANTUM, len - pos));
+        connection.process(cursor, this->queue, this->log);
+        this->apply();
+    }
+}
+
+void HostPipeline::apply() {
+    this->apply_stage.apply(this->control_table_map_, SIZE_MAX);
+    this->apply_stage.drain(this->log);
+
+    Log::Record record;
+
+    while (this->log.pop(&record)) {
+        *this->errors << to_string(record) << "\n";
+    }
+}
+
+void print_devices(std::ostream& out, const ControlTableMap& map, bool is_verbose) {
+    for (auto id_and_table : map) {
+        auto& control_table = id_and_table.second;
+        auto is_disconnected = map.is_disconnected(id_and_table.first);
+        out << "device " << id_and_table.first.to_string() << ": "
+            << control_table->device_name() << (is_disconnected ? " (disconnected)" : "")
+            << "\n";
+
+        if (is_verbose) {
+            for (auto& name_and_value : control_table->fmt_fields()) {
+                out << "    " << name_and_value.first << ": " << name_and_value.second << "\n";
+            }
+        }
+    }
+
+    out.flush();
+}
+
+void HostPipeline::print_devices(std::ostream& out, bool is_verbose) const {
+    ::print_devices(out, this->control_table_map_, is_verbose);
+}
+
+void HostPipeline::print_stats(std::ostream& out, Clock::Timestamp start) {
+    std::unique_ptr<LogStats> stats(new LogStats());
+    this->log.request_stats();
+    this->log.publish_stats();
+    this->log.read_stats(stats.get());
+
+    auto seconds = Clock::to_us(Clock::now() - start) / 1e6f;
+    uint64_t num_bytes = 0;
+
+    for (size_t bus = 0; bus < this->num_buses(); bus++) {
+        auto& bus_stats = stats->buses[bus];
+        num_bytes += bus_stats.num_bytes;
+        out << "bus " << bus << ": " << bus_stats.num_bytes << " bytes, "
+            << bus_stats.num_packets << " packets, " << bus_stats.num_errors << " errors\n";
+    }
+
+    out << "processed " << num_bytes << " bytes in " << seconds << "s ("
+        << num_bytes / seconds / 1e6f << " MB/s)" << std::endl;
+}
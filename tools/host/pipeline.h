@@ -0,0 +1,89 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "apply_stage.h"
+#include "clock.h"
+#include "connection.h"
+#include "control_table.h"
+#include "log.h"
+#include "packet_queue.h"
+#include "software_dma.h"
+
+#include <memory>
+#include <ostream>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/// Writes the state of every device in `map`. `is_verbose` includes the value of every field.
+void print_devices(std::ostream& out, const ControlTableMap& map, bool is_verbose);
+
+/// The firmware's packet pipeline for the host tools. Both stages run in turn on the calling
+/// thread instead of in separate tasks. Errors are written to an output stream as soon as
+/// they have been logged.
+class HostPipeline {
+  public:
+    /// The receive ring of every bus, like on the target.
+    static const size_t NUM_SEGMENTS = 32;
+    static const size_t SEGMENT_LEN = 256;
+
+    /// The maximum number of bytes parsed before the queued packets are applied. Small enough
+    /// that even a quantum full of the shortest packets fits into the `PacketQueue`.
+    static const size_t QUANTUM = 512;
+
+    /// Creates the pipeline for `num_buses` buses (at most `MAX_NUM_BUSES`). Errors are
+    /// written to `errors`.
+    HostPipeline(size_t num_buses, uint32_t baudrate, std::ostream* errors);
+
+    HostPipeline(const HostPipeline&) = delete;
+
+    HostPipeline& operator=(const HostPipeline&) = delete;
+
+    size_t num_buses() const {
+        return this->buses.size();
+    }
+
+    /// Returns the receive ring of `bus`. Data written to it is processed by
+    /// `process_received`.
+    SoftwareDma& dma(size_t bus) {
+        return this->buses[bus]->dma;
+    }
+
+    /// Processes everything written to the receive ring of `bus` since the last call.
+    void process_received(size_t bus);
+
+    /// Processes `len` bytes received on `bus` directly from memory, without copying them to
+    /// the receive ring.
+    void process(size_t bus, const uint8_t* data, size_t len);
+
+    const ControlTableMap& control_table_map() const {
+        return this->control_table_map_;
+    }
+
+    /// Writes the state of every device. `is_verbose` includes the value of every field.
+    void print_devices(std::ostream& out, bool is_verbose) const;
+
+    /// Writes the number of bytes, packets and errors per bus and the throughput since
+    /// `start`.
+    void print_stats(std::ostream& out, Clock::Timestamp start);
+
+  private:
+    struct Bus {
+        Bus(size_t bus, uint32_t baudrate);
+
+        SoftwareDma dma;
+        Connection connection;
+    };
+
+    /// Applies the queued packets and writes the logged errors.
+    void apply();
+
+    std::ostream* errors;
+    std::vector<std::unique_ptr<Bus>> buses;
+    Log log;
+    PacketQueue queue;
+    ApplyStage apply_stage;
+    ControlTableMap control_table_map_;
+};
+
+#endif
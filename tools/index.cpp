@@ -0,0 +1,226 @@
+#include "capture.h"
+#include "capture_index.h"
+#include "host/mapped_file.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <set>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+// Indexes captures recorded by `monitor -w` (see `src/capture_index.h`) and finds packets by
+// device, instruction and time with the index. `build` parses the whole capture once and
+// writes the index next to it (`<capture>.idx`). `query` reads the index, seeks to the
+// matching packets and only parses these. Times are in seconds since the capture started.
+// All given filters have to match.
+//
+// usage: index build <capture>
+//        index query [-d device] [-n instruction] [-t from-to] <capture>
+
+/// Maps the capture at `path` and opens it. Exits on errors.
+static void open_capture(const char* path, MappedFile* file, CaptureReader* reader) {
+    std::string error;
+
+    if (!file->open(path, &error)) {
+        std::cerr << "error: cannot open `" << path << "`: " << error << std::endl;
+        exit(1);
+    }
+
+    *reader = CaptureReader(file->data(), file->len());
+    auto result = reader->open();
+
+    if (result != CaptureResult::Ok) {
+        std::cerr << "error: cannot read `" << path << "`: " << to_string(result) << std::endl;
+        exit(1);
+    }
+}
+
+static void build(const char* path) {
+    MappedFile file;
+    CaptureReader reader(nullptr, 0);
+    open_capture(path, &file, &reader);
+
+    CaptureScanner scanner(&reader);
+    CaptureIndexBuilder builder(reader.num_buses());
+    ScannedPacket packet;
+    CaptureResult result;
+
+    while ((result = scanner.next(&packet)) == CaptureResult::Ok) {
+        builder.add(packet);
+    }
+
+    if (result != CaptureResult::End) {
+        std::cerr << "warning: index ends early: " << to_string(result) << std::endl;
+    }
+
+    auto index_path = std::string(path) + ".idx";
+    std::ofstream index_file(index_path, std::ios::binary);
+    builder.write(&index_file, file.len());
+    index_file.flush();
+
+    if (!index_file) {
+        std::cerr << "error: cannot write `" << index_path << "`" << std::endl;
+        exit(1);
+    }
+
+    std::cout << "indexed " << builder.num_packets() << " packets" << std::endl;
+}
+
+static void print_packet(const ScannedPacket& packet) {
+    auto& data = packet.packet->data;
+    std::cout << std::fixed << std::setprecision(6) << packet.timestamp / 1e6 << " bus "
+              << packet.bus << ": " << to_string(packet.packet->instruction) << " device "
+              << packet.packet->device_id << " error " << (int) packet.packet->error.to_byte()
+              << ", " << packet.packet->data_offset + data.size() << " bytes";
+
+    // only the last fragment of large packets is available
+    if (packet.packet->data_offset == 0) {
+        std::cout << ":" << std::hex << std::setfill('0');
+
+        for (auto byte : data) {
+            std::cout << " " << std::setw(2) << (int) byte;
+        }
+
+        std::cout << std::dec << std::setfill(' ');
+    }
+
+    std::cout << "\n";
+}
+
+static void query(int argc, char** argv) {
+    std::vector<IndexKey> keys;
+    uint64_t from = 0;
+    uint64_t to = UINT64_MAX;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:n:t:")) != -1) {
+        switch (opt) {
+            case 'd': {
+                keys.push_back(IndexKey::device(DeviceId((uint8_t) strtoul(optarg, nullptr, 10))));
+                break;
+            }
+            case 'n': {
+                Instruction instruction;
+
+                if (!instruction_from_string(optarg, &instruction)) {
+                    std::cerr << "error: unknown instruction `" << optarg << "`" << std::endl;
+                    exit(1);
+                }
+
+                keys.push_back(IndexKey::instruction(instruction));
+                break;
+            }
+            case 't': {
+                char* end;
+                from = (uint64_t) (strtod(optarg, &end) * 1e6);
+
+                if (*end == '-' && end[1] != '\0') {
+                    to = (uint64_t) (strtod(end + 1, nullptr) * 1e6);
+                } else if (*end != '-') {
+                    std::cerr << "error: expected a time range like `120-180`" << std::endl;
+                    exit(1);
+                }
+
+                break;
+            }
+            default: { exit(1); }
+        }
+    }
+
+    if (optind >= argc) {
+        std::cerr << "error: missing capture path" << std::endl;
+        exit(1);
+    }
+
+    if (keys.empty()) {
+        std::cerr << "error: expected a device or an instruction" << std::endl;
+        exit(1);
+    }
+
+    auto path = argv[optind];
+    MappedFile file;
+    CaptureReader reader(nullptr, 0);
+    open_capture(path, &file, &reader);
+
+    auto index_path = std::string(path) + ".idx";
+    MappedFile index_file;
+    std::string error;
+
+    if (!index_file.open(index_path.c_str(), &error)) {
+        std::cerr << "error: cannot open `" << index_path << "`: " << error
+                  << " (see `index build`)" << std::endl;
+        exit(1);
+    }
+
+    CaptureIndex index(index_file.data(), index_file.len());
+    auto result = index.open(file.len());
+    std::vector<IndexEntry> entries;
+
+    if (result == CaptureIndexResult::Ok) {
+        result = index.find(keys[0], from, to, &entries);
+    }
+
+    // the other filters only remove entries
+    for (size_t i = 1; i < keys.size() && result == CaptureIndexResult::Ok; i++) {
+        std::vector<IndexEntry> other_entries;
+        result = index.find(keys[i], from, to, &other_entries);
+        std::set<std::pair<size_t, size_t>> locations;
+
+        for (auto& entry : other_entries) {
+            locations.insert({entry.location.chunk_offset, entry.location.pos});
+        }
+
+        auto end = std::remove_if(entries.begin(), entries.end(), [&](const IndexEntry& entry) {
+            return locations.count({entry.location.chunk_offset, entry.location.pos}) == 0;
+        });
+        entries.erase(end, entries.end());
+    }
+
+    if (result != CaptureIndexResult::Ok) {
+        std::cerr << "error: cannot read `" << index_path << "`: " << to_string(result)
+                  << std::endl;
+        exit(1);
+    }
+
+    CaptureScanner scanner(&reader);
+    ScannedPacket packet;
+
+    for (auto& entry : entries) {
+        scanner.seek(entry.location);
+
+        while (scanner.next(&packet) == CaptureResult::Ok) {
+            if (packet.result == ParseResult::PacketAvailable
+                && packet.location == entry.location) {
+                print_packet(packet);
+                break;
+            }
+        }
+    }
+
+    std::cout.flush();
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "error: expected `build` or `query`" << std::endl;
+        exit(1);
+    }
+
+    // the options follow the command
+    if (strcmp(argv[1], "build") == 0 && argc == 3) {
+        build(argv[2]);
+    } else if (strcmp(argv[1], "query") == 0) {
+        query(argc - 1, argv + 1);
+    } else {
+        std::cerr << "error: expected `build <capture>` or `query [options] <capture>`"
+                  << std::endl;
+        exit(1);
+    }
+
+    exit(0);
+}
@@ -0,0 +1,204 @@
+#include "clock.h"
+#include "histogram.h"
+#include "host/bus_input.h"
+#include "master_script.h"
+
+#include <fstream>
+#include <iostream>
+#include <poll.h>
+#include <signal.h>
+#include <sstream>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+// Drives the devices on a bus like a controller: sends the instructions of a master script
+// (see `src/master_script.h`) in every control cycle and waits for the responses to every
+// instruction, until they arrived or the timeout (in us) elapsed. Cycles start every interval
+// (in us) or as soon as the last one ended. Together with `farm`, which emulates the devices,
+// and `monitor` on the farm's tap, this soak-tests the whole pipeline without hardware. Once
+// all cycles have been sent (`-n`, all until Ctrl+C by default), the tool prints the number
+// of responses, timeouts and errors and the latency from the end of an instruction to its
+// last response.
+//
+// usage: master [-b baudrate] [-n cycles] [-i interval in us] [-t timeout in us] <script> <bus>
+
+static volatile sig_atomic_t is_interrupted = 0;
+
+/// Waits until `Clock::now()` reaches `timestamp`.
+static void sleep_until(Clock::Timestamp timestamp) {
+    auto now = Clock::now();
+
+    if (timestamp <= now) {
+        return;
+    }
+
+    auto ns = (timestamp - now) * (1000 / Clock::TICKS_PER_US);
+    timespec duration{(time_t) (ns / 1000000000), (long) (ns % 1000000000)};
+    nanosleep(&duration, nullptr);
+}
+
+int main(int argc, char** argv) {
+    uint32_t baudrate = 1000000;
+    uint64_t num_cycles = 0;
+    uint32_t interval_us = 0;
+    uint32_t timeout_us = 10000;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "b:n:i:t:")) != -1) {
+        switch (opt) {
+            case 'b': {
+                baudrate = strtoul(optarg, nullptr, 10);
+                break;
+            }
+            case 'n': {
+                num_cycles = strtoull(optarg, nullptr, 10);
+                break;
+            }
+            case 'i': {
+                interval_us = strtoul(optarg, nullptr, 10);
+                break;
+            }
+            case 't': {
+                timeout_us = strtoul(optarg, nullptr, 10);
+                break;
+            }
+            default: { exit(1); }
+        }
+    }
+
+    if (argc - optind != 2) {
+        std::cerr << "error: expected a script and a bus" << std::endl;
+        exit(1);
+    }
+
+    auto script_path = argv[optind];
+    auto bus_path = argv[optind + 1];
+    std::ifstream script_file(script_path);
+
+    if (!script_file) {
+        std::cerr << "error: cannot open `" << script_path << "`" << std::endl;
+        exit(1);
+    }
+
+    std::stringstream text;
+    text << script_file.rdbuf();
+    MasterScript script;
+    std::string error;
+
+    if (!script.parse(text.str(), &error)) {
+        std::cerr << "error: " << script_path << ": " << error << std::endl;
+        exit(1);
+    }
+
+    auto bus = open_bus(bus_path, baudrate, &error);
+
+    if (bus < 0) {
+        std::cerr << "error: cannot open `" << bus_path << "`: " << error << std::endl;
+        exit(1);
+    }
+
+    signal(SIGINT, [](int) { is_interrupted = 1; });
+
+    Parser parser;
+    Packet packet{DeviceId(0), Instruction::Ping, Error(), {}};
+    std::vector<uint8_t> chunk(4096);
+    Histogram latencies;
+    uint64_t cycle = 0;
+    uint64_t num_responses = 0;
+    uint64_t num_status_errors = 0;
+    uint64_t num_timeouts = 0;
+    uint64_t num_errors = 0;
+    auto start = Clock::now();
+
+    for (; (num_cycles == 0 || cycle < num_cycles) && !is_interrupted; cycle++) {
+        auto cycle_start = Clock::now();
+
+        for (auto& step : script.steps()) {
+            if (!write_bus(bus, script.data() + step.offset, step.len)) {
+                std::cerr << "error: cannot write `" << bus_path << "`" << std::endl;
+                exit(1);
+            }
+
+            auto sent = Clock::now();
+            auto timeout = sent + (Clock::Timestamp) timeout_us * Clock::TICKS_PER_US;
+            auto last_response = sent;
+            size_t num_step_responses = 0;
+
+            while (num_step_responses < step.num_responses && !is_interrupted) {
+                auto now = Clock::now();
+
+                if (now >= timeout) {
+                    break;
+                }
+
+                auto remaining_ns = (timeout - now) * (1000 / Clock::TICKS_PER_US);
+                timespec remaining{(time_t) (remaining_ns / 1000000000),
+                                   (long) (remaining_ns % 1000000000)};
+                pollfd fd{bus, POLLIN, 0};
+
+                if (ppoll(&fd, 1, &remaining, nullptr) <= 0) {
+                    continue;
+                }
+
+                auto len = read(bus, chunk.data(), chunk.size());
+
+                if (len <= 0) {
+                    std::cerr << "error: cannot read `" << bus_path << "`" << std::endl;
+                    exit(1);
+                }
+
+                Cursor cursor(chunk.data(), len);
+                ParseResult result;
+
+                while ((result = parser.parse(cursor, &packet)) != ParseResult::NeedMoreData) {
+                    if (result == ParseResult::PacketFragment) {
+                        continue;
+                    }
+
+                    if (result != ParseResult::PacketAvailable) {
+                        num_errors++;
+                        continue;
+                    }
+
+                    if (packet.instruction != Instruction::Status) {
+                        continue;
+                    }
+
+                    if (!packet.error.is_ok()) {
+                        num_status_errors++;
+                    }
+
+                    last_response = Clock::now();
+                    num_step_responses++;
+                    num_responses++;
+                }
+            }
+
+            // a broadcast ping always waits for the timeout
+            if (step.num_responses != MasterScript::UNKNOWN_NUM_RESPONSES
+                && num_step_responses < step.num_responses) {
+                num_timeouts++;
+            } else if (num_step_responses > 0) {
+                latencies.record((uint32_t) ((last_response - sent) / Clock::TICKS_PER_US));
+            }
+        }
+
+        sleep_until(cycle_start + (Clock::Timestamp) interval_us * Clock::TICKS_PER_US);
+    }
+
+    auto duration_s = (Clock::now() - start) / (1e6 * Clock::TICKS_PER_US);
+    std::cerr << cycle << " cycles in " << duration_s << " s (" << cycle / duration_s
+              << " cycles/s), " << num_responses << " responses (" << num_status_errors
+              << " with errors), " << num_timeouts << " timeouts, " << num_errors << " errors"
+              << std::endl;
+
+    if (latencies.count() > 0) {
+        std::cerr << "latency (us): min " << latencies.min() << ", mean " << latencies.mean()
+                  << ", p99 " << latencies.percentile(99.0f) << ", max " << latencies.max()
+                  << std::endl;
+    }
+
+    exit(0);
+}
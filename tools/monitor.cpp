@@ -0,0 +1,197 @@
+#include "capture.h"
+#include "clock.h"
+#include "control_table.h"
+#include "host/bus_input.h"
+#include "host/pipeline.h"
+#include "pcap_export.h"
+
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <vector>
+
+// Runs the firmware's packet pipeline on the host. Every input is a bus: a serial port (e.g.
+// a USB-RS485 adapter), a pty or a file of raw bus data. Errors are printed as they occur,
+// the state of all devices periodically and once all inputs have ended (or on Ctrl+C)
+// together with the throughput. The received data can be recorded to a capture (see
+// `src/capture.h`), which can be replayed with `replay`, and every received packet can be
+// written to a pcap file for Wireshark (see `src/pcap_export.h`).
+//
+// usage: monitor [-b baudrate] [-i interval in ms] [-v] [-w capture] [-p pcap] <input>...
+
+static volatile sig_atomic_t is_interrupted = 0;
+
+int main(int argc, char** argv) {
+    uint32_t baudrate = 1000000;
+    uint32_t interval_ms = 1000;
+    bool is_verbose = false;
+    const char* capture_path = nullptr;
+    const char* pcap_path = nullptr;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "b:i:vw:p:")) != -1) {
+        switch (opt) {
+            case 'b': {
+                baudrate = strtoul(optarg, nullptr, 10);
+                break;
+            }
+            case 'i': {
+                interval_ms = strtoul(optarg, nullptr, 10);
+                break;
+            }
+            case 'v': {
+                is_verbose = true;
+                break;
+            }
+            case 'w': {
+                capture_path = optarg;
+                break;
+            }
+            case 'p': {
+                pcap_path = optarg;
+                break;
+            }
+            default: { exit(1); }
+        }
+    }
+
+    size_t num_buses = argc - optind;
+
+    if (num_buses == 0 || num_buses > MAX_NUM_BUSES) {
+        std::cerr << "error: expected 1 to " << MAX_NUM_BUSES << " inputs" << std::endl;
+        exit(1);
+    }
+
+    if (baudrate == 0) {
+        std::cerr << "error: invalid baudrate" << std::endl;
+        exit(1);
+    }
+
+    std::vector<int> inputs;
+
+    for (size_t bus = 0; bus < num_buses; bus++) {
+        auto path = argv[optind + bus];
+        std::string error;
+        auto fd = open_bus_input(path, baudrate, &error);
+
+        if (fd < 0) {
+            std::cerr << "error: cannot open `" << path << "`: " << error << std::endl;
+            exit(1);
+        }
+
+        inputs.push_back(fd);
+    }
+
+    std::ofstream capture_file;
+    std::unique_ptr<CaptureWriter> capture;
+
+    if (capture_path) {
+        capture_file.open(capture_path, std::ios::binary);
+
+        if (!capture_file) {
+            std::cerr << "error: cannot create `" << capture_path << "`" << std::endl;
+            exit(1);
+        }
+
+        capture.reset(new CaptureWriter(&capture_file, num_buses));
+    }
+
+    std::ofstream pcap_file;
+    std::unique_ptr<PcapWriter> pcap;
+    std::unique_ptr<PcapExporter> pcap_exporter;
+
+    if (pcap_path) {
+        pcap_file.open(pcap_path, std::ios::binary);
+
+        if (!pcap_file) {
+            std::cerr << "error: cannot create `" << pcap_path << "`" << std::endl;
+            exit(1);
+        }
+
+        pcap.reset(new PcapWriter(&pcap_file, PCAP_LINK_TYPE));
+        pcap_exporter.reset(new PcapExporter(pcap.get(), num_buses, baudrate));
+    }
+
+    signal(SIGINT, [](int) { is_interrupted = 1; });
+
+    // the pipeline is too large for the stack
+    std::unique_ptr<HostPipeline> pipeline(new HostPipeline(num_buses, baudrate, &std::cout));
+    auto start = Clock::now();
+    auto last_print = start;
+    size_t num_open = num_buses;
+    std::vector<pollfd> fds(num_buses);
+    std::vector<uint8_t> chunk(HostPipeline::NUM_SEGMENTS * HostPipeline::SEGMENT_LEN / 2);
+
+    while (num_open > 0 && !is_interrupted) {
+        for (size_t bus = 0; bus < num_buses; bus++) {
+            fds[bus] = pollfd{inputs[bus], POLLIN, 0};
+        }
+
+        if (poll(fds.data(), fds.size(), interval_ms) < 0) {
+            continue;
+        }
+
+        for (size_t bus = 0; bus < num_buses; bus++) {
+            if (fds[bus].revents == 0) {
+                continue;
+            }
+
+            // a filled half is processed right away, so nothing is overwritten
+            auto len = read(inputs[bus], chunk.data(), chunk.size());
+            auto now = Clock::now();
+
+            if (len <= 0) {
+                // a pty reports the end of the other side as an error
+                close(inputs[bus]);
+                inputs[bus] = -1;
+                num_open--;
+                continue;
+            }
+
+            if (capture) {
+                capture->write((now - start) / Clock::TICKS_PER_US, bus, chunk.data(), len);
+            }
+
+            if (pcap_exporter) {
+                pcap_exporter->add((now - start) / Clock::TICKS_PER_US, bus, chunk.data(), len);
+            }
+
+            pipeline->dma(bus).write(chunk.data(), len);
+            pipeline->process_received(bus);
+        }
+
+        auto now = Clock::now();
+
+        if (now - last_print >= (Clock::Timestamp) interval_ms * 1000 * Clock::TICKS_PER_US) {
+            pipeline->print_devices(std::cout, is_verbose);
+            last_print = now;
+        }
+    }
+
+    pipeline->print_devices(std::cout, is_verbose);
+    pipeline->print_stats(std::cerr, start);
+
+    // `exit` does not flush the files
+    capture_file.flush();
+
+    if (capture && !capture->is_ok()) {
+        std::cerr << "error: cannot write `" << capture_path << "`" << std::endl;
+        exit(1);
+    }
+
+    if (pcap) {
+        pcap->flush();
+        pcap_file.flush();
+
+        if (!pcap->is_ok()) {
+            std::cerr << "error: cannot write `" << pcap_path << "`" << std::endl;
+            exit(1);
+        }
+    }
+
+    exit(0);
+}
@@ -0,0 +1,86 @@
+#include "capture.h"
+#include "host/mapped_file.h"
+#include "pcap_export.h"
+
+#include <fstream>
+#include <iostream>
+#include <stdlib.h>
+#include <unistd.h>
+
+// Converts a capture recorded by `monitor -w` into a pcap file for Wireshark (see
+// `src/pcap_export.h`). Every packet is a frame with the raw bytes received on the bus,
+// including packets with mismatched checksums. `etc/dynamixel.lua` decodes the frames. With
+// `-b`, the time of every packet is calculated from the baudrate instead of using the time of
+// the chunk in which it was received.
+//
+// usage: pcap [-b baudrate] <capture> <pcap>
+
+int main(int argc, char** argv) {
+    uint32_t baudrate = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "b:")) != -1) {
+        switch (opt) {
+            case 'b': {
+                baudrate = strtoul(optarg, nullptr, 10);
+                break;
+            }
+            default: { exit(1); }
+        }
+    }
+
+    if (argc - optind != 2) {
+        std::cerr << "error: expected a capture and a pcap path" << std::endl;
+        exit(1);
+    }
+
+    auto path = argv[optind];
+    auto pcap_path = argv[optind + 1];
+    MappedFile file;
+    std::string error;
+
+    if (!file.open(path, &error)) {
+        std::cerr << "error: cannot open `" << path << "`: " << error << std::endl;
+        exit(1);
+    }
+
+    CaptureReader reader(file.data(), file.len());
+    auto result = reader.open();
+
+    if (result != CaptureResult::Ok) {
+        std::cerr << "error: cannot read `" << path << "`: " << to_string(result) << std::endl;
+        exit(1);
+    }
+
+    std::ofstream pcap_file(pcap_path, std::ios::binary);
+
+    if (!pcap_file) {
+        std::cerr << "error: cannot create `" << pcap_path << "`" << std::endl;
+        exit(1);
+    }
+
+    PcapWriter writer(&pcap_file, PCAP_LINK_TYPE);
+    PcapExporter exporter(&writer, reader.num_buses(), baudrate);
+    CaptureChunk chunk;
+
+    while ((result = reader.next(&chunk)) == CaptureResult::Ok) {
+        if (chunk.kind == CaptureChunkKind::Data) {
+            exporter.add(chunk.timestamp, chunk.bus, chunk.data, chunk.len);
+        }
+    }
+
+    if (result != CaptureResult::End) {
+        std::cerr << "warning: export ends early: " << to_string(result) << std::endl;
+    }
+
+    writer.flush();
+    pcap_file.flush();
+
+    if (!writer.is_ok()) {
+        std::cerr << "error: cannot write `" << pcap_path << "`" << std::endl;
+        exit(1);
+    }
+
+    std::cout << "exported " << exporter.num_frames() << " packets" << std::endl;
+    exit(0);
+}
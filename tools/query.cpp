@@ -0,0 +1,188 @@
+#include "capture.h"
+#include "capture_index.h"
+#include "capture_query.h"
+#include "field_export.h"
+#include "host/mapped_file.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <set>
+#include <stdlib.h>
+#include <string.h>
+#include <utility>
+#include <vector>
+
+// Prints the packets of a capture recorded by `monitor -w` that match all filters (see
+// `src/capture_query.h`), e.g. `device=5 instruction=SyncWrite field="Goal Position"
+// t=120s..180s` or `status.error!=0`. Filters on the header of a packet are checked before its
+// payload is decoded. If the capture has an index (see `index build`) and the filters select a
+// device or an instruction, only the packets listed in the index are parsed. Otherwise the
+// capture is scanned up to the end of the time range. Every row is a packet, followed by the
+// values of the queried field.
+//
+// usage: query [filters...] <capture>
+
+/// Maps the file at `path`. Exits on errors.
+static void open_file(const char* path, MappedFile* file) {
+    std::string error;
+
+    if (!file->open(path, &error)) {
+        std::cerr << "error: cannot open `" << path << "`: " << error << std::endl;
+        exit(1);
+    }
+}
+
+static void print_packet(const ScannedPacket& packet, const CaptureQuery& query) {
+    auto& data = packet.packet->data;
+    std::cout << std::fixed << std::setprecision(6) << packet.timestamp / 1e6 << " bus "
+              << packet.bus << ": " << to_string(packet.packet->instruction) << " device "
+              << packet.packet->device_id << " error " << (int) packet.packet->error.to_byte()
+              << ", " << packet.packet->data_offset + data.size() << " bytes";
+
+    // only the last fragment of large packets is available
+    if (packet.packet->data_offset == 0) {
+        std::cout << ":" << std::hex << std::setfill('0');
+
+        for (auto byte : data) {
+            std::cout << " " << std::setw(2) << (int) byte;
+        }
+
+        std::cout << std::dec << std::setfill(' ');
+    }
+
+    if (!query.field_values().empty()) {
+        std::cout << " | " << query.field_name() << ":";
+
+        for (auto& value : query.field_values()) {
+            std::cout << " " << value.device_id << "=" << fmt_field_value(value.type, value.value);
+        }
+    }
+
+    std::cout << "\n";
+}
+
+/// Finds the packets listed under all `keys` in the index of the capture at `path`. Returns
+/// `false` if there is no usable index.
+static bool find_entries(
+    const char* path,
+    size_t capture_len,
+    const CaptureQuery& query,
+    const std::vector<IndexKey>& keys,
+    std::vector<IndexEntry>* entries) {
+    auto index_path = std::string(path) + ".idx";
+    MappedFile index_file;
+    std::string error;
+
+    if (!index_file.open(index_path.c_str(), &error)) {
+        return false;
+    }
+
+    CaptureIndex index(index_file.data(), index_file.len());
+    auto result = index.open(capture_len);
+
+    if (result == CaptureIndexResult::Ok) {
+        result = index.find(keys[0], query.from(), query.to(), entries);
+    }
+
+    // the other keys only remove entries
+    for (size_t i = 1; i < keys.size() && result == CaptureIndexResult::Ok; i++) {
+        std::vector<IndexEntry> other_entries;
+        result = index.find(keys[i], query.from(), query.to(), &other_entries);
+        std::set<std::pair<size_t, size_t>> locations;
+
+        for (auto& entry : other_entries) {
+            locations.insert({entry.location.chunk_offset, entry.location.pos});
+        }
+
+        auto end = std::remove_if(entries->begin(), entries->end(), [&](const IndexEntry& entry) {
+            return locations.count({entry.location.chunk_offset, entry.location.pos}) == 0;
+        });
+        entries->erase(end, entries->end());
+    }
+
+    if (result != CaptureIndexResult::Ok) {
+        std::cerr << "warning: ignoring `" << index_path << "`: " << to_string(result)
+                  << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "error: expected `query [filters...] <capture>`" << std::endl;
+        exit(1);
+    }
+
+    auto path = argv[argc - 1];
+    MappedFile file;
+    open_file(path, &file);
+
+    CaptureReader reader(file.data(), file.len());
+    auto result = reader.open();
+
+    if (result != CaptureResult::Ok) {
+        std::cerr << "error: cannot read `" << path << "`: " << to_string(result) << std::endl;
+        exit(1);
+    }
+
+    CaptureQuery query(reader.num_buses());
+    std::string error;
+
+    for (int i = 1; i < argc - 1; i++) {
+        if (!query.add_filter(argv[i], &error)) {
+            std::cerr << "error: " << error << std::endl;
+            exit(1);
+        }
+    }
+
+    CaptureScanner scanner(&reader);
+    ScannedPacket packet;
+    std::vector<IndexKey> keys;
+    std::vector<IndexEntry> entries;
+
+    if (query.index_keys(&keys) && find_entries(path, file.len(), query, keys, &entries)) {
+        for (auto& entry : entries) {
+            query.reset();
+            scanner.seek(entry.location);
+
+            // the fragments of a large packet share its location
+            while (scanner.next(&packet) == CaptureResult::Ok) {
+                if (!(packet.location == entry.location)) {
+                    continue;
+                }
+
+                if (query.matches(packet)) {
+                    print_packet(packet, query);
+                }
+
+                if (packet.result != ParseResult::PacketFragment) {
+                    break;
+                }
+            }
+        }
+
+        std::cout.flush();
+        exit(0);
+    }
+
+    while ((result = scanner.next(&packet)) == CaptureResult::Ok) {
+        // packets are completed in the order of their timestamps
+        if (packet.timestamp > query.to()) {
+            break;
+        }
+
+        if (query.matches(packet)) {
+            print_packet(packet, query);
+        }
+    }
+
+    if (result != CaptureResult::Ok && result != CaptureResult::End) {
+        std::cerr << "warning: query ends early: " << to_string(result) << std::endl;
+    }
+
+    std::cout.flush();
+    exit(0);
+}
@@ -0,0 +1,168 @@
+#include "capture.h"
+#include "clock.h"
+#include "host/mapped_file.h"
+#include "host/parallel_replay.h"
+#include "host/pipeline.h"
+
+#include <iostream>
+#include <memory>
+#include <stdlib.h>
+#include <unistd.h>
+
+// Replays a capture recorded by `monitor -w` through the firmware's packet pipeline. The
+// capture is mapped into memory and its chunks are parsed in place. By default the chunks are
+// replayed as fast as possible; `-s` replays them at a multiple of the original speed
+// (`-s 1` reproduces the original timing). Prints the same output as `monitor`.
+//
+// `-j` replays large captures on multiple threads instead: segments of the capture are parsed
+// in parallel and their packets are applied in order (see `tools/host/parallel_replay.h`).
+// Only the final state of the devices is printed, and the timing cannot be reproduced.
+//
+// usage: replay [-b baudrate] [-i interval in ms] [-s speed] [-v] <capture>
+//        replay -j threads [-v] <capture>
+
+/// Replays the capture with `replay_parallel` and prints the devices and statistics.
+static void replay_on_threads(
+    const MappedFile& file,
+    size_t num_buses,
+    size_t num_threads,
+    bool is_verbose) {
+    ControlTableMap map(num_buses);
+    ParallelReplayStats stats;
+    auto start = Clock::now();
+    auto result = replay_parallel(file.data(), file.len(), num_threads, &map, &stats);
+    auto seconds = Clock::to_us(Clock::now() - start) / 1e6f;
+
+    print_devices(std::cout, map, is_verbose);
+
+    for (size_t bus = 0; bus < num_buses; bus++) {
+        std::cerr << "bus " << bus << ": " << stats.num_packets[bus] << " packets, "
+                  << stats.num_errors[bus] << " errors\n";
+    }
+
+    std::cerr << "processed " << file.len() << " bytes in " << stats.num_segments
+              << " segments on " << num_threads << " threads (" << stats.num_resyncs
+              << " resyncs) in " << seconds << "s (" << file.len() / seconds / 1e6f << " MB/s)"
+              << std::endl;
+
+    if (result != CaptureResult::End) {
+        std::cerr << "error: cannot read the capture: " << to_string(result) << std::endl;
+        exit(1);
+    }
+}
+
+int main(int argc, char** argv) {
+    uint32_t baudrate = 1000000;
+    uint32_t interval_ms = 1000;
+    float speed = 0.0f;
+    size_t num_threads = 0;
+    bool is_verbose = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "b:i:j:s:v")) != -1) {
+        switch (opt) {
+            case 'b': {
+                baudrate = strtoul(optarg, nullptr, 10);
+                break;
+            }
+            case 'i': {
+                interval_ms = strtoul(optarg, nullptr, 10);
+                break;
+            }
+            case 'j': {
+                num_threads = strtoul(optarg, nullptr, 10);
+
+                if (num_threads == 0) {
+                    std::cerr << "error: expected at least one thread" << std::endl;
+                    exit(1);
+                }
+
+                break;
+            }
+            case 's': {
+                speed = strtof(optarg, nullptr);
+                break;
+            }
+            case 'v': {
+                is_verbose = true;
+                break;
+            }
+            default: { exit(1); }
+        }
+    }
+
+    if (optind >= argc) {
+        std::cerr << "error: missing capture path" << std::endl;
+        exit(1);
+    }
+
+    auto path = argv[optind];
+    MappedFile file;
+    std::string error;
+
+    if (!file.open(path, &error)) {
+        std::cerr << "error: cannot open `" << path << "`: " << error << std::endl;
+        exit(1);
+    }
+
+    CaptureReader reader(file.data(), file.len());
+    auto result = reader.open();
+
+    if (result == CaptureResult::Ok
+        && (reader.num_buses() == 0 || reader.num_buses() > MAX_NUM_BUSES)) {
+        result = CaptureResult::InvalidBus;
+    }
+
+    if (result != CaptureResult::Ok) {
+        std::cerr << "error: cannot read `" << path << "`: " << to_string(result) << std::endl;
+        exit(1);
+    }
+
+    if (num_threads > 0) {
+        if (speed > 0.0f) {
+            std::cerr << "error: `-j` cannot be combined with `-s`" << std::endl;
+            exit(1);
+        }
+
+        replay_on_threads(file, reader.num_buses(), num_threads, is_verbose);
+        exit(0);
+    }
+
+    std::unique_ptr<HostPipeline> pipeline(
+        new HostPipeline(reader.num_buses(), baudrate, &std::cout));
+    ReplayPacer pacer(speed);
+    auto start = Clock::now();
+    auto last_print = start;
+    auto interval = (Clock::Timestamp) interval_ms * 1000 * Clock::TICKS_PER_US;
+    CaptureChunk chunk;
+
+    while ((result = reader.next(&chunk)) == CaptureResult::Ok) {
+        if (chunk.kind != CaptureChunkKind::Data) {
+            continue;
+        }
+
+        auto delay = pacer.delay(chunk.timestamp, (Clock::now() - start) / Clock::TICKS_PER_US);
+
+        if (delay > 0) {
+            usleep(delay);
+        }
+
+        pipeline->process(chunk.bus, chunk.data, chunk.len);
+
+        // the interval refers to the replay, not to the capture
+        if (Clock::now() - last_print >= interval) {
+            pipeline->print_devices(std::cout, is_verbose);
+            last_print = Clock::now();
+        }
+    }
+
+    pipeline->print_devices(std::cout, is_verbose);
+    pipeline->print_stats(std::cerr, start);
+
+    if (result != CaptureResult::End) {
+        std::cerr << "error: cannot read `" << path << "`: " << to_string(result) << std::endl;
+        exit(1);
+    }
+
+    exit(0);
+}
@@ -0,0 +1,49 @@
+#include "trace.h"
+
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdlib.h>
+
+// Converts a dump of the firmware's trace ring into a Chrome trace JSON file. Create the
+// dump in GDB with `dump binary value trace.bin trace_ring` (requires `make TRACE=1`).
+//
+// usage: trace_to_json <dump> [ticks per us]
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "error: missing dump path" << std::endl;
+        exit(1);
+    }
+
+    uint32_t ticks_per_us = 216;
+
+    if (argc >= 3) {
+        ticks_per_us = strtoul(argv[2], nullptr, 10);
+
+        if (ticks_per_us == 0) {
+            std::cerr << "error: invalid ticks per us `" << argv[2] << "`" << std::endl;
+            exit(1);
+        }
+    }
+
+    std::ifstream file(argv[1], std::ios::binary);
+
+    if (!file) {
+        std::cerr << "error: cannot open `" << argv[1] << "`" << std::endl;
+        exit(1);
+    }
+
+    std::vector<uint8_t> dump(
+        (std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    std::vector<TraceRecord> records;
+    auto result = decode_trace_dump(dump.data(), dump.size(), &records);
+
+    if (result != TraceDecodeResult::Ok) {
+        std::cerr << "error: cannot decode `" << argv[1] << "`: " << to_string(result)
+                  << std::endl;
+        exit(1);
+    }
+
+    std::cout << to_chrome_trace_json(records, ticks_per_us);
+    exit(0);
+}